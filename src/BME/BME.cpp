@@ -1,4 +1,7 @@
 #include "BME.h"
+#include <cmath>
+#include "../HAL/Hal.h"
+#include "../Log/Log.h"
 
 namespace SmartAirControl {
 
@@ -8,7 +11,8 @@ namespace SmartAirControl {
             u_int8_t IIRFilterSize,
             int gasHeaterTemp,
             int gasHeaterDuration,
-            float seaLevelPressure_hPa)
+            float seaLevelPressure_hPa,
+            GasBaseline::State& baselineState)
           : bme(Adafruit_BME680()),
           tempOversampling(tempOversampling),
           humidityOversampling(humidityOversampling),
@@ -16,13 +20,14 @@ namespace SmartAirControl {
           IIRFilterSize(IIRFilterSize),
           gasHeaterTemp(gasHeaterTemp),
           gasHeaterDuration(gasHeaterDuration),
-          sealevelPressure_hPa(seaLevelPressure_hPa)
+          sealevelPressure_hPa(seaLevelPressure_hPa),
+          gasBaseline(baselineState)
             {}
 
     void BME::setup() {
       valid = bme.begin();
       if (!valid) {
-          Serial.println(F("[BME680] Could not find a valid BME680 sensor, check wiring!"));
+          LOG_ERROR(BME, "Could not find a valid BME680 sensor, check wiring!");
       }
 
       // Set up oversampling and filter initialization
@@ -31,6 +36,21 @@ namespace SmartAirControl {
       bme.setPressureOversampling(pressureOversampling);
       bme.setIIRFilterSize(IIRFilterSize);
       bme.setGasHeater(gasHeaterTemp, gasHeaterDuration);
+      heaterOn = true;
+
+      // the plate may have cooled down since the last reading
+      gasStable = false;
+      lastGasResistance = 0;
+      burstLeft = 0;
+      gasBaseline.restore(hal::rtcMillis());
+    }
+
+    void BME::setGasInterval(uint32_t intervalMs) {
+      gasIntervalMs = intervalMs;
+    }
+
+    bool BME::isGasStable() {
+      return gasStable;
     }
 
     bool BME::isValid() {
@@ -38,52 +58,125 @@ namespace SmartAirControl {
     }
 
     BMEData BME::read() {
-      BMEData bmeData = BMEData();
+      if (!startConversion()) {
+        return BMEData();
+      }
+      return finishConversion();
+    }
+
+    bool BME::startConversion() {
+      if (isConverting()) {
+        return true;
+      }
+
+      bool heat = isGasDue();
+      if (heat != heaterOn) {
+        // a heater temperature or time of 0 turns the gas measurement off
+        bme.setGasHeater(heat ? gasHeaterTemp : 0, heat ? gasHeaterDuration : 0);
+        heaterOn = heat;
+      }
+
       unsigned long endTime = bme.beginReading();
       if (endTime == 0) {
-        Serial.println(F("[BME680] Failed to begin reading!"));
-        return bmeData;
+        LOG_ERROR(BME, "Failed to begin reading!");
+        return false;
+      }
+      gasConversion = heat;
+
+      LOG_DEBUG(BME, "Reading started at %lu and will finish at %lu", hal::millis(), endTime);
+
+      conversionEnd = endTime;
+      return true;
+    }
+
+    bool BME::isGasDue() {
+      if (gasIntervalMs == 0 || !gasStable || burstLeft > 0) {
+        return true;
+      }
+      if (hal::millis() - lastBurst < gasIntervalMs) {
+        return false;
+      }
+      lastBurst = hal::millis();
+      burstLeft = GAS_BURST;
+      return true;
+    }
+
+    bool BME::isConverting() {
+      return conversionEnd != 0;
+    }
+
+    bool BME::poll() {
+      if (!isConverting() || (long)(hal::millis() - conversionEnd) < 0) {
+        return false;
       }
+      return collect();
+    }
 
-      Serial.print(F("[BME680] Reading started at "));
-      Serial.print(millis());
-      Serial.print(F(" and will finish at "));
-      Serial.println(endTime);
+    BMEData BME::finishConversion() {
+      if (!isConverting()) {
+        return BMEData();
+      }
+      // endReading() sleeps for whatever is left of the conversion time
+      if (!collect()) {
+        return BMEData();
+      }
+      return bmeData;
+    }
+
+    BMEData BME::getData() {
+      return bmeData;
+    }
+
+    bool BME::collect() {
+      conversionEnd = 0;
 
       if (!bme.endReading()) {
-        Serial.println(F("[BME680] Failed to complete reading!"));
-        return bmeData;
+        LOG_ERROR(BME, "Failed to complete reading!");
+        return false;
       }
 
       bmeData.temperature = bme.temperature;
       bmeData.pressure = bme.pressure / 100.0;
       bmeData.humidity = bme.humidity;
-      bmeData.altitude = bme.readAltitude(sealevelPressure_hPa);
-      bmeData.gasResistance = bme.gas_resistance / 1000.0;
+      // barometric formula as in Adafruit_BME680::readAltitude(), which would
+      // block on another (heated) conversion to get the pressure
+      bmeData.altitude = 44330.0 * (1.0 - std::pow(bmeData.pressure / sealevelPressure_hPa, 0.1903));
+
+      // the gas values stay those of the last gas reading in between, and
+      // while a burst warms the plate up
+      if (gasConversion && burstLeft > 0) {
+        burstLeft--;
+      }
+      if (gasConversion && burstLeft == 0) {
+        bmeData.gasResistance = bme.gas_resistance / 1000.0;
+
+        if (!gasStable && lastGasResistance > 0) {
+          float change = (bmeData.gasResistance - lastGasResistance) / lastGasResistance;
+          gasStable = change < GAS_STABLE_DELTA && change > -GAS_STABLE_DELTA;
+          lastBurst = hal::millis();
+        }
+        lastGasResistance = bmeData.gasResistance;
+
+        if (gasStable) {
+          bmeData.gasCompensated = gasBaseline.update(bmeData.gasResistance, bmeData.humidity, hal::rtcMillis());
+        } else {
+          bmeData.gasCompensated = GasBaseline::compensate(bmeData.gasResistance, bmeData.humidity);
+        }
+        bmeData.gasBaseline = gasBaseline.getBaseline();
+        bmeData.gasConfidence = gasBaseline.getConfidence();
+      }
 
       printSensorData(bmeData);
       
-      return bmeData;
+      return true;
     }
 
     void BME::printSensorData(BMEData& bmeData) {
-      Serial.println(F("[BME680]"));
-      Serial.println(F("---------------------------------------"));
-      Serial.print(F("Temperature: "));
-      Serial.print(bmeData.temperature);
-      Serial.println(F(" °C"));
-      Serial.print(F("Pressure: "));
-      Serial.print(bmeData.pressure);
-      Serial.println(F(" hPa"));
-      Serial.print(F("Humidity: "));
-      Serial.print(bmeData.humidity);
-      Serial.println(F(" %"));
-      Serial.print(F("Altitude: "));
-      Serial.print(bmeData.altitude);
-      Serial.println(F(" m"));
-      Serial.print(F("Gas Resistance: "));
-      Serial.print(bmeData.gasResistance);
-      Serial.println(F(" KOhm"));
+      LOG_DEBUG(BME, "Temperature: %.2f C  Pressure: %.2f hPa  Humidity: %.2f %%",
+                bmeData.temperature, bmeData.pressure, bmeData.humidity);
+      LOG_DEBUG(BME, "Altitude: %.2f m  Gas Resistance: %.2f KOhm", bmeData.altitude, bmeData.gasResistance);
+      LOG_DEBUG(BME, "Gas compensated: %.2f KOhm  Baseline: %.2f KOhm (confidence %u)", bmeData.gasCompensated,
+                bmeData.gasBaseline, bmeData.gasConfidence);
     }
 
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <SPI.h>
 #include <Adafruit_Sensor.h>
 #include "Adafruit_BME680.h"
+#include "GasBaseline.h"
 
 namespace SmartAirControl {
     class BMEData {
@@ -14,13 +15,19 @@ namespace SmartAirControl {
                   pressure(0.0),
                   humidity(0.0),
                   altitude(0.0),
-                  gasResistance(0.0) {}
+                  gasResistance(0.0),
+                  gasCompensated(0.0),
+                  gasBaseline(0.0),
+                  gasConfidence(GasBaseline::CONFIDENCE_NONE) {}
 
             float temperature;  /** Temperature in degrees celsius */
             float pressure;     /** Pressure in hPa */
             float humidity;     /** Humidity in % */
             float altitude;     /** Altitude in meters */
-            float gasResistance;/** Gas resistance in KOhms */
+            float gasResistance;/** Gas resistance in KOhms, of the last gas reading */
+            float gasCompensated;/** The same at the reference humidity (GasBaseline.h) */
+            float gasBaseline;  /** Compensated gas resistance of clean air in KOhms, 0 until known */
+            uint8_t gasConfidence;/** GasBaseline::Confidence of the baseline */
     };
 
     class BME {
@@ -35,6 +42,18 @@ namespace SmartAirControl {
             int gasHeaterDuration;
             float sealevelPressure_hPa;
             bool valid = false;
+            unsigned long conversionEnd = 0; /** hal::millis() when the running conversion is done, 0 if idle */
+            float lastGasResistance = 0;     /** KOhm, of the previous reading */
+            bool gasStable = false;
+            GasBaseline gasBaseline;
+            uint32_t gasIntervalMs = 0;
+            bool heaterOn = true;            /** gas heater set up for the next conversion */
+            bool gasConversion = false;      /** the running conversion heats the plate */
+            uint8_t burstLeft = 0;           /** heated conversions left of the gas reading */
+            unsigned long lastBurst = 0;     /** hal::millis() of the last gas reading's start */
+
+            bool collect();
+            bool isGasDue();
         public:
             BME(u_int8_t tempOversampling,
                 u_int8_t humidityOversampling,
@@ -42,10 +61,36 @@ namespace SmartAirControl {
                 u_int8_t IIRFilterSize,
                 int gasHeaterTemp,
                 int gasHeaterDuration,
-                float seaLevelPressure_hPa);
+                float seaLevelPressure_hPa,
+                GasBaseline::State& baselineState);
 
             void setup();
             BMEData read();
+
+            // Split read: startConversion() kicks off a measurement and returns
+            // at once, poll() collects it without blocking once the gas heater
+            // time has elapsed and finishConversion() waits for the remainder.
+            bool startConversion();
+            bool isConverting();
+            bool poll();
+            BMEData finishConversion();
+            BMEData getData();
+
+            // The gas plate reads off while it warms up. True once two
+            // successive readings agree within GAS_STABLE_DELTA, until the
+            // next setup(); conversions back to back get there fastest.
+            bool isGasStable();
+            static constexpr float GAS_STABLE_DELTA = 0.03f;
+
+            // Heater profile: once the plate is stable, gas is read every
+            // intervalMs only, the conversions in between measure temperature,
+            // humidity and pressure with the heater off. The plate cools
+            // within seconds, so a gas reading is GAS_BURST heated
+            // conversions in a row of which the last counts. 0 (the default)
+            // heats every conversion.
+            void setGasInterval(uint32_t intervalMs);
+            static const uint8_t GAS_BURST = 4;
+
             bool isValid();
             void printSensorData(BMEData& bmeData);
     };
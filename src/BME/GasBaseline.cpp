@@ -0,0 +1,111 @@
+#include "GasBaseline.h"
+#include <cmath>
+#include "../HAL/Hal.h"
+#include "../Log/Log.h"
+#include "../Storage/Crc.h"
+
+namespace SmartAirControl {
+
+    // NVS layout
+    struct StoredBaseline {
+        uint8_t version;
+        GasBaseline::State state;
+        uint16_t crc;
+    };
+    static const uint8_t STORED_BASELINE_VERSION = 1;
+
+    const float GasBaseline::REFERENCE_HUMIDITY = 40.0f;
+    // MOX sensors lose about 2 % of their resistance per % RH around room
+    // conditions
+    const float GasBaseline::HUMIDITY_SLOPE = 0.02f;
+
+    GasBaseline::GasBaseline(State& state) : state(state) {
+    }
+
+    void GasBaseline::restore(uint32_t nowMs) {
+        if (state.magic == MAGIC) {
+            return;
+        }
+
+        StoredBaseline stored;
+        bool ok;
+        {
+            hal::Nvs store("gas", true);
+            ok = store.getBytes("baseline", &stored, sizeof(stored)) == sizeof(stored) &&
+                 stored.version == STORED_BASELINE_VERSION &&
+                 stored.crc == crc16(&stored.state, sizeof(stored.state)) && stored.state.magic == MAGIC &&
+                 stored.state.baseline > 0;
+        }
+
+        if (ok) {
+            state = stored.state;
+            LOG_INFO(BME, "Gas baseline restored from NVS: %.1f KOhm", state.baseline);
+        } else {
+            state.magic = MAGIC;
+            state.baseline = 0;
+            state.burnInSum = 0;
+            state.burnInCount = 0;
+            state.burnInMs = 0;
+            state.trackedMs = 0;
+        }
+        // the clock started over with the power
+        state.lastMs = nowMs;
+        state.savedMs = nowMs;
+    }
+
+    float GasBaseline::compensate(float gasKOhm, float humidity) {
+        return gasKOhm * std::exp(HUMIDITY_SLOPE * (humidity - REFERENCE_HUMIDITY));
+    }
+
+    float GasBaseline::update(float gasKOhm, float humidity, uint32_t nowMs) {
+        float compensated = compensate(gasKOhm, humidity);
+        uint32_t step = nowMs - state.lastMs;
+        if (step > MAX_STEP_MS) {
+            step = MAX_STEP_MS;
+        }
+        state.lastMs = nowMs;
+
+        if (state.baseline == 0) {
+            state.burnInSum += compensated;
+            state.burnInCount++;
+            state.burnInMs += step;
+            if (state.burnInMs >= BURN_IN_MS) {
+                state.baseline = state.burnInSum / state.burnInCount;
+                LOG_INFO(BME, "Gas burn-in done, baseline %.1f KOhm from %u readings", state.baseline,
+                         state.burnInCount);
+                save(nowMs);
+            }
+            return compensated;
+        }
+
+        // clean air has the highest resistance: VOCs lower it
+        uint32_t tau = compensated > state.baseline ? RISE_TAU_MS : FALL_TAU_MS;
+        state.baseline += (compensated - state.baseline) * step / static_cast<float>(tau + step);
+        state.trackedMs = CONFIDENT_MS - state.trackedMs > step ? state.trackedMs + step : CONFIDENT_MS;
+
+        if (nowMs - state.savedMs >= SAVE_INTERVAL_MS) {
+            save(nowMs);
+        }
+        return compensated;
+    }
+
+    GasBaseline::Confidence GasBaseline::getConfidence() const {
+        if (state.baseline == 0) {
+            return CONFIDENCE_NONE;
+        }
+        return state.trackedMs >= CONFIDENT_MS ? CONFIDENCE_HIGH : CONFIDENCE_LOW;
+    }
+
+    void GasBaseline::save(uint32_t nowMs) {
+        state.savedMs = nowMs;
+
+        StoredBaseline stored;
+        stored.version = STORED_BASELINE_VERSION;
+        stored.state = state;
+        stored.crc = crc16(&stored.state, sizeof(stored.state));
+
+        hal::Nvs store("gas");
+        store.putBytes("baseline", &stored, sizeof(stored));
+    }
+
+}
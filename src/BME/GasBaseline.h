@@ -0,0 +1,79 @@
+#ifndef GAS_BASELINE_H
+#define GAS_BASELINE_H
+
+#include <cstdint>
+
+namespace SmartAirControl {
+
+    // The clean air gas resistance of the BME680, learned from its settled
+    // readings, for the VOC index (Control/AirScore.h).
+    //
+    // Humidity lowers the resistance of the gas plate as VOCs do. Readings
+    // are compensated to REFERENCE_HUMIDITY first: ln R falls about linearly
+    // with humidity, by HUMIDITY_SLOPE per % RH.
+    //
+    // The first BURN_IN_MS of settled readings after a cold start average
+    // into the baseline. From then on it follows cleaner air quickly
+    // (RISE_TAU_MS) and dirtier air slowly (FALL_TAU_MS): a VOC event of a
+    // few hours moves it a little, the drift of the plate over weeks is
+    // followed. After CONFIDENT_MS of that it has seen a day of air.
+    //
+    // State survives deep sleep in RTC memory, which the caller keeps, and
+    // a power cycle in NVS, written every SAVE_INTERVAL_MS at most (flash
+    // wear). The clock is hal::rtcMillis().
+    class GasBaseline {
+        public:
+            enum Confidence {
+                CONFIDENCE_NONE,  /** burning in, no baseline yet */
+                CONFIDENCE_LOW,   /** from the burn-in or a day not yet seen */
+                CONFIDENCE_HIGH   /** tracked for CONFIDENT_MS */
+            };
+
+            struct State {
+                uint32_t magic;
+                float baseline;       /** KOhm at REFERENCE_HUMIDITY, 0 while burning in */
+                float burnInSum;      /** KOhm, of the burn-in readings so far */
+                uint16_t burnInCount;
+                uint32_t burnInMs;    /** settled time burnt in so far */
+                uint32_t trackedMs;   /** since the burn-in, up to CONFIDENT_MS */
+                uint32_t lastMs;      /** rtcMillis() of the last reading */
+                uint32_t savedMs;     /** rtcMillis() of the last NVS write */
+            };
+
+            static const uint32_t MAGIC = 0x47415331; // "GAS1"
+
+            static const float REFERENCE_HUMIDITY;
+            static const float HUMIDITY_SLOPE;
+            static const uint32_t BURN_IN_MS = 5UL * 60 * 1000;
+            static const uint32_t RISE_TAU_MS = 10UL * 60 * 1000;
+            static const uint32_t FALL_TAU_MS = 24UL * 60 * 60 * 1000;
+            static const uint32_t CONFIDENT_MS = 24UL * 60 * 60 * 1000;
+            static const uint32_t SAVE_INTERVAL_MS = 60UL * 60 * 1000;
+            // a reading after a long pause weighs no more than one this far
+            // after the previous
+            static const uint32_t MAX_STEP_MS = 5UL * 60 * 1000;
+
+            explicit GasBaseline(State& state);
+
+            // After every boot: the state kept over deep sleep, else the one
+            // in NVS, else a new burn-in
+            void restore(uint32_t nowMs);
+
+            // A settled reading, returns it compensated for humidity
+            float update(float gasKOhm, float humidity, uint32_t nowMs);
+
+            // KOhm at REFERENCE_HUMIDITY, 0 until burnt in
+            float getBaseline() const { return state.baseline; }
+            Confidence getConfidence() const;
+
+            static float compensate(float gasKOhm, float humidity);
+
+        private:
+            void save(uint32_t nowMs);
+
+            State& state;
+    };
+
+}
+
+#endif // GAS_BASELINE_H
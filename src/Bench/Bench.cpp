@@ -0,0 +1,228 @@
+#include "Bench.h"
+#include <Arduino.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if !defined(ESP32)
+#include <chrono>
+#endif
+
+// Counts every operator new of the bench build; the firmware builds do not
+// link this file
+static uint32_t allocationCount = 0;
+
+void* operator new(size_t size) {
+    allocationCount++;
+    void* p = std::malloc(size ? size : 1);
+    if (p == nullptr) {
+        // out of memory ends the bench
+        std::abort();
+    }
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    std::free(p);
+}
+
+namespace SmartAirControl {
+namespace bench {
+
+#if defined(ESP32)
+    // the loop task has 8 KB of stack
+    static const size_t STACK_PROBE_SIZE = 3072;
+#else
+    static const size_t STACK_PROBE_SIZE = 16384;
+#endif
+    static const uint8_t STACK_PAINT = 0xA5;
+
+    uint32_t ticks() {
+#if defined(ESP32)
+        return ESP.getCycleCount();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    double ticksToNs(double ticks) {
+#if defined(ESP32)
+        return ticks * 1000.0 / ESP.getCpuFreqMHz();
+#else
+        return ticks;
+#endif
+    }
+
+    uint32_t allocations() {
+        return allocationCount;
+    }
+
+    // Both probes have the same frame, so area covers the same addresses
+    // when they are called from the same place. Reading what the previous
+    // call left there is the point, hence the silenced warnings.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-but-set-variable"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+    __attribute__((noinline)) void paintStack() {
+        volatile uint8_t area[STACK_PROBE_SIZE];
+        for (size_t i = 0; i < STACK_PROBE_SIZE; i++) {
+            area[i] = STACK_PAINT;
+        }
+    }
+
+    __attribute__((noinline)) uint32_t stackUsed() {
+        volatile uint8_t area[STACK_PROBE_SIZE];
+        // the stack grows down, area[0] is the deepest byte
+        size_t untouched = 0;
+        while (untouched < STACK_PROBE_SIZE && area[untouched] == STACK_PAINT) {
+            untouched++;
+        }
+        return STACK_PROBE_SIZE - untouched;
+    }
+#pragma GCC diagnostic pop
+
+    uint32_t overheadTicks() {
+        uint32_t best = UINT32_MAX;
+        auto empty = []() {};
+        for (int i = 0; i < 100; i++) {
+            uint32_t start = ticks();
+            invoke(empty);
+            uint32_t elapsed = ticks() - start;
+            best = elapsed < best ? elapsed : best;
+        }
+        return best;
+    }
+
+    Result summarize(const char* name, uint32_t* samples, uint32_t calls, uint32_t allocs, uint32_t stack) {
+        Result result;
+        result.name = name;
+        result.calls = calls;
+
+        uint64_t sum = 0;
+        uint32_t min = UINT32_MAX;
+        uint32_t max = 0;
+        for (uint32_t i = 0; i < calls; i++) {
+            sum += samples[i];
+            min = samples[i] < min ? samples[i] : min;
+            max = samples[i] > max ? samples[i] : max;
+        }
+        std::nth_element(samples, samples + calls / 2, samples + calls);
+
+        result.medianNs = ticksToNs(samples[calls / 2]);
+        result.meanNs = ticksToNs(static_cast<double>(sum) / calls);
+        result.minNs = ticksToNs(min);
+        result.maxNs = ticksToNs(max);
+        result.allocsPerCall = static_cast<double>(allocs) / calls;
+        result.stackBytes = stack;
+        return result;
+    }
+
+    static void emit(const char* line) {
+#if defined(ESP32)
+        Serial.println(line);
+#else
+        std::puts(line);
+#endif
+    }
+
+    void printHeader() {
+        emit("BENCH,name,calls,median_ns,mean_ns,min_ns,max_ns,allocs_per_call,stack_bytes");
+    }
+
+    void print(const Result& result) {
+        char line[160];
+        std::snprintf(line, sizeof(line), "BENCH,%s,%u,%.0f,%.0f,%.0f,%.0f,%.2f,%u", result.name,
+                      static_cast<unsigned>(result.calls), result.medianNs, result.meanNs, result.minNs, result.maxNs,
+                      result.allocsPerCall, static_cast<unsigned>(result.stackBytes));
+        emit(line);
+    }
+
+#if !defined(ESP32)
+    size_t load(const char* path, Result* results, size_t maxResults) {
+        static char names[64][48];
+
+        FILE* file = std::fopen(path, "r");
+        if (file == nullptr) {
+            return 0;
+        }
+
+        size_t count = 0;
+        char line[256];
+        while (count < maxResults && count < 64 && std::fgets(line, sizeof(line), file) != nullptr) {
+            Result& result = results[count];
+            unsigned calls;
+            unsigned stack;
+            // anything that is not a result line (header, firmware output) is skipped
+            if (std::sscanf(line, "BENCH,%47[^,],%u,%lf,%lf,%lf,%lf,%lf,%u", names[count], &calls, &result.medianNs,
+                            &result.meanNs, &result.minNs, &result.maxNs, &result.allocsPerCall, &stack) == 8) {
+                result.name = names[count];
+                result.calls = calls;
+                result.stackBytes = stack;
+                count++;
+            }
+        }
+        std::fclose(file);
+        return count;
+    }
+
+    int compare(const char* baselinePath, const Result* results, size_t count, double tolerance) {
+        static Result baseline[64];
+        size_t baselineCount = load(baselinePath, baseline, 64);
+        if (baselineCount == 0) {
+            return -1;
+        }
+
+        // timings this close are noise, whatever the ratio
+        const double NOISE_NS = 20;
+
+        int regressions = 0;
+        for (size_t i = 0; i < count; i++) {
+            const Result& now = results[i];
+            const Result* before = nullptr;
+            for (size_t j = 0; j < baselineCount && before == nullptr; j++) {
+                if (std::strcmp(baseline[j].name, now.name) == 0) {
+                    before = &baseline[j];
+                }
+            }
+            if (before == nullptr) {
+                std::printf("NEW        %s\n", now.name);
+                continue;
+            }
+
+            bool slower = now.medianNs > before->medianNs * (1 + tolerance) && now.medianNs - before->medianNs > NOISE_NS;
+            bool allocates = now.allocsPerCall > before->allocsPerCall + 0.005;
+            bool deeper = now.stackBytes > before->stackBytes * (1 + tolerance) + 16;
+            if (slower || allocates || deeper) {
+                regressions++;
+            }
+            std::printf("%-10s %-28s %10.0f ns (%+6.1f %%)  %6.2f allocs (was %.2f)  %6u B stack (was %u)\n",
+                        slower || allocates || deeper ? "REGRESSION" : "ok", now.name, now.medianNs,
+                        before->medianNs > 0 ? 100.0 * (now.medianNs - before->medianNs) / before->medianNs : 0.0,
+                        now.allocsPerCall, before->allocsPerCall, static_cast<unsigned>(now.stackBytes),
+                        static_cast<unsigned>(before->stackBytes));
+        }
+        return regressions;
+    }
+#endif
+
+}
+}
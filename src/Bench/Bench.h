@@ -0,0 +1,97 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace SmartAirControl {
+namespace bench {
+
+    // What one call of a benchmarked function costs
+    struct Result {
+        const char* name;
+        uint32_t calls;
+        double medianNs;
+        double meanNs;
+        double minNs;
+        double maxNs;
+        double allocsPerCall; /** operator new calls */
+        uint32_t stackBytes;  /** deepest stack use of a single call */
+    };
+
+    // Time stamps: the CPU cycle counter on the ESP32, a monotonic ns clock
+    // on the host
+    uint32_t ticks();
+    double ticksToNs(double ticks);
+
+    // operator new calls since start, counted by the bench build
+    uint32_t allocations();
+
+    // Stack probe: paintStack() fills the stack below the caller with a
+    // pattern, stackUsed() tells how deep a call made in between has written
+    // into it. Approximate (a frame either way) and capped at a few KB.
+    void paintStack();
+    uint32_t stackUsed();
+
+    // Per-call timings of one run
+    static const uint32_t MAX_CALLS = 1000;
+
+    Result summarize(const char* name, uint32_t* samples, uint32_t calls, uint32_t allocs, uint32_t stack);
+
+    // Prints the CSV header and result lines, every line prefixed with
+    // "BENCH," so they can be picked out of a mixed serial log:
+    //  BENCH,name,calls,median_ns,mean_ns,min_ns,max_ns,allocs_per_call,stack_bytes
+    void printHeader();
+    void print(const Result& result);
+
+    template <typename F>
+    __attribute__((noinline)) void invoke(F& f) {
+        f();
+    }
+
+    // Overhead of taking two time stamps around an empty call
+    uint32_t overheadTicks();
+
+    // Runs f calls times (at most MAX_CALLS) after one warm-up call and
+    // measures each call on its own
+    template <typename F>
+    Result run(const char* name, uint32_t calls, F f) {
+        static uint32_t samples[MAX_CALLS];
+        if (calls > MAX_CALLS) calls = MAX_CALLS;
+        if (calls == 0) calls = 1;
+
+        // warm-up: caches, lazy initialization, first-time allocations
+        invoke(f);
+
+        paintStack();
+        invoke(f);
+        uint32_t stack = stackUsed();
+
+        uint32_t overhead = overheadTicks();
+        uint32_t allocs = allocations();
+        for (uint32_t i = 0; i < calls; i++) {
+            uint32_t start = ticks();
+            invoke(f);
+            uint32_t elapsed = ticks() - start;
+            samples[i] = elapsed > overhead ? elapsed - overhead : 0;
+        }
+        allocs = allocations() - allocs;
+
+        return summarize(name, samples, calls, allocs, stack);
+    }
+
+#if !defined(ESP32)
+    // Compares results against a baseline CSV (the output of a previous run,
+    // either target). A benchmark regresses if its median time or stack use
+    // grew by more than tolerance (a fraction) or it allocates more.
+    // Returns the number of regressions, -1 if the baseline is unreadable.
+    int compare(const char* baselinePath, const Result* results, size_t count, double tolerance);
+    // Loads results from a CSV file, names point into storage owned by the
+    // function and stay valid until the next call. Returns the count.
+    size_t load(const char* path, Result* results, size_t maxResults);
+#endif
+
+}
+}
+
+#endif // BENCH_H
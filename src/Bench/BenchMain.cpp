@@ -0,0 +1,273 @@
+#include <Arduino.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "Bench.h"
+#include "../BME/BME.h"
+#include "../PMS/PMS.h"
+#include "../Fan/Fan.h"
+#include "../Fan/IsrTach.h"
+#include "../Control/FanPolicy.h"
+#include "../Control/PmForecaster.h"
+#include "../Filter/PmFilter.h"
+#include "../Codec/BatchCodec.h"
+#include "../Storage/RtcSampleRing.h"
+#include "../GPS/Ubx.h"
+#include "../Log/Log.h"
+#if !defined(ESP32)
+#include "../HAL/native/Scenario.h"
+#include "../HAL/native/Simulation.h"
+#endif
+
+// Microbenchmarks of what the firmware does per sensor/control cycle. Built
+// instead of main.cpp by env:native_bench and env:bench (on the ESP32).
+
+using namespace SmartAirControl;
+
+static IsrTach tach(12);
+static Fan fan(13, tach);
+static PMS pms(16, 17, 9600, SERIAL_8N1);
+static GasBaseline::State gasBaselineState;
+static BME bme(BME680_OS_8X, BME680_OS_2X, BME680_OS_4X, BME680_FILTER_SIZE_3, 320, 150, 1013.25, gasBaselineState);
+
+// keeps results alive so the calls are not optimized away
+static volatile int sink;
+
+static size_t runAll(uint32_t calls, bench::Result* results) {
+    size_t count = 0;
+
+    // two readings of different air so every call changes the fan setpoint
+    Data data[2];
+    data[0].bmeData.temperature = 23.5;
+    data[0].bmeData.humidity = 45;
+    data[0].bmeData.pressure = 1013.2;
+    data[0].bmeData.gasResistance = 120;
+    data[0].bmeData.gasCompensated = 132;
+    data[0].pmsData.pm25_env = 9;
+    data[0].pmsData.particles_10um = 48;
+    data[0].pmsData.particles_25um = 6;
+    data[0].pmsData.particles_100um = 1;
+    data[0].bmeData.gasBaseline = 150;
+    data[0].pmsData.pm100_env = 14;
+    data[1] = data[0];
+    data[1].bmeData.temperature = 27;
+    data[1].bmeData.gasResistance = 80;
+    data[1].bmeData.gasCompensated = 88;
+    data[1].pmsData.pm25_env = 41;
+    data[1].pmsData.particles_10um = 12;
+    Settings settings = Settings::defaults();
+    int cycle = 0;
+    // each scoring on its own, then with the fan (at 10 Hz a cycle has 100 ms)
+    static const char* const SCORES[] = { "AirScore::evaluate legacy", "AirScore::evaluate EPA", "AirScore::evaluate EU" };
+    for (uint8_t policy = AIR_SCORE_LEGACY; policy <= AIR_SCORE_EU; policy++) {
+        const AirScore& score = airScore(policy);
+        results[count++] = bench::run(SCORES[policy], calls, [&]() {
+            sink = score.evaluate(data[cycle++ & 1], settings).score * 100;
+        });
+    }
+    FanPolicy fanPolicy(FAN_POLICY_OPTIMAL);
+    results[count++] = bench::run("FanPolicy::adjustFanSpeed", calls, [&]() {
+        const Data& cycleData = data[cycle++ & 1];
+        fanPolicy.adjustFanSpeed(fan, airScore(settings.scorePolicy).evaluate(cycleData, settings).score, settings,
+                                 cycle * 1000);
+        sink = cycle;
+    });
+
+    // every PMS5003 frame goes through the filter, one push a second
+    PmFilter pmFilter;
+    PM25_AQI_Data frames[2] = { data[0].pmsData, data[1].pmsData };
+    results[count++] = bench::run("PmFilter::push", calls, [&]() {
+        pmFilter.push(frames[cycle++ & 1]);
+        sink = pmFilter.getFrames();
+    });
+
+    // predictive fan control: a forecast update and the data it scores
+    PmForecaster forecaster(FAN_CONTROL_PREDICTIVE);
+    uint32_t nowMs = 0;
+    results[count++] = bench::run("PmForecaster::update+predict", calls, [&]() {
+        const Data& cycleData = data[cycle++ & 1];
+        forecaster.update(cycleData.pmsData.pm25_env, nowMs += 1000);
+        sink = forecaster.predict(cycleData).pmsData.pm25_env;
+    });
+
+    int percent = 0;
+    results[count++] = bench::run("Fan::getInterpolatedDuty", calls, [&]() {
+        sink = fan.getInterpolatedDuty(percent);
+        percent = percent == 100 ? 0 : percent + 1;
+    });
+
+    // the uplink serialization (BatchCodec replaced the JSON document), from
+    // the RTC ring the firmware queues into
+    static RtcSampleRing::Storage ringStorage;
+    RtcSampleRing ring(ringStorage);
+    ring.restore();
+    for (int i = 0; i < 6; i++) {
+        ring.push(Sample(22.5 + i * 0.1, 1013.2, 45 + i, 120 - i, 6, 9 + i, 14, 7000 + 50 * i, 45, 0.2));
+    }
+    uint8_t payload[222];
+    results[count++] = bench::run("BatchCodec::encode", calls, [&]() {
+        size_t encoded;
+        sink = BatchCodec::encode(ring, payload, sizeof(payload), encoded);
+    });
+
+#if !defined(ESP32)
+    // the same on a day of the simulated room, one sample a minute with a
+    // little sensor noise, encoded a batch at a time like RadioTask sends it
+    static const size_t DAY_SAMPLES = 24 * 60;
+    static const size_t BATCH_SIZE = 6;
+    static Sample day[DAY_SAMPLES];
+    sim::Scenario scenario;
+    scenario.load("day");
+    uint32_t noise = 1;
+    for (size_t i = 0; i < DAY_SAMPLES; i++) {
+        sim::Air air;
+        scenario.at(i * 60.0, air);
+        noise = noise * 1664525 + 1013904223;
+        float jitter = int(noise >> 24) / 128.0f - 1;
+        Data sampleData = data[0];
+        sampleData.bmeData.temperature = air.temperature + 0.05f * jitter;
+        sampleData.bmeData.humidity = air.humidity + 0.5f * jitter;
+        sampleData.bmeData.gasResistance = air.gasResistance * (1 + 0.02f * jitter);
+        sampleData.bmeData.gasCompensated = sampleData.bmeData.gasResistance;
+        sampleData.pmsData.pm10_env = air.pm10 * (1 + 0.1f * jitter) + 0.5f;
+        sampleData.pmsData.pm25_env = air.pm25 * (1 + 0.1f * jitter) + 0.5f;
+        sampleData.pmsData.pm100_env = air.pm100 * (1 + 0.1f * jitter) + 0.5f;
+        float score = airScore(settings.scorePolicy).evaluate(sampleData, settings).score;
+        int fanPercent = int(score * 100 + 0.5f);
+        int rpm = sim::FanModel::steadyRpm(fan.getInterpolatedDuty(fanPercent));
+        day[i] = Sample(sampleData.bmeData.temperature, sampleData.bmeData.pressure, sampleData.bmeData.humidity,
+                        sampleData.bmeData.gasResistance, sampleData.pmsData.pm10_env,
+                        sampleData.pmsData.pm25_env, sampleData.pmsData.pm100_env, rpm, fanPercent, score);
+    }
+    struct Batch {
+        size_t size() const { return BATCH_SIZE; }
+        const Sample& at(size_t index) const { return day[first + index]; }
+        size_t first;
+    } batch = { 0 };
+    size_t dayBytes = 0;
+    for (batch.first = 0; batch.first + BATCH_SIZE <= DAY_SAMPLES; batch.first += BATCH_SIZE) {
+        size_t encoded;
+        dayBytes += BatchCodec::encode(batch, payload, sizeof(payload), encoded);
+    }
+    // stdout only carries the results
+    std::fprintf(stderr, "BatchCodec day: %.2f bytes/sample, %.1f bytes/batch of %u\n",
+                 double(dayBytes) / DAY_SAMPLES, double(dayBytes) * BATCH_SIZE / DAY_SAMPLES, unsigned(BATCH_SIZE));
+    batch.first = 0;
+    results[count++] = bench::run("BatchCodec::encode day", calls, [&]() {
+        size_t encoded;
+        sink = BatchCodec::encode(batch, payload, sizeof(payload), encoded);
+        batch.first = batch.first + 2 * BATCH_SIZE <= DAY_SAMPLES ? batch.first + BATCH_SIZE : 0;
+    });
+#endif
+
+    // a log statement only queues a record; the log task formats and prints
+    // it later, one drain call per record here (the ring is sized to hold
+    // all calls, see LOG_RING_SIZE of the bench envs)
+    while (logging::drain(SIZE_MAX) > 0) {
+    }
+    unsigned size = 0;
+    results[count++] = bench::run("LOG_INFO", calls, [&]() {
+        LOG_INFO(APP, "Payload size: %u bytes for %u samples", size++, 6);
+    });
+    results[count++] = bench::run("logging::drain", calls, [&]() {
+        sink = logging::drain(1);
+    });
+
+    // UBX-CFG-PM2 sized message: class, id, length, 44 bytes payload
+    uint8_t ubx[48] = { 0x06, 0x3B, 44, 0 };
+    uint8_t frame[48 + Ubx::OVERHEAD];
+    results[count++] = bench::run("Ubx::frame", calls, [&]() {
+        sink = Ubx::frame(ubx, sizeof(ubx), frame, sizeof(frame));
+    });
+
+    results[count++] = bench::run("PMS::printSensorData", calls, [&]() {
+        pms.printSensorData();
+    });
+
+    results[count++] = bench::run("BME::printSensorData", calls, [&]() {
+        bme.printSensorData(data[0].bmeData);
+    });
+
+    return count;
+}
+
+static const size_t MAX_RESULTS = 16;
+
+#if defined(ESP32)
+
+void setup() {
+    Serial.begin(115200);
+    delay(2000);
+
+    bench::Result results[MAX_RESULTS];
+    size_t count = runAll(200, results);
+
+    bench::printHeader();
+    for (size_t i = 0; i < count; i++) {
+        bench::print(results[i]);
+    }
+}
+
+void loop() {
+    delay(1000);
+}
+
+#else
+
+static int usage(const char* program) {
+    std::fprintf(stderr, "Usage: %s [-n calls] [-b baseline.csv] [-t tolerance %%]\n", program);
+    std::fprintf(stderr, "       %s -c baseline.csv current.csv [-t tolerance %%]\n", program);
+    return 2;
+}
+
+// Prints the results as CSV. With a baseline (-b, or -c to compare two
+// captures, e.g. from the serial log of env:bench) regressions are listed
+// and the exit code is 1.
+int main(int argc, char** argv) {
+    uint32_t calls = bench::MAX_CALLS;
+    const char* baseline = nullptr;
+    const char* current = nullptr;
+    double tolerance = 0.25;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            calls = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            baseline = argv[++i];
+        } else if (std::strcmp(argv[i], "-c") == 0 && i + 2 < argc) {
+            baseline = argv[++i];
+            current = argv[++i];
+        } else if (std::strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            tolerance = std::strtod(argv[++i], nullptr) / 100.0;
+        } else {
+            return usage(argv[0]);
+        }
+    }
+
+    bench::Result results[MAX_RESULTS];
+    size_t count;
+    if (current != nullptr) {
+        count = bench::load(current, results, MAX_RESULTS);
+    } else {
+        // the routines under test print, only the results go to stdout
+        Serial.setEcho(false);
+        count = runAll(calls, results);
+
+        bench::printHeader();
+        for (size_t i = 0; i < count; i++) {
+            bench::print(results[i]);
+        }
+    }
+
+    if (baseline == nullptr) {
+        return 0;
+    }
+    int regressions = bench::compare(baseline, results, count, tolerance);
+    if (regressions < 0) {
+        std::fprintf(stderr, "Cannot read baseline %s\n", baseline);
+        return 2;
+    }
+    return regressions > 0 ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,63 @@
+#include "BootTrace.h"
+#include <Arduino.h>
+#include "../HAL/Hal.h"
+#include "../Log/Log.h"
+
+namespace SmartAirControl {
+namespace boot {
+
+    static const char* const NAMES[PHASE_COUNT] = {
+        "setup", "PMS5003 ready", "BME680 ready", "first sample", "fan ready", "LoRaWAN activated"
+    };
+
+    // log records carry no strings (Log.h), so one literal per phase
+    static const char* const FORMATS[PHASE_COUNT] = {
+        "Boot: setup done after %lu ms",
+        "Boot: PMS5003 ready after %lu ms",
+        "Boot: BME680 ready after %lu ms",
+        "Boot: first sample after %lu ms",
+        "Boot: fan ready after %lu ms",
+        "Boot: LoRaWAN activated after %lu ms",
+    };
+
+    RTC_DATA_ATTR Stats phaseStats[PHASE_COUNT];
+
+    static uint32_t startMs = 0;
+    static uint32_t reached[PHASE_COUNT];
+
+    void start() {
+        startMs = hal::millis();
+        for (int i = 0; i < PHASE_COUNT; i++) {
+            reached[i] = NOT_REACHED;
+        }
+    }
+
+    void mark(Phase phase) {
+        if (reached[phase] != NOT_REACHED) {
+            return;
+        }
+        uint32_t ms = hal::millis() - startMs;
+        reached[phase] = ms;
+
+        Stats& stats = phaseStats[phase];
+        stats.boots++;
+        stats.sumMs += ms;
+        stats.maxMs = ms > stats.maxMs ? ms : stats.maxMs;
+
+        LOG_INFO(APP, FORMATS[phase], ms);
+    }
+
+    uint32_t elapsed(Phase phase) {
+        return reached[phase];
+    }
+
+    const Stats& stats(Phase phase) {
+        return phaseStats[phase];
+    }
+
+    const char* name(Phase phase) {
+        return NAMES[phase];
+    }
+
+}
+}
@@ -0,0 +1,44 @@
+#ifndef BOOT_TRACE_H
+#define BOOT_TRACE_H
+
+#include <cstdint>
+
+namespace SmartAirControl {
+namespace boot {
+
+    // Milestones of a boot, in the order they usually happen. The sensors,
+    // the fan calibration and the LoRaWAN join start together, so the later
+    // ones overlap.
+    enum Phase {
+        PHASE_SETUP,          /** setup() returned, the tasks run */
+        PHASE_PMS_READY,      /** first valid PMS5003 frame */
+        PHASE_BME_READY,      /** BME680 gas reading settled */
+        PHASE_FIRST_SAMPLE,   /** first sample of the air queued */
+        PHASE_FAN_READY,      /** fan table loaded or calibrated */
+        PHASE_LORA_ACTIVATED, /** session restored or joined */
+        PHASE_COUNT
+    };
+
+    // Per phase over all boots, kept in RTC memory across deep sleep
+    struct Stats {
+        uint32_t boots;  /** boots that reached the phase */
+        uint32_t sumMs;
+        uint32_t maxMs;
+    };
+
+    // Starts the trace of this boot, first thing in setup()
+    void start();
+    // Records the time since start() the first time a phase is reached in
+    // this boot and logs it; later calls are cheap and ignored
+    void mark(Phase phase);
+    // ms from start() to the phase in this boot, NOT_REACHED if not yet
+    uint32_t elapsed(Phase phase);
+    static const uint32_t NOT_REACHED = UINT32_MAX;
+
+    const Stats& stats(Phase phase);
+    const char* name(Phase phase);
+
+}
+}
+
+#endif // BOOT_TRACE_H
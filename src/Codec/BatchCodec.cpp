@@ -0,0 +1,96 @@
+#include "BatchCodec.h"
+
+namespace SmartAirControl {
+
+    size_t BatchCodec::decode(const uint8_t* buffer, size_t size, Sample* samples, size_t maxSamples) {
+        if (buffer == nullptr || size < HEADER_SIZE + UplinkCodec::FIELDS_SIZE || buffer[0] != VERSION) {
+            return 0;
+        }
+
+        size_t count = buffer[1];
+        if (count == 0 || count > maxSamples) {
+            return 0;
+        }
+
+        UplinkCodec::getFields(&buffer[HEADER_SIZE], samples[0]);
+        size_t offset = HEADER_SIZE + UplinkCodec::FIELDS_SIZE;
+
+        int32_t fields[FIELD_COUNT];
+        toFields(samples[0], fields);
+        for (size_t n = 1; n < count; n++) {
+            for (size_t f = 0; f < FIELD_COUNT; f++) {
+                uint32_t value;
+                size_t used = getVarint(&buffer[offset], size - offset, value);
+                if (used == 0) {
+                    return 0;
+                }
+                offset += used;
+                fields[f] += unZigZag(value);
+            }
+            fromFields(fields, samples[n]);
+        }
+
+        return offset == size ? count : 0;
+    }
+
+    size_t BatchCodec::putDelta(const Sample& previous, const Sample& current, uint8_t* buffer) {
+        int32_t before[FIELD_COUNT];
+        int32_t after[FIELD_COUNT];
+        toFields(previous, before);
+        toFields(current, after);
+
+        size_t length = 0;
+        for (size_t f = 0; f < FIELD_COUNT; f++) {
+            length += putVarint(zigZag(after[f] - before[f]), &buffer[length]);
+        }
+        return length;
+    }
+
+    size_t BatchCodec::putVarint(uint32_t value, uint8_t* buffer) {
+        size_t length = 0;
+        while (value >= 0x80) {
+            buffer[length++] = (value & 0x7F) | 0x80;
+            value >>= 7;
+        }
+        buffer[length++] = value;
+        return length;
+    }
+
+    size_t BatchCodec::getVarint(const uint8_t* buffer, size_t size, uint32_t& value) {
+        value = 0;
+        for (size_t i = 0; i < size && i < 5; i++) {
+            value |= static_cast<uint32_t>(buffer[i] & 0x7F) << (7 * i);
+            if ((buffer[i] & 0x80) == 0) {
+                return i + 1;
+            }
+        }
+        return 0;
+    }
+
+    void BatchCodec::toFields(const Sample& sample, int32_t fields[FIELD_COUNT]) {
+        fields[0] = sample.temperature;
+        fields[1] = sample.pressure;
+        fields[2] = sample.humidity;
+        fields[3] = sample.gasResistance;
+        fields[4] = sample.pm10;
+        fields[5] = sample.pm25;
+        fields[6] = sample.pm100;
+        fields[7] = sample.fanRpm;
+        fields[8] = sample.fanPercent;
+        fields[9] = sample.score;
+    }
+
+    void BatchCodec::fromFields(const int32_t fields[FIELD_COUNT], Sample& sample) {
+        sample.temperature = fields[0];
+        sample.pressure = fields[1];
+        sample.humidity = fields[2];
+        sample.gasResistance = fields[3];
+        sample.pm10 = fields[4];
+        sample.pm25 = fields[5];
+        sample.pm100 = fields[6];
+        sample.fanRpm = fields[7];
+        sample.fanPercent = fields[8];
+        sample.score = fields[9];
+    }
+
+}
@@ -0,0 +1,80 @@
+#ifndef BATCH_CODEC_H
+#define BATCH_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include "Sample.h"
+#include "UplinkCodec.h"
+
+namespace SmartAirControl {
+
+    // Several samples in one uplink: a full base sample followed by the
+    // field-wise difference of every further sample to its predecessor,
+    // each difference zig-zag mapped and written as a LEB128 varint.
+    //
+    //  byte  field
+    //  0     version
+    //  1     sample count
+    //  2-18  base sample (UplinkCodec field block)
+    //  19-   FIELD_COUNT varints per further sample
+    class BatchCodec {
+        public:
+            static const uint8_t VERSION = 2;
+            static const size_t HEADER_SIZE = 2;
+            static const size_t FIELD_COUNT = 10;
+            // a uint16 delta is at most 17 bits after zig-zag, i.e. 3 varint bytes
+            static const size_t MAX_DELTA_SIZE = FIELD_COUNT * 3;
+
+            // Encodes the oldest samples of ring (anything with size() and at())
+            // until the next one would not fit into size bytes. Returns the bytes
+            // written and stores the number of samples consumed in encoded.
+            template <typename Ring>
+            static size_t encode(const Ring& ring, uint8_t* buffer, size_t size, size_t& encoded) {
+                encoded = 0;
+                if (ring.size() == 0 || buffer == nullptr || size < HEADER_SIZE + UplinkCodec::FIELDS_SIZE) {
+                    return 0;
+                }
+
+                buffer[0] = VERSION;
+                UplinkCodec::putFields(ring.at(0), &buffer[HEADER_SIZE]);
+                size_t length = HEADER_SIZE + UplinkCodec::FIELDS_SIZE;
+                encoded = 1;
+
+                uint8_t delta[MAX_DELTA_SIZE];
+                while (encoded < ring.size() && encoded < UINT8_MAX) {
+                    size_t deltaSize = putDelta(ring.at(encoded - 1), ring.at(encoded), delta);
+                    if (length + deltaSize > size) {
+                        break;
+                    }
+                    for (size_t i = 0; i < deltaSize; i++) {
+                        buffer[length + i] = delta[i];
+                    }
+                    length += deltaSize;
+                    encoded++;
+                }
+
+                buffer[1] = encoded;
+                return length;
+            }
+
+            // Returns the number of samples decoded, 0 on a malformed frame
+            static size_t decode(const uint8_t* buffer, size_t size, Sample* samples, size_t maxSamples);
+
+            // Writes the deltas from previous to current, returns the bytes written
+            static size_t putDelta(const Sample& previous, const Sample& current, uint8_t* buffer);
+
+            static size_t putVarint(uint32_t value, uint8_t* buffer);
+            // Returns the bytes consumed, 0 if the varint is truncated or too long
+            static size_t getVarint(const uint8_t* buffer, size_t size, uint32_t& value);
+
+            static uint32_t zigZag(int32_t value) { return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31); }
+            static int32_t unZigZag(uint32_t value) { return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1); }
+
+        private:
+            static void toFields(const Sample& sample, int32_t fields[FIELD_COUNT]);
+            static void fromFields(const int32_t fields[FIELD_COUNT], Sample& sample);
+    };
+
+}
+
+#endif // BATCH_CODEC_H
@@ -0,0 +1,73 @@
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include <cstdint>
+
+namespace SmartAirControl {
+
+    // Fixed-point snapshot of one sensor cycle. This is what goes on air, so
+    // every field is stored in the resolution the uplink codec transmits.
+    class Sample {
+        public:
+            Sample()
+                : temperature(0),
+                  pressure(0),
+                  humidity(0),
+                  gasResistance(0),
+                  pm10(0),
+                  pm25(0),
+                  pm100(0),
+                  fanRpm(0),
+                  fanPercent(0),
+                  score(0) {}
+
+            Sample(float temperatureC,
+                   float pressureHpa,
+                   float humidityPercent,
+                   float gasResistanceKOhm,
+                   uint16_t pm10,
+                   uint16_t pm25,
+                   uint16_t pm100,
+                   int fanRpm,
+                   float fanPercent,
+                   float score)
+                : temperature(saturate(temperatureC * 100.0f, INT16_MIN, INT16_MAX)),
+                  pressure(saturate(pressureHpa * 10.0f, 0, UINT16_MAX)),
+                  humidity(saturate(humidityPercent * 2.0f, 0, 200)),
+                  gasResistance(saturate(gasResistanceKOhm * 10.0f, 0, UINT16_MAX)),
+                  pm10(pm10),
+                  pm25(pm25),
+                  pm100(pm100),
+                  fanRpm(saturate(fanRpm, 0, UINT16_MAX)),
+                  fanPercent(saturate(fanPercent, 0, 100)),
+                  score(saturate(score * 200.0f, 0, 200)) {}
+
+            float temperatureC() const { return temperature / 100.0f; }
+            float pressureHpa() const { return pressure / 10.0f; }
+            float humidityPercent() const { return humidity / 2.0f; }
+            float gasResistanceKOhm() const { return gasResistance / 10.0f; }
+            float scoreRatio() const { return score / 200.0f; }
+
+            int16_t temperature;    /** Temperature in 0.01 degrees celsius */
+            uint16_t pressure;      /** Pressure in 0.1 hPa */
+            uint8_t humidity;       /** Humidity in 0.5 % */
+            uint16_t gasResistance; /** Gas resistance in 0.1 KOhms */
+            uint16_t pm10;          /** PM 1.0 (environmental) in ug/m3 */
+            uint16_t pm25;          /** PM 2.5 (environmental) in ug/m3 */
+            uint16_t pm100;         /** PM 10.0 (environmental) in ug/m3 */
+            uint16_t fanRpm;        /** Fan speed in RPM */
+            uint8_t fanPercent;     /** Fan setpoint in % */
+            uint8_t score;          /** Air quality score in 0.5 % */
+
+        private:
+            static int32_t saturate(float value, int32_t min, int32_t max) {
+                float rounded = value < 0 ? value - 0.5f : value + 0.5f;
+                if (rounded <= min) return min;
+                if (rounded >= max) return max;
+                return static_cast<int32_t>(rounded);
+            }
+    };
+
+}
+
+#endif // SAMPLE_H
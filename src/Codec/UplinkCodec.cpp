@@ -0,0 +1,61 @@
+#include "UplinkCodec.h"
+
+namespace SmartAirControl {
+
+    size_t UplinkCodec::encode(const Sample& sample, uint8_t* buffer, size_t size) {
+        if (buffer == nullptr || size < FRAME_SIZE) {
+            return 0;
+        }
+
+        buffer[0] = VERSION;
+        putFields(sample, &buffer[1]);
+
+        return FRAME_SIZE;
+    }
+
+    bool UplinkCodec::decode(const uint8_t* buffer, size_t size, Sample& sample) {
+        if (buffer == nullptr || size < FRAME_SIZE || buffer[0] != VERSION) {
+            return false;
+        }
+
+        getFields(&buffer[1], sample);
+
+        return true;
+    }
+
+    void UplinkCodec::putFields(const Sample& sample, uint8_t* buffer) {
+        putU16(&buffer[0], static_cast<uint16_t>(sample.temperature));
+        putU16(&buffer[2], sample.pressure);
+        buffer[4] = sample.humidity;
+        putU16(&buffer[5], sample.gasResistance);
+        putU16(&buffer[7], sample.pm10);
+        putU16(&buffer[9], sample.pm25);
+        putU16(&buffer[11], sample.pm100);
+        putU16(&buffer[13], sample.fanRpm);
+        buffer[15] = sample.fanPercent;
+        buffer[16] = sample.score;
+    }
+
+    void UplinkCodec::getFields(const uint8_t* buffer, Sample& sample) {
+        sample.temperature = static_cast<int16_t>(getU16(&buffer[0]));
+        sample.pressure = getU16(&buffer[2]);
+        sample.humidity = buffer[4];
+        sample.gasResistance = getU16(&buffer[5]);
+        sample.pm10 = getU16(&buffer[7]);
+        sample.pm25 = getU16(&buffer[9]);
+        sample.pm100 = getU16(&buffer[11]);
+        sample.fanRpm = getU16(&buffer[13]);
+        sample.fanPercent = buffer[15];
+        sample.score = buffer[16];
+    }
+
+    void UplinkCodec::putU16(uint8_t* buffer, uint16_t value) {
+        buffer[0] = value >> 8;
+        buffer[1] = value & 0xFF;
+    }
+
+    uint16_t UplinkCodec::getU16(const uint8_t* buffer) {
+        return (static_cast<uint16_t>(buffer[0]) << 8) | buffer[1];
+    }
+
+}
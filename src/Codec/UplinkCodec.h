@@ -0,0 +1,46 @@
+#ifndef UPLINK_CODEC_H
+#define UPLINK_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include "Sample.h"
+
+namespace SmartAirControl {
+
+    // Versioned binary uplink frame, big endian, no heap use.
+    //
+    //  byte  field
+    //  0     version
+    //  1-2   temperature     int16   0.01 C
+    //  3-4   pressure        uint16  0.1 hPa
+    //  5     humidity        uint8   0.5 %
+    //  6-7   gas resistance  uint16  0.1 KOhm
+    //  8-9   PM 1.0          uint16  ug/m3
+    //  10-11 PM 2.5          uint16  ug/m3
+    //  12-13 PM 10.0         uint16  ug/m3
+    //  14-15 fan speed       uint16  RPM
+    //  16    fan setpoint    uint8   %
+    //  17    score           uint8   0.5 %
+    class UplinkCodec {
+        public:
+            static const uint8_t VERSION = 1;
+            static const size_t FIELDS_SIZE = 17;
+            static const size_t FRAME_SIZE = 1 + FIELDS_SIZE;
+
+            // Returns the number of bytes written, 0 if the buffer is too small
+            static size_t encode(const Sample& sample, uint8_t* buffer, size_t size);
+
+            // Returns false on a short buffer or an unknown version
+            static bool decode(const uint8_t* buffer, size_t size, Sample& sample);
+
+            // Field block without the version byte, shared with BatchCodec
+            static void putFields(const Sample& sample, uint8_t* buffer);
+            static void getFields(const uint8_t* buffer, Sample& sample);
+
+            static void putU16(uint8_t* buffer, uint16_t value);
+            static uint16_t getU16(const uint8_t* buffer);
+    };
+
+}
+
+#endif // UPLINK_CODEC_H
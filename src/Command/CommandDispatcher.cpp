@@ -0,0 +1,85 @@
+#include "CommandDispatcher.h"
+
+namespace SmartAirControl {
+
+    static uint16_t get16(const uint8_t* buffer) {
+        return static_cast<uint16_t>(buffer[0] << 8 | buffer[1]);
+    }
+
+    static void applyFan(const uint8_t* payload, Settings& settings) {
+        settings.fanMode = payload[0];
+        settings.fanPercent = payload[1];
+    }
+
+    static void applyThresholds(const uint8_t* payload, Settings& settings) {
+        settings.pmLow = get16(&payload[0]);
+        settings.pmHigh = get16(&payload[2]);
+        settings.gasLow = get16(&payload[4]);
+        settings.gasHigh = get16(&payload[6]);
+        settings.tempLow = static_cast<int8_t>(payload[8]);
+        settings.tempHigh = static_cast<int8_t>(payload[9]);
+    }
+
+    static void applyWeights(const uint8_t* payload, Settings& settings) {
+        settings.gasWeight = payload[0];
+        settings.pmWeight = payload[1];
+        settings.tempWeight = payload[2];
+    }
+
+    static void applyUplink(const uint8_t* payload, Settings& settings) {
+        settings.uplinkPolicy = payload[0];
+        settings.heartbeatMin = get16(&payload[1]);
+    }
+
+    static void applyReset(const uint8_t* payload, Settings& settings) {
+        (void)payload;
+        settings = Settings::defaults();
+    }
+
+    static void applyScore(const uint8_t* payload, Settings& settings) {
+        settings.scorePolicy = payload[0];
+    }
+
+    struct Command {
+        uint8_t fPort;
+        uint8_t size;
+        void (*apply)(const uint8_t* payload, Settings& settings);
+    };
+
+    // see the table in CommandDispatcher.h
+    static const Command COMMANDS[] = {
+        { 10, 2, applyFan },
+        { 11, 10, applyThresholds },
+        { 12, 3, applyWeights },
+        { 13, 3, applyUplink },
+        { 14, 0, applyReset },
+        { 15, 1, applyScore },
+    };
+    static const size_t COMMAND_COUNT = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+
+    CommandDispatcher::Result CommandDispatcher::dispatch(uint8_t fPort, const uint8_t* payload, size_t size,
+                                                          Settings& settings) {
+        const Command* command = nullptr;
+        for (size_t i = 0; i < COMMAND_COUNT && command == nullptr; i++) {
+            if (COMMANDS[i].fPort == fPort) {
+                command = &COMMANDS[i];
+            }
+        }
+        if (command == nullptr) {
+            return RESULT_UNKNOWN_PORT;
+        }
+        if (size != command->size || (size > 0 && payload == nullptr)) {
+            return RESULT_BAD_SIZE;
+        }
+
+        // the field checks are those of the stored settings, on the result
+        Settings updated = settings;
+        command->apply(payload, updated);
+        if (!updated.isValid()) {
+            return RESULT_BAD_VALUE;
+        }
+        settings = updated;
+        return RESULT_OK;
+    }
+
+}
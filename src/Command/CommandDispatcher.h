@@ -0,0 +1,43 @@
+#ifndef COMMAND_DISPATCHER_H
+#define COMMAND_DISPATCHER_H
+
+#include <cstddef>
+#include <cstdint>
+#include "../Control/Settings.h"
+
+namespace SmartAirControl {
+
+    // Downlink commands, one per frame, each on its own fPort with a fixed
+    // size. Multi-byte fields are big endian, as in the uplinks.
+    //
+    //  fPort  command     bytes
+    //  10     fan         mode (FAN_AUTO, FAN_MANUAL, FAN_OFF), manual %
+    //  11     thresholds  PM low, PM high (u16 ug/m3), gas low, gas high
+    //                     (u16 KOhm), temperature low, high (s8 degrees C)
+    //  12     weights     gas, PM, temperature in % (adding up to 100)
+    //  13     uplink      policy (UPLINK_FIXED, UPLINK_ADAPTIVE), heartbeat
+    //                     interval (u16 min)
+    //  14     reset       none, back to the build defaults
+    //  15     score       policy (AIR_SCORE_LEGACY, AIR_SCORE_EPA, AIR_SCORE_EU)
+    class CommandDispatcher {
+        public:
+            static const uint8_t FIRST_PORT = 10;
+            static const uint8_t LAST_PORT = 15;
+
+            enum Result {
+                RESULT_OK,
+                RESULT_UNKNOWN_PORT,
+                RESULT_BAD_SIZE,  /** truncated or oversized */
+                RESULT_BAD_VALUE  /** out of range, or leaves the settings inconsistent */
+            };
+
+            static bool isCommandPort(uint8_t fPort) { return fPort >= FIRST_PORT && fPort <= LAST_PORT; }
+
+            // Applies the command to a copy of settings, which is replaced
+            // only if the whole command is valid. No heap, no I/O.
+            static Result dispatch(uint8_t fPort, const uint8_t* payload, size_t size, Settings& settings);
+    };
+
+}
+
+#endif // COMMAND_DISPATCHER_H
@@ -0,0 +1,91 @@
+#include "AirScore.h"
+
+namespace SmartAirControl {
+namespace aqi {
+
+    uint16_t vocIndex(float gasKOhm, float baselineKOhm) {
+        if (baselineKOhm <= 0 || gasKOhm <= 0) {
+            return NO_INDEX;
+        }
+        // readings above the baseline (warmer, drier air) are clean air
+        float drop = gasKOhm < baselineKOhm ? 100 * (1 - gasKOhm / baselineKOhm) : 0;
+        return subIndex(VOC_DROP, static_cast<uint32_t>(drop + 0.5f));
+    }
+
+}
+
+    // the worst of the sub-indices, each against its full scale, at most 1
+    static float worst(uint16_t index, uint16_t fullScale, float score) {
+        if (index == aqi::NO_INDEX) {
+            return score;
+        }
+        float scaled = static_cast<float>(index) / fullScale;
+        return scaled > score ? (scaled < 1 ? scaled : 1) : score;
+    }
+
+    AirQuality LegacyAirScore::evaluate(const Data& data, const Settings& settings) const {
+        float gas = data.bmeData.gasCompensated;
+        float pm1 = data.pmsData.particles_10um;
+        float pm25 = data.pmsData.particles_25um;
+        float pm10 = data.pmsData.particles_100um;
+        float temp = data.bmeData.temperature;
+
+        // Normalize sensor values (thresholds from the settings)
+        float gasScore = gas < settings.gasLow ? 1.0 : (gas < settings.gasHigh ? 0.5 : 0.0); // lower gas resistance = worse air
+        float pmScore = (pm1 + pm25 + pm10) / 3.0;
+        float pmNorm = pmScore < settings.pmLow ? 0.0 : (pmScore < settings.pmHigh ? 0.5 : 1.0); // higher PM = worse air
+        float tempScore = temp > settings.tempHigh ? 1.0 : (temp > settings.tempLow ? 0.5 : 0.0); // higher temp = higher speed
+
+        AirQuality quality;
+        quality.pm25Index = aqi::NO_INDEX;
+        quality.pm10Index = aqi::NO_INDEX;
+        quality.vocIndex = aqi::NO_INDEX;
+        // Weighted sum, the weights are in %
+        quality.score = (settings.gasWeight * gasScore + settings.pmWeight * pmNorm + settings.tempWeight * tempScore) / 100.0f;
+        return quality;
+    }
+
+    AirQuality EpaAirScore::evaluate(const Data& data, const Settings& settings) const {
+        (void)settings;
+        AirQuality quality;
+        quality.pm25Index = aqi::subIndex(aqi::EPA_PM25, data.pmsData.pm25_env * 10u);
+        quality.pm10Index = aqi::subIndex(aqi::EPA_PM10, data.pmsData.pm100_env);
+        quality.vocIndex = aqi::vocIndex(data.bmeData.gasCompensated, data.bmeData.gasBaseline);
+
+        float score = worst(quality.pm25Index, FULL_SCALE, 0);
+        score = worst(quality.pm10Index, FULL_SCALE, score);
+        quality.score = worst(quality.vocIndex, FULL_SCALE, score);
+        return quality;
+    }
+
+    AirQuality EuAirScore::evaluate(const Data& data, const Settings& settings) const {
+        (void)settings;
+        AirQuality quality;
+        quality.pm25Index = aqi::subIndex(aqi::CAQI_PM25, data.pmsData.pm25_env);
+        quality.pm10Index = aqi::subIndex(aqi::CAQI_PM10, data.pmsData.pm100_env);
+        quality.vocIndex = aqi::vocIndex(data.bmeData.gasCompensated, data.bmeData.gasBaseline);
+
+        float score = worst(quality.pm25Index, FULL_SCALE, 0);
+        score = worst(quality.pm10Index, FULL_SCALE, score);
+        quality.score = worst(quality.vocIndex, VOC_FULL_SCALE, score);
+        return quality;
+    }
+
+    static const LegacyAirScore legacyAirScore;
+    static const EpaAirScore epaAirScore;
+    static const EuAirScore euAirScore;
+
+    const AirScore& airScore(uint8_t policy) {
+        switch (policy) {
+            case AIR_SCORE_LEGACY:
+                return legacyAirScore;
+            case AIR_SCORE_EPA:
+                return epaAirScore;
+            case AIR_SCORE_EU:
+                return euAirScore;
+            default:
+                return airScore(AIR_SCORE);
+        }
+    }
+
+}
@@ -0,0 +1,172 @@
+#ifndef AIR_SCORE_H
+#define AIR_SCORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include "Data.h"
+#include "Settings.h"
+
+// Air quality scoring selected by the AIR_SCORE build flag, the default of
+// Settings::scorePolicy (which a downlink command can change)
+#define AIR_SCORE_LEGACY 0 // weighted buckets of particle counts, gas and temperature
+#define AIR_SCORE_EPA 1    // US EPA AQI of PM2.5 and PM10, and the VOC index
+#define AIR_SCORE_EU 2     // European CAQI of PM2.5 and PM10, and the VOC index
+
+#ifndef AIR_SCORE
+#define AIR_SCORE AIR_SCORE_EPA
+#endif
+
+namespace SmartAirControl {
+namespace aqi {
+
+    // One band of a piecewise linear index: concentrations from low to high
+    // (in the unit of the table) map onto the index from indexLow to indexHigh
+    struct Breakpoint {
+        uint16_t low;
+        uint16_t high;
+        uint16_t indexLow;
+        uint16_t indexHigh;
+    };
+
+    // The index of value within band, rounded to the nearest integer as the
+    // EPA prescribes
+    constexpr uint16_t interpolate(const Breakpoint& band, uint32_t value) {
+        return band.indexLow + ((band.indexHigh - band.indexLow) * (value - band.low) + (band.high - band.low) / 2) /
+                                   (band.high - band.low);
+    }
+
+    // The index of value from table, the top of the last band above it.
+    // constexpr (in C++11 form, like the ESP32 core builds), so the tables
+    // are checked against reference values at compile time below.
+    template <size_t N>
+    constexpr uint16_t subIndex(const Breakpoint (&table)[N], uint32_t value, size_t i = 0) {
+        return value <= table[i].high ? interpolate(table[i], value < table[i].low ? table[i].low : value)
+                                      : (i + 1 < N ? subIndex(table, value, i + 1) : table[N - 1].indexHigh);
+    }
+
+    // US EPA AQI, 2024 revision, in 0.1 ug/m3 (24 h PM2.5 is reported to
+    // one decimal)
+    constexpr Breakpoint EPA_PM25[] = {
+        { 0, 90, 0, 50 },
+        { 91, 354, 51, 100 },
+        { 355, 554, 101, 150 },
+        { 555, 1254, 151, 200 },
+        { 1255, 2254, 201, 300 },
+        { 2255, 3254, 301, 500 },
+    };
+
+    // US EPA AQI, 2024 revision, in ug/m3
+    constexpr Breakpoint EPA_PM10[] = {
+        { 0, 54, 0, 50 },
+        { 55, 154, 51, 100 },
+        { 155, 254, 101, 150 },
+        { 255, 354, 151, 200 },
+        { 355, 424, 201, 300 },
+        { 425, 604, 301, 500 },
+    };
+
+    // European Common Air Quality Index (CAQI), hourly background grid, in
+    // ug/m3. Above 100 ("very high") it is only reported as > 100.
+    constexpr Breakpoint CAQI_PM25[] = {
+        { 0, 15, 0, 25 },
+        { 15, 30, 25, 50 },
+        { 30, 55, 50, 75 },
+        { 55, 110, 75, 100 },
+    };
+
+    constexpr Breakpoint CAQI_PM10[] = {
+        { 0, 25, 0, 25 },
+        { 25, 50, 25, 50 },
+        { 50, 90, 50, 75 },
+        { 90, 180, 75, 100 },
+    };
+
+    // VOC index on the scale of the Bosch IAQ (0-50 excellent, 51-100 good,
+    // 101-150 lightly, 151-200 moderately, 201-250 heavily, 251-350
+    // severely, above extremely polluted), from how far the gas resistance
+    // dropped below its clean air baseline, in %, both compensated for
+    // humidity (BME/GasBaseline.h). Not the calibrated BSEC index.
+    constexpr Breakpoint VOC_DROP[] = {
+        { 0, 10, 0, 50 },
+        { 10, 25, 50, 100 },
+        { 25, 40, 100, 150 },
+        { 40, 55, 150, 200 },
+        { 55, 70, 200, 250 },
+        { 70, 85, 250, 350 },
+        { 85, 100, 350, 500 },
+    };
+
+    // reference values of the EPA AQI calculator and the CAQI tables
+    static_assert(subIndex(EPA_PM25, 0) == 0, "EPA PM2.5 0.0");
+    static_assert(subIndex(EPA_PM25, 90) == 50, "EPA PM2.5 9.0");
+    static_assert(subIndex(EPA_PM25, 120) == 56, "EPA PM2.5 12.0");
+    static_assert(subIndex(EPA_PM25, 354) == 100, "EPA PM2.5 35.4");
+    static_assert(subIndex(EPA_PM25, 355) == 101, "EPA PM2.5 35.5");
+    static_assert(subIndex(EPA_PM25, 1500) == 225, "EPA PM2.5 150.0");
+    static_assert(subIndex(EPA_PM25, 9999) == 500, "EPA PM2.5 beyond the index");
+    static_assert(subIndex(EPA_PM10, 100) == 73, "EPA PM10 100");
+    static_assert(subIndex(EPA_PM10, 154) == 100, "EPA PM10 154");
+    static_assert(subIndex(EPA_PM10, 425) == 301, "EPA PM10 425");
+    static_assert(subIndex(CAQI_PM25, 20) == 33, "CAQI PM2.5 20");
+    static_assert(subIndex(CAQI_PM25, 55) == 75, "CAQI PM2.5 55");
+    static_assert(subIndex(CAQI_PM10, 70) == 63, "CAQI PM10 70");
+    static_assert(subIndex(CAQI_PM10, 500) == 100, "CAQI PM10 beyond the index");
+
+    static const uint16_t NO_INDEX = UINT16_MAX;
+
+    // VOC index of a gas resistance against the clean air baseline, NO_INDEX
+    // while the baseline is unknown
+    uint16_t vocIndex(float gasKOhm, float baselineKOhm);
+
+}
+
+    // What an AirScore makes of a sensor cycle
+    struct AirQuality {
+        uint16_t pm25Index; /** aqi::NO_INDEX if the scoring has none */
+        uint16_t pm10Index;
+        uint16_t vocIndex;
+        float score;        /** 0 = good, 1 = bad, what the fan follows */
+    };
+
+    // Turns a sensor cycle into an air quality score. The implementations
+    // keep no state; airScore() has one of each for every caller.
+    class AirScore {
+        public:
+            virtual ~AirScore() {}
+
+            virtual AirQuality evaluate(const Data& data, const Settings& settings) const = 0;
+    };
+
+    // The original score: the mean particle count (per 0.1 l, against the
+    // PM thresholds of the settings), gas and temperature each in three
+    // steps, weighted by the settings
+    class LegacyAirScore : public AirScore {
+        public:
+            AirQuality evaluate(const Data& data, const Settings& settings) const override;
+    };
+
+    // The worst of the EPA AQI sub-indices of PM2.5 and PM10 and the VOC
+    // index, full scale at 200 ("unhealthy", "moderately polluted")
+    class EpaAirScore : public AirScore {
+        public:
+            static const uint16_t FULL_SCALE = 200;
+
+            AirQuality evaluate(const Data& data, const Settings& settings) const override;
+    };
+
+    // The worst of the CAQI sub-indices of PM2.5 and PM10, full scale at 100
+    // ("very high"), and the VOC index, full scale at 200
+    class EuAirScore : public AirScore {
+        public:
+            static const uint16_t FULL_SCALE = 100;
+            static const uint16_t VOC_FULL_SCALE = 200;
+
+            AirQuality evaluate(const Data& data, const Settings& settings) const override;
+    };
+
+    // The scoring of a policy (AIR_SCORE_*), the build default for unknown ones
+    const AirScore& airScore(uint8_t policy);
+
+}
+
+#endif // AIR_SCORE_H
@@ -0,0 +1,23 @@
+#ifndef DATA_H
+#define DATA_H
+
+#include <Adafruit_PM25AQI.h>
+#include "../BME/BME.h"
+
+namespace SmartAirControl {
+
+    // One sensor cycle as the control task sees it
+    class Data {
+        public:
+            Data() : pmsData(), bmeData(), FanRpm(0), FanPercent(0), pm25Slope(0) {}
+            Data(PM25_AQI_Data pmsData, BMEData bmeData, int FanRpm, float FanPercent) : pmsData(pmsData), bmeData(bmeData), FanRpm(FanRpm), FanPercent(FanPercent), pm25Slope(0) {}
+            PM25_AQI_Data pmsData;  /** filtered (Filter/PmFilter.h) */
+            BMEData bmeData;
+            int FanRpm;
+            float FanPercent;
+            float pm25Slope;        /** ug/m3 per minute */
+    };
+
+}
+
+#endif // DATA_H
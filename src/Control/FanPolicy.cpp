@@ -0,0 +1,129 @@
+#include "FanPolicy.h"
+#include <cmath>
+#include "../Log/Log.h"
+
+namespace SmartAirControl {
+
+#if !defined(ESP32)
+    static int policyOverride = -1;
+
+    void FanPolicy::overridePolicy(int policy) {
+        policyOverride = policy;
+    }
+#endif
+
+    // a purifier of about 5 air changes per hour in a bedroom of 0.7
+    const float FanPolicy::CLEANING_RATIO = 7.0f;
+    // at these weights the fan runs at 20 % in clean air (AQI below 10),
+    // 30 % at AQI 20 and 50 % at AQI 100, where it starts to be heard; only
+    // much worse air gets it past that
+    const float FanPolicy::POWER_WEIGHT = 0.3f;
+    const float FanPolicy::NOISE_WEIGHT = 0.05f;
+    // a 40 mm fan at full speed, a bedroom at night
+    const float FanPolicy::QUIET_DB = 25.0f;
+    const float FanPolicy::FULL_SPEED_DB = 40.0f;
+    const float FanPolicy::HYSTERESIS = 0.01f;
+
+    static const int STEP_PERCENT = 100 / (FanPolicy::CANDIDATES - 1);
+
+    FanPolicy::FanPolicy(int policy) : policy(policy), current(0), changedMs(0), started(false) {
+        for (int i = 0; i < CANDIDATES; i++) {
+            float speed = static_cast<float>(i) / (CANDIDATES - 1);
+            removal[i] = 1 + CLEANING_RATIO * speed;
+
+            float noise = 0;
+            if (i > 0) {
+                float db = FULL_SPEED_DB + 50 * std::log10(speed);
+                noise = db > QUIET_DB ? (db - QUIET_DB) / (FULL_SPEED_DB - QUIET_DB) : 0;
+            }
+            penalty[i] = POWER_WEIGHT * speed * speed * speed + NOISE_WEIGHT * noise;
+        }
+    }
+
+    int FanPolicy::getPolicy() const {
+#if !defined(ESP32)
+        if (policyOverride >= 0) {
+            return policyOverride;
+        }
+#endif
+        return policy;
+    }
+
+    const char* FanPolicy::policyName(int policy) {
+#if !defined(ESP32)
+        if (policy == FAN_POLICY_INVERTED) {
+            return "inverted";
+        }
+#endif
+        return policy == FAN_POLICY_LINEAR ? "linear" : "optimal";
+    }
+
+    int FanPolicy::optimal(float score, uint32_t nowMs) {
+        // the score of the air without the fan, per unit of removal
+        float unpurified = score * removal[current];
+
+        int best = 0;
+        float bestCost = unpurified / removal[0] + penalty[0];
+        for (int i = 1; i < CANDIDATES; i++) {
+            float cost = unpurified / removal[i] + penalty[i];
+            if (cost < bestCost) {
+                best = i;
+                bestCost = cost;
+            }
+        }
+
+        if (started && best != current) {
+            float currentCost = unpurified / removal[current] + penalty[current];
+            uint32_t dwellMs = best > current ? UP_DWELL_MS : DOWN_DWELL_MS;
+            if (currentCost - bestCost < HYSTERESIS || nowMs - changedMs < dwellMs) {
+                return current;
+            }
+        }
+
+        if (!started || best != current) {
+            current = best;
+            changedMs = nowMs;
+            started = true;
+        }
+        return current;
+    }
+
+    int FanPolicy::setpoint(float score, uint32_t nowMs) {
+        if (getPolicy() == FAN_POLICY_LINEAR) {
+            return static_cast<int>(score * 100);
+        }
+#if !defined(ESP32)
+        if (getPolicy() == FAN_POLICY_INVERTED) {
+            return static_cast<int>((1 - score) * 100);
+        }
+#endif
+        return optimal(score, nowMs) * STEP_PERCENT;
+    }
+
+    void FanPolicy::adjustFanSpeed(Fan& fan, float score, const Settings& settings, uint32_t nowMs) {
+        int fanPercent;
+        switch (settings.fanMode) {
+            case FAN_MANUAL:
+                fanPercent = settings.fanPercent;
+                break;
+            case FAN_OFF:
+                fanPercent = 0;
+                break;
+            default:
+                fanPercent = setpoint(score, nowMs);
+                break;
+        }
+
+        if (settings.fanMode != FAN_AUTO) {
+            // back in FAN_AUTO the scaling starts from what the fan runs at
+            current = (fanPercent + STEP_PERCENT / 2) / STEP_PERCENT;
+            changedMs = nowMs;
+            started = false;
+        }
+
+        fan.setRpmPercent(fanPercent);
+
+        LOG_DEBUG(APP, "Adjusting fan speed to %d%% based on air quality and temperature.", fanPercent);
+    }
+
+}
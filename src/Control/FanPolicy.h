@@ -0,0 +1,81 @@
+#ifndef FAN_POLICY_H
+#define FAN_POLICY_H
+
+#include <cstdint>
+#include "../Fan/Fan.h"
+#include "AirScore.h"
+#include "Settings.h"
+
+// Fan policy selected by the FAN_POLICY build flag
+#define FAN_POLICY_LINEAR 0  // the setpoint in % is the score
+#define FAN_POLICY_OPTIMAL 1 // the setpoint of the least exposure, power and noise cost
+#if !defined(ESP32)
+#define FAN_POLICY_INVERTED 2 // native simulation only: the old (1 - score) mapping, to compare against
+#endif
+
+#ifndef FAN_POLICY
+#define FAN_POLICY FAN_POLICY_OPTIMAL
+#endif
+
+namespace SmartAirControl {
+
+    // Sets the fan speed from the air quality score (AirScore.h, 0 = good,
+    // 1 = bad), or as the fan mode of settings says.
+    //
+    // FAN_POLICY_OPTIMAL weighs, per hour and for each of the CANDIDATES
+    // setpoints:
+    //  - exposure: the score the room settles at. The sensor sees the air
+    //    the fan already cleans, so the score is first scaled back to the
+    //    air without the fan (at the current setpoint), then down to the
+    //    candidate: removal by ventilation plus CLEANING_RATIO times that
+    //    by the fan at full speed
+    //  - power: cubic in the speed, POWER_WEIGHT at full speed
+    //  - noise: dB(A) above QUIET_DB, 50 log10 of the speed ratio below
+    //    FULL_SPEED_DB, NOISE_WEIGHT at full speed
+    // The last two only depend on the candidate and are tabled at
+    // construction, an evaluation is a handful of multiply-adds. A new
+    // setpoint has to be HYSTERESIS cheaper than the current one and the
+    // current one has to have been held for UP_DWELL_MS (faster) or
+    // DOWN_DWELL_MS (slower), so the fan does not chatter.
+    class FanPolicy {
+        public:
+            static const int CANDIDATES = 11;          /** 0, 10, ... 100 % */
+            static const float CLEANING_RATIO;         /** fan air changes at full speed per natural one */
+            static const float POWER_WEIGHT;           /** per hour at full speed, a score of 1 weighs 1 */
+            static const float NOISE_WEIGHT;
+            static const float QUIET_DB;
+            static const float FULL_SPEED_DB;
+            static const float HYSTERESIS;
+            static const uint32_t UP_DWELL_MS = 10000;
+            static const uint32_t DOWN_DWELL_MS = 120000;
+
+            explicit FanPolicy(int policy);
+
+            int getPolicy() const;
+            static const char* policyName(int policy);
+
+            // The setpoint in % for the score at nowMs (hal::millis()),
+            // in FAN_AUTO
+            int setpoint(float score, uint32_t nowMs);
+
+            void adjustFanSpeed(Fan& fan, float score, const Settings& settings, uint32_t nowMs);
+
+#if !defined(ESP32)
+            // Native simulation: the fan policy given on the command line
+            static void overridePolicy(int policy);
+#endif
+
+        private:
+            int policy;
+            float removal[CANDIDATES];  /** relative to ventilation alone */
+            float penalty[CANDIDATES];  /** power and noise cost */
+            int current;                /** candidate index */
+            uint32_t changedMs;
+            bool started;
+
+            int optimal(float score, uint32_t nowMs);
+    };
+
+}
+
+#endif // FAN_POLICY_H
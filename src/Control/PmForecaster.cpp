@@ -0,0 +1,87 @@
+#include "PmForecaster.h"
+
+namespace SmartAirControl {
+
+#if !defined(ESP32)
+    static int policyOverride = -1;
+
+    void PmForecaster::overridePolicy(int policy) {
+        policyOverride = policy;
+    }
+#endif
+
+    // the readings come out of the PMS filter already smoothed
+    const float PmForecaster::LEVEL_TAU_S = 5.0f;
+    const float PmForecaster::TREND_TAU_S = 60.0f;
+
+    PmForecaster::PmForecaster(int policy) : policy(policy), level(0), trend(0), lastMs(0), started(false) {
+    }
+
+    int PmForecaster::getPolicy() const {
+#if !defined(ESP32)
+        if (policyOverride >= 0) {
+            return policyOverride;
+        }
+#endif
+        return policy;
+    }
+
+    const char* PmForecaster::policyName(int policy) {
+        return policy == FAN_CONTROL_PREDICTIVE ? "predictive" : "reactive";
+    }
+
+    void PmForecaster::update(float pm25, uint32_t nowMs) {
+        uint32_t elapsedMs = nowMs - lastMs;
+        if (!started || elapsedMs > MAX_GAP_MS) {
+            level = pm25;
+            trend = 0;
+            lastMs = nowMs;
+            started = true;
+            return;
+        }
+        if (elapsedMs == 0) {
+            return;
+        }
+        lastMs = nowMs;
+
+        float dt = elapsedMs / 1000.0f;
+        float predicted = level + trend * dt;
+        float newLevel = predicted + (pm25 - predicted) * dt / (LEVEL_TAU_S + dt);
+        trend += ((newLevel - level) / dt - trend) * dt / (TREND_TAU_S + dt);
+        level = newLevel;
+    }
+
+    float PmForecaster::forecast() const {
+        float ahead = level + trend * HORIZON_S;
+        return ahead > 0 ? ahead : 0;
+    }
+
+    static uint16_t scaled(uint16_t value, float factor) {
+        float result = value * factor + 0.5f;
+        return result >= UINT16_MAX ? UINT16_MAX : static_cast<uint16_t>(result);
+    }
+
+    Data PmForecaster::predict(const Data& data) const {
+        Data predicted = data;
+        if (!started) {
+            return predicted;
+        }
+
+        PM25_AQI_Data& pms = predicted.pmsData;
+        float ahead = forecast();
+        if (pms.pm25_env == 0) {
+            // nothing to scale, the PM2.5 alone
+            pms.pm25_env = scaled(1, ahead);
+            return predicted;
+        }
+        float factor = ahead / pms.pm25_env;
+        pms.pm10_env = scaled(pms.pm10_env, factor);
+        pms.pm25_env = scaled(pms.pm25_env, factor);
+        pms.pm100_env = scaled(pms.pm100_env, factor);
+        pms.particles_10um = scaled(pms.particles_10um, factor);
+        pms.particles_25um = scaled(pms.particles_25um, factor);
+        pms.particles_100um = scaled(pms.particles_100um, factor);
+        return predicted;
+    }
+
+}
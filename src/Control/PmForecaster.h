@@ -0,0 +1,65 @@
+#ifndef PM_FORECASTER_H
+#define PM_FORECASTER_H
+
+#include <cstdint>
+#include "Data.h"
+
+// Fan control selected by the FAN_CONTROL build flag
+#define FAN_CONTROL_REACTIVE 0   // the fan follows the air as it is
+#define FAN_CONTROL_PREDICTIVE 1 // the fan follows the PM forecast HORIZON_S ahead
+
+#ifndef FAN_CONTROL
+#define FAN_CONTROL FAN_CONTROL_REACTIVE
+#endif
+
+namespace SmartAirControl {
+
+    // Forecasts the filtered PM2.5 HORIZON_S ahead with Holt's linear trend
+    // (double exponential smoothing): a level that follows the readings
+    // within LEVEL_TAU_S and a trend that follows the change of the level
+    // within TREND_TAU_S, both by time constant so irregular intervals
+    // (light sleep, deep sleep wakeups) weigh right. Constant time and
+    // memory per reading.
+    //
+    // Under FAN_CONTROL_PREDICTIVE the fan is set from the score of the
+    // forecast: it ramps up while a pollution event is still building and
+    // backs off once it decays.
+    class PmForecaster {
+        public:
+            static const uint32_t HORIZON_S = 180;
+            static const float LEVEL_TAU_S;
+            static const float TREND_TAU_S;
+            // readings further apart start over, the trend is stale
+            static const uint32_t MAX_GAP_MS = 60000;
+
+            explicit PmForecaster(int policy);
+
+            int getPolicy() const;
+            static const char* policyName(int policy);
+
+            // A filtered PM2.5 reading in ug/m3 at nowMs (hal::millis())
+            void update(float pm25, uint32_t nowMs);
+
+            // ug/m3, HORIZON_S ahead, the last reading until there is a trend
+            float forecast() const;
+
+            // data with the mass concentrations and particle counts of the
+            // forecast, scaled alike (the mix of particle sizes stays)
+            Data predict(const Data& data) const;
+
+#if !defined(ESP32)
+            // Native simulation: the fan control given on the command line
+            static void overridePolicy(int policy);
+#endif
+
+        private:
+            int policy;
+            float level;  /** ug/m3 */
+            float trend;  /** ug/m3 per second */
+            uint32_t lastMs;
+            bool started;
+    };
+
+}
+
+#endif // PM_FORECASTER_H
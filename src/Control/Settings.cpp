@@ -0,0 +1,65 @@
+#include "Settings.h"
+#include "AirScore.h"
+#include "../HAL/Hal.h"
+#include "../LoRa/UplinkScheduler.h"
+#include "../Storage/Crc.h"
+
+namespace SmartAirControl {
+
+    // NVS layout
+    struct StoredSettings {
+        uint8_t version;
+        Settings settings;
+        uint16_t crc;
+    };
+    static const uint8_t STORED_SETTINGS_VERSION = 3;
+
+    Settings Settings::defaults() {
+        Settings settings;
+        settings.fanMode = FAN_AUTO;
+        settings.fanPercent = 0;
+        settings.pmLow = 10;
+        settings.pmHigh = 35;
+        settings.gasLow = 50;
+        settings.gasHigh = 100;
+        settings.tempLow = 25;
+        settings.tempHigh = 30;
+        settings.gasWeight = 20;
+        settings.pmWeight = 70;
+        settings.tempWeight = 10;
+        settings.uplinkPolicy = UPLINK_POLICY;
+        settings.heartbeatMin = UplinkScheduler::DEFAULT_HEARTBEAT_MS / 60000;
+        settings.scorePolicy = AIR_SCORE;
+        return settings;
+    }
+
+    bool Settings::isValid() const {
+        return fanMode <= FAN_OFF && fanPercent <= 100 &&
+               pmLow < pmHigh && gasLow < gasHigh && tempLow < tempHigh &&
+               gasWeight + pmWeight + tempWeight == 100 &&
+               uplinkPolicy <= UPLINK_ADAPTIVE && heartbeatMin > 0 && scorePolicy <= AIR_SCORE_EU;
+    }
+
+    bool Settings::load(Settings& settings) {
+        StoredSettings stored;
+        hal::Nvs store("settings", true);
+        if (store.getBytes("settings", &stored, sizeof(stored)) != sizeof(stored) ||
+            stored.version != STORED_SETTINGS_VERSION ||
+            stored.crc != crc16(&stored.settings, sizeof(stored.settings)) || !stored.settings.isValid()) {
+            return false;
+        }
+        settings = stored.settings;
+        return true;
+    }
+
+    void Settings::save() const {
+        StoredSettings stored;
+        stored.version = STORED_SETTINGS_VERSION;
+        stored.settings = *this;
+        stored.crc = crc16(&stored.settings, sizeof(stored.settings));
+
+        hal::Nvs store("settings");
+        store.putBytes("settings", &stored, sizeof(stored));
+    }
+
+}
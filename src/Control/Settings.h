@@ -0,0 +1,46 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <cstdint>
+
+// Fan modes
+#define FAN_AUTO 0   // from the air quality score
+#define FAN_MANUAL 1 // at Settings::fanPercent
+#define FAN_OFF 2
+
+namespace SmartAirControl {
+
+    // What the network can change (Command/CommandDispatcher.h), kept in
+    // NVS. Plain data, so a complete copy can be handed to the control task
+    // and swapped in between two cycles.
+    struct Settings {
+        uint8_t fanMode;        /** FAN_AUTO, FAN_MANUAL or FAN_OFF */
+        uint8_t fanPercent;     /** setpoint in FAN_MANUAL */
+        uint16_t pmLow;         /** ug/m3, mean PM above scores half (legacy score) */
+        uint16_t pmHigh;        /** ug/m3, mean PM above scores full (legacy score) */
+        uint16_t gasLow;        /** KOhm, gas resistance below scores full (legacy score) */
+        uint16_t gasHigh;       /** KOhm, gas resistance below scores half (legacy score) */
+        int8_t tempLow;         /** degrees celsius, above scores half (legacy score) */
+        int8_t tempHigh;        /** degrees celsius, above scores full (legacy score) */
+        uint8_t gasWeight;      /** % of the legacy score, the weights add up to 100 */
+        uint8_t pmWeight;
+        uint8_t tempWeight;
+        uint8_t uplinkPolicy;   /** UPLINK_FIXED or UPLINK_ADAPTIVE */
+        uint16_t heartbeatMin;  /** adaptive uplinks: at least this often */
+        uint8_t scorePolicy;    /** AIR_SCORE_LEGACY, AIR_SCORE_EPA or AIR_SCORE_EU */
+
+        // The values the firmware was built with
+        static Settings defaults();
+
+        // Every field in range and the pairs in order
+        bool isValid() const;
+
+        // The stored settings, false (and settings untouched) if there are
+        // none or they do not pass the checks
+        static bool load(Settings& settings);
+        void save() const;
+    };
+
+}
+
+#endif // SETTINGS_H
@@ -0,0 +1,76 @@
+#include "CaptureTach.h"
+
+#include "../HAL/Hal.h"
+
+namespace SmartAirControl {
+
+    // the capture timer runs from the 80 MHz APB clock
+    static const uint32_t TICKS_PER_US = 80;
+
+    CaptureTach::CaptureTach(int pin, mcpwm_unit_t unit, uint32_t prescale, uint32_t minPeriodUs)
+        : pin(pin), unit(unit), prescale(prescale), minTicks(minPeriodUs * TICKS_PER_US * prescale),
+          pulseCount(0), lastTicks(0), lastEdgeUs(0), anchored(false), anchorTicks(0), anchorUs(0), lock(portMUX_INITIALIZER_UNLOCKED) {
+    }
+
+    void CaptureTach::begin() {
+        mcpwm_gpio_init(unit, MCPWM_CAP_0, pin);
+        gpio_pullup_en(static_cast<gpio_num_t>(pin));
+
+        mcpwm_capture_config_t config = {};
+        config.cap_edge = MCPWM_NEG_EDGE;
+        config.cap_prescale = prescale;
+        config.capture_cb = onCapture;
+        config.user_data = this;
+        mcpwm_capture_enable_channel(unit, MCPWM_SELECT_CAP0, &config);
+    }
+
+    uint32_t CaptureTach::takePulses() {
+        portENTER_CRITICAL(&lock);
+            uint32_t count = pulseCount;
+            pulseCount = 0;
+        portEXIT_CRITICAL(&lock);
+        return count;
+    }
+
+    const PulseRing* CaptureTach::getEdges() const {
+        return &edges;
+    }
+
+    bool IRAM_ATTR CaptureTach::onCapture(mcpwm_unit_t unit,
+                                          mcpwm_capture_channel_id_t channel,
+                                          const cap_event_data_t* event,
+                                          void* arg) {
+        CaptureTach* tach = static_cast<CaptureTach*>(arg);
+
+        uint32_t now = hal::micros();
+
+        portENTER_CRITICAL_ISR(&tach->lock);
+        // the 32 bit capture timer wraps after ~53 s: re-anchor after long
+        // silences, and move the anchor along while the fan keeps running
+        if (!tach->anchored || now - tach->lastEdgeUs > 50000000UL) {
+            tach->anchored = true;
+            tach->anchorTicks = event->cap_value;
+            tach->anchorUs = now;
+            tach->lastTicks = event->cap_value - tach->minTicks;
+        }
+
+        uint32_t ticks = event->cap_value - tach->lastTicks;
+        if (ticks >= tach->minTicks) {
+            tach->pulseCount += tach->prescale;
+            tach->lastTicks = event->cap_value;
+            tach->lastEdgeUs = now;
+
+            uint32_t sinceAnchor = event->cap_value - tach->anchorTicks;
+            uint32_t stampUs = tach->anchorUs + sinceAnchor / TICKS_PER_US;
+            tach->edges.push(stampUs);
+            if (sinceAnchor > (1UL << 30)) {
+                tach->anchorTicks = event->cap_value - sinceAnchor % TICKS_PER_US;
+                tach->anchorUs = stampUs;
+            }
+        }
+        portEXIT_CRITICAL_ISR(&tach->lock);
+
+        return false; // no task was woken
+    }
+
+}
@@ -0,0 +1,53 @@
+#ifndef CAPTURE_TACH_H
+#define CAPTURE_TACH_H
+
+#include <driver/mcpwm.h>
+#include <esp_attr.h>
+#include <freertos/FreeRTOS.h>
+#include "Tach.h"
+
+namespace SmartAirControl {
+
+    // Time-stamps edges with the MCPWM capture unit. The edge time is latched
+    // by the hardware at 80 MHz, so interrupt latency does not show up in the
+    // period. With prescale > 1 only every n-th edge raises an interrupt,
+    // which cuts the interrupt rate at high speed; the prescaler counts
+    // every edge, contact bounce included, so only for a clean tach line.
+    // Periods shorter than minPeriodUs are treated as glitches. Capture ticks
+    // are converted to the micros() time base against an anchor taken at
+    // the first edge.
+    class CaptureTach : public Tach {
+        public:
+            CaptureTach(int pin,
+                        mcpwm_unit_t unit = MCPWM_UNIT_0,
+                        uint32_t prescale = 1,
+                        uint32_t minPeriodUs = 500);
+
+            void begin() override;
+            uint32_t takePulses() override;
+            const PulseRing* getEdges() const override;
+            uint32_t getPulsesPerEdge() const override { return prescale; }
+
+        private:
+            static bool IRAM_ATTR onCapture(mcpwm_unit_t unit,
+                                            mcpwm_capture_channel_id_t channel,
+                                            const cap_event_data_t* event,
+                                            void* arg);
+
+            int pin;
+            mcpwm_unit_t unit;
+            uint32_t prescale;
+            uint32_t minTicks;
+            volatile uint32_t pulseCount;
+            volatile uint32_t lastTicks;
+            volatile uint32_t lastEdgeUs;
+            bool anchored;
+            uint32_t anchorTicks;
+            uint32_t anchorUs;
+            PulseRing edges;
+            portMUX_TYPE lock;
+    };
+
+}
+
+#endif // CAPTURE_TACH_H
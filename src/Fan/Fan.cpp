@@ -1,34 +1,51 @@
 #include "Fan.h"
-#include <Arduino.h>
+#include "../HAL/Hal.h"
 
 namespace SmartAirControl {
 
-// Define static member variables
-volatile int Fan::pulseCount = 0;
-volatile unsigned long Fan::lastPulse = 0;
-
-    Fan::Fan(int fanPwmPin, int tachPin)
-        : fanPwmPin(fanPwmPin), tachPin(tachPin),
+    Fan::Fan(int fanPwmPin, Tach& tach)
+        : fanPwmPin(fanPwmPin), tach(tach),
           rpmTable{   0,   780,  1140,  1440,  1740,  2730,  6720,  9960, 12930, 14520, 12570 },
           dutyTable{ 255,   230,   204,   179,   153,   128,   102,    77,    51,    26,     0 },
-          maxRpm(14520.0), currentPercent(0), lastRpmTime(0) {
+          calibrated(false), maxRpm(14520.0), currentPercent(0), lastRpmTime(0), trimStart(0), changeStart(0),
+          measuredRpm(0),
+          estimator(500000UL, 2000000UL, 2.0),
+          // output is the drive level (PWM_MAX - duty), so more output = faster,
+          // the speeds are in duty steps (see update()). A PI loop: on the
+          // simulated fan a derivative term changed neither the overshoot nor
+          // the settling time, the tach speed of one period is too coarse.
+          pid(0.5, 0.5, 0.0, 0, PWM_MAX, 64) {
+        // the factory table runs backwards at the top (14520 then 12570)
+        setTable(rpmTable, dutyTable);
     }
 
     void Fan::setup() {
-        pinMode(fanPwmPin, OUTPUT);
-        analogWrite(fanPwmPin, 255); 
+        hal::pinOutput(fanPwmPin);
+        hal::pwmWrite(fanPwmPin, 255);
+
+        tach.begin();
 
-        pinMode(tachPin, INPUT_PULLUP);
-        attachInterrupt(digitalPinToInterrupt(tachPin), countPulse, FALLING);
+        lastRpmTime = hal::millis();
+
+        calibrated = loadTable();
     }
 
     int Fan::getRpm() {
-        noInterrupts();
-            int count = pulseCount;
-            pulseCount = 0;
-        interrupts();
+        return estimator.getSmoothedRpm();
+    }
 
-        return (count / 2.0) * 60.0;
+    int Fan::measureRpm() {
+        uint32_t count = tach.takePulses();
+
+        unsigned long now = hal::millis();
+        unsigned long elapsed = now - lastRpmTime;
+        lastRpmTime = now;
+
+        const PulseRing* edges = tach.getEdges();
+        if (edges != nullptr) {
+            return estimator.update(*edges, tach.getPulsesPerEdge(), hal::micros());
+        }
+        return estimator.update(count, elapsed * 1000UL, hal::micros());
     }
 
     float Fan::getRpmPercent() {
@@ -41,36 +58,170 @@ volatile unsigned long Fan::lastPulse = 0;
 
         if (currentPercent != percent) {
             currentPercent = percent;
+            // jump straight to the table value, update() trims from there
             int duty = getInterpolatedDuty(percent);
-            analogWrite(fanPwmPin, duty);
+            pid.reset(PWM_MAX - duty);
+            writeDuty(duty);
+            trimStart = hal::millis();
+            changeStart = trimStart;
         }
     }
-    
+
+    bool Fan::needsTach() {
+        return currentPercent > 0 && hal::millis() - trimStart < TRIM_WINDOW_MS;
+    }
+
+    void Fan::restartMeasurement() {
+        tach.takePulses();
+        lastRpmTime = hal::millis();
+    }
+
+    void Fan::holdStopped() {
+        hal::pinHold(fanPwmPin, true);
+    }
+
+    void Fan::update() {
+        if (hal::millis() - trimStart >= TRIM_INTERVAL_MS) {
+            trimStart = hal::millis();
+        }
+
+        unsigned long elapsed = hal::millis() - lastRpmTime;
+        if (elapsed < CONTROL_PERIOD_MS) {
+            return;
+        }
+
+        measuredRpm = measureRpm();
+
+        // stopped, open loop (setDuty) or still following the jump
+        if (currentPercent <= 0 || hal::millis() - changeStart < SPIN_UP_MS) {
+            return;
+        }
+
+        float targetRpm = currentPercent / 100.0 * maxRpm;
+        float feedForward = PWM_MAX - getInterpolatedDuty(currentPercent);
+        // the fan is ten times as sensitive to the duty at the bottom of the
+        // table as in the middle: the loop works in duty steps of the table
+        // segment the setpoint is in, so that one set of gains fits all
+        float scale = dutyPerRpm(targetRpm);
+        float drive = pid.update(targetRpm * scale, measuredRpm * scale, feedForward, elapsed / 1000.0);
+        writeDuty(PWM_MAX - int(drive + 0.5));
+    }
+
+    float Fan::dutyPerRpm(float rpm) {
+        int i = 0;
+        while (i < N - 2 && rpm > rpmTable[i+1]) {
+            i++;
+        }
+        float span = rpmTable[i+1] - rpmTable[i];
+        // a flat segment of a calibrated table: the average slope
+        return span > 0 ? (dutyTable[i] - dutyTable[i+1]) / span : PWM_MAX / maxRpm;
+    }
+
+    void Fan::setDuty(int duty) {
+        if (duty < 0) duty = 0;
+        if (duty > PWM_MAX) duty = PWM_MAX;
+
+        currentPercent = -1;
+        writeDuty(duty);
+    }
+
+    int Fan::getRawRpm() {
+        return measuredRpm;
+    }
+
+    void Fan::writeDuty(int duty) {
+        hal::pwmWrite(fanPwmPin, duty);
+    }
 
     int Fan::getInterpolatedDuty(int percent) {
-        float desiredRpm = percent / 100.0 * maxRpm;
+        if (percent < 0) percent = 0;
+        if (percent > 100) percent = 100;
+        return dutyForPercent[percent];
+    }
 
-        // unterhalb Minimum
-        if (desiredRpm <= rpmTable[0]) return dutyTable[0];
-        // oberhalb Maximum
-        if (desiredRpm >= rpmTable[N-1]) return dutyTable[N-1];
+    void Fan::setTable(const int rpm[], const int duty[]) {
+        // isotonic fit: a point may not be slower than the one below it
+        for (int i = 0; i < N; i++) {
+            rpmTable[i] = (i > 0 && rpm[i] < rpmTable[i-1]) ? rpmTable[i-1] : rpm[i];
+            dutyTable[i] = duty[i];
+        }
+        maxRpm = rpmTable[N-1];
+
+        buildLookup();
+    }
+
+    void Fan::buildLookup() {
+        // one pass over the monotonic table, so getInterpolatedDuty() is a plain index
+        int i = 0;
+        for (int percent = 0; percent <= 100; percent++) {
+            float desiredRpm = percent / 100.0 * maxRpm;
 
-        // Segment suchen und interpolieren
-        for (int i = 0; i < N - 1; i++) {
-            if (desiredRpm <= rpmTable[i+1]) {
+            // unterhalb Minimum
+            if (desiredRpm <= rpmTable[0]) {
+                dutyForPercent[percent] = dutyTable[0];
+                continue;
+            }
+
+            // Segment suchen und interpolieren
+            while (i < N - 2 && desiredRpm > rpmTable[i+1]) {
+                i++;
+            }
+            if (desiredRpm >= rpmTable[i+1] || rpmTable[i+1] == rpmTable[i]) {
+                dutyForPercent[percent] = dutyTable[i+1];
+                continue;
+            }
             float frac = (desiredRpm - rpmTable[i]) / (rpmTable[i+1] - rpmTable[i]);
             float d    = dutyTable[i] + frac * (dutyTable[i+1] - dutyTable[i]);
-            return int(d + 0.5);  // aufrunden
-            }
+            dutyForPercent[percent] = int(d + 0.5);  // aufrunden
+        }
+    }
+
+    // NVS layout of a calibrated table
+    struct StoredTable {
+        uint8_t version;
+        uint16_t rpm[Fan::N];
+        uint8_t duty[Fan::N];
+    };
+    static const uint8_t STORED_TABLE_VERSION = 1;
+
+    bool Fan::isCalibrated() {
+        return calibrated;
+    }
+
+    bool Fan::loadTable() {
+        StoredTable stored;
+        bool ok;
+        {
+            hal::Nvs store("fan", true);
+            ok = store.getBytes("table", &stored, sizeof(stored)) == sizeof(stored) &&
+                 stored.version == STORED_TABLE_VERSION;
+        }
+
+        if (!ok) {
+            return false;
         }
-        return dutyTable[N-1];
+
+        int rpm[N];
+        int duty[N];
+        for (int i = 0; i < N; i++) {
+            rpm[i] = stored.rpm[i];
+            duty[i] = stored.duty[i];
+        }
+        setTable(rpm, duty);
+        return true;
     }
 
-    void IRAM_ATTR Fan::countPulse() {
-        unsigned long now = micros();
-        if (now - lastPulse > 1000) {   // 1 ms Debounce
-            pulseCount++;
-            lastPulse = now;
+    void Fan::saveTable() {
+        StoredTable stored;
+        stored.version = STORED_TABLE_VERSION;
+        for (int i = 0; i < N; i++) {
+            stored.rpm[i] = rpmTable[i];
+            stored.duty[i] = dutyTable[i];
         }
+
+        hal::Nvs store("fan");
+        store.putBytes("table", &stored, sizeof(stored));
+
+        calibrated = true;
     }
 }
\ No newline at end of file
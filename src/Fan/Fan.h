@@ -1,27 +1,83 @@
-#include <Arduino.h>
+#ifndef FAN_H
+#define FAN_H
+
+#include <cstdint>
+#include "PidController.h"
+#include "Tach.h"
+#include "RpmEstimator.h"
 
 namespace SmartAirControl {
     class Fan {
         public:
-            Fan(int fanPwmPin, int tachPin);
+            Fan(int fanPwmPin, Tach& tach);
             void setup();
+            // Smoothed speed, refreshed by update()
             int getRpm();
             void setRpmPercent(int percent);
             float getRpmPercent();
 
-        private:
+            // Closed loop speed control, call often; it acts every CONTROL_PERIOD_MS
+            void update();
+
+            // The tach does not count while the CPU sleeps. After a setpoint
+            // change, and every TRIM_INTERVAL_MS, the loop wants a
+            // TRIM_WINDOW_MS stretch awake to settle; in between the duty is
+            // held. True while in such a window.
+            bool needsTach();
+            // The CPU slept, tach edges were lost: the next measurement
+            // starts now
+            void restartMeasurement();
+            // Keeps the fan stopped through deep sleep, until setup()
+            void holdStopped();
+
+            // Open loop duty, bypasses the controller until the next setRpmPercent()
+            void setDuty(int duty);
+            // Unsmoothed speed of the last update()
+            int getRawRpm();
+            // Open loop duty for a setpoint, a lookup in the table built by setTable()
+            int getInterpolatedDuty(int percent);
+
+            // Replaces the duty->RPM table (ordered from stopped to full speed).
+            // RPM is forced monotonic and the percent->duty lookup rebuilt.
+            void setTable(const int rpm[], const int duty[]);
+            // Calibrated table in NVS, loaded by setup()
+            bool isCalibrated();
+            void saveTable();
+
+            static const unsigned long CONTROL_PERIOD_MS = 500;
+            // After a setpoint change the duty jumps to the table value and
+            // the loop leaves it alone for this long, about 2.5 time
+            // constants of the fan: trimming while the rotor still spins up
+            // or down winds the integrator up and overshoots
+            static const unsigned long SPIN_UP_MS = 3000;
+            static const unsigned long TRIM_WINDOW_MS = 5000;
+            static const unsigned long TRIM_INTERVAL_MS = 60000;
             static const int N = 11;
+            static const int PWM_MAX = 255;
+
+        private:
             int fanPwmPin;
-            int tachPin;
-            static volatile int pulseCount;
-            static volatile unsigned long lastPulse;
+            Tach& tach;
             int rpmTable[N];
             int dutyTable[N];
+            uint8_t dutyForPercent[101];
+            bool calibrated;
             float maxRpm;
             int currentPercent;
             unsigned long lastRpmTime;
+            unsigned long trimStart;
+            unsigned long changeStart;
+            int measuredRpm;
+            RpmEstimator estimator;
+            PidController pid;
 
-            int getInterpolatedDuty(int percent);
-            static void IRAM_ATTR countPulse();
+            int measureRpm();
+            // Slope of the table around rpm, duty steps per rpm
+            float dutyPerRpm(float rpm);
+            void buildLookup();
+            bool loadTable();
+            void writeDuty(int duty);
     };
-}
\ No newline at end of file
+}
+
+#endif // FAN_H
@@ -0,0 +1,82 @@
+#include "FanCalibration.h"
+#include <Arduino.h>
+#include <cstdlib>
+#include "../HAL/Hal.h"
+#include "../Log/Log.h"
+
+namespace SmartAirControl {
+
+    FanCalibration::FanCalibration(Fan& fan, unsigned long settleMs, unsigned long maxSettleMs)
+        : fan(fan), settleMs(settleMs), maxSettleMs(maxSettleMs), index(-1), pointStart(0), lastCheck(0), lastRpm(-1) {
+        // evenly spaced duty points from 255 (stopped) down to 0 (full speed)
+        for (int i = 0; i < Fan::N; i++) {
+            duty[i] = Fan::PWM_MAX - (Fan::PWM_MAX * i + (Fan::N - 1) / 2) / (Fan::N - 1);
+            rpm[i] = 0;
+        }
+    }
+
+    void FanCalibration::start() {
+        LOG_INFO(FAN, "Calibration started, budget %lu ms", getBudgetMs());
+
+        index = Fan::N - 1;
+        beginPoint();
+    }
+
+    bool FanCalibration::isRunning() {
+        return index >= 0;
+    }
+
+    unsigned long FanCalibration::getBudgetMs() {
+        return Fan::N * maxSettleMs;
+    }
+
+    bool FanCalibration::step() {
+        if (!isRunning()) {
+            return false;
+        }
+
+        fan.update();
+
+        unsigned long elapsed = hal::millis() - pointStart;
+        bool timedOut = elapsed >= maxSettleMs;
+        if (!timedOut && (elapsed < settleMs || hal::millis() - lastCheck < Fan::CONTROL_PERIOD_MS)) {
+            return true;
+        }
+        lastCheck = hal::millis();
+
+        int now = fan.getRawRpm();
+        int tolerance = now / 50 > 30 ? now / 50 : 30; // 2 %, at least 30 RPM
+        bool stable = lastRpm >= 0 && std::abs(now - lastRpm) <= tolerance;
+        lastRpm = now;
+        if (!stable && !timedOut) {
+            return true;
+        }
+
+        rpm[index] = now;
+        LOG_INFO(FAN, "Duty %d -> %d RPM", duty[index], now);
+
+        index--;
+        if (index < 0) {
+            finish();
+            return false;
+        }
+        beginPoint();
+        return true;
+    }
+
+    void FanCalibration::beginPoint() {
+        fan.setDuty(duty[index]);
+        pointStart = hal::millis();
+        lastCheck = pointStart;
+        lastRpm = -1;
+    }
+
+    void FanCalibration::finish() {
+        fan.setTable(rpm, duty);
+        fan.saveTable();
+        fan.setRpmPercent(0);
+
+        LOG_INFO(FAN, "Calibration stored");
+    }
+
+}
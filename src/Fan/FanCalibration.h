@@ -0,0 +1,44 @@
+#ifndef FAN_CALIBRATION_H
+#define FAN_CALIBRATION_H
+
+#include "Fan.h"
+
+namespace SmartAirControl {
+
+    // Measures the duty->RPM table of the connected fan. The sweep runs from
+    // full speed down so the fan never has to start from standstill at a low
+    // duty. Each point waits at least settleMs and is accepted once two
+    // consecutive readings agree, or after maxSettleMs at the latest, so the
+    // whole run is bounded by getBudgetMs(). The result is stored in NVS.
+    class FanCalibration {
+        public:
+            FanCalibration(Fan& fan, unsigned long settleMs = 1500, unsigned long maxSettleMs = 4000);
+
+            void start();
+            // Advances the sweep without blocking, returns true while running
+            bool step();
+            bool isRunning();
+
+            unsigned long getBudgetMs();
+
+        private:
+            void beginPoint();
+            void finish();
+
+            Fan& fan;
+            unsigned long settleMs;
+            unsigned long maxSettleMs;
+
+            // the sweep points, ordered from stopped to full speed like the Fan table
+            int duty[Fan::N];
+            int rpm[Fan::N];
+
+            int index; // -1 when idle
+            unsigned long pointStart;
+            unsigned long lastCheck;
+            int lastRpm;
+    };
+
+}
+
+#endif // FAN_CALIBRATION_H
@@ -0,0 +1,37 @@
+#include "IsrTach.h"
+#include "../HAL/Hal.h"
+
+namespace SmartAirControl {
+
+    IsrTach::IsrTach(int pin, uint32_t debounceUs)
+        : pin(pin), debounceUs(debounceUs), pulseCount(0), lastPulse(0) {
+    }
+
+    void IsrTach::begin() {
+        hal::pinInputPullup(pin);
+        hal::attachFallingEdge(pin, onEdge, this);
+    }
+
+    uint32_t IsrTach::takePulses() {
+        hal::disableInterrupts();
+            uint32_t count = pulseCount;
+            pulseCount = 0;
+        hal::enableInterrupts();
+        return count;
+    }
+
+    const PulseRing* IsrTach::getEdges() const {
+        return &edges;
+    }
+
+    void IRAM_ATTR IsrTach::onEdge(void* arg) {
+        IsrTach* tach = static_cast<IsrTach*>(arg);
+        uint32_t now = hal::micros();
+        if (now - tach->lastPulse > tach->debounceUs) {
+            tach->edges.push(now);
+            tach->pulseCount++;
+            tach->lastPulse = now;
+        }
+    }
+
+}
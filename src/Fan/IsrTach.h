@@ -0,0 +1,30 @@
+#ifndef ISR_TACH_H
+#define ISR_TACH_H
+
+#include <esp_attr.h>
+#include "Tach.h"
+
+namespace SmartAirControl {
+
+    // One GPIO interrupt per falling edge, debounced in software
+    class IsrTach : public Tach {
+        public:
+            IsrTach(int pin, uint32_t debounceUs = 300);
+
+            void begin() override;
+            uint32_t takePulses() override;
+            const PulseRing* getEdges() const override;
+
+        private:
+            static void IRAM_ATTR onEdge(void* arg);
+
+            int pin;
+            uint32_t debounceUs;
+            volatile uint32_t pulseCount;
+            volatile uint32_t lastPulse;
+            PulseRing edges;
+    };
+
+}
+
+#endif // ISR_TACH_H
@@ -0,0 +1,49 @@
+#include "PcntTach.h"
+
+namespace SmartAirControl {
+
+    PcntTach::PcntTach(int pin, pcnt_unit_t unit, uint32_t filterNs)
+        : pin(pin), unit(unit), filterNs(filterNs), lastCount(0) {
+    }
+
+    void PcntTach::begin() {
+        pcnt_config_t config = {};
+        config.pulse_gpio_num = pin;
+        config.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+        config.channel = PCNT_CHANNEL_0;
+        config.unit = unit;
+        config.pos_mode = PCNT_COUNT_DIS;
+        config.neg_mode = PCNT_COUNT_INC;
+        config.lctrl_mode = PCNT_MODE_KEEP;
+        config.hctrl_mode = PCNT_MODE_KEEP;
+        config.counter_h_lim = COUNTER_LIMIT;
+        config.counter_l_lim = 0;
+        pcnt_unit_config(&config);
+
+        // the filter counts APB clock cycles (80 MHz) in a 10 bit field
+        uint32_t cycles = filterNs * 80 / 1000;
+        pcnt_set_filter_value(unit, cycles > 1023 ? 1023 : cycles);
+        pcnt_filter_enable(unit);
+
+        gpio_pullup_en(static_cast<gpio_num_t>(pin));
+
+        pcnt_counter_pause(unit);
+        pcnt_counter_clear(unit);
+        pcnt_counter_resume(unit);
+        lastCount = 0;
+    }
+
+    uint32_t PcntTach::takePulses() {
+        int16_t count = 0;
+        pcnt_get_counter_value(unit, &count);
+
+        // the counter restarts at 0 when it reaches COUNTER_LIMIT
+        int32_t delta = count - lastCount;
+        if (delta < 0) {
+            delta += COUNTER_LIMIT;
+        }
+        lastCount = count;
+        return delta;
+    }
+
+}
@@ -0,0 +1,30 @@
+#ifndef PCNT_TACH_H
+#define PCNT_TACH_H
+
+#include <driver/pcnt.h>
+#include "Tach.h"
+
+namespace SmartAirControl {
+
+    // Counts edges in the ESP32 pulse counter. No CPU work per edge; the
+    // hardware glitch filter drops pulses shorter than filterNs (max ~12 us).
+    // The counter gives no edge times, so the speed comes from counting.
+    class PcntTach : public Tach {
+        public:
+            PcntTach(int pin, pcnt_unit_t unit = PCNT_UNIT_0, uint32_t filterNs = 10000);
+
+            void begin() override;
+            uint32_t takePulses() override;
+
+        private:
+            static const int16_t COUNTER_LIMIT = 32767;
+
+            int pin;
+            pcnt_unit_t unit;
+            uint32_t filterNs;
+            int16_t lastCount;
+    };
+
+}
+
+#endif // PCNT_TACH_H
@@ -0,0 +1,47 @@
+#include "PidController.h"
+
+namespace SmartAirControl {
+
+    PidController::PidController(float kp, float ki, float kd, float outMin, float outMax, float maxSlewPerSecond)
+        : kp(kp), ki(ki), kd(kd), outMin(outMin), outMax(outMax), maxSlew(maxSlewPerSecond),
+          integral(0), lastMeasured(0), output(outMin), hasLast(false) {
+    }
+
+    float PidController::update(float setpoint, float measured, float feedForward, float dt) {
+        if (dt <= 0) {
+            return output;
+        }
+
+        float error = setpoint - measured;
+        float derivative = hasLast ? -(measured - lastMeasured) / dt : 0;
+        lastMeasured = measured;
+        hasLast = true;
+
+        float nextIntegral = integral + ki * error * dt;
+        float wanted = feedForward + kp * error + nextIntegral + kd * derivative;
+
+        float limited = wanted;
+        if (limited > outMax) limited = outMax;
+        if (limited < outMin) limited = outMin;
+
+        float step = maxSlew * dt;
+        if (limited > output + step) limited = output + step;
+        if (limited < output - step) limited = output - step;
+
+        // only integrate while the output can still follow
+        bool heldBack = (limited < wanted && error > 0) || (limited > wanted && error < 0);
+        if (!heldBack) {
+            integral = nextIntegral;
+        }
+
+        output = limited;
+        return output;
+    }
+
+    void PidController::reset(float output) {
+        this->output = output;
+        integral = 0;
+        hasLast = false;
+    }
+
+}
@@ -0,0 +1,39 @@
+#ifndef PID_CONTROLLER_H
+#define PID_CONTROLLER_H
+
+namespace SmartAirControl {
+
+    // PID controller with feed-forward, output clamping, slew rate limiting and
+    // anti-windup: the integrator is frozen whenever the clamp or the slew
+    // limit holds the output back in the direction the error pushes it.
+    // A derivative term, if kd is not 0, acts on the measurement so that
+    // setpoint steps do not kick; the fan loop runs without one.
+    class PidController {
+        public:
+            PidController(float kp, float ki, float kd, float outMin, float outMax, float maxSlewPerSecond);
+
+            // dt in seconds, returns the new output
+            float update(float setpoint, float measured, float feedForward, float dt);
+
+            // Restarts from output without integral or derivative history
+            void reset(float output);
+
+            float getOutput() const { return output; }
+
+        private:
+            float kp;
+            float ki;
+            float kd;
+            float outMin;
+            float outMax;
+            float maxSlew;
+
+            float integral;
+            float lastMeasured;
+            float output;
+            bool hasLast;
+    };
+
+}
+
+#endif // PID_CONTROLLER_H
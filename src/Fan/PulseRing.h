@@ -0,0 +1,51 @@
+#ifndef PULSE_RING_H
+#define PULSE_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace SmartAirControl {
+
+    // Time stamps (us) of the most recent tach edges. Written from a single
+    // interrupt handler, read from tasks without locking: readers copy what
+    // they need and then check that the writer has not lapped them.
+    class PulseRing {
+        public:
+            static const uint32_t CAPACITY = 64; // power of two
+
+            PulseRing() : written(0) {}
+
+            // Writer side, interrupt context
+            void push(uint32_t timestampUs) {
+                uint32_t w = written.load(std::memory_order_relaxed);
+                stamps[w & (CAPACITY - 1)] = timestampUs;
+                written.store(w + 1, std::memory_order_release);
+            }
+
+            // Copies up to max time stamps, newest first. Returns how many are valid.
+            size_t snapshot(uint32_t* out, size_t max) const {
+                uint32_t before = written.load(std::memory_order_acquire);
+                size_t n = before < max ? before : max;
+                if (n > CAPACITY) n = CAPACITY;
+                for (size_t i = 0; i < n; i++) {
+                    out[i] = stamps[(before - 1 - i) & (CAPACITY - 1)];
+                }
+
+                // the oldest copies may have been overwritten meanwhile, drop those
+                uint32_t lapped = written.load(std::memory_order_acquire) - before;
+                if (lapped >= CAPACITY) return 0;
+                return n < CAPACITY - lapped ? n : CAPACITY - lapped;
+            }
+
+            // Total number of edges ever pushed, wraps at 2^32
+            uint32_t count() const { return written.load(std::memory_order_acquire); }
+
+        private:
+            volatile uint32_t stamps[CAPACITY];
+            std::atomic<uint32_t> written;
+    };
+
+}
+
+#endif // PULSE_RING_H
@@ -0,0 +1,63 @@
+#include "RpmEstimator.h"
+
+namespace SmartAirControl {
+
+    RpmEstimator::RpmEstimator(uint32_t windowUs, uint32_t timeoutUs, float smoothingSeconds, uint8_t pulsesPerRevolution)
+        : windowUs(windowUs), timeoutUs(timeoutUs), smoothingSeconds(smoothingSeconds), pulsesPerRevolution(pulsesPerRevolution),
+          rpm(0), smoothedRpm(0), lastUpdateUs(0), hasUpdate(false) {
+    }
+
+    float RpmEstimator::update(const PulseRing& edges, uint32_t pulsesPerEdge, uint32_t nowUs) {
+        uint32_t stamps[PulseRing::CAPACITY];
+        size_t n = edges.snapshot(stamps, PulseRing::CAPACITY);
+
+        float raw = 0;
+        uint32_t sinceLast = n > 0 ? nowUs - stamps[0] : timeoutUs;
+        if (static_cast<int32_t>(sinceLast) < 0) {
+            sinceLast = 0; // edge stamped a little after nowUs was taken
+        }
+        if (n >= 2 && sinceLast < timeoutUs) {
+            // use every edge inside the window, but at least the newest period
+            size_t oldest = 1;
+            while (oldest + 1 < n && nowUs - stamps[oldest + 1] <= windowUs) {
+                oldest++;
+            }
+            uint32_t span = stamps[0] - stamps[oldest];
+            if (span > 0) {
+                raw = 60000000.0f * oldest * pulsesPerEdge / (pulsesPerRevolution * static_cast<float>(span));
+            }
+
+            // a fan that is slowing down has not produced its next edge yet;
+            // the silence since the last edge bounds the speed from above
+            if (sinceLast > span / oldest) {
+                float bound = 60000000.0f * pulsesPerEdge / (pulsesPerRevolution * static_cast<float>(sinceLast));
+                if (bound < raw) raw = bound;
+            }
+        }
+
+        return smooth(raw, nowUs);
+    }
+
+    float RpmEstimator::update(uint32_t pulses, uint32_t elapsedUs, uint32_t nowUs) {
+        float raw = elapsedUs > 0 ? 60000000.0f * pulses / (pulsesPerRevolution * static_cast<float>(elapsedUs)) : rpm;
+        return smooth(raw, nowUs);
+    }
+
+    float RpmEstimator::smooth(float raw, uint32_t nowUs) {
+        rpm = raw;
+
+        if (!hasUpdate || smoothingSeconds <= 0) {
+            smoothedRpm = raw;
+        } else {
+            // alpha = dt / (tau + dt) keeps the time constant for any call interval
+            float dt = (nowUs - lastUpdateUs) / 1000000.0f;
+            float alpha = dt / (smoothingSeconds + dt);
+            smoothedRpm += alpha * (raw - smoothedRpm);
+        }
+
+        lastUpdateUs = nowUs;
+        hasUpdate = true;
+        return rpm;
+    }
+
+}
@@ -0,0 +1,43 @@
+#ifndef RPM_ESTIMATOR_H
+#define RPM_ESTIMATOR_H
+
+#include <cstdint>
+#include "PulseRing.h"
+
+namespace SmartAirControl {
+
+    // Time-normalised fan speed. With edge time stamps the speed comes from
+    // the edge periods inside the last windowUs; with a plain pulse count it
+    // comes from the count over the elapsed time. Either way the result does
+    // not depend on how often update() is called. A time-constant based EWMA
+    // smooths the raw value, also for irregular update intervals.
+    class RpmEstimator {
+        public:
+            RpmEstimator(uint32_t windowUs = 500000,
+                         uint32_t timeoutUs = 2000000,
+                         float smoothingSeconds = 2.0,
+                         uint8_t pulsesPerRevolution = 2);
+
+            float update(const PulseRing& edges, uint32_t pulsesPerEdge, uint32_t nowUs);
+            float update(uint32_t pulses, uint32_t elapsedUs, uint32_t nowUs);
+
+            float getRpm() const { return rpm; }
+            float getSmoothedRpm() const { return smoothedRpm; }
+
+        private:
+            float smooth(float raw, uint32_t nowUs);
+
+            uint32_t windowUs;
+            uint32_t timeoutUs;
+            float smoothingSeconds;
+            uint8_t pulsesPerRevolution;
+
+            float rpm;
+            float smoothedRpm;
+            uint32_t lastUpdateUs;
+            bool hasUpdate;
+    };
+
+}
+
+#endif // RPM_ESTIMATOR_H
@@ -0,0 +1,34 @@
+#ifndef TACH_H
+#define TACH_H
+
+#include <cstdint>
+#include "PulseRing.h"
+
+// Tach backend selected by the FAN_TACH_BACKEND build flag
+#define FAN_TACH_ISR 0     // GPIO interrupt per edge, software debounce (fallback)
+#define FAN_TACH_PCNT 1    // pulse counter peripheral with glitch filter, no interrupts
+#define FAN_TACH_CAPTURE 2 // MCPWM capture, edges time-stamped in hardware
+
+namespace SmartAirControl {
+
+    // Source of fan tachometer edges (falling edges, 2 per revolution)
+    class Tach {
+        public:
+            virtual ~Tach() {}
+
+            virtual void begin() = 0;
+
+            // Edges counted since the previous call
+            virtual uint32_t takePulses() = 0;
+
+            // micros() time stamps of the recent edges, nullptr if the backend
+            // only counts
+            virtual const PulseRing* getEdges() const { return nullptr; }
+
+            // Tach pulses between two entries of getEdges()
+            virtual uint32_t getPulsesPerEdge() const { return 1; }
+    };
+
+}
+
+#endif // TACH_H
@@ -0,0 +1,129 @@
+#ifndef FIXED_FILTERS_H
+#define FIXED_FILTERS_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace SmartAirControl {
+
+    // Streaming filters for sensor values in fixed point: integers in, Q8
+    // (1/256 of the unit) inside, no heap and no floating point, so they
+    // cost the same on the ESP32 as on the host. One push() per sample, at
+    // a steady rate.
+
+    static const int FIXED_SHIFT = 8;
+
+    inline int32_t toFixed(int32_t value) { return value * (1 << FIXED_SHIFT); }
+    inline int32_t fromFixed(int32_t fixed) { return (fixed + (1 << (FIXED_SHIFT - 1))) >> FIXED_SHIFT; }
+
+    // Median of the last N samples (fewer until N arrived), for spikes
+    // shorter than half the window. N odd.
+    template <size_t N>
+    class MedianFilter {
+        public:
+            MedianFilter() : next(0), count(0) {}
+
+            int32_t push(int32_t value) {
+                window[next] = value;
+                next = (next + 1) % N;
+                if (count < N) {
+                    count++;
+                }
+
+                // insertion sort of a copy, N is a handful
+                int32_t sorted[N];
+                for (size_t i = 0; i < count; i++) {
+                    int32_t v = window[i];
+                    size_t j = i;
+                    for (; j > 0 && sorted[j - 1] > v; j--) {
+                        sorted[j] = sorted[j - 1];
+                    }
+                    sorted[j] = v;
+                }
+                return sorted[count / 2];
+            }
+
+            void reset() { next = 0; count = 0; }
+
+        private:
+            static_assert(N % 2 == 1, "odd window");
+
+            int32_t window[N];
+            size_t next;
+            size_t count;
+    };
+
+    // Exponentially weighted moving average, alpha in 1/65536. Starts at the
+    // first sample instead of ramping up from 0.
+    class Ewma {
+        public:
+            explicit Ewma(uint32_t alphaQ16) : alpha(alphaQ16), state(0), started(false) {}
+
+            // value and result in Q8
+            int32_t push(int32_t value) {
+                if (!started) {
+                    state = value;
+                    started = true;
+                } else {
+                    state += static_cast<int32_t>((static_cast<int64_t>(value - state) * alpha) >> 16);
+                }
+                return state;
+            }
+
+            int32_t get() const { return state; }
+            void reset() { started = false; }
+
+        private:
+            uint32_t alpha;
+            int32_t state;
+            bool started;
+    };
+
+    // Least squares slope over the last N samples, per sample and in Q8.
+    // The sums are kept up to date as the window slides, a push is O(1).
+    template <size_t N>
+    class SlopeEstimator {
+        public:
+            SlopeEstimator() : next(0), count(0), sum(0), weightedSum(0) {}
+
+            // value in Q8
+            void push(int32_t value) {
+                if (count < N) {
+                    // sample i of the window weighs i
+                    weightedSum += static_cast<int64_t>(count) * value;
+                    sum += value;
+                    count++;
+                } else {
+                    // every sample moves down one place, the oldest drops out
+                    int32_t oldest = window[next];
+                    weightedSum += -(sum - oldest) + static_cast<int64_t>(N - 1) * value;
+                    sum += value - oldest;
+                }
+                window[next] = value;
+                next = (next + 1) % N;
+            }
+
+            // 0 until two samples arrived
+            int32_t get() const {
+                if (count < 2) {
+                    return 0;
+                }
+                int64_t n = count;
+                int64_t sumI = n * (n - 1) / 2;
+                int64_t sumII = (n - 1) * n * (2 * n - 1) / 6;
+                return static_cast<int32_t>((n * weightedSum - sumI * sum) / (n * sumII - sumI * sumI));
+            }
+
+            void reset() { next = 0; count = 0; sum = 0; weightedSum = 0; }
+
+        private:
+            int32_t window[N];
+            size_t next;
+            size_t count;
+            int64_t sum;
+            int64_t weightedSum;
+    };
+
+}
+
+#endif // FIXED_FILTERS_H
@@ -0,0 +1,70 @@
+#include "PmFilter.h"
+
+namespace SmartAirControl {
+
+    // dt / (tau + dt) at one frame per step
+    static const uint32_t ALPHA_Q16 = 65536 / (PmFilter::SMOOTHING_FRAMES + 1);
+
+    PmFilter::PmFilter()
+        : latest(),
+          smoothed{ Ewma(ALPHA_Q16), Ewma(ALPHA_Q16), Ewma(ALPHA_Q16),
+                    Ewma(ALPHA_Q16), Ewma(ALPHA_Q16), Ewma(ALPHA_Q16) },
+          frames(0) {
+    }
+
+    uint16_t& PmFilter::field(PM25_AQI_Data& frame, int channel) {
+        switch (channel) {
+            case PM10_ENV:
+                return frame.pm10_env;
+            case PM25_ENV:
+                return frame.pm25_env;
+            case PM100_ENV:
+                return frame.pm100_env;
+            case PARTICLES_10UM:
+                return frame.particles_10um;
+            case PARTICLES_25UM:
+                return frame.particles_25um;
+            default:
+                return frame.particles_100um;
+        }
+    }
+
+    void PmFilter::push(const PM25_AQI_Data& frame) {
+        latest = frame;
+        for (int channel = 0; channel < CHANNELS; channel++) {
+            int32_t despiked = median[channel].push(toFixed(field(latest, channel)));
+            smoothed[channel].push(despiked);
+            if (channel == PM25_ENV) {
+                pm25Slope.push(despiked);
+            }
+        }
+        frames++;
+    }
+
+    PM25_AQI_Data PmFilter::filtered() const {
+        PM25_AQI_Data frame = latest;
+        if (frames == 0) {
+            return frame;
+        }
+        for (int channel = 0; channel < CHANNELS; channel++) {
+            int32_t value = fromFixed(smoothed[channel].get());
+            field(frame, channel) = value < 0 ? 0 : (value > UINT16_MAX ? UINT16_MAX : value);
+        }
+        return frame;
+    }
+
+    float PmFilter::getPm25Slope() const {
+        return pm25Slope.get() * 60.0f / (1 << FIXED_SHIFT);
+    }
+
+    void PmFilter::reset() {
+        latest = PM25_AQI_Data();
+        for (int channel = 0; channel < CHANNELS; channel++) {
+            median[channel].reset();
+            smoothed[channel].reset();
+        }
+        pm25Slope.reset();
+        frames = 0;
+    }
+
+}
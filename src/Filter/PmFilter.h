@@ -0,0 +1,60 @@
+#ifndef PM_FILTER_H
+#define PM_FILTER_H
+
+#include <cstdint>
+#include <Adafruit_PM25AQI.h>
+#include "FixedFilters.h"
+
+namespace SmartAirControl {
+
+    // Every PMS5003 frame (about one a second) goes through a median of
+    // MEDIAN_WINDOW frames against spikes and an EWMA with a time constant
+    // of about SMOOTHING_FRAMES frames against the counting noise, per mass
+    // concentration and per particle count the scoring uses. The PM2.5
+    // trend is the least squares slope of the median over SLOPE_WINDOW
+    // frames: two minutes, shorter windows mostly measure the noise.
+    //
+    // filtered() is the latest frame with those values replaced, what the
+    // control task and the uplinks get in place of a single frame.
+    class PmFilter {
+        public:
+            static const size_t MEDIAN_WINDOW = 5;
+            static const uint32_t SMOOTHING_FRAMES = 10;
+            static const size_t SLOPE_WINDOW = 120;
+
+            PmFilter();
+
+            // One frame, each of them in order
+            void push(const PM25_AQI_Data& frame);
+
+            PM25_AQI_Data filtered() const;
+            // ug/m3 per minute, at one frame a second
+            float getPm25Slope() const;
+            uint32_t getFrames() const { return frames; }
+
+            // Starts over, e.g. after the sensor was off
+            void reset();
+
+        private:
+            enum Channel {
+                PM10_ENV,
+                PM25_ENV,
+                PM100_ENV,
+                PARTICLES_10UM,
+                PARTICLES_25UM,
+                PARTICLES_100UM,
+                CHANNELS
+            };
+
+            static uint16_t& field(PM25_AQI_Data& frame, int channel);
+
+            PM25_AQI_Data latest;
+            MedianFilter<MEDIAN_WINDOW> median[CHANNELS];
+            Ewma smoothed[CHANNELS];
+            SlopeEstimator<SLOPE_WINDOW> pm25Slope;
+            uint32_t frames;
+    };
+
+}
+
+#endif // PM_FILTER_H
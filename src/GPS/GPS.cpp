@@ -1,59 +1,48 @@
 #include "GPS.h"
+#include "Ubx.h"
+#include "../Log/Log.h"
 
 namespace SmartAirControl {
 
     RTC_DATA_ATTR bool isFirstFix = true;
 
     GPS::GPS(uint8_t portNumber, unsigned long baud, enum SerialConfig config, int8_t rx, int8_t tx)
-        : gpsSerial(portNumber) {
+        : gpsSerial(hal::serialPort(portNumber)) {
         gpsSerial.begin(baud, config, rx, tx);
     }
 
     void GPS::setup() {
-        while (!gpsSerial)
-            ; // wait for serial to be initalised
-
         while (gpsSerial.available()) {
             gpsSerial.read();
         }
+        fixLogged = false;
+        timeoutLogged = false;
+        setupTime = hal::millis();
+    }
 
-        unsigned long start = millis();
-        while (millis() - start < 2000 && !isValid()) {
-            while (gpsSerial.available() > 0 && !isValid()) {
-                gps.encode(gpsSerial.read());
-            }
+    bool GPS::poll() {
+        while (gpsSerial.available() > 0) {
+            gps.encode(gpsSerial.read());
         }
-
-        if (isValid()) {
-            Serial.println(F("[GPS] ############### GPS ###############"));
-            Serial.print(F("[GPS] LAT = "));
-            Serial.println(gps.location.lat(), 6);
-            Serial.print(F("[GPS] LONG = "));
-            Serial.println(gps.location.lng(), 6);
-            Serial.print(F("[GPS] Date in UTC = "));
-            Serial.println(String(gps.date.year()) + "/" + String(gps.date.month()) + "/" + String(gps.date.day()));
-            Serial.print(F("[GPS] Time in UTC = "));
-            Serial.println(String(gps.time.hour()) + ":" + String(gps.time.minute()) + ":" + String(gps.time.second()));
-            Serial.print(F("[GPS] Satellites = "));
-            Serial.println(gps.satellites.value());
-            Serial.print(F("[GPS] ALT (min) = "));
-            Serial.println(gps.altitude.meters());
-            Serial.print(F("[GPS] SPEED (km/h) = "));
-            Serial.println(gps.speed.kmph());
-            Serial.print(F("[GPS] COURSE = "));
-            Serial.println(gps.course.deg());
-            Serial.print(F("[GPS] HDOP = "));
-            Serial.println(gps.hdop.value() / 100.0);
-            Serial.println(F("[GPS] -----------------------------------"));
+        if (isValid() && !fixLogged) {
+            fixLogged = true;
+            LOG_INFO(GPS, "LAT = %.5f  LONG = %.5f  ALT = %.1f m  HDOP = %.2f  Satellites = %lu",
+                     gps.location.lat(), gps.location.lng(), gps.altitude.meters(), gps.hdop.value() / 100.0,
+                     gps.satellites.value());
+            LOG_INFO(GPS, "UTC %u/%u/%u %u:%02u:%02u  SPEED = %.1f km/h  COURSE = %.1f",
+                     gps.date.year(), gps.date.month(), gps.date.day(), gps.time.hour(), gps.time.minute(),
+                     gps.time.second(), gps.speed.kmph(), gps.course.deg());
 
             if (isFirstFix) {
                 isFirstFix = false;
 
                 gpsPowerSaving();
             }
-        } else {
-            Serial.println(F("GPS positioning data not valid"));
+        } else if (!isValid() && !fixLogged && !timeoutLogged && hal::millis() - setupTime >= FIX_TIMEOUT_MS) {
+            timeoutLogged = true;
+            LOG_WARN(GPS, "Positioning data not valid");
         }
+        return isValid();
     }
 
     void GPS::goToSleep() {
@@ -79,44 +68,11 @@ namespace SmartAirControl {
     //----------------------------------GPS unit functions------------------------------------------------
     // Send a byte array of UBX protocol to the GPS
     void GPS::sendUBX(const uint8_t* MSG, uint32_t len, long timeout) {
-        uint32_t CK_A = 0, CK_B = 0;
-        uint8_t sum1 = 0x00, sum2 = 0x00;
-        uint8_t fullPacket[len + 4];
-
-        for (int i = 0; i < len; i++) {
-            fullPacket[i + 2] = MSG[i];
-        }
-
-        Serial.println();
-        fullPacket[0] = 0xB5;
-        fullPacket[1] = 0x62;
-
-        // Calculate checksum
-        for (int i = 0; i < len; i++) {
-            CK_A = CK_A + MSG[i];
-            CK_B = CK_B + CK_A;
-        }
-
-        sum1 = CK_A & 0xff; // Mask the checksums to be one byte
-        sum2 = CK_B & 0xff;
-
-        fullPacket[len + 2] = sum1; // Add the checksums to the end of the UBX packet
-        fullPacket[len + 3] = sum2;
+        uint8_t fullPacket[len + Ubx::OVERHEAD];
+        size_t size = Ubx::frame(MSG, len, fullPacket, sizeof(fullPacket));
 
-        Serial.print(F("Checksum 1 = "));
-        Serial.println(sum1, HEX);
-
-        Serial.print(F("Checksum 2 = "));
-        Serial.println(sum2, HEX);
-
-        Serial.print(F("fullPacket is: "));
-
-        for (int i = 0; i < (len + 4); i++) {
-            Serial.print(fullPacket[i], HEX); // Print out a byt of the UBX data packet to the serial monitor
-            Serial.print(", ");
-            gpsSerial.write(fullPacket[i]); // Send a byte of the UBX data packet to the GPS unit
-        }
-        Serial.println();
+        LOG_HEX(LOG_LEVEL_DEBUG, GPS, "UBX sent:", fullPacket, size);
+        gpsSerial.write(fullPacket, size);
     } // end function
 
     // Calculate expected UBX ACK packet and parse UBX response from GPS--------------------------
@@ -124,11 +80,9 @@ namespace SmartAirControl {
         uint8_t b;
         uint8_t ackByteID = 0;
         uint8_t ackPacket[10];
-        unsigned long startTime = millis();
-        uint32_t CK_A = 0, CK_B = 0;
+        unsigned long startTime = hal::millis();
         boolean notAcknowledged = false;
 
-        Serial.print(F("Reading ACK response: "));
         // Construct the expected ACK packet
         ackPacket[0] = 0xB5; // header
         ackPacket[1] = 0x62; // header
@@ -141,42 +95,25 @@ namespace SmartAirControl {
         ackPacket[8] = 0;      // CK_A
         ackPacket[9] = 0;      // CK_B
 
-        // Calculate the checksums
-        for (uint8_t i = 2; i < 8; i++) {
-            CK_A = CK_A + ackPacket[i];
-            CK_B = CK_B + CK_A;
-        }
-
-        ackPacket[8] = CK_A & 0xff; // Mask the checksums to be one byte
-        ackPacket[9] = CK_B & 0xff;
+        Ubx::addChecksum(ackPacket, sizeof(ackPacket));
 
-        Serial.println(F("Searching for UBX ACK response:"));
-        Serial.print(F("  Target data packet: "));
-
-        for (int i = 0; i < 10; i++) {
-            Serial.print(ackPacket[i], HEX);
-            Serial.print(", ");
-        }
-
-        Serial.println();
-        Serial.print(F("  Candidate   packet: "));
+        LOG_HEX(LOG_LEVEL_DEBUG, GPS, "Searching for UBX ACK:", ackPacket, sizeof(ackPacket));
 
         while (1) {
             // Test for success
             if (ackByteID > 9) {
                 // All packets in order!
-                Serial.println(F(" (Response received from GPS unit:)"));
                 if (notAcknowledged) {
-                    Serial.println(F("ACK-NAK!"));
+                    LOG_WARN(GPS, "UBX ACK-NAK for %02X %02X", MSG[0], MSG[1]);
                 } else {
-                    Serial.println(F("ACK-ACK!"));
+                    LOG_DEBUG(GPS, "UBX ACK-ACK for %02X %02X", MSG[0], MSG[1]);
                     return true;
                 }
             }
 
             // Timeout if no valid response in 5 seconds
-            if (millis() - startTime > 5000) {
-                Serial.println(F("<<<Response timed out!>>>"));
+            if (hal::millis() - startTime > 5000) {
+                LOG_WARN(GPS, "UBX ACK for %02X %02X timed out", MSG[0], MSG[1]);
                 return false;
             }
 
@@ -187,8 +124,6 @@ namespace SmartAirControl {
                 // Check that bytes arrive in sequence as per expected ACK packet
                 if (b == ackPacket[ackByteID]) {
                     ackByteID++;
-                    Serial.print(b, HEX);
-                    Serial.print(F(", "));
                     // Check if message was not acknowledged
                     if (ackByteID == 3) {
                         b = gpsSerial.read();
@@ -199,24 +134,12 @@ namespace SmartAirControl {
                     }
                 } else if (ackByteID > 0) {
                     ackByteID = 0; // Reset and look again, invalid order
-                    Serial.print(b, HEX);
-                    Serial.println(F(" -->NOPE!"));
-                    Serial.print(F("Candidate   packet: "));
+                    LOG_DEBUG(GPS, "UBX ACK mismatch at %02X", b);
                 }
             }
         } // end while
     } // end function
 
-    void GPS::addChecksum(uint8_t* msg, size_t len) {
-        uint8_t ckA = 0, ckB = 0;
-        for (size_t i = 2; i < len - 2; i++) { // Skip the 2-byte header
-            ckA += msg[i];
-            ckB += ckA;
-        }
-        msg[len - 2] = ckA;
-        msg[len - 1] = ckB;
-    }
-
     void GPS::gpsSetPPSDutyCycle() {
         byte ackRequest[] = {
             0xB5, 0x62, 0x06, 0x07, // CFG TP
@@ -234,11 +157,11 @@ namespace SmartAirControl {
 
         };
 
-        addChecksum(ackRequest, sizeof(ackRequest));
+        Ubx::addChecksum(ackRequest, sizeof(ackRequest));
 
         gpsSerial.write(ackRequest, sizeof(ackRequest));
 
-        delay(300);
+        hal::delay(300);
     }
 
     bool GPS::gpsCheckIfGPSActive() {
@@ -251,7 +174,7 @@ namespace SmartAirControl {
 
         gpsSerial.write(ackRequest, sizeof(ackRequest));
 
-        delay(100); // Small delay for response
+        hal::delay(100); // Small delay for response
 
         return gpsSerial.available() > 0;
     }
@@ -272,9 +195,9 @@ namespace SmartAirControl {
 
         gpsSerial.write(deepSleepCmd, sizeof(deepSleepCmd));
 
-        delay(100); // Small delay for response
+        hal::delay(100); // Small delay for response
 
-        Serial.println(F("[GPS] Power save mode: ON"));
+        LOG_INFO(GPS, "Power save mode: ON");
 
         return !gpsCheckIfGPSActive();
     }
@@ -283,14 +206,14 @@ namespace SmartAirControl {
         byte wakeCmd[] = {0xB5, 0x62, 0x06, 0x11, 0x02, 0x00, 0x08, 0x00, 0x21, 0x91};
         gpsSerial.write(wakeCmd, sizeof(wakeCmd));
 
-        delay(100); // Small delay for response
+        hal::delay(100); // Small delay for response
 
         bool gpsIsActive = gpsCheckIfGPSActive();
         if (gpsIsActive) {
-            delay(5000); // Wait for GPS to collect data
+            hal::delay(5000); // Wait for GPS to collect data
         }
 
-        Serial.println(F("[GPS] Max performance mode: ON"));
+        LOG_INFO(GPS, "Max performance mode: ON");
 
         return gpsIsActive;
     }
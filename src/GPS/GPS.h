@@ -2,6 +2,7 @@
 #define GPS_H
 
 #include <TinyGPS++.h>
+#include "../HAL/Hal.h"
 
 namespace SmartAirControl {
 
@@ -10,8 +11,14 @@ namespace SmartAirControl {
         GPS(uint8_t portNumber, unsigned long baud, enum SerialConfig config, int8_t rx, int8_t tx);
 
         void setup();
+        // Feeds the received NMEA sentences to the parser without blocking,
+        // returns true while the fix is valid. The first fix, or its absence
+        // FIX_TIMEOUT_MS after setup(), is logged.
+        bool poll();
         void goToSleep();
 
+        static const unsigned long FIX_TIMEOUT_MS = 2000;
+
         bool isValid();
         bool isUpdated();
 
@@ -24,15 +31,17 @@ namespace SmartAirControl {
         void sendUBX(const uint8_t* MSG, uint32_t len, long timeout = 3000);
         boolean getUBX_ACK(const uint8_t* MSG, uint32_t len);
 
-        void addChecksum(uint8_t* msg, size_t len);
         void gpsSetPPSDutyCycle();
         bool gpsCheckIfGPSActive();
         bool gpsPowerSaving();
         bool gpsMaxPerformance();
 
     private:
-        HardwareSerial gpsSerial;
+        hal::SerialPort& gpsSerial;
         TinyGPSPlus gps;
+        unsigned long setupTime = 0;
+        bool fixLogged = false;
+        bool timeoutLogged = false;
     };
 
 } // namespace GAIT
@@ -0,0 +1,37 @@
+#include "Ubx.h"
+
+namespace SmartAirControl {
+
+    void Ubx::checksum(const uint8_t* data, size_t size, uint8_t& ckA, uint8_t& ckB) {
+        uint8_t a = 0;
+        uint8_t b = 0;
+        for (size_t i = 0; i < size; i++) {
+            a += data[i];
+            b += a;
+        }
+        ckA = a;
+        ckB = b;
+    }
+
+    size_t Ubx::frame(const uint8_t* msg, size_t size, uint8_t* buffer, size_t bufferSize) {
+        if (bufferSize < size + OVERHEAD) {
+            return 0;
+        }
+
+        buffer[0] = SYNC_1;
+        buffer[1] = SYNC_2;
+        for (size_t i = 0; i < size; i++) {
+            buffer[i + 2] = msg[i];
+        }
+        checksum(msg, size, buffer[size + 2], buffer[size + 3]);
+        return size + OVERHEAD;
+    }
+
+    void Ubx::addChecksum(uint8_t* frame, size_t size) {
+        if (size < OVERHEAD) {
+            return;
+        }
+        checksum(&frame[2], size - OVERHEAD, frame[size - 2], frame[size - 1]);
+    }
+
+}
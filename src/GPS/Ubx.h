@@ -0,0 +1,31 @@
+#ifndef UBX_H
+#define UBX_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace SmartAirControl {
+
+    // u-blox UBX framing, independent of the receiver driver
+    //
+    //  0xB5 0x62 | class | id | length (LE) | payload | CK_A CK_B
+    //  the 8 bit Fletcher checksum covers class to the end of the payload
+    class Ubx {
+        public:
+            static const uint8_t SYNC_1 = 0xB5;
+            static const uint8_t SYNC_2 = 0x62;
+            static const size_t OVERHEAD = 4; // sync and checksum around the message
+
+            static void checksum(const uint8_t* data, size_t size, uint8_t& ckA, uint8_t& ckB);
+
+            // Wraps msg (class, id, length, payload) into buffer. Returns the
+            // frame size, 0 if buffer is too small.
+            static size_t frame(const uint8_t* msg, size_t size, uint8_t* buffer, size_t bufferSize);
+
+            // Fills in the checksum of a complete frame whose last two bytes are reserved for it
+            static void addChecksum(uint8_t* frame, size_t size);
+    };
+
+}
+
+#endif // UBX_H
@@ -0,0 +1,119 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace SmartAirControl {
+
+    // Thin hardware abstraction the drivers are written against. HalEsp32.cpp
+    // maps it onto the Arduino core; on the native build (HAL/native) it runs
+    // on a virtual clock with simulated sensors and fan.
+    namespace hal {
+
+        // Clock
+        uint32_t millis();
+        // in IRAM, interrupt handlers may call it
+        uint32_t micros();
+        void delay(uint32_t ms);
+        // ms that keep counting through deep sleep, unlike millis(), which
+        // starts over with every boot; for schedules that span boots
+        uint32_t rtcMillis();
+
+        // GPIO / PWM
+        void pinInputPullup(int pin);
+        void pinOutput(int pin);
+        // 8 bit duty cycle
+        void pwmWrite(int pin, uint8_t duty);
+
+        // Drives pin to level and keeps it there through deep sleep, when the
+        // other pins float; pinOutput() releases it
+        void pinHold(int pin, bool level);
+
+        // Interrupts
+        typedef void (*EdgeHandler)(void* arg);
+        void attachFallingEdge(int pin, EdgeHandler handler, void* arg);
+        void disableInterrupts();
+        void enableInterrupts();
+
+        // Sleep. In light sleep the CPU and the UARTs stop while RAM, the
+        // clock and the fan PWM keep running; tach edges and received bytes
+        // are lost. Deep sleep powers everything down but RTC memory
+        // (RTC_DATA_ATTR) and held pins, and the firmware boots again.
+        enum WakeupCause {
+            WAKEUP_POWER_ON, /** or any reset */
+            WAKEUP_TIMER,
+            WAKEUP_PIN
+        };
+
+        // Pin that ends a sleep when pulled low (a button), -1 for none
+        void setWakeupPin(int pin);
+        // Sleeps for up to ms, returns the time slept
+        uint32_t lightSleep(uint32_t ms);
+        [[noreturn]] void deepSleep(uint32_t ms);
+        // Why the firmware is running
+        WakeupCause wakeupCause();
+
+        // Byte stream of a UART
+        class SerialPort {
+            public:
+                virtual ~SerialPort() {}
+
+                // config is the core's SERIAL_* frame format
+                virtual void begin(unsigned long baud, uint32_t config, int8_t rxPin, int8_t txPin) = 0;
+                virtual int available() = 0;
+                // Next byte, -1 if none is buffered
+                virtual int read() = 0;
+                virtual size_t write(const uint8_t* buffer, size_t size) = 0;
+        };
+
+        // UART by hardware port number
+        SerialPort& serialPort(uint8_t number);
+
+        // Key/value blobs in non-volatile storage, grouped by namespace
+        class Nvs {
+            public:
+                Nvs(const char* name, bool readOnly = false);
+                ~Nvs();
+
+                // Bytes read, 0 if the key is missing or its size differs
+                size_t getBytes(const char* key, void* buffer, size_t size);
+                size_t putBytes(const char* key, const void* buffer, size_t size);
+                bool isKey(const char* key);
+
+            private:
+                Nvs(const Nvs&);
+                Nvs& operator=(const Nvs&);
+
+                void* handle;
+        };
+
+        // Raw data partition by label (partitions.csv), for journals that
+        // level their own wear (Storage/Journal.h). Erased bytes read 0xFF
+        // and programming only clears bits, so a range is written once per
+        // erase of its sector.
+        class Flash {
+            public:
+                static const size_t SECTOR_SIZE = 4096;
+
+                explicit Flash(const char* label);
+
+                // Bytes, 0 if there is no such partition
+                size_t size();
+                bool read(size_t offset, void* buffer, size_t size);
+                bool write(size_t offset, const void* data, size_t size);
+                bool eraseSector(size_t sector);
+
+            private:
+                Flash(const Flash&);
+                Flash& operator=(const Flash&);
+
+                const char* label;
+                const void* handle; /** found on first use */
+        };
+
+    }
+
+}
+
+#endif // HAL_H
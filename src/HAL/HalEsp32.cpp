@@ -0,0 +1,258 @@
+#if defined(ESP32)
+
+#include "Hal.h"
+#include <Arduino.h>
+#include <HardwareSerial.h>
+#include <Preferences.h>
+#include <driver/gpio.h>
+#include <driver/ledc.h>
+#include <esp_attr.h>
+#include <esp_partition.h>
+#include <esp_sleep.h>
+#include <esp_timer.h>
+#include <sys/time.h>
+
+namespace SmartAirControl {
+namespace hal {
+
+    uint32_t millis() {
+        return ::millis();
+    }
+
+    // the tach interrupt handlers time-stamp edges with it: in IRAM, and
+    // straight from the timer, which is safe while the flash cache is off
+    uint32_t IRAM_ATTR micros() {
+        return static_cast<uint32_t>(esp_timer_get_time());
+    }
+
+    void delay(uint32_t ms) {
+        ::delay(ms);
+    }
+
+    uint32_t rtcMillis() {
+        // the system time runs on the RTC timer, which deep sleep keeps
+        struct timeval now;
+        gettimeofday(&now, nullptr);
+        return static_cast<uint32_t>(now.tv_sec * 1000ULL + now.tv_usec / 1000);
+    }
+
+    void pinInputPullup(int pin) {
+        pinMode(pin, INPUT_PULLUP);
+    }
+
+    void pinOutput(int pin) {
+        gpio_hold_dis(static_cast<gpio_num_t>(pin));
+        pinMode(pin, OUTPUT);
+    }
+
+    void pinHold(int pin, bool level) {
+        gpio_num_t gpio = static_cast<gpio_num_t>(pin);
+        // a running PWM channel owns the pin, give it back to the GPIO matrix
+        pinMode(pin, OUTPUT);
+        digitalWrite(pin, level ? HIGH : LOW);
+        gpio_hold_en(gpio);
+        gpio_deep_sleep_hold_en();
+    }
+
+    // analogWrite() clocks LEDC from the APB clock, which stops in light
+    // sleep and freezes the output at whatever level it had. The channels
+    // here run from the 8 MHz RTC oscillator, which keeps running.
+    static const uint32_t PWM_FREQUENCY = 1000;
+    static const int PWM_CHANNELS = 8;
+    static int pwmPins[PWM_CHANNELS] = { -1, -1, -1, -1, -1, -1, -1, -1 };
+
+    static int pwmChannel(int pin) {
+        for (int channel = 0; channel < PWM_CHANNELS; channel++) {
+            if (pwmPins[channel] == pin) {
+                return channel;
+            }
+        }
+        for (int channel = 0; channel < PWM_CHANNELS; channel++) {
+            if (pwmPins[channel] >= 0) {
+                continue;
+            }
+            if (channel == 0) {
+                ledc_timer_config_t timer = {};
+                timer.speed_mode = LEDC_LOW_SPEED_MODE;
+                timer.duty_resolution = LEDC_TIMER_8_BIT;
+                timer.timer_num = LEDC_TIMER_0;
+                timer.freq_hz = PWM_FREQUENCY;
+                timer.clk_cfg = LEDC_USE_RTC8M_CLK;
+                ledc_timer_config(&timer);
+            }
+            ledc_channel_config_t config = {};
+            config.gpio_num = pin;
+            config.speed_mode = LEDC_LOW_SPEED_MODE;
+            config.channel = static_cast<ledc_channel_t>(channel);
+            config.timer_sel = LEDC_TIMER_0;
+            config.duty = 0;
+            ledc_channel_config(&config);
+            pwmPins[channel] = pin;
+            return channel;
+        }
+        return -1;
+    }
+
+    void pwmWrite(int pin, uint8_t duty) {
+        int channel = pwmChannel(pin);
+        if (channel < 0) {
+            analogWrite(pin, duty);
+            return;
+        }
+        // full scale is 2^8, so 255 alone would leave a short low pulse
+        uint32_t value = duty == 255 ? 256 : duty;
+        ledc_set_duty(LEDC_LOW_SPEED_MODE, static_cast<ledc_channel_t>(channel), value);
+        ledc_update_duty(LEDC_LOW_SPEED_MODE, static_cast<ledc_channel_t>(channel));
+    }
+
+    void attachFallingEdge(int pin, EdgeHandler handler, void* arg) {
+        attachInterruptArg(digitalPinToInterrupt(pin), handler, arg, FALLING);
+    }
+
+    void disableInterrupts() {
+        noInterrupts();
+    }
+
+    void enableInterrupts() {
+        interrupts();
+    }
+
+    static int wakeupPin = -1;
+
+    void setWakeupPin(int pin) {
+        wakeupPin = pin;
+        if (pin >= 0) {
+            pinMode(pin, INPUT_PULLUP);
+        }
+    }
+
+    uint32_t lightSleep(uint32_t ms) {
+        // the UART stops mid-byte otherwise
+        Serial.flush();
+
+        esp_sleep_enable_timer_wakeup(ms * 1000ULL);
+        if (wakeupPin >= 0) {
+            gpio_wakeup_enable(static_cast<gpio_num_t>(wakeupPin), GPIO_INTR_LOW_LEVEL);
+            esp_sleep_enable_gpio_wakeup();
+        }
+        // the PWM clock
+        esp_sleep_pd_config(ESP_PD_DOMAIN_RTC8M, ESP_PD_OPTION_ON);
+
+        uint32_t start = ::millis();
+        esp_light_sleep_start();
+        return ::millis() - start;
+    }
+
+    void deepSleep(uint32_t ms) {
+        Serial.flush();
+
+        esp_sleep_enable_timer_wakeup(ms * 1000ULL);
+        if (wakeupPin >= 0) {
+            esp_sleep_enable_ext0_wakeup(static_cast<gpio_num_t>(wakeupPin), 0);
+        }
+        esp_deep_sleep_start();
+    }
+
+    WakeupCause wakeupCause() {
+        switch (esp_sleep_get_wakeup_cause()) {
+            case ESP_SLEEP_WAKEUP_TIMER:
+                return WAKEUP_TIMER;
+            case ESP_SLEEP_WAKEUP_EXT0:
+            case ESP_SLEEP_WAKEUP_GPIO:
+                return WAKEUP_PIN;
+            default:
+                return WAKEUP_POWER_ON;
+        }
+    }
+
+    class HardwareSerialPort : public SerialPort {
+        public:
+            explicit HardwareSerialPort(uint8_t number) : uart(number) {}
+
+            void begin(unsigned long baud, uint32_t config, int8_t rxPin, int8_t txPin) override {
+                uart.begin(baud, config, rxPin, txPin);
+            }
+
+            int available() override {
+                return uart.available();
+            }
+
+            int read() override {
+                return uart.read();
+            }
+
+            size_t write(const uint8_t* buffer, size_t size) override {
+                return uart.write(buffer, size);
+            }
+
+        private:
+            HardwareSerial uart;
+    };
+
+    SerialPort& serialPort(uint8_t number) {
+        // UART0 is the console, the sensors share the other two
+        static HardwareSerialPort uart1(1);
+        static HardwareSerialPort uart2(2);
+        return number == 1 ? uart1 : uart2;
+    }
+
+    Nvs::Nvs(const char* name, bool readOnly) : handle(new Preferences()) {
+        static_cast<Preferences*>(handle)->begin(name, readOnly);
+    }
+
+    Nvs::~Nvs() {
+        Preferences* store = static_cast<Preferences*>(handle);
+        store->end();
+        delete store;
+    }
+
+    size_t Nvs::getBytes(const char* key, void* buffer, size_t size) {
+        Preferences* store = static_cast<Preferences*>(handle);
+        if (store->getBytesLength(key) != size) {
+            return 0;
+        }
+        return store->getBytes(key, buffer, size);
+    }
+
+    size_t Nvs::putBytes(const char* key, const void* buffer, size_t size) {
+        return static_cast<Preferences*>(handle)->putBytes(key, buffer, size);
+    }
+
+    bool Nvs::isKey(const char* key) {
+        return static_cast<Preferences*>(handle)->isKey(key);
+    }
+
+    Flash::Flash(const char* label) : label(label), handle(nullptr) {
+    }
+
+    static const esp_partition_t* partition(const char* label, const void*& handle) {
+        if (handle == nullptr) {
+            handle = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+        }
+        return static_cast<const esp_partition_t*>(handle);
+    }
+
+    size_t Flash::size() {
+        const esp_partition_t* data = partition(label, handle);
+        return data != nullptr ? data->size : 0;
+    }
+
+    bool Flash::read(size_t offset, void* buffer, size_t size) {
+        const esp_partition_t* data = partition(label, handle);
+        return data != nullptr && esp_partition_read(data, offset, buffer, size) == ESP_OK;
+    }
+
+    bool Flash::write(size_t offset, const void* data, size_t size) {
+        const esp_partition_t* target = partition(label, handle);
+        return target != nullptr && esp_partition_write(target, offset, data, size) == ESP_OK;
+    }
+
+    bool Flash::eraseSector(size_t sector) {
+        const esp_partition_t* data = partition(label, handle);
+        return data != nullptr && esp_partition_erase_range(data, sector * SECTOR_SIZE, SECTOR_SIZE) == ESP_OK;
+    }
+
+}
+}
+
+#endif
@@ -0,0 +1,106 @@
+#if !defined(ESP32)
+
+#include <Adafruit_BME680.h>
+#include "../Hal.h"
+#include "Simulation.h"
+
+// TPH measurement time on top of the heater time, roughly what the
+// datasheet gives for the oversampling used in main.cpp
+static const unsigned long MEASUREMENT_MS = 40;
+
+// A cold gas plate reads high and settles over the first heating cycles
+// (the burn-in over days is not modelled); it is cold again after a pause.
+static const unsigned long PLATE_COOL_MS = 10000;
+static const float COLD_PLATE_ERROR = 0.6f;
+
+Adafruit_BME680::Adafruit_BME680()
+    : temperature(0), pressure(0), humidity(0), gas_resistance(0), heaterTime(0), readyAt(0),
+      heatedUntil(0), heatedCycles(0) {
+}
+
+bool Adafruit_BME680::begin(uint8_t addr, bool initSettings) {
+    (void)addr;
+    (void)initSettings;
+    return true;
+}
+
+bool Adafruit_BME680::setTemperatureOversampling(uint8_t os) {
+    return os <= BME680_OS_16X;
+}
+
+bool Adafruit_BME680::setHumidityOversampling(uint8_t os) {
+    return os <= BME680_OS_16X;
+}
+
+bool Adafruit_BME680::setPressureOversampling(uint8_t os) {
+    return os <= BME680_OS_16X;
+}
+
+bool Adafruit_BME680::setIIRFilterSize(uint8_t fs) {
+    return fs <= BME680_FILTER_SIZE_127;
+}
+
+bool Adafruit_BME680::setGasHeater(uint16_t heaterTemp, uint16_t heaterTime) {
+    // either 0 turns the gas measurement off, as in the driver
+    this->heaterTime = heaterTemp == 0 ? 0 : heaterTime;
+    return true;
+}
+
+unsigned long Adafruit_BME680::beginReading() {
+    if (readyAt != 0) {
+        return readyAt;
+    }
+    readyAt = SmartAirControl::hal::millis() + heaterTime + MEASUREMENT_MS;
+    if (heaterTime > 0) {
+        SmartAirControl::sim::Simulation::get().heat(heaterTime);
+    }
+    return readyAt;
+}
+
+bool Adafruit_BME680::endReading() {
+    if (beginReading() == 0) {
+        return false;
+    }
+
+    long remaining = static_cast<long>(readyAt - SmartAirControl::hal::millis());
+    if (remaining > 0) {
+        SmartAirControl::hal::delay(remaining);
+    }
+    readyAt = 0;
+
+    const SmartAirControl::sim::Air& air = SmartAirControl::sim::Simulation::get().air();
+    temperature = air.temperature;
+    pressure = static_cast<uint32_t>(air.pressure * 100.0f);
+    humidity = air.humidity;
+    if (heaterTime == 0) {
+        gas_resistance = 0;
+        return true;
+    }
+
+    unsigned long now = SmartAirControl::hal::millis();
+    if (heatedCycles > 0 && now - heatedUntil > PLATE_COOL_MS) {
+        heatedCycles = 0;
+    }
+    float plateError = COLD_PLATE_ERROR / static_cast<float>(1u << (heatedCycles < 16 ? heatedCycles : 16));
+    heatedCycles++;
+    heatedUntil = now;
+
+    gas_resistance = static_cast<uint32_t>(air.gasResistance * (1.0f + plateError) * 1000.0f);
+    return true;
+}
+
+bool Adafruit_BME680::performReading() {
+    return endReading();
+}
+
+float Adafruit_BME680::readPressure() {
+    // a whole conversion, as the driver does
+    performReading();
+    return pressure;
+}
+
+float Adafruit_BME680::readAltitude(float seaLevel) {
+    return 44330.0 * (1.0 - std::pow((readPressure() / 100.0f) / seaLevel, 0.1903));
+}
+
+#endif
@@ -0,0 +1,180 @@
+#if !defined(ESP32)
+
+#include <driver/mcpwm.h>
+#include <driver/pcnt.h>
+#include "Simulation.h"
+
+// The ESP32 tach peripherals of driver/pcnt.h and driver/mcpwm.h on the
+// simulated tach line. Only the fan's tach pin carries edges.
+
+namespace {
+
+    // the peripherals run from the 80 MHz APB clock
+    const uint32_t APB_TICKS_PER_US = 80;
+
+    struct PulseCounter {
+        int pin;
+        int16_t highLimit;
+        uint16_t filterCycles;
+        bool filtering;
+        bool running;
+        int16_t count;
+    };
+
+    struct CaptureChannel {
+        int pin;
+        bool enabled;
+        uint32_t prescale;
+        uint32_t edges;
+        cap_isr_cb_t callback;
+        void* arg;
+    };
+
+    PulseCounter counters[PCNT_UNIT_MAX];
+    CaptureChannel captures[MCPWM_UNIT_MAX];
+
+    SmartAirControl::sim::Simulation& simulation() {
+        return SmartAirControl::sim::Simulation::get();
+    }
+
+    void countEdge(void* arg, uint32_t lowUs) {
+        PulseCounter& counter = *static_cast<PulseCounter*>(arg);
+        if (counter.pin != simulation().fanTachPin || !counter.running) {
+            return;
+        }
+        // a low phase shorter than the filter never reaches the counter
+        if (counter.filtering && lowUs * APB_TICKS_PER_US < counter.filterCycles) {
+            return;
+        }
+        counter.count++;
+        if (counter.highLimit > 0 && counter.count >= counter.highLimit) {
+            counter.count = 0;
+        }
+    }
+
+    void captureEdge(void* arg, uint32_t lowUs) {
+        (void)lowUs;
+        CaptureChannel& capture = *static_cast<CaptureChannel*>(arg);
+        if (capture.pin != simulation().fanTachPin || !capture.enabled || capture.callback == nullptr) {
+            return;
+        }
+        if (++capture.edges % capture.prescale != 0) {
+            return;
+        }
+        cap_event_data_t event;
+        event.cap_edge = MCPWM_NEG_EDGE;
+        event.cap_value = static_cast<uint32_t>(simulation().nowUs() * APB_TICKS_PER_US);
+        simulation().tachInterrupt();
+        capture.callback(static_cast<mcpwm_unit_t>(&capture - captures), MCPWM_SELECT_CAP0, &event, capture.arg);
+    }
+
+    bool validUnit(pcnt_unit_t unit) {
+        return unit >= PCNT_UNIT_0 && unit < PCNT_UNIT_MAX;
+    }
+
+}
+
+esp_err_t pcnt_unit_config(const pcnt_config_t* config) {
+    if (config == nullptr || !validUnit(config->unit)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    PulseCounter& counter = counters[config->unit];
+    counter.pin = config->neg_mode == PCNT_COUNT_INC ? config->pulse_gpio_num : -1;
+    counter.highLimit = config->counter_h_lim;
+    counter.count = 0;
+    counter.running = true;
+    simulation().listenTach(countEdge, &counter);
+    return ESP_OK;
+}
+
+esp_err_t pcnt_set_filter_value(pcnt_unit_t unit, uint16_t filterValue) {
+    if (!validUnit(unit) || filterValue > 1023) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    counters[unit].filterCycles = filterValue;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_filter_enable(pcnt_unit_t unit) {
+    if (!validUnit(unit)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    counters[unit].filtering = true;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_filter_disable(pcnt_unit_t unit) {
+    if (!validUnit(unit)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    counters[unit].filtering = false;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_counter_pause(pcnt_unit_t unit) {
+    if (!validUnit(unit)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    counters[unit].running = false;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_counter_resume(pcnt_unit_t unit) {
+    if (!validUnit(unit)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    counters[unit].running = true;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_counter_clear(pcnt_unit_t unit) {
+    if (!validUnit(unit)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    counters[unit].count = 0;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_get_counter_value(pcnt_unit_t unit, int16_t* count) {
+    if (!validUnit(unit) || count == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *count = counters[unit].count;
+    return ESP_OK;
+}
+
+esp_err_t mcpwm_gpio_init(mcpwm_unit_t unit, mcpwm_io_signals_t signal, int gpio) {
+    if (unit < MCPWM_UNIT_0 || unit >= MCPWM_UNIT_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (signal == MCPWM_CAP_0) {
+        captures[unit].pin = gpio;
+    }
+    return ESP_OK;
+}
+
+esp_err_t mcpwm_capture_enable_channel(mcpwm_unit_t unit, mcpwm_capture_channel_id_t channel,
+                                       const mcpwm_capture_config_t* config) {
+    if (unit < MCPWM_UNIT_0 || unit >= MCPWM_UNIT_MAX || channel != MCPWM_SELECT_CAP0 || config == nullptr ||
+        config->cap_prescale == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    CaptureChannel& capture = captures[unit];
+    capture.enabled = (config->cap_edge & MCPWM_NEG_EDGE) != 0;
+    capture.prescale = config->cap_prescale;
+    capture.edges = 0;
+    capture.callback = config->capture_cb;
+    capture.arg = config->user_data;
+    simulation().listenTach(captureEdge, &capture);
+    return ESP_OK;
+}
+
+esp_err_t mcpwm_capture_disable_channel(mcpwm_unit_t unit, mcpwm_capture_channel_id_t channel) {
+    if (unit < MCPWM_UNIT_0 || unit >= MCPWM_UNIT_MAX || channel != MCPWM_SELECT_CAP0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    captures[unit].enabled = false;
+    return ESP_OK;
+}
+
+#endif
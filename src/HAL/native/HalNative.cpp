@@ -0,0 +1,153 @@
+#if !defined(ESP32)
+
+#include "../Hal.h"
+#include "Simulation.h"
+#include <Arduino.h>
+#include <cstring>
+
+Console Serial;
+
+namespace SmartAirControl {
+namespace hal {
+
+    uint32_t millis() {
+        return sim::Simulation::get().nowUs() / 1000;
+    }
+
+    uint32_t micros() {
+        return sim::Simulation::get().nowUs();
+    }
+
+    uint32_t rtcMillis() {
+        // the virtual clock runs on through the simulated deep sleep
+        return millis();
+    }
+
+    void delay(uint32_t ms) {
+        sim::Simulation& simulation = sim::Simulation::get();
+        simulation.advance(ms * 1000ULL);
+        simulation.wakeup();
+    }
+
+    void pinInputPullup(int pin) {
+        (void)pin;
+    }
+
+    void pinOutput(int pin) {
+        (void)pin;
+    }
+
+    void pinHold(int pin, bool level) {
+        sim::Simulation::get().pwmWrite(pin, level ? 255 : 0);
+    }
+
+    void pwmWrite(int pin, uint8_t duty) {
+        sim::Simulation::get().pwmWrite(pin, duty);
+    }
+
+    void attachFallingEdge(int pin, EdgeHandler handler, void* arg) {
+        sim::Simulation::get().attachFallingEdge(pin, handler, arg);
+    }
+
+    // single threaded, handlers only run while the clock advances
+    void disableInterrupts() {
+    }
+
+    void enableInterrupts() {
+    }
+
+    // there is no button on the simulated board
+    void setWakeupPin(int pin) {
+        (void)pin;
+    }
+
+    uint32_t lightSleep(uint32_t ms) {
+        sim::Simulation& simulation = sim::Simulation::get();
+        simulation.lightSleep(ms * 1000ULL);
+        simulation.wakeup();
+        return ms;
+    }
+
+    void deepSleep(uint32_t ms) {
+        sim::Simulation::get().deepSleep(ms * 1000ULL);
+    }
+
+    WakeupCause wakeupCause() {
+        return sim::Simulation::get().wakeupCause();
+    }
+
+    SerialPort& serialPort(uint8_t number) {
+        return sim::Simulation::get().port(number);
+    }
+
+    struct NvsHandle {
+        std::string name;
+        bool readOnly;
+    };
+
+    Nvs::Nvs(const char* name, bool readOnly) : handle(new NvsHandle()) {
+        NvsHandle* nvs = static_cast<NvsHandle*>(handle);
+        nvs->name = name;
+        nvs->readOnly = readOnly;
+    }
+
+    Nvs::~Nvs() {
+        delete static_cast<NvsHandle*>(handle);
+    }
+
+    size_t Nvs::getBytes(const char* key, void* buffer, size_t size) {
+        NvsHandle* nvs = static_cast<NvsHandle*>(handle);
+        std::map<std::string, std::vector<uint8_t> >& storage = sim::Simulation::get().nvs();
+        std::map<std::string, std::vector<uint8_t> >::const_iterator entry = storage.find(nvs->name + "/" + key);
+        if (entry == storage.end() || entry->second.size() != size) {
+            return 0;
+        }
+        std::memcpy(buffer, entry->second.data(), size);
+        return size;
+    }
+
+    size_t Nvs::putBytes(const char* key, const void* buffer, size_t size) {
+        NvsHandle* nvs = static_cast<NvsHandle*>(handle);
+        if (nvs->readOnly) {
+            return 0;
+        }
+        const uint8_t* bytes = static_cast<const uint8_t*>(buffer);
+        sim::Simulation::get().nvs()[nvs->name + "/" + key].assign(bytes, bytes + size);
+        return size;
+    }
+
+    bool Nvs::isKey(const char* key) {
+        NvsHandle* nvs = static_cast<NvsHandle*>(handle);
+        return sim::Simulation::get().nvs().count(nvs->name + "/" + key) > 0;
+    }
+
+    Flash::Flash(const char* label) : label(label), handle(nullptr) {
+    }
+
+    static sim::FlashModel& partition(const char* label, const void*& handle) {
+        if (handle == nullptr) {
+            handle = &sim::Simulation::get().flash(label);
+        }
+        return *const_cast<sim::FlashModel*>(static_cast<const sim::FlashModel*>(handle));
+    }
+
+    size_t Flash::size() {
+        return partition(label, handle).size();
+    }
+
+    bool Flash::read(size_t offset, void* buffer, size_t size) {
+        return partition(label, handle).read(offset, buffer, size);
+    }
+
+    bool Flash::write(size_t offset, const void* data, size_t size) {
+        return partition(label, handle).write(offset, data, size);
+    }
+
+    bool Flash::eraseSector(size_t sector) {
+        return partition(label, handle).eraseSector(sector);
+    }
+
+}
+}
+
+#endif
@@ -0,0 +1,312 @@
+#if !defined(ESP32) && !defined(PIO_UNIT_TESTING)
+
+#include <cctype>
+#include <csetjmp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <Arduino.h>
+#include "../Hal.h"
+#include "../../Tasks/Task.h"
+#include "../../Log/Log.h"
+#include "../../Power/PowerManager.h"
+#include "../../LoRa/UplinkScheduler.h"
+#include "../../Control/PmForecaster.h"
+#include "../../Control/FanPolicy.h"
+#include "../../Boot/BootTrace.h"
+#include "../../LoRa/SessionStore.h"
+#include "../../Storage/Journal.h"
+#include "Simulation.h"
+
+// Firmware entry point from main.cpp
+void setup();
+
+#ifndef SIM_DEFAULT_SECONDS
+#define SIM_DEFAULT_SECONDS 60
+#endif
+
+static int usage(const char* program) {
+    std::fprintf(stderr, "Usage: %s [-q] [-s scenario] [-p policy] [-u policy] [-f control] [-m policy] [-d downlink]... [-g outage]... [simulated seconds]\n",
+                 program);
+    std::fprintf(stderr, "       %s -c\n", program);
+    std::fprintf(stderr, "  -q           no firmware console output, only the report\n");
+    std::fprintf(stderr, "  -p policy    always, light or deep (POWER_POLICY)\n");
+    std::fprintf(stderr, "  -u policy    fixed or adaptive uplinks (UPLINK_POLICY)\n");
+    std::fprintf(stderr, "  -f control   reactive or predictive fan control (FAN_CONTROL)\n");
+    std::fprintf(stderr, "  -m policy    linear or optimal fan speed (FAN_POLICY), or inverted:\n");
+    std::fprintf(stderr, "               the (1 - score) mapping FanPolicy replaced, to compare against\n");
+    std::fprintf(stderr, "  -d downlink  seconds:fPort:hex, queued by the network then, e.g. 3600:10:0132\n");
+    std::fprintf(stderr, "               sets the fan to manual 50 %% after an hour (Command/CommandDispatcher.h)\n");
+    std::fprintf(stderr, "  -g outage    seconds:duration, no gateway in reach then, e.g. 0:21600 for the first 6 h\n");
+    std::fprintf(stderr, "  -s scenario  %s or a CSV trace, runs its length by default\n",
+                 SmartAirControl::sim::Scenario::names());
+    std::fprintf(stderr, "  -c           power cuts at every byte of a session journal append, then exit\n");
+    return 2;
+}
+
+static bool parsePolicy(const char* name, int& policy) {
+    static const char* const NAMES[] = { "always", "light", "deep" };
+    static const int POLICIES[] = { POWER_ALWAYS_ON, POWER_LIGHT_SLEEP, POWER_DEEP_SLEEP };
+    for (size_t i = 0; i < sizeof(POLICIES) / sizeof(POLICIES[0]); i++) {
+        if (std::strcmp(name, NAMES[i]) == 0) {
+            policy = POLICIES[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parseUplinkPolicy(const char* name, int& policy) {
+    static const int POLICIES[] = { UPLINK_FIXED, UPLINK_ADAPTIVE };
+    for (size_t i = 0; i < sizeof(POLICIES) / sizeof(POLICIES[0]); i++) {
+        if (std::strcmp(name, SmartAirControl::UplinkScheduler::policyName(POLICIES[i])) == 0) {
+            policy = POLICIES[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parseFanControl(const char* name, int& control) {
+    static const int CONTROLS[] = { FAN_CONTROL_REACTIVE, FAN_CONTROL_PREDICTIVE };
+    for (size_t i = 0; i < sizeof(CONTROLS) / sizeof(CONTROLS[0]); i++) {
+        if (std::strcmp(name, SmartAirControl::PmForecaster::policyName(CONTROLS[i])) == 0) {
+            control = CONTROLS[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parseFanPolicy(const char* name, int& policy) {
+    static const int POLICIES[] = { FAN_POLICY_LINEAR, FAN_POLICY_OPTIMAL, FAN_POLICY_INVERTED };
+    for (size_t i = 0; i < sizeof(POLICIES) / sizeof(POLICIES[0]); i++) {
+        if (std::strcmp(name, SmartAirControl::FanPolicy::policyName(POLICIES[i])) == 0) {
+            policy = POLICIES[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+// seconds:fPort:hex, the hex may be empty
+static bool parseDownlink(const char* text, SmartAirControl::sim::NetworkModel& network) {
+    char* end;
+    unsigned long seconds = std::strtoul(text, &end, 10);
+    if (*end != ':') {
+        return false;
+    }
+    unsigned long fPort = std::strtoul(end + 1, &end, 10);
+    if (*end != ':' || fPort == 0 || fPort > 255) {
+        return false;
+    }
+    std::vector<uint8_t> payload;
+    for (const char* hex = end + 1; *hex != '\0'; hex += 2) {
+        char byte[3] = { hex[0], hex[1], '\0' };
+        if (hex[1] == '\0' || !std::isxdigit(static_cast<unsigned char>(hex[0])) ||
+            !std::isxdigit(static_cast<unsigned char>(hex[1]))) {
+            return false;
+        }
+        payload.push_back(static_cast<uint8_t>(std::strtoul(byte, nullptr, 16)));
+    }
+    network.scheduleDownlink(seconds * 1000000ULL, static_cast<uint8_t>(fPort), payload);
+    return true;
+}
+
+// seconds:duration
+static bool parseOutage(const char* text, SmartAirControl::sim::NetworkModel& network) {
+    char* end;
+    unsigned long seconds = std::strtoul(text, &end, 10);
+    if (*end != ':') {
+        return false;
+    }
+    unsigned long duration = std::strtoul(end + 1, &end, 10);
+    if (*end != '\0' || duration == 0) {
+        return false;
+    }
+    network.addOutage(seconds * 1000000ULL, duration * 1000000ULL);
+    return true;
+}
+
+// A record of the session journal size, every byte the same
+static SmartAirControl::SessionStore::Record testRecord(uint8_t fill) {
+    SmartAirControl::SessionStore::Record record;
+    std::memset(&record, fill, sizeof(record));
+    return record;
+}
+
+// The journal recovers the newest record, which has to be expected (or one
+// of the two), and takes the next append
+static bool recovers(SmartAirControl::hal::Flash& partition, uint8_t expected, uint8_t alternative, uint8_t& got) {
+    SmartAirControl::Journal journal(partition, SmartAirControl::SessionStore::VERSION,
+                                     sizeof(SmartAirControl::SessionStore::Record));
+    SmartAirControl::SessionStore::Record record;
+    if (!journal.recover(&record)) {
+        return false;
+    }
+    SmartAirControl::SessionStore::Record same = testRecord(record.nonces[0]);
+    got = record.nonces[0];
+    if (std::memcmp(&record, &same, sizeof(record)) != 0 || (got != expected && got != alternative)) {
+        return false;
+    }
+    SmartAirControl::SessionStore::Record next = testRecord(0x5A);
+    return journal.append(&next) && journal.recover(&record) && std::memcmp(&record, &next, sizeof(record)) == 0;
+}
+
+// Cuts the power after every byte of an append to a session journal, once
+// in the middle of a sector and once where the append starts with the
+// erase of the oldest sector; each time the journal has to come back with
+// the record before or the new one, never less, and go on. Returns the
+// number of failures.
+static int checkPowerCuts() {
+    SmartAirControl::sim::FlashModel& flash = SmartAirControl::sim::Simulation::get().flash("check");
+    SmartAirControl::hal::Flash partition("check");
+    const size_t recordSize = sizeof(SmartAirControl::SessionStore::Record);
+    SmartAirControl::Journal journal(partition, SmartAirControl::SessionStore::VERSION, recordSize);
+    journal.recover(nullptr);
+
+    // records fill, fill + 1, ...: three of them, then up to the wrap
+    const size_t counts[2] = { 3, journal.getSlots() };
+    const char* const names[2] = { "in a sector", "at the wrap" };
+    int failures = 0;
+    for (int c = 0; c < 2; c++) {
+        flash = SmartAirControl::sim::FlashModel();
+        SmartAirControl::Journal filling(partition, SmartAirControl::SessionStore::VERSION, recordSize);
+        for (size_t i = 0; i < counts[c]; i++) {
+            SmartAirControl::SessionStore::Record record = testRecord(static_cast<uint8_t>(i + 1));
+            filling.append(&record);
+        }
+        const SmartAirControl::sim::FlashModel before = flash;
+        const uint8_t previous = static_cast<uint8_t>(counts[c]);
+        const uint8_t written = static_cast<uint8_t>(counts[c] + 1);
+
+        size_t cuts = 0, kept = 0, completed = 0, failed = 0;
+        for (size_t cut = 0;; cut++) {
+            flash = before;
+            flash.cutPowerAfter(cut);
+            SmartAirControl::Journal appending(partition, SmartAirControl::SessionStore::VERSION, recordSize);
+            SmartAirControl::SessionStore::Record record = testRecord(written);
+            bool done = appending.append(&record);
+            flash.restorePower();
+
+            uint8_t got = 0;
+            if (!recovers(partition, done ? written : previous, written, got)) {
+                failed++;
+            } else if (got == written) {
+                completed++;
+            } else {
+                kept++;
+            }
+            cuts++;
+            if (done) {
+                // the cut came after the last byte
+                break;
+            }
+        }
+        std::printf("[SIM] Power cuts %s:  %lu, %lu kept the record before, %lu the new one, %lu failed\n",
+                    names[c], static_cast<unsigned long>(cuts), static_cast<unsigned long>(kept),
+                    static_cast<unsigned long>(completed), static_cast<unsigned long>(failed));
+        failures += failed;
+    }
+    return failures;
+}
+
+// Runs setup() and then the tasks it started on the virtual clock, then
+// prints the report of the run.
+int main(int argc, char** argv) {
+    SmartAirControl::sim::Simulation& simulation = SmartAirControl::sim::Simulation::get();
+    unsigned long seconds = 0;
+    int policy = POWER_POLICY;
+    int uplinkPolicy = UPLINK_POLICY;
+    int fanControl = FAN_CONTROL;
+    int fanPolicy = FAN_POLICY;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "-q") == 0) {
+            Serial.setEcho(false);
+        } else if (std::strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            if (!simulation.loadScenario(argv[++i])) {
+                std::fprintf(stderr, "Cannot load scenario %s\n", argv[i]);
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            if (!parsePolicy(argv[++i], policy)) {
+                return usage(argv[0]);
+            }
+            SmartAirControl::PowerManager::overridePolicy(policy);
+        } else if (std::strcmp(argv[i], "-u") == 0 && i + 1 < argc) {
+            if (!parseUplinkPolicy(argv[++i], uplinkPolicy)) {
+                return usage(argv[0]);
+            }
+            SmartAirControl::UplinkScheduler::overridePolicy(uplinkPolicy);
+        } else if (std::strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            if (!parseFanControl(argv[++i], fanControl)) {
+                return usage(argv[0]);
+            }
+            SmartAirControl::PmForecaster::overridePolicy(fanControl);
+        } else if (std::strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            if (!parseFanPolicy(argv[++i], fanPolicy)) {
+                return usage(argv[0]);
+            }
+            SmartAirControl::FanPolicy::overridePolicy(fanPolicy);
+        } else if (std::strcmp(argv[i], "-c") == 0) {
+            return checkPowerCuts() == 0 ? 0 : 1;
+        } else if (std::strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            if (!parseDownlink(argv[++i], simulation.network())) {
+                return usage(argv[0]);
+            }
+        } else if (std::strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+            if (!parseOutage(argv[++i], simulation.network())) {
+                return usage(argv[0]);
+            }
+        } else if (argv[i][0] != '-' && seconds == 0) {
+            seconds = std::strtoul(argv[i], nullptr, 10);
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if (seconds == 0) {
+        seconds = simulation.scenario().getDurationSeconds();
+    }
+    if (seconds == 0) {
+        seconds = SIM_DEFAULT_SECONDS;
+    }
+
+    // volatile, the deep sleep longjmp()s back over it
+    volatile uint32_t untilMs = SmartAirControl::hal::millis() + seconds * 1000UL;
+
+    // a deep sleep ends here, as the reboot of the firmware: the tasks are
+    // started again, RTC memory (everything static here) is kept
+    if (setjmp(simulation.bootPoint()) != 0) {
+        SmartAirControl::resetTasks();
+    }
+    setup();
+    SmartAirControl::runTasks(untilMs);
+
+    // whatever the log task has not printed yet
+    while (SmartAirControl::logging::drain(SIZE_MAX) > 0) {
+    }
+    std::fflush(stdout);
+    std::printf("[SIM] Power policy: %s\n", SmartAirControl::PowerManager::policyName(policy));
+    std::printf("[SIM] Uplink policy: %s\n", SmartAirControl::UplinkScheduler::policyName(uplinkPolicy));
+    std::printf("[SIM] Fan control: %s\n", SmartAirControl::PmForecaster::policyName(fanControl));
+    std::printf("[SIM] Fan policy: %s\n", SmartAirControl::FanPolicy::policyName(fanPolicy));
+    simulation.printReport(stdout, Serial.getWritten());
+
+    // how long the boots took to get there, deep sleep wakes included
+    for (int i = 0; i < SmartAirControl::boot::PHASE_COUNT; i++) {
+        SmartAirControl::boot::Phase phase = static_cast<SmartAirControl::boot::Phase>(i);
+        const SmartAirControl::boot::Stats& stats = SmartAirControl::boot::stats(phase);
+        if (stats.boots > 0) {
+            char label[40];
+            std::snprintf(label, sizeof(label), "Boot to %s:", SmartAirControl::boot::name(phase));
+            std::printf("[SIM] %-26s %lu ms average, %lu ms max, %lu boots\n", label,
+                        static_cast<unsigned long>(stats.sumMs / stats.boots), static_cast<unsigned long>(stats.maxMs),
+                        static_cast<unsigned long>(stats.boots));
+        }
+    }
+    return 0;
+}
+
+#endif
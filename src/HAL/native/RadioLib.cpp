@@ -0,0 +1,239 @@
+#if !defined(ESP32)
+
+#include <RadioLib.h>
+#include <cstring>
+#include "Simulation.h"
+
+// Persistent buffers start with a magic so a zeroed RTC or a missing NVS key
+// is told apart from a real state, like RadioLib's own signatures
+static const uint32_t NONCES_MAGIC = 0x4E4F4E43; // "NONC"
+static const uint32_t SESSION_MAGIC = 0x53455353; // "SESS"
+
+const LoRaWANBand_t EU868 = { "EU868" };
+
+// checkSum16 as RadioLib signs its session buffer: the big endian 16 bit
+// words in front of the signature XORed, stored little endian
+static uint16_t signature(const uint8_t* session) {
+    uint16_t checksum = 0;
+    for (size_t i = 0; i < RADIOLIB_LORAWAN_SESSION_SIGNATURE; i += 2) {
+        checksum ^= uint16_t(session[i]) << 8 | session[i + 1];
+    }
+    return checksum;
+}
+
+Module::Module(uint32_t cs, uint32_t irq, uint32_t rst, uint32_t gpio) {
+    (void)cs;
+    (void)irq;
+    (void)rst;
+    (void)gpio;
+}
+
+SX1262::SX1262(Module* module) : module(module) {
+}
+
+SX1262::~SX1262() {
+    delete module;
+}
+
+int16_t SX1262::begin() {
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t SX1262::sleep() {
+    return RADIOLIB_ERR_NONE;
+}
+
+float SX1262::getRSSI() {
+    return -95.0;
+}
+
+float SX1262::getSNR() {
+    return 7.0;
+}
+
+LoRaWANNode::LoRaWANNode(PhysicalLayer* phy, const LoRaWANBand_t* band, uint8_t subBand)
+    : active(false), restored(false), devNonce(0), joinNonce(0), fCntUp(0), nFCntDown(0), aFCntDown(0), lastToA(0),
+      nonces(), session() {
+    (void)phy;
+    (void)band;
+    (void)subBand;
+}
+
+int16_t LoRaWANNode::beginOTAA(uint64_t joinEUI, uint64_t devEUI, uint8_t* nwkKey, uint8_t* appKey) {
+    (void)joinEUI;
+    (void)devEUI;
+    (void)nwkKey;
+    (void)appKey;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t LoRaWANNode::setBufferNonces(const uint8_t* persistentBuffer) {
+    uint32_t magic;
+    memcpy(&magic, persistentBuffer, sizeof(magic));
+    if (magic != NONCES_MAGIC) {
+        return RADIOLIB_ERR_NONCES_DISCARDED;
+    }
+    memcpy(&devNonce, &persistentBuffer[4], sizeof(devNonce));
+    memcpy(&joinNonce, &persistentBuffer[6], sizeof(joinNonce));
+    return RADIOLIB_ERR_NONE;
+}
+
+uint8_t* LoRaWANNode::getBufferNonces() {
+    memcpy(&nonces[0], &NONCES_MAGIC, sizeof(NONCES_MAGIC));
+    memcpy(&nonces[4], &devNonce, sizeof(devNonce));
+    memcpy(&nonces[6], &joinNonce, sizeof(joinNonce));
+    return nonces;
+}
+
+int16_t LoRaWANNode::setBufferSession(const uint8_t* persistentBuffer) {
+    uint32_t magic;
+    uint32_t sessionJoinNonce;
+    uint16_t sessionSignature;
+    memcpy(&magic, persistentBuffer, sizeof(magic));
+    memcpy(&sessionJoinNonce, &persistentBuffer[8], sizeof(sessionJoinNonce));
+    memcpy(&sessionSignature, &persistentBuffer[RADIOLIB_LORAWAN_SESSION_SIGNATURE], sizeof(sessionSignature));
+    // a session only belongs to the join the nonces describe
+    if (magic != SESSION_MAGIC || sessionJoinNonce != joinNonce || sessionSignature != signature(persistentBuffer)) {
+        return RADIOLIB_ERR_SESSION_DISCARDED;
+    }
+    memcpy(&fCntUp, &persistentBuffer[RADIOLIB_LORAWAN_SESSION_FCNT_UP], sizeof(fCntUp));
+    memcpy(&nFCntDown, &persistentBuffer[RADIOLIB_LORAWAN_SESSION_N_FCNT_DOWN], sizeof(nFCntDown));
+    memcpy(&aFCntDown, &persistentBuffer[RADIOLIB_LORAWAN_SESSION_A_FCNT_DOWN], sizeof(aFCntDown));
+    restored = true;
+    return RADIOLIB_ERR_NONE;
+}
+
+uint8_t* LoRaWANNode::getBufferSession() {
+    if (active) {
+        memcpy(&session[0], &SESSION_MAGIC, sizeof(SESSION_MAGIC));
+        memcpy(&session[RADIOLIB_LORAWAN_SESSION_FCNT_UP], &fCntUp, sizeof(fCntUp));
+        memcpy(&session[8], &joinNonce, sizeof(joinNonce));
+        memcpy(&session[RADIOLIB_LORAWAN_SESSION_N_FCNT_DOWN], &nFCntDown, sizeof(nFCntDown));
+        memcpy(&session[RADIOLIB_LORAWAN_SESSION_A_FCNT_DOWN], &aFCntDown, sizeof(aFCntDown));
+        uint16_t checksum = signature(session);
+        memcpy(&session[RADIOLIB_LORAWAN_SESSION_SIGNATURE], &checksum, sizeof(checksum));
+    }
+    return session;
+}
+
+int16_t LoRaWANNode::activateOTAA(uint8_t initialDr, LoRaWANJoinEvent_t* joinEvent) {
+    (void)initialDr;
+
+    if (restored) {
+        active = true;
+        if (joinEvent != nullptr) {
+            joinEvent->newSession = false;
+            joinEvent->devNonce = devNonce;
+            joinEvent->joinNonce = joinNonce;
+        }
+        return RADIOLIB_LORAWAN_SESSION_RESTORED;
+    }
+
+    SmartAirControl::sim::Simulation& simulation = SmartAirControl::sim::Simulation::get();
+    devNonce++;
+    bool heard;
+    uint32_t airtimeUs = simulation.transmit(SmartAirControl::sim::NetworkModel::JOIN_REQUEST_SIZE, true, heard);
+    lastToA = (airtimeUs + 500) / 1000;
+    if (!heard) {
+        // RX1 and RX2 pass without a join accept
+        return RADIOLIB_ERR_NO_JOIN_ACCEPT;
+    }
+
+    joinNonce++;
+    fCntUp = 0;
+    nFCntDown = 0;
+    aFCntDown = 0;
+    active = true;
+    if (joinEvent != nullptr) {
+        joinEvent->newSession = true;
+        joinEvent->devNonce = devNonce;
+        joinEvent->joinNonce = joinNonce;
+    }
+    return RADIOLIB_LORAWAN_NEW_SESSION;
+}
+
+int16_t LoRaWANNode::sendReceive(const uint8_t* dataUp, size_t lenUp, uint8_t fPort, uint8_t* dataDown, size_t* lenDown,
+                                 bool isConfirmed, LoRaWANEvent_t* eventUp, LoRaWANEvent_t* eventDown) {
+    if (!active) {
+        return RADIOLIB_ERR_NETWORK_NOT_JOINED;
+    }
+    if (lenUp > getMaxPayloadLen()) {
+        return RADIOLIB_ERR_INVALID_PAYLOAD;
+    }
+
+    SmartAirControl::sim::Simulation& simulation = SmartAirControl::sim::Simulation::get();
+    bool heard;
+    uint32_t airtimeUs = simulation.transmit(lenUp + SmartAirControl::sim::NetworkModel::UPLINK_OVERHEAD, false, heard);
+    lastToA = (airtimeUs + 500) / 1000;
+    if (heard) {
+        simulation.deliver(fPort, dataUp, lenUp);
+    }
+
+    if (eventUp != nullptr) {
+        *eventUp = LoRaWANEvent_t();
+        eventUp->confirmed = isConfirmed;
+        eventUp->datarate = simulation.network().getDataRate();
+        eventUp->freq = 868.1;
+        eventUp->fCnt = fCntUp;
+        eventUp->fPort = fPort;
+        eventUp->nbTrans = 1;
+    }
+    if (eventDown != nullptr) {
+        *eventDown = LoRaWANEvent_t();
+    }
+    if (lenDown != nullptr) {
+        *lenDown = 0;
+    }
+    fCntUp++;
+
+    // a queued downlink arrives in RX1, if the uplink got through
+    uint8_t fPortDown;
+    std::vector<uint8_t> payload;
+    if (!heard || dataDown == nullptr || lenDown == nullptr ||
+        !simulation.network().takeDownlink(simulation.nowUs(), fPortDown, payload)) {
+        return 0;
+    }
+    std::memcpy(dataDown, payload.data(), payload.size());
+    *lenDown = payload.size();
+    if (eventDown != nullptr) {
+        eventDown->dir = 1;
+        eventDown->datarate = simulation.network().getDataRate();
+        eventDown->freq = 868.1;
+        // MAC only frames count on their own, application ones on AFCntDown
+        eventDown->fCnt = fPortDown == 0 ? ++nFCntDown : ++aFCntDown;
+        eventDown->fPort = fPortDown;
+    }
+    return 1;
+}
+
+uint32_t LoRaWANNode::getFCntUp() {
+    return fCntUp;
+}
+
+int16_t LoRaWANNode::sendMacCommandReq(uint8_t cid) {
+    (void)cid;
+    return RADIOLIB_ERR_NONE;
+}
+
+RadioLibTime_t LoRaWANNode::getLastToA() {
+    return lastToA;
+}
+
+int16_t LoRaWANNode::getMacLinkCheckAns(uint8_t* margin, uint8_t* gwCnt) {
+    (void)margin;
+    (void)gwCnt;
+    return RADIOLIB_LORAWAN_NO_DOWNLINK;
+}
+
+int16_t LoRaWANNode::getMacDeviceTimeAns(uint32_t* gpsEpoch, uint8_t* fraction, bool returnUnix) {
+    (void)gpsEpoch;
+    (void)fraction;
+    (void)returnUnix;
+    return RADIOLIB_LORAWAN_NO_DOWNLINK;
+}
+
+uint8_t LoRaWANNode::getMaxPayloadLen() {
+    return SmartAirControl::sim::Simulation::get().network().getMaxPayload();
+}
+
+#endif
@@ -0,0 +1,187 @@
+#if !defined(ESP32)
+
+#include "Scenario.h"
+#include "Simulation.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace SmartAirControl {
+namespace sim {
+
+    // A pollution event (cooking, candles, traffic through an open window):
+    // ramps up linearly over riseS, then decays exponentially with decayS
+    struct Event {
+        uint32_t startS;
+        uint32_t riseS;
+        uint32_t decayS;
+        float pm25;          /** peak PM2.5 on top of the background */
+        float gasDrop;       /** peak fraction of the gas resistance lost to VOCs */
+        float temperature;   /** peak warming */
+        float humidity;      /** peak humidity rise */
+    };
+
+    // The synthetic readings are what the BME680 would report: its gas plate
+    // loses resistance with humidity (a power law here, not the firmware's
+    // compensation) and drifts down as it ages
+    static const float CLEAN_GAS_KOHM = 150.0f;
+    static const float GAS_HUMIDITY_EXPONENT = -0.8f;
+    static const float GAS_DRIFT_PER_DAY = 0.015f;
+
+    static float eventLevel(const Event& event, double seconds) {
+        if (seconds < event.startS) {
+            return 0;
+        }
+        double t = seconds - event.startS;
+        if (t < event.riseS) {
+            return t / event.riseS;
+        }
+        return std::exp(-(t - event.riseS) / event.decayS);
+    }
+
+    Scenario::Scenario() {
+        constant();
+    }
+
+    const char* Scenario::names() {
+        return "constant, spike, day, week";
+    }
+
+    bool Scenario::load(const std::string& nameOrPath) {
+        if (nameOrPath == "constant") {
+            constant();
+            return true;
+        }
+
+        std::vector<Event> events;
+        uint32_t duration;
+        if (nameOrPath == "spike") {
+            // a single heavy cooking event
+            duration = 2 * 3600;
+            events.push_back(Event{ 600, 600, 1800, 120, 0.6f, 1.5f, 12 });
+        } else if (nameOrPath == "day" || nameOrPath == "week") {
+            // a working day at home: meals, commuter traffic through the window,
+            // candles; the week has seven of them for the gas baseline to learn
+            duration = (nameOrPath == "day" ? 1 : 7) * 24 * 3600;
+            events.push_back(Event{  7 * 3600 + 1800,  600, 1200,  55, 0.3f, 1.0f,  8 });
+            events.push_back(Event{  8 * 3600,        1800, 3600,  15, 0.0f, 0.0f,  0 });
+            events.push_back(Event{ 12 * 3600 + 1800,  900, 1800,  45, 0.3f, 1.0f,  6 });
+            events.push_back(Event{ 17 * 3600 + 1800, 1800, 3600,  20, 0.0f, 0.0f,  0 });
+            events.push_back(Event{ 19 * 3600,        1200, 2400, 150, 0.6f, 2.0f, 15 });
+            events.push_back(Event{ 21 * 3600,        1800, 1800,  35, 0.2f, 0.5f,  0 });
+        } else {
+            return loadCsv(nameOrPath);
+        }
+
+        name = nameOrPath;
+        points.clear();
+
+        // fixed seed, every run sees the same sensor noise
+        uint32_t seed = 12345;
+        for (uint32_t s = 0; s <= duration; s += 60) {
+            seed = seed * 1103515245u + 12345u;
+            float noise = ((seed >> 16) & 0x7FFF) / 32767.0f - 0.5f;
+
+            // background follows the day: a bit cooler and cleaner at night
+            float daytime = 0.5f - 0.5f * std::cos(2 * M_PI * (s % 86400) / 86400.0);
+            Point point;
+            point.seconds = s;
+            point.pm25 = 6.0f + 4.0f * daytime + noise;
+            point.temperature = 20.0f + 3.0f * daytime;
+            point.humidity = 50.0f - 10.0f * daytime;
+
+            float gasLoss = 0;
+            for (size_t i = 0; i < events.size(); i++) {
+                float level = eventLevel(events[i], s % 86400);
+                point.pm25 += level * events[i].pm25;
+                gasLoss += level * events[i].gasDrop;
+                point.temperature += level * events[i].temperature;
+                point.humidity += level * events[i].humidity;
+            }
+            point.gasResistance = CLEAN_GAS_KOHM * (1.0f - GAS_DRIFT_PER_DAY * s / 86400.0f) *
+                                  std::pow(point.humidity / 45.0f, GAS_HUMIDITY_EXPONENT) *
+                                  (gasLoss < 0.9f ? 1.0f - gasLoss : 0.1f);
+            point.pm10 = 0.7f * point.pm25;
+            point.pm100 = 1.4f * point.pm25;
+            points.push_back(point);
+        }
+        return true;
+    }
+
+    bool Scenario::loadCsv(const std::string& path) {
+        FILE* file = std::fopen(path.c_str(), "r");
+        if (file == nullptr) {
+            return false;
+        }
+
+        std::vector<Point> loaded;
+        char line[256];
+        bool ok = true;
+        while (ok && std::fgets(line, sizeof(line), file) != nullptr) {
+            char* comment = std::strchr(line, '#');
+            if (comment != nullptr) {
+                *comment = '\0';
+            }
+            if (std::strspn(line, " \t\r\n") == std::strlen(line)) {
+                continue;
+            }
+
+            Point point;
+            ok = std::sscanf(line, "%u,%f,%f,%f,%f,%f,%f", &point.seconds, &point.pm10, &point.pm25, &point.pm100,
+                             &point.gasResistance, &point.temperature, &point.humidity) == 7 &&
+                 (loaded.empty() || point.seconds > loaded.back().seconds);
+            loaded.push_back(point);
+        }
+        std::fclose(file);
+
+        if (!ok || loaded.empty()) {
+            return false;
+        }
+        name = path;
+        points.swap(loaded);
+        return true;
+    }
+
+    void Scenario::constant() {
+        name = "constant";
+        points.clear();
+        points.push_back(Point{ 0, 6.0f, 9.0f, 14.0f, 120.0f, 22.0f, 45.0f });
+    }
+
+    uint32_t Scenario::getDurationSeconds() const {
+        return points.back().seconds;
+    }
+
+    void Scenario::at(double seconds, Air& air) const {
+        // first point after t, the one before it is the segment start
+        size_t i = 0;
+        size_t count = points.size();
+        while (count > 0) {
+            size_t half = count / 2;
+            if (points[i + half].seconds <= seconds) {
+                i += half + 1;
+                count -= half + 1;
+            } else {
+                count = half;
+            }
+        }
+
+        const Point& b = points[i < points.size() ? i : points.size() - 1];
+        const Point& a = points[i > 0 ? i - 1 : 0];
+        float frac = b.seconds > a.seconds ? (seconds - a.seconds) / (b.seconds - a.seconds) : 0;
+        if (frac > 1) frac = 1;
+        if (frac < 0) frac = 0;
+
+        air.pm10 = a.pm10 + frac * (b.pm10 - a.pm10);
+        air.pm25 = a.pm25 + frac * (b.pm25 - a.pm25);
+        air.pm100 = a.pm100 + frac * (b.pm100 - a.pm100);
+        air.gasResistance = a.gasResistance + frac * (b.gasResistance - a.gasResistance);
+        air.temperature = a.temperature + frac * (b.temperature - a.temperature);
+        air.humidity = a.humidity + frac * (b.humidity - a.humidity);
+    }
+
+}
+}
+
+#endif
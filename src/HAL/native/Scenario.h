@@ -0,0 +1,63 @@
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#if !defined(ESP32)
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace SmartAirControl {
+namespace sim {
+
+    struct Air;
+
+    // Room conditions over time as they would be without the purifier running,
+    // linearly interpolated between points and held after the last one.
+    // Either a recorded trace (CSV) or one of the synthetic built-ins.
+    //
+    // CSV: one point per line, '#' starts a comment
+    //  seconds,pm10,pm25,pm100,gas_kohm,temperature,humidity
+    class Scenario {
+        public:
+            struct Point {
+                uint32_t seconds;
+                float pm10;          /** PM1.0 in ug/m3 */
+                float pm25;          /** PM2.5 in ug/m3 */
+                float pm100;         /** PM10 in ug/m3 */
+                float gasResistance; /** BME680 gas resistance in KOhms */
+                float temperature;   /** Temperature in degrees celsius */
+                float humidity;      /** Relative humidity in % */
+            };
+
+            // Steady indoor air, what the simulation ran on before scenarios
+            Scenario();
+
+            // A built-in name (see names()) or the path of a CSV trace.
+            // Returns false and leaves the scenario unchanged on failure.
+            bool load(const std::string& nameOrPath);
+
+            static const char* names();
+
+            const std::string& getName() const { return name; }
+            // Time of the last point
+            uint32_t getDurationSeconds() const;
+
+            // Unpurified room at t
+            void at(double seconds, Air& air) const;
+
+        private:
+            bool loadCsv(const std::string& path);
+            void constant();
+            void day();
+
+            std::string name;
+            std::vector<Point> points;
+    };
+
+}
+}
+
+#endif
+
+#endif // SCENARIO_H
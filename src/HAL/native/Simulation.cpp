@@ -0,0 +1,645 @@
+#if !defined(ESP32)
+
+#include "Simulation.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "../../Codec/BatchCodec.h"
+
+namespace SmartAirControl {
+namespace sim {
+
+    // Measured on the real fan, duty 255 is stopped (PWM drives a transistor)
+    static const int TABLE_SIZE = 11;
+    static const float TABLE_RPM[TABLE_SIZE]  = {   0,  780, 1140, 1440, 1740, 2730, 6720, 9960, 12930, 14520, 12570 };
+    static const float TABLE_DUTY[TABLE_SIZE] = { 255,  230,  204,  179,  153,  128,  102,   77,    51,    26,     0 };
+
+    const float FanModel::TIME_CONSTANT_S = 1.2;
+    // 40 mm 12 V fan of this speed class
+    const float FanModel::MAX_RPM = 14520;
+    const float FanModel::MAX_POWER_W = 1.6;
+
+    FanModel::FanModel() : duty(255), rpm(0), phase(0) {
+    }
+
+    float FanModel::steadyRpm(uint8_t duty) {
+        for (int i = 1; i < TABLE_SIZE; i++) {
+            if (duty >= TABLE_DUTY[i]) {
+                float frac = (TABLE_DUTY[i-1] - duty) / (TABLE_DUTY[i-1] - TABLE_DUTY[i]);
+                return TABLE_RPM[i-1] + frac * (TABLE_RPM[i] - TABLE_RPM[i-1]);
+            }
+        }
+        return TABLE_RPM[TABLE_SIZE-1];
+    }
+
+    float FanModel::power(float rpm) {
+        float n = rpm / MAX_RPM;
+        return MAX_POWER_W * n * n * n;
+    }
+
+    bool FanModel::advance(uint64_t& nowUs, uint64_t toUs) {
+        if (toUs <= nowUs) {
+            return false;
+        }
+
+        uint64_t dtUs = toUs - nowUs;
+        bool edge = false;
+
+        // edges per microsecond at the current speed
+        float rate = rpm * PULSES_PER_REVOLUTION / 60e6f;
+        if (rate > 0) {
+            float untilEdge = (1.0f - phase) / rate;
+            if (untilEdge <= dtUs) {
+                dtUs = untilEdge < 1 ? 1 : static_cast<uint64_t>(untilEdge);
+                edge = true;
+            }
+        }
+
+        float target = steadyRpm(duty);
+        rpm += (target - rpm) * (1.0f - std::exp(-(dtUs / 1e6f) / TIME_CONSTANT_S));
+        phase = edge ? 0 : phase + rate * dtUs;
+
+        nowUs += dtUs;
+        return edge;
+    }
+
+    PmsModel::PmsModel() : open(false), lost(0), nextFrameUs(STARTUP_US), head(0), count(0), seed(12345) {
+    }
+
+    void PmsModel::begin(unsigned long baud, uint32_t config, int8_t rxPin, int8_t txPin) {
+        (void)baud;
+        (void)config;
+        (void)rxPin;
+        (void)txPin;
+        open = true;
+    }
+
+    int PmsModel::available() {
+        return count;
+    }
+
+    int PmsModel::read() {
+        if (count == 0) {
+            return -1;
+        }
+        uint8_t b = rx[head];
+        head = (head + 1) % RX_BUFFER_SIZE;
+        count--;
+        return b;
+    }
+
+    size_t PmsModel::write(const uint8_t* buffer, size_t size) {
+        // commands (sleep, passive mode) are not modelled
+        (void)buffer;
+        return size;
+    }
+
+    static uint16_t clampWord(float value) {
+        if (value <= 0) return 0;
+        if (value >= 65535) return 65535;
+        return static_cast<uint16_t>(value + 0.5f);
+    }
+
+    const float PmsModel::NOISE_RELATIVE = 0.1f;
+    const float PmsModel::NOISE_ABSOLUTE = 1.0f;
+    const float PmsModel::SPIKE_FACTOR = 3.0f;
+
+    float PmsModel::gaussian() {
+        // Irwin-Hall: four uniforms, mean 0, variance 1
+        float sum = 0;
+        for (int i = 0; i < 4; i++) {
+            seed = seed * 1103515245u + 12345u;
+            sum += ((seed >> 16) & 0x7FFF) / 32767.0f;
+        }
+        return (sum - 2.0f) * 1.7320508f;
+    }
+
+    void PmsModel::advance(uint64_t nowUs, const Air& air, bool listening) {
+        while (nextFrameUs <= nowUs) {
+            nextFrameUs += FRAME_PERIOD_US;
+
+            // one count behind all channels, so they scatter together
+            float scale = 1.0f + NOISE_RELATIVE * gaussian();
+            float offset = NOISE_ABSOLUTE * gaussian();
+            seed = seed * 1103515245u + 12345u;
+            if ((seed >> 16) % SPIKE_PERIOD == 0) {
+                scale *= SPIKE_FACTOR;
+            }
+            float pm10 = air.pm10 * scale + 0.7f * offset;
+            float pm25 = air.pm25 * scale + offset;
+            float pm100 = air.pm100 * scale + 1.4f * offset;
+
+            // counts per 0.1 l from the mass concentration, rough urban aerosol ratios
+            uint16_t words[13] = {
+                clampWord(pm10), clampWord(pm25), clampWord(pm100),
+                clampWord(pm10), clampWord(pm25), clampWord(pm100),
+                clampWord(pm10 * 150), clampWord(pm10 * 45), clampWord(pm10 * 8),
+                clampWord(pm25 * 0.7f), clampWord(pm100 * 0.15f), clampWord(pm100 * 0.05f),
+                0
+            };
+
+            uint8_t frame[32];
+            frame[0] = 0x42;
+            frame[1] = 0x4D;
+            frame[2] = 0;
+            frame[3] = 28;
+            for (int i = 0; i < 13; i++) {
+                frame[4 + 2*i] = words[i] >> 8;
+                frame[5 + 2*i] = words[i] & 0xFF;
+            }
+            uint16_t sum = 0;
+            for (int i = 0; i < 30; i++) {
+                sum += frame[i];
+            }
+            frame[30] = sum >> 8;
+            frame[31] = sum & 0xFF;
+
+            if (open && listening) {
+                receive(frame, sizeof(frame));
+            } else if (open) {
+                lost += sizeof(frame);
+            }
+        }
+    }
+
+    void PmsModel::receive(const uint8_t* data, size_t size) {
+        for (size_t i = 0; i < size && count < RX_BUFFER_SIZE; i++) {
+            rx[(head + count) % RX_BUFFER_SIZE] = data[i];
+            count++;
+        }
+    }
+
+    // bedroom of 12 m2, a purifier of this size gets to about 5 air changes per hour
+    const float RoomModel::VOLUME_M3 = 30;
+    const float RoomModel::AIR_CHANGES_PER_HOUR = 0.7;
+    const float RoomModel::MAX_CADR_M3_PER_HOUR = 150;
+
+    RoomModel::RoomModel() : reduction{ 0, 0, 0 } {
+    }
+
+    void RoomModel::advance(double dtS, float fanRpm, const Air& unpurified, Air& air) {
+        float rpm = fanRpm > 0 ? fanRpm : 0;
+        double cleaning = MAX_CADR_M3_PER_HOUR * rpm / FanModel::MAX_RPM / VOLUME_M3 / 3600.0;
+        double removal = cleaning + AIR_CHANGES_PER_HOUR / 3600.0;
+        double decay = std::exp(-removal * dtS);
+
+        const float source[3] = { unpurified.pm10, unpurified.pm25, unpurified.pm100 };
+        float* purified[3] = { &air.pm10, &air.pm25, &air.pm100 };
+        for (int i = 0; i < 3; i++) {
+            reduction[i] = reduction[i] * decay + cleaning * source[i] / removal * (1.0 - decay);
+            if (reduction[i] > source[i]) {
+                reduction[i] = source[i];
+            }
+            *purified[i] = source[i] - reduction[i];
+        }
+
+        // gases and climate pass through the particle filter unchanged
+        air.gasResistance = unpurified.gasResistance;
+        air.temperature = unpurified.temperature;
+        air.humidity = unpurified.humidity;
+    }
+
+    FlashModel::FlashModel()
+        : bytes(SIZE, 0xFF), sectorErases(SIZE / hal::Flash::SECTOR_SIZE, 0), writes(0), erases(0), powered(true),
+          cutting(false), remaining(0) {
+    }
+
+    bool FlashModel::read(size_t offset, void* buffer, size_t size) const {
+        if (!powered || offset > bytes.size() || size > bytes.size() - offset) {
+            return false;
+        }
+        std::memcpy(buffer, &bytes[offset], size);
+        return true;
+    }
+
+    bool FlashModel::write(size_t offset, const void* data, size_t size) {
+        if (!powered || offset > bytes.size() || size > bytes.size() - offset) {
+            return false;
+        }
+        writes++;
+        const uint8_t* source = static_cast<const uint8_t*>(data);
+        size_t done = budget(size);
+        for (size_t i = 0; i < done; i++) {
+            bytes[offset + i] &= source[i];
+        }
+        return done == size;
+    }
+
+    bool FlashModel::eraseSector(size_t sector) {
+        if (!powered || sector >= sectorErases.size()) {
+            return false;
+        }
+        erases++;
+        sectorErases[sector]++;
+        size_t done = budget(hal::Flash::SECTOR_SIZE);
+        std::memset(&bytes[sector * hal::Flash::SECTOR_SIZE], 0xFF, done);
+        return done == hal::Flash::SECTOR_SIZE;
+    }
+
+    void FlashModel::cutPowerAfter(size_t bytes) {
+        cutting = true;
+        remaining = bytes;
+    }
+
+    void FlashModel::restorePower() {
+        powered = true;
+        cutting = false;
+    }
+
+    uint32_t FlashModel::getMaxSectorErases() const {
+        uint32_t most = 0;
+        for (size_t i = 0; i < sectorErases.size(); i++) {
+            most = sectorErases[i] > most ? sectorErases[i] : most;
+        }
+        return most;
+    }
+
+    size_t FlashModel::budget(size_t size) {
+        if (!cutting) {
+            return size;
+        }
+        if (remaining > size) {
+            remaining -= size;
+            return size;
+        }
+        size_t done = remaining;
+        remaining = 0;
+        powered = false;
+        return done;
+    }
+
+    const float Report::PM25_THRESHOLDS[Report::THRESHOLD_COUNT] = { 15, 35 };
+
+    Report::Report()
+        : simulatedUs(0), fanEnergyWh(0), pm25Exposure(0), unpurifiedExposure(0),
+          aboveUs{ 0, 0 }, unpurifiedAboveUs{ 0, 0 }, joins(0), joinsAccepted(0), uplinks(0), uplinksLost(0), airtimeUs(0), joinAirtimeUs(0),
+          dutyCycleViolations(0), wakeups(0), tachInterrupts(0),
+          lightSleepUs(0), deepSleepUs(0), lightSleeps(0), boots(1), heaterUs(0), gasReadings(0) {
+    }
+
+    const float PowerModel::CPU_ACTIVE_MA = 50;
+    const float PowerModel::CPU_IDLE_MA = 30;
+    const float PowerModel::LIGHT_SLEEP_MA = 0.8;
+    const float PowerModel::DEEP_SLEEP_MA = 0.01;
+    const float PowerModel::RADIO_TX_MA = 45;
+    const float PowerModel::HEATER_MA = 12;
+    const uint32_t PowerModel::BOOT_US = 250000;
+    const uint32_t PowerModel::SLEEP_EXIT_US = 1000;
+
+    NetworkModel::NetworkModel() : dataRate(5) {
+    }
+
+    uint8_t NetworkModel::getMaxPayload() const {
+        // EU868 (RP002) for DR0 ... DR5
+        static const uint8_t MAX_PAYLOAD[6] = { 51, 51, 51, 115, 222, 222 };
+        return MAX_PAYLOAD[dataRate < 6 ? dataRate : 5];
+    }
+
+    uint32_t NetworkModel::timeOnAirUs(size_t phySize) const {
+        // SX1262 datasheet / AN1200.13, explicit header, CRC on, 8 preamble symbols
+        int sf = 12 - (dataRate < 6 ? dataRate : 5);
+        double symbolUs = (1 << sf) / 125e3 * 1e6;
+        int lowRate = sf >= 11 ? 1 : 0;
+        double bits = 8.0 * phySize - 4 * sf + 28 + 16;
+        double blocks = std::ceil(bits / (4 * (sf - 2 * lowRate)));
+        double symbols = 8 + 4.25 + 8 + (blocks > 0 ? blocks : 0) * 5;
+        return static_cast<uint32_t>(symbols * symbolUs + 0.5);
+    }
+
+    void NetworkModel::scheduleDownlink(uint64_t atUs, uint8_t fPort, const std::vector<uint8_t>& payload) {
+        Downlink downlink = { atUs, fPort, payload };
+        std::vector<Downlink>::iterator it = downlinks.begin();
+        while (it != downlinks.end() && it->atUs <= atUs) {
+            ++it;
+        }
+        downlinks.insert(it, downlink);
+    }
+
+    bool NetworkModel::takeDownlink(uint64_t nowUs, uint8_t& fPort, std::vector<uint8_t>& payload) {
+        if (downlinks.empty() || downlinks.front().atUs > nowUs) {
+            return false;
+        }
+        fPort = downlinks.front().fPort;
+        payload = downlinks.front().payload;
+        downlinks.erase(downlinks.begin());
+        return true;
+    }
+
+    void NetworkModel::addOutage(uint64_t fromUs, uint64_t durationUs) {
+        Outage outage = { fromUs, fromUs + durationUs };
+        outages.push_back(outage);
+    }
+
+    bool NetworkModel::isReachable(uint64_t nowUs) const {
+        for (size_t i = 0; i < outages.size(); i++) {
+            if (nowUs >= outages[i].fromUs && nowUs < outages[i].untilUs) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    uint64_t NetworkModel::getOutageUs(uint64_t untilUs) const {
+        // overlapping outages count once, second by second
+        uint64_t outageUs = 0;
+        for (uint64_t us = 0; us < untilUs; us += 1000000) {
+            if (!isReachable(us)) {
+                outageUs += untilUs - us < 1000000 ? untilUs - us : 1000000;
+            }
+        }
+        return outageUs;
+    }
+
+    Simulation& Simulation::get() {
+        static Simulation simulation;
+        return simulation;
+    }
+
+    Simulation::Simulation()
+        : fanPwmPin(13), fanTachPin(12), tachHandler(nullptr), tachArg(nullptr), now(0), sleeping(false),
+          cause(hal::WAKEUP_POWER_ON), lastTransmitUs(0), lastAirtimeUs(0) {
+        unpurified.pressure = 1013.25;
+        trace.at(0, unpurified);
+        room = unpurified;
+    }
+
+    bool Simulation::loadScenario(const std::string& nameOrPath) {
+        if (!trace.load(nameOrPath)) {
+            return false;
+        }
+        trace.at(now / 1e6, unpurified);
+        room = unpurified;
+        return true;
+    }
+
+    void Simulation::advance(uint64_t us) {
+        advanceTo(now + us);
+    }
+
+    void Simulation::advanceTo(uint64_t us) {
+        while (now < us) {
+            uint64_t stepStart = now;
+            uint64_t stepEnd = now + STEP_US < us ? now + STEP_US : us;
+            while (now < stepEnd) {
+                // the clock sits on the edge while the handler runs, like micros() in an ISR
+                if (fanModel.advance(now, stepEnd)) {
+                    tachEdge(static_cast<uint32_t>(fanModel.getLowUs()));
+                }
+            }
+            accumulate(now - stepStart);
+            pmsModel.advance(now, room, !sleeping);
+        }
+    }
+
+    void Simulation::accumulate(uint64_t dtUs) {
+        double dtS = dtUs / 1e6;
+        trace.at(now / 1e6, unpurified);
+        roomModel.advance(dtS, fanModel.getRpm(), unpurified, room);
+
+        totals.simulatedUs += dtUs;
+        totals.fanEnergyWh += FanModel::power(fanModel.getRpm()) * dtS / 3600.0;
+        totals.pm25Exposure += room.pm25 * dtS / 3600.0;
+        totals.unpurifiedExposure += unpurified.pm25 * dtS / 3600.0;
+        while (roomPm25.size() * 1000000ULL <= now) {
+            roomPm25.push_back(room.pm25);
+        }
+        for (int i = 0; i < Report::THRESHOLD_COUNT; i++) {
+            if (room.pm25 > Report::PM25_THRESHOLDS[i]) {
+                totals.aboveUs[i] += dtUs;
+            }
+            if (unpurified.pm25 > Report::PM25_THRESHOLDS[i]) {
+                totals.unpurifiedAboveUs[i] += dtUs;
+            }
+        }
+    }
+
+    void Simulation::lightSleep(uint64_t us) {
+        sleeping = true;
+        advance(us);
+        sleeping = false;
+        totals.lightSleepUs += us;
+        totals.lightSleeps++;
+    }
+
+    void Simulation::deepSleep(uint64_t us) {
+        sleeping = true;
+        advance(us);
+        sleeping = false;
+        totals.deepSleepUs += us;
+
+        // the ROM and the bootloader run before the firmware
+        advance(PowerModel::BOOT_US);
+        totals.boots++;
+        cause = hal::WAKEUP_TIMER;
+        std::longjmp(boot, 1);
+    }
+
+    uint32_t Simulation::transmit(size_t phySize, bool join, bool& heard) {
+        uint32_t airtimeUs = networkModel.timeOnAirUs(phySize);
+        // EU868 1 %: the band is quiet for 99 times the time on air
+        if (totals.joins + totals.uplinks > 0 && now < lastTransmitUs + lastAirtimeUs * 100ULL) {
+            totals.dutyCycleViolations++;
+        }
+        lastTransmitUs = now;
+        lastAirtimeUs = airtimeUs;
+        totals.airtimeUs += airtimeUs;
+        heard = networkModel.isReachable(now);
+        if (join) {
+            totals.joins++;
+            totals.joinsAccepted += heard ? 1 : 0;
+            totals.joinAirtimeUs += airtimeUs;
+        } else {
+            totals.uplinks++;
+            totals.uplinksLost += heard ? 0 : 1;
+        }
+        return airtimeUs;
+    }
+
+    void Simulation::deliver(uint8_t fPort, const uint8_t* payload, size_t size) {
+        if (fPort != 2) {
+            return;
+        }
+        Sample samples[UINT8_MAX];
+        size_t count = BatchCodec::decode(payload, size, samples, UINT8_MAX);
+        for (size_t i = 0; i < count; i++) {
+            // the newest was taken about when it was sent
+            uint64_t ageUs = (count - 1 - i) * static_cast<uint64_t>(SAMPLE_SPACING_US);
+            Delivered sample = { now > ageUs ? now - ageUs : 0, now, samples[i].pm25 };
+            delivered.push_back(sample);
+        }
+    }
+
+    // Estimated cost of running the firmware: a task switch and a short step
+    // per wakeup at 240 MHz, entry, dispatch and exit of an interrupt, and
+    // the console at 115200 baud, 8N1
+    static const double WAKEUP_COST_US = 50;
+    static const double INTERRUPT_COST_US = 2;
+    static const double CONSOLE_BYTE_US = 10 * 1e6 / 115200;
+
+    double Simulation::averageCurrent(uint64_t consoleBytes) const {
+        const Report& r = totals;
+        if (r.simulatedUs == 0) {
+            return 0;
+        }
+        double activeUs = r.wakeups * WAKEUP_COST_US + r.tachInterrupts * INTERRUPT_COST_US +
+                          consoleBytes * CONSOLE_BYTE_US +
+                          static_cast<double>(r.boots - 1) * PowerModel::BOOT_US +
+                          static_cast<double>(r.lightSleeps) * PowerModel::SLEEP_EXIT_US;
+        double idleUs = static_cast<double>(r.simulatedUs) - r.lightSleepUs - r.deepSleepUs - activeUs;
+        double charge = activeUs * PowerModel::CPU_ACTIVE_MA +
+                        (idleUs > 0 ? idleUs : 0) * PowerModel::CPU_IDLE_MA +
+                        r.lightSleepUs * static_cast<double>(PowerModel::LIGHT_SLEEP_MA) +
+                        r.deepSleepUs * static_cast<double>(PowerModel::DEEP_SLEEP_MA) +
+                        r.airtimeUs * static_cast<double>(PowerModel::RADIO_TX_MA) +
+                        r.heaterUs * static_cast<double>(PowerModel::HEATER_MA);
+        return charge / r.simulatedUs;
+    }
+
+    void Simulation::printReport(std::FILE* out, uint64_t consoleBytes) const {
+        const Report& r = totals;
+        double seconds = r.simulatedUs / 1e6;
+        double hours = seconds / 3600.0;
+        double awakeS = (r.wakeups * WAKEUP_COST_US + r.tachInterrupts * INTERRUPT_COST_US +
+                         consoleBytes * CONSOLE_BYTE_US) / 1e6;
+
+        std::fprintf(out, "[SIM] Scenario:              %s\n", trace.getName().c_str());
+        std::fprintf(out, "[SIM] Simulated:             %.0f s\n", seconds);
+        std::fprintf(out, "[SIM] Fan energy:            %.3f Wh (%.3f W average)\n",
+                     r.fanEnergyWh, hours > 0 ? r.fanEnergyWh / hours : 0);
+        std::fprintf(out, "[SIM] PM2.5 exposure:        %.1f ug/m3*h (%.1f unpurified)\n",
+                     r.pm25Exposure, r.unpurifiedExposure);
+        for (int i = 0; i < Report::THRESHOLD_COUNT; i++) {
+            std::fprintf(out, "[SIM] PM2.5 above %2.0f ug/m3:   %.0f s (%.0f unpurified)\n",
+                         Report::PM25_THRESHOLDS[i], r.aboveUs[i] / 1e6, r.unpurifiedAboveUs[i] / 1e6);
+        }
+        std::fprintf(out, "[SIM] Joins / uplinks:       %u / %u\n", r.joins, r.uplinks);
+        std::fprintf(out, "[SIM] Join requests:         %u accepted, %.3f s airtime\n", r.joinsAccepted,
+                     r.joinAirtimeUs / 1e6);
+        if (networkModel.hasOutages()) {
+            std::fprintf(out, "[SIM] Gateway outages:       %.0f s, %u uplinks lost\n",
+                         networkModel.getOutageUs(r.simulatedUs) / 1e6, r.uplinksLost);
+        }
+        std::fprintf(out, "[SIM] Radio airtime:         %.3f s\n", r.airtimeUs / 1e6);
+        double days = seconds / 86400.0;
+        std::fprintf(out, "[SIM] Uplinks per day:       %.0f, %.1f s airtime/day (TTN fair use 30 s), %u duty cycle violations\n",
+                     days > 0 ? r.uplinks / days : 0, days > 0 ? r.airtimeUs / 1e6 / days : 0, r.dutyCycleViolations);
+        printNetworkView(out);
+        std::fprintf(out, "[SIM] CPU awake:             %.1f s (%.2f %%), %llu wakeups, %llu tach interrupts, "
+                          "%llu console bytes\n",
+                     awakeS, seconds > 0 ? 100.0 * awakeS / seconds : 0, static_cast<unsigned long long>(r.wakeups),
+                     static_cast<unsigned long long>(r.tachInterrupts), static_cast<unsigned long long>(consoleBytes));
+        std::fprintf(out, "[SIM] Light / deep sleep:    %.1f %% / %.1f %% of the time, %u light sleeps, %u boots\n",
+                     seconds > 0 ? 100.0 * r.lightSleepUs / r.simulatedUs : 0,
+                     seconds > 0 ? 100.0 * r.deepSleepUs / r.simulatedUs : 0, r.lightSleeps, r.boots);
+        std::fprintf(out, "[SIM] PMS5003 bytes lost:    %u (UART asleep)\n", pmsModel.getLostBytes());
+        std::fprintf(out, "[SIM] BME680 gas heater:     %.1f s on, %u gas conversions\n", r.heaterUs / 1e6,
+                     r.gasReadings);
+        for (std::map<std::string, FlashModel>::const_iterator it = partitions.begin(); it != partitions.end(); ++it) {
+            const FlashModel& flash = it->second;
+            std::fprintf(out, "[SIM] Flash %-17s%u writes, %u erases, %.0f erases/year of the most worn sector\n",
+                         (it->first + ":").c_str(), flash.getWrites(), flash.getErases(),
+                         days > 0 ? flash.getMaxSectorErases() / days * 365 : 0);
+        }
+        double current = averageCurrent(consoleBytes);
+        std::fprintf(out, "[SIM] Board charge:          %.1f mAh/day (%.2f mA average)\n", current * 24, current);
+    }
+
+    // Error of the PM2.5 the network knows against the room, over the seconds
+    // from the first arrival on
+    static const float VIEW_ERROR_THRESHOLD = 5;
+
+    void Simulation::printNetworkView(std::FILE* out) const {
+        if (delivered.empty()) {
+            std::fprintf(out, "[SIM] PM2.5 at the network:  no samples delivered\n");
+            return;
+        }
+
+        std::vector<Delivered> taken(delivered);
+        std::stable_sort(taken.begin(), taken.end(),
+                         [](const Delivered& a, const Delivered& b) { return a.sampleUs < b.sampleUs; });
+
+        size_t arrived = 0;     /** in delivered, by arrival */
+        size_t before = 0;      /** in taken, by sample time */
+        int live = -1;
+        uint64_t liveSampleUs = 0;
+        double liveError = 0, afterError = 0;
+        uint32_t liveOff = 0, afterOff = 0, seconds = 0;
+        for (size_t t = delivered[0].arrivalUs / 1000000 + 1; t < roomPm25.size(); t++) {
+            uint64_t us = t * 1000000ULL;
+            // live: the newest sample of everything that has arrived
+            while (arrived < delivered.size() && delivered[arrived].arrivalUs <= us) {
+                if (live < 0 || delivered[arrived].sampleUs >= liveSampleUs) {
+                    live = delivered[arrived].pm25;
+                    liveSampleUs = delivered[arrived].sampleUs;
+                }
+                arrived++;
+            }
+            // afterwards: the last sample taken before
+            while (before + 1 < taken.size() && taken[before + 1].sampleUs <= us) {
+                before++;
+            }
+
+            float liveDiff = std::fabs(live - roomPm25[t]);
+            float afterDiff = std::fabs(taken[before].pm25 - roomPm25[t]);
+            liveError += liveDiff;
+            afterError += afterDiff;
+            liveOff += liveDiff > VIEW_ERROR_THRESHOLD ? 1 : 0;
+            afterOff += afterDiff > VIEW_ERROR_THRESHOLD ? 1 : 0;
+            seconds++;
+        }
+
+        std::fprintf(out, "[SIM] PM2.5 at the network:  %zu samples; live %.2f ug/m3 off (%.1f %% of the time by > %.0f), "
+                          "afterwards %.2f (%.1f %%)\n",
+                     delivered.size(), seconds > 0 ? liveError / seconds : 0, seconds > 0 ? 100.0 * liveOff / seconds : 0,
+                     VIEW_ERROR_THRESHOLD, seconds > 0 ? afterError / seconds : 0,
+                     seconds > 0 ? 100.0 * afterOff / seconds : 0);
+    }
+
+    hal::SerialPort& Simulation::port(uint8_t number) {
+        if (number == 2) {
+            return pmsModel;
+        }
+        return nullPort;
+    }
+
+    void Simulation::pwmWrite(int pin, uint8_t duty) {
+        if (pin == fanPwmPin) {
+            fanModel.setDuty(duty);
+        }
+    }
+
+    void Simulation::attachFallingEdge(int pin, hal::EdgeHandler handler, void* arg) {
+        if (pin == fanTachPin) {
+            tachHandler = handler;
+            tachArg = arg;
+        }
+    }
+
+    void Simulation::listenTach(TachListener listener, void* arg) {
+        std::pair<TachListener, void*> entry(listener, arg);
+        for (size_t i = 0; i < tachListeners.size(); i++) {
+            if (tachListeners[i] == entry) {
+                return;
+            }
+        }
+        tachListeners.push_back(entry);
+    }
+
+    void Simulation::tachEdge(uint32_t lowUs) {
+        // the APB clock of the peripherals stops in light sleep as well
+        if (sleeping) {
+            return;
+        }
+        if (tachHandler != nullptr) {
+            tachInterrupt();
+            tachHandler(tachArg);
+        }
+        for (size_t i = 0; i < tachListeners.size(); i++) {
+            tachListeners[i].first(tachListeners[i].second, lowUs);
+        }
+    }
+
+}
+}
+
+#endif
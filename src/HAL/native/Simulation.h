@@ -0,0 +1,406 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#if !defined(ESP32)
+
+#include <cstddef>
+#include <cstdint>
+#include <csetjmp>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../Hal.h"
+#include "Scenario.h"
+
+namespace SmartAirControl {
+namespace sim {
+
+    // Room air as seen by the simulated sensors
+    struct Air {
+        float temperature;   /** Temperature in degrees celsius */
+        float humidity;      /** Relative humidity in % */
+        float pressure;      /** Pressure in hPa */
+        float gasResistance; /** BME680 gas resistance in KOhms */
+        float pm10;          /** PM1.0 in ug/m3 */
+        float pm25;          /** PM2.5 in ug/m3 */
+        float pm100;         /** PM10 in ug/m3 */
+    };
+
+    // PWM fan with a tach output: duty -> speed from the measured table of
+    // the real fan (including its drop at full duty), first order lag
+    class FanModel {
+        public:
+            static const int PULSES_PER_REVOLUTION = 2;
+            static const float MAX_RPM;
+            static const float MAX_POWER_W;
+
+            FanModel();
+
+            void setDuty(uint8_t duty) { this->duty = duty; }
+            uint8_t getDuty() const { return duty; }
+            float getRpm() const { return rpm; }
+            // The tach output is low for half of a pulse period
+            float getLowUs() const { return rpm > 0 ? 60e6f / (rpm * PULSES_PER_REVOLUTION) / 2 : 0; }
+
+            // Steady state speed for a duty cycle
+            static float steadyRpm(uint8_t duty);
+            // Electrical power at a speed: fan laws, P ~ n^3
+            static float power(float rpm);
+
+            // Turns the rotor forward from nowUs towards toUs. Stops early at
+            // the next tach edge: returns true and sets nowUs to its time.
+            bool advance(uint64_t& nowUs, uint64_t toUs);
+
+        private:
+            static const float TIME_CONSTANT_S;
+
+            uint8_t duty;
+            float rpm;
+            float phase; /** fraction of the way to the next tach edge */
+    };
+
+    // PMS5003 in active mode: a 32 byte frame every second, the first once
+    // the fan has spun up after power on, into a UART buffer of the size the
+    // ESP32 core uses, excess bytes are lost like on hardware.
+    //
+    // The sensor counts the particles in a small volume of air per frame:
+    // successive frames in steady air scatter by NOISE_RELATIVE of the
+    // concentration plus NOISE_ABSOLUTE ug/m3 (standard deviations), and
+    // about every SPIKE_PERIOD frames a large particle or an insect in the
+    // beam makes one read SPIKE_FACTOR times high.
+    class PmsModel : public hal::SerialPort {
+        public:
+            static const uint32_t FRAME_PERIOD_US = 1000000;
+            static const uint32_t STARTUP_US = 2500000;
+            static const size_t RX_BUFFER_SIZE = 256;
+            static const float NOISE_RELATIVE;
+            static const float NOISE_ABSOLUTE;
+            static const uint32_t SPIKE_PERIOD = 300;
+            static const float SPIKE_FACTOR;
+
+            PmsModel();
+
+            void begin(unsigned long baud, uint32_t config, int8_t rxPin, int8_t txPin) override;
+            int available() override;
+            int read() override;
+            size_t write(const uint8_t* buffer, size_t size) override;
+
+            // Frames keep coming while the UART does not listen (light
+            // sleep), their bytes are lost
+            void advance(uint64_t nowUs, const Air& air, bool listening);
+            uint32_t getLostBytes() const { return lost; }
+
+        private:
+            void receive(const uint8_t* data, size_t size);
+            // Standard normal, from a fixed seed: every run sees the same noise
+            float gaussian();
+
+            bool open;
+            uint32_t lost;
+            uint64_t nextFrameUs;
+            uint8_t rx[RX_BUFFER_SIZE];
+            size_t head;
+            size_t count;
+            uint32_t seed;
+    };
+
+    // Well mixed room. The scenario gives the concentrations without the
+    // purifier; the purifier removes particles at its clean air delivery
+    // rate (CADR, proportional to fan speed) on top of ventilation and
+    // deposition. For the difference D between the unpurified and the
+    // purified concentration C0 - C that gives
+    //  dD/dt = (CADR/V) C0 - (lambda + CADR/V) D
+    // which is integrated exactly over each step.
+    class RoomModel {
+        public:
+            static const float VOLUME_M3;
+            static const float AIR_CHANGES_PER_HOUR; /** ventilation and deposition */
+            static const float MAX_CADR_M3_PER_HOUR; /** at the fan's top speed */
+
+            RoomModel();
+
+            void advance(double dtS, float fanRpm, const Air& unpurified, Air& air);
+
+        private:
+            float reduction[3]; /** D for PM1.0, PM2.5, PM10 */
+    };
+
+    // What a run cost and achieved, accumulated while the clock advances
+    struct Report {
+        static const int THRESHOLD_COUNT = 2;
+        static const float PM25_THRESHOLDS[THRESHOLD_COUNT]; /** WHO and EPA 24 h levels in ug/m3 */
+
+        Report();
+
+        uint64_t simulatedUs;
+        double fanEnergyWh;
+        double pm25Exposure;                         /** integral of PM2.5 in ug/m3 * h */
+        double unpurifiedExposure;                   /** the same without the purifier */
+        uint64_t aboveUs[THRESHOLD_COUNT];           /** time PM2.5 spent above each threshold */
+        uint64_t unpurifiedAboveUs[THRESHOLD_COUNT];
+        uint32_t joins;                              /** join requests */
+        uint32_t joinsAccepted;
+        uint32_t uplinks;
+        uint32_t uplinksLost;                        /** sent while the gateways were out */
+        uint64_t airtimeUs;                          /** radio transmitting */
+        uint64_t joinAirtimeUs;                      /** of that, join requests */
+        uint32_t dutyCycleViolations;                /** sent within 99 times the last time on air */
+        uint64_t wakeups;                            /** the firmware waited and resumed */
+        uint64_t tachInterrupts;                     /** GPIO or capture interrupts of tach edges */
+        uint64_t lightSleepUs;
+        uint64_t deepSleepUs;
+        uint32_t lightSleeps;
+        uint32_t boots;                              /** including the first */
+        uint64_t heaterUs;                           /** BME680 gas heater on */
+        uint32_t gasReadings;                        /** BME680 conversions with the heater on */
+    };
+
+    // Supply current of the controller board in each state, for the charge
+    // estimate of the report. ESP32 at 240 MHz with WiFi/BT off (datasheet
+    // ranges, upper half), SX1262 at +14 dBm, BME680 gas heater. The PMS5003
+    // (about 100 mA while its fan runs) and the purifier fan are not switched
+    // by the firmware and not included.
+    struct PowerModel {
+        static const float CPU_ACTIVE_MA;    /** running code */
+        static const float CPU_IDLE_MA;      /** awake, waiting in the idle task */
+        static const float LIGHT_SLEEP_MA;
+        static const float DEEP_SLEEP_MA;    /** RTC timer and memory */
+        static const float RADIO_TX_MA;
+        static const float HEATER_MA;
+        static const uint32_t BOOT_US;       /** ROM and bootloader after a deep sleep */
+        static const uint32_t SLEEP_EXIT_US; /** light sleep entry and exit, at CPU_ACTIVE_MA */
+    };
+
+    // LoRaWAN as the node sees it: EU868 at a fixed data rate, every join is
+    // accepted and downlinks arrive only when scheduled (e.g. commands from
+    // the command line). In a gateway outage nothing the node sends is heard:
+    // join requests get no accept and uplinks are lost. Only time on air is accounted, the clock does not
+    // move for a transaction: the radio has its own core on the board and
+    // the other tasks keep running meanwhile.
+    class NetworkModel {
+        public:
+            // MHDR, FHDR without options, FPort and MIC around the payload
+            static const size_t UPLINK_OVERHEAD = 13;
+            static const size_t JOIN_REQUEST_SIZE = 23;
+
+            NetworkModel();
+
+            void setDataRate(uint8_t dataRate) { this->dataRate = dataRate; }
+            uint8_t getDataRate() const { return dataRate; }
+            // Largest application payload at the data rate
+            uint8_t getMaxPayload() const;
+
+            // LoRa time on air of a PHY payload at the data rate (BW 125 kHz, CR 4/5)
+            uint32_t timeOnAirUs(size_t phySize) const;
+
+            // The network queues a downlink at atUs, it goes out in the RX
+            // window of the next uplink
+            void scheduleDownlink(uint64_t atUs, uint8_t fPort, const std::vector<uint8_t>& payload);
+            // The oldest downlink queued by nowUs, false if there is none
+            bool takeDownlink(uint64_t nowUs, uint8_t& fPort, std::vector<uint8_t>& payload);
+
+            // No gateway hears the node from fromUs for durationUs
+            void addOutage(uint64_t fromUs, uint64_t durationUs);
+            bool isReachable(uint64_t nowUs) const;
+            // Time the gateways were out before untilUs
+            uint64_t getOutageUs(uint64_t untilUs) const;
+            bool hasOutages() const { return !outages.empty(); }
+
+        private:
+            struct Downlink {
+                uint64_t atUs;
+                uint8_t fPort;
+                std::vector<uint8_t> payload;
+            };
+
+            struct Outage {
+                uint64_t fromUs;
+                uint64_t untilUs;
+            };
+
+            uint8_t dataRate;
+            std::vector<Downlink> downlinks; /** by atUs */
+            std::vector<Outage> outages;
+    };
+
+    // NOR flash partition: erased bytes read 0xFF, programming ANDs the data
+    // in, an erase resets a whole sector. Counts the erases per sector for
+    // the wear estimate. cutPowerAfter() stops the flash in the middle of an
+    // operation, as a power loss would: a write programs its first bytes
+    // only, an erase resets the start of the sector only.
+    class FlashModel {
+        public:
+            static const size_t SIZE = 4 * hal::Flash::SECTOR_SIZE; /** the session partition of partitions.csv */
+
+            FlashModel();
+
+            size_t size() const { return bytes.size(); }
+            bool read(size_t offset, void* buffer, size_t size) const;
+            bool write(size_t offset, const void* data, size_t size);
+            bool eraseSector(size_t sector);
+
+            // Every operation fails once bytes more have been programmed or
+            // erased, until restorePower()
+            void cutPowerAfter(size_t bytes);
+            void restorePower();
+            bool isPowered() const { return powered; }
+
+            uint32_t getWrites() const { return writes; }
+            uint32_t getErases() const { return erases; }
+            uint32_t getMaxSectorErases() const;
+
+        private:
+            // Bytes of the operation that get done before the power is gone
+            size_t budget(size_t size);
+
+            std::vector<uint8_t> bytes;
+            std::vector<uint32_t> sectorErases;
+            uint32_t writes;
+            uint32_t erases;
+            bool powered;
+            bool cutting;
+            size_t remaining;
+    };
+
+    // Serial port with nothing attached
+    class NullPort : public hal::SerialPort {
+        public:
+            void begin(unsigned long, uint32_t, int8_t, int8_t) override {}
+            int available() override { return 0; }
+            int read() override { return -1; }
+            size_t write(const uint8_t*, size_t size) override { return size; }
+    };
+
+    // Everything the native HAL runs on: the virtual clock, the devices behind
+    // the pins and UARTs, the room air replayed from a scenario, the LoRaWAN
+    // network and the NVS contents. Time only moves when the firmware waits
+    // (hal::delay), so a day of operation takes as long as the firmware needs
+    // to compute it. Energy, exposure and airtime add up in report().
+    class Simulation {
+        public:
+            // Device models are stepped at least this often
+            static const uint32_t STEP_US = 10000;
+
+            static Simulation& get();
+
+            uint64_t nowUs() const { return now; }
+            void advance(uint64_t us);
+            void advanceTo(uint64_t us);
+
+            // Loads the room conditions to replay, see Scenario
+            bool loadScenario(const std::string& nameOrPath);
+            const Scenario& scenario() const { return trace; }
+
+            Air& air() { return room; }
+            FanModel& fan() { return fanModel; }
+            PmsModel& pms() { return pmsModel; }
+            hal::SerialPort& port(uint8_t number);
+
+            void pwmWrite(int pin, uint8_t duty);
+            // The GPIO interrupt of the tach pin (hal::attachFallingEdge)
+            void attachFallingEdge(int pin, hal::EdgeHandler handler, void* arg);
+            // Peripherals that watch the tach pin besides the GPIO interrupt,
+            // the pulse counter and the capture unit (HAL/native/Drivers.cpp):
+            // told of every falling edge and how long the line then stays low
+            typedef void (*TachListener)(void* arg, uint32_t lowUs);
+            void listenTach(TachListener listener, void* arg);
+            // A falling edge on the tach pin now, low for lowUs. The fan
+            // model makes them; tests add glitches or whole edge timelines.
+            void tachEdge(uint32_t lowUs);
+            // An interrupt handler ran for a tach edge
+            void tachInterrupt() { totals.tachInterrupts++; }
+
+            NetworkModel& network() { return networkModel; }
+            // Books a join request or uplink of phySize bytes; heard is
+            // false if no gateway was in reach
+            uint32_t transmit(size_t phySize, bool join, bool& heard);
+            // Application payload of an uplink as the network server gets
+            // it; sample batches (fPort 2) feed the network view of PM2.5
+            void deliver(uint8_t fPort, const uint8_t* payload, size_t size);
+
+            std::map<std::string, std::vector<uint8_t> >& nvs() { return storage; }
+            // Raw partition by label, blank at the start of the run
+            FlashModel& flash(const std::string& label) { return partitions[label]; }
+
+            // The firmware waits (hal::delay) and resumes
+            void wakeup() { totals.wakeups++; }
+
+            // hal::lightSleep: the clock moves on, the CPU does not see tach
+            // edges or UART bytes meanwhile
+            void lightSleep(uint64_t us);
+            // hal::deepSleep: the clock moves on, then the firmware boots
+            // again by a longjmp to bootPoint(), set by main() before setup()
+            [[noreturn]] void deepSleep(uint64_t us);
+            std::jmp_buf& bootPoint() { return boot; }
+            hal::WakeupCause wakeupCause() const { return cause; }
+
+            // The BME680 heats its gas plate for ms
+            void heat(uint32_t ms) {
+                totals.heaterUs += ms * 1000ULL;
+                totals.gasReadings++;
+            }
+
+            const Report& report() const { return totals; }
+            // Human readable summary; consoleBytes is what went to the UART
+            void printReport(std::FILE* out, uint64_t consoleBytes) const;
+            // Average supply current of the board from the report, in mA
+            double averageCurrent(uint64_t consoleBytes) const;
+
+            // Pins the models are wired to, as on the board
+            int fanPwmPin;
+            int fanTachPin;
+
+        private:
+            // The batches carry no timestamps: the network places their
+            // samples back from the arrival at the spacing the firmware
+            // queues them (SAMPLE_INTERVAL_MS in main.cpp)
+            static const uint32_t SAMPLE_SPACING_US = 10000000;
+
+            // A sample the network received
+            struct Delivered {
+                uint64_t sampleUs;  /** when it was taken, as the network places it */
+                uint64_t arrivalUs;
+                uint16_t pm25;
+            };
+
+            Simulation();
+
+            // How well the delivered samples describe the room PM2.5: live
+            // from what has arrived so far, and afterwards from all of them
+            void printNetworkView(std::FILE* out) const;
+
+            hal::EdgeHandler tachHandler;
+            void* tachArg;
+            std::vector<std::pair<TachListener, void*> > tachListeners;
+
+            void accumulate(uint64_t dtUs);
+
+            uint64_t now;
+            bool sleeping;
+            hal::WakeupCause cause;
+            std::jmp_buf boot;
+            Scenario trace;
+            Air unpurified;
+            Air room;
+            RoomModel roomModel;
+            FanModel fanModel;
+            PmsModel pmsModel;
+            NetworkModel networkModel;
+            Report totals;
+            uint64_t lastTransmitUs;
+            uint32_t lastAirtimeUs;
+            std::vector<Delivered> delivered;
+            std::vector<float> roomPm25; /** every second */
+            NullPort nullPort;
+            std::map<std::string, std::vector<uint8_t> > storage;
+            std::map<std::string, FlashModel> partitions;
+    };
+
+}
+}
+
+#endif
+
+#endif // SIMULATION_H
@@ -0,0 +1,56 @@
+#ifndef ADAFRUIT_BME680_H
+#define ADAFRUIT_BME680_H
+
+// Native build: same interface as the Adafruit driver, the readings come from
+// the simulated room air (HAL/native/Simulation.h) on the virtual clock.
+#include <Arduino.h>
+
+#define BME680_OS_NONE 0
+#define BME680_OS_1X 1
+#define BME680_OS_2X 2
+#define BME680_OS_4X 3
+#define BME680_OS_8X 4
+#define BME680_OS_16X 5
+
+#define BME680_FILTER_SIZE_0 0
+#define BME680_FILTER_SIZE_1 1
+#define BME680_FILTER_SIZE_3 2
+#define BME680_FILTER_SIZE_7 3
+#define BME680_FILTER_SIZE_15 4
+#define BME680_FILTER_SIZE_31 5
+#define BME680_FILTER_SIZE_63 6
+#define BME680_FILTER_SIZE_127 7
+
+class Adafruit_BME680 {
+    public:
+        Adafruit_BME680();
+
+        bool begin(uint8_t addr = 0x77, bool initSettings = true);
+        bool setTemperatureOversampling(uint8_t os);
+        bool setHumidityOversampling(uint8_t os);
+        bool setPressureOversampling(uint8_t os);
+        bool setIIRFilterSize(uint8_t fs);
+        bool setGasHeater(uint16_t heaterTemp, uint16_t heaterTime);
+
+        // millis() when the reading is ready, 0 on failure
+        unsigned long beginReading();
+        // Waits for the rest of the conversion on the virtual clock
+        bool endReading();
+        bool performReading();
+        // Both start and wait for a conversion of their own
+        float readPressure();
+        float readAltitude(float seaLevel);
+
+        float temperature;
+        uint32_t pressure;
+        float humidity;
+        uint32_t gas_resistance;
+
+    private:
+        uint16_t heaterTime;
+        unsigned long readyAt;
+        unsigned long heatedUntil;  /** millis() when the plate was last heated */
+        unsigned heatedCycles;      /** back-to-back heating cycles since the plate was cold */
+};
+
+#endif // ADAFRUIT_BME680_H
@@ -0,0 +1,17 @@
+#ifndef ADAFRUIT_PM25AQI_H
+#define ADAFRUIT_PM25AQI_H
+
+// Native build: only the frame layout of the Adafruit library is needed,
+// PMSParser decodes the UART stream itself.
+#include <Arduino.h>
+
+typedef struct PMSAQIdata {
+    uint16_t framelen;
+    uint16_t pm10_standard, pm25_standard, pm100_standard;
+    uint16_t pm10_env, pm25_env, pm100_env;
+    uint16_t particles_03um, particles_05um, particles_10um, particles_25um, particles_50um, particles_100um;
+    uint16_t unused;
+    uint16_t checksum;
+} PM25_AQI_Data;
+
+#endif // ADAFRUIT_PM25AQI_H
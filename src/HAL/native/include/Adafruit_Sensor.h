@@ -0,0 +1,7 @@
+#ifndef ADAFRUIT_SENSOR_H
+#define ADAFRUIT_SENSOR_H
+
+// Native build: only here so the sensor includes resolve
+#include <Arduino.h>
+
+#endif // ADAFRUIT_SENSOR_H
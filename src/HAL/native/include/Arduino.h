@@ -0,0 +1,98 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+// Native build: the Arduino core is not available, this only provides the
+// console (Serial, F()) and the few types the drivers share with it. Time,
+// GPIO, interrupts, UARTs and NVS go through HAL/Hal.h instead.
+
+#include <cmath>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/types.h>
+#include "esp_attr.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define DEC 10
+#define HEX 16
+
+enum SerialConfig {
+    SERIAL_8N1 = 0x800001c
+};
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper*>(string_literal))
+
+// Console output, everything ends up in write()
+class Print {
+    public:
+        virtual ~Print() {}
+
+        virtual size_t write(const char* text, size_t size) = 0;
+
+        size_t print(const __FlashStringHelper* text) { return print(reinterpret_cast<const char*>(text)); }
+        size_t print(const char* text) { return write(text, std::strlen(text)); }
+        size_t print(char c) { return write(&c, 1); }
+        size_t print(unsigned char value, int base = DEC) { return print(static_cast<unsigned long>(value), base); }
+        size_t print(int value, int base = DEC) { return print(static_cast<long>(value), base); }
+        size_t print(unsigned int value, int base = DEC) { return print(static_cast<unsigned long>(value), base); }
+        size_t print(long value, int base = DEC) {
+            return base == DEC ? printf("%ld", value) : print(static_cast<unsigned long>(value), base);
+        }
+        size_t print(unsigned long value, int base = DEC) { return printf(base == HEX ? "%lX" : "%lu", value); }
+        size_t print(double value, int digits = 2) { return printf("%.*f", digits, value); }
+
+        template <typename T>
+        size_t println(T value) { return print(value) + println(); }
+        template <typename T>
+        size_t println(T value, int format) { return print(value, format) + println(); }
+        size_t println() { return print('\n'); }
+
+        size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+inline size_t Print::printf(const char* format, ...) {
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    int length = std::vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (length <= 0) {
+        return 0;
+    }
+    return write(buffer, static_cast<size_t>(length) < sizeof(buffer) ? length : sizeof(buffer) - 1);
+}
+
+// Console on stdout. Counts what the firmware prints, on the board every
+// byte costs UART time; echo can be turned off for long simulations.
+class Console : public Print {
+    public:
+        Console() : echo(true), written(0) {}
+
+        void begin(unsigned long baud) { (void)baud; }
+        operator bool() const { return true; }
+
+        size_t write(const char* text, size_t size) override {
+            written += size;
+            if (echo) {
+                std::fwrite(text, 1, size, stdout);
+            }
+            return size;
+        }
+
+        void setEcho(bool echo) { this->echo = echo; }
+        uint64_t getWritten() const { return written; }
+
+    private:
+        bool echo;
+        uint64_t written;
+};
+
+extern Console Serial;
+
+#endif // ARDUINO_H
@@ -0,0 +1,40 @@
+#ifndef PREFERENCES_H
+#define PREFERENCES_H
+
+// Native build: the ESP32 Preferences API over hal::Nvs, for code that still
+// talks to the store directly (LoRa/LoRAWAN.hpp)
+#include <Arduino.h>
+#include "../../Hal.h"
+
+class Preferences {
+    public:
+        Preferences() : store(nullptr) {}
+        ~Preferences() { end(); }
+
+        bool begin(const char* name, bool readOnly = false) {
+            end();
+            store = new SmartAirControl::hal::Nvs(name, readOnly);
+            return true;
+        }
+
+        void end() {
+            delete store;
+            store = nullptr;
+        }
+
+        bool isKey(const char* key) { return store != nullptr && store->isKey(key); }
+        size_t getBytes(const char* key, void* buffer, size_t size) {
+            return store != nullptr ? store->getBytes(key, buffer, size) : 0;
+        }
+        size_t putBytes(const char* key, const void* buffer, size_t size) {
+            return store != nullptr ? store->putBytes(key, buffer, size) : 0;
+        }
+
+    private:
+        Preferences(const Preferences&);
+        Preferences& operator=(const Preferences&);
+
+        SmartAirControl::hal::Nvs* store;
+};
+
+#endif // PREFERENCES_H
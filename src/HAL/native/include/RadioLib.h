@@ -0,0 +1,127 @@
+#ifndef RADIOLIB_H
+#define RADIOLIB_H
+
+// Native build: the part of the RadioLib API that LoRa/LoRAWAN.hpp uses, on
+// top of the simulated network (HAL/native/Simulation.h). The node joins,
+// counts frames and books time on air; there is no radio underneath.
+#include <Arduino.h>
+
+#define RADIOLIB_ERR_NONE 0
+#define RADIOLIB_ERR_UNKNOWN -1
+#define RADIOLIB_ERR_NETWORK_NOT_JOINED -1101
+#define RADIOLIB_ERR_NO_JOIN_ACCEPT -1115
+#define RADIOLIB_LORAWAN_NO_DOWNLINK -1116
+#define RADIOLIB_LORAWAN_SESSION_RESTORED -1117
+#define RADIOLIB_LORAWAN_NEW_SESSION -1118
+#define RADIOLIB_ERR_NONCES_DISCARDED -1119
+#define RADIOLIB_ERR_SESSION_DISCARDED -1120
+#define RADIOLIB_ERR_INVALID_PAYLOAD -1121
+
+#define RADIOLIB_LORAWAN_DATA_RATE_UNUSED 0xFF
+#define RADIOLIB_LORAWAN_NONCES_BUF_SIZE 16
+#define RADIOLIB_LORAWAN_SESSION_BUF_SIZE 304
+
+// where the session buffer keeps the frame counters and its signature; the
+// names are RadioLib's, the layout (magic, FCntUp, JoinNonce, NFCntDown,
+// AFCntDown) is the simulation's own
+#define RADIOLIB_LORAWAN_SESSION_FCNT_UP 4
+#define RADIOLIB_LORAWAN_SESSION_N_FCNT_DOWN 12
+#define RADIOLIB_LORAWAN_SESSION_A_FCNT_DOWN 16
+#define RADIOLIB_LORAWAN_SESSION_SIGNATURE (RADIOLIB_LORAWAN_SESSION_BUF_SIZE - 2)
+
+#define RADIOLIB_LORAWAN_MAC_LINK_CHECK 0x02
+#define RADIOLIB_LORAWAN_MAC_DEVICE_TIME 0x0D
+
+typedef uint32_t RadioLibTime_t;
+
+class Module {
+    public:
+        Module(uint32_t cs, uint32_t irq, uint32_t rst, uint32_t gpio);
+};
+
+class PhysicalLayer {
+    public:
+        virtual ~PhysicalLayer() {}
+};
+
+class SX1262 : public PhysicalLayer {
+    public:
+        explicit SX1262(Module* module);
+        ~SX1262();
+
+        int16_t begin();
+        int16_t sleep();
+        float getRSSI();
+        float getSNR();
+
+    private:
+        SX1262(const SX1262&);
+        SX1262& operator=(const SX1262&);
+
+        Module* module;
+};
+
+struct LoRaWANBand_t {
+    const char* name;
+};
+
+extern const LoRaWANBand_t EU868;
+
+struct LoRaWANEvent_t {
+    uint8_t dir;
+    bool confirmed;
+    bool confirming;
+    uint8_t datarate;
+    float freq;
+    int16_t power;
+    uint32_t fCnt;
+    uint8_t fPort;
+    bool frmPending;
+    bool multicast;
+    uint8_t nbTrans;
+};
+
+struct LoRaWANJoinEvent_t {
+    bool newSession;
+    uint16_t devNonce;
+    uint32_t joinNonce;
+};
+
+class LoRaWANNode {
+    public:
+        LoRaWANNode(PhysicalLayer* phy, const LoRaWANBand_t* band, uint8_t subBand = 0);
+
+        int16_t beginOTAA(uint64_t joinEUI, uint64_t devEUI, uint8_t* nwkKey, uint8_t* appKey);
+
+        int16_t setBufferNonces(const uint8_t* persistentBuffer);
+        uint8_t* getBufferNonces();
+        int16_t setBufferSession(const uint8_t* persistentBuffer);
+        uint8_t* getBufferSession();
+
+        int16_t activateOTAA(uint8_t initialDr, LoRaWANJoinEvent_t* joinEvent);
+
+        // Returns the RX window a downlink arrived in, 0 if none did
+        int16_t sendReceive(const uint8_t* dataUp, size_t lenUp, uint8_t fPort, uint8_t* dataDown, size_t* lenDown,
+                            bool isConfirmed, LoRaWANEvent_t* eventUp, LoRaWANEvent_t* eventDown);
+
+        uint32_t getFCntUp();
+        int16_t sendMacCommandReq(uint8_t cid);
+        RadioLibTime_t getLastToA();
+        int16_t getMacLinkCheckAns(uint8_t* margin, uint8_t* gwCnt);
+        int16_t getMacDeviceTimeAns(uint32_t* gpsEpoch, uint8_t* fraction, bool returnUnix);
+        uint8_t getMaxPayloadLen();
+
+    private:
+        bool active;
+        bool restored;
+        uint16_t devNonce;
+        uint32_t joinNonce;
+        uint32_t fCntUp;
+        uint32_t nFCntDown;
+        uint32_t aFCntDown;
+        RadioLibTime_t lastToA;
+        uint8_t nonces[RADIOLIB_LORAWAN_NONCES_BUF_SIZE];
+        uint8_t session[RADIOLIB_LORAWAN_SESSION_BUF_SIZE];
+};
+
+#endif // RADIOLIB_H
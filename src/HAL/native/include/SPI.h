@@ -0,0 +1,7 @@
+#ifndef SPI_H
+#define SPI_H
+
+// Native build: the bus is simulated inside Adafruit_BME680.h
+#include <Arduino.h>
+
+#endif // SPI_H
@@ -0,0 +1,7 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+// Native build: the bus is simulated inside Adafruit_BME680.h
+#include <Arduino.h>
+
+#endif // WIRE_H
@@ -0,0 +1,15 @@
+#ifndef DRIVER_GPIO_H
+#define DRIVER_GPIO_H
+
+// Native build: the GPIO calls the tach backends make around their
+// peripherals; the simulated tach line needs no pull-up
+#include "esp_err.h"
+
+typedef int gpio_num_t;
+
+inline esp_err_t gpio_pullup_en(gpio_num_t gpio) {
+    (void)gpio;
+    return ESP_OK;
+}
+
+#endif // DRIVER_GPIO_H
@@ -0,0 +1,57 @@
+#ifndef DRIVER_MCPWM_H
+#define DRIVER_MCPWM_H
+
+// Native build: the MCPWM capture API that Fan/CaptureTach.cpp uses, on
+// the simulated tach line (HAL/native/Drivers.cpp). Capture channel 0 of a
+// unit latches its 80 MHz timer at every cap_prescale-th falling edge of
+// its pin and calls back at once, in interrupt context; the PWM operators
+// and the rising edge are not modelled.
+#include <cstdint>
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+typedef enum {
+    MCPWM_UNIT_0,
+    MCPWM_UNIT_1,
+    MCPWM_UNIT_MAX
+} mcpwm_unit_t;
+
+typedef enum {
+    MCPWM_CAP_0 = 6,
+    MCPWM_CAP_1,
+    MCPWM_CAP_2
+} mcpwm_io_signals_t;
+
+typedef enum {
+    MCPWM_SELECT_CAP0,
+    MCPWM_SELECT_CAP1,
+    MCPWM_SELECT_CAP2
+} mcpwm_capture_channel_id_t;
+
+typedef enum {
+    MCPWM_NEG_EDGE = 1,
+    MCPWM_POS_EDGE = 2,
+    MCPWM_BOTH_EDGE = 3
+} mcpwm_capture_on_edge_t;
+
+typedef struct {
+    mcpwm_capture_on_edge_t cap_edge;
+    uint32_t cap_value;
+} cap_event_data_t;
+
+typedef bool (*cap_isr_cb_t)(mcpwm_unit_t mcpwm, mcpwm_capture_channel_id_t cap_channel,
+                             const cap_event_data_t* edata, void* user_data);
+
+typedef struct {
+    mcpwm_capture_on_edge_t cap_edge;
+    uint32_t cap_prescale;
+    cap_isr_cb_t capture_cb;
+    void* user_data;
+} mcpwm_capture_config_t;
+
+esp_err_t mcpwm_gpio_init(mcpwm_unit_t unit, mcpwm_io_signals_t signal, int gpio);
+esp_err_t mcpwm_capture_enable_channel(mcpwm_unit_t unit, mcpwm_capture_channel_id_t channel,
+                                       const mcpwm_capture_config_t* config);
+esp_err_t mcpwm_capture_disable_channel(mcpwm_unit_t unit, mcpwm_capture_channel_id_t channel);
+
+#endif // DRIVER_MCPWM_H
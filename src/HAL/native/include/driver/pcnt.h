@@ -0,0 +1,70 @@
+#ifndef DRIVER_PCNT_H
+#define DRIVER_PCNT_H
+
+// Native build: the ESP-IDF pulse counter (PCNT) API that Fan/PcntTach.cpp
+// uses, on the simulated tach line (HAL/native/Drivers.cpp). A unit counts
+// the falling edges of its pin whose low phase outlasts the glitch filter
+// and starts over at 0 when it reaches the high limit; control pins, the
+// rising edge and the low limit are not modelled.
+#include <cstdint>
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+typedef enum {
+    PCNT_UNIT_0,
+    PCNT_UNIT_1,
+    PCNT_UNIT_2,
+    PCNT_UNIT_3,
+    PCNT_UNIT_4,
+    PCNT_UNIT_5,
+    PCNT_UNIT_6,
+    PCNT_UNIT_7,
+    PCNT_UNIT_MAX
+} pcnt_unit_t;
+
+typedef enum {
+    PCNT_CHANNEL_0,
+    PCNT_CHANNEL_1,
+    PCNT_CHANNEL_MAX
+} pcnt_channel_t;
+
+typedef enum {
+    PCNT_COUNT_DIS,
+    PCNT_COUNT_INC,
+    PCNT_COUNT_DEC,
+    PCNT_COUNT_MAX
+} pcnt_count_mode_t;
+
+typedef enum {
+    PCNT_MODE_KEEP,
+    PCNT_MODE_REVERSE,
+    PCNT_MODE_DISABLE,
+    PCNT_MODE_MAX
+} pcnt_ctrl_mode_t;
+
+#define PCNT_PIN_NOT_USED (-1)
+
+typedef struct {
+    int pulse_gpio_num;
+    int ctrl_gpio_num;
+    pcnt_ctrl_mode_t lctrl_mode;
+    pcnt_ctrl_mode_t hctrl_mode;
+    pcnt_count_mode_t pos_mode;
+    pcnt_count_mode_t neg_mode;
+    int16_t counter_h_lim;
+    int16_t counter_l_lim;
+    pcnt_unit_t unit;
+    pcnt_channel_t channel;
+} pcnt_config_t;
+
+esp_err_t pcnt_unit_config(const pcnt_config_t* config);
+// APB clock cycles (80 MHz), 10 bits
+esp_err_t pcnt_set_filter_value(pcnt_unit_t unit, uint16_t filterValue);
+esp_err_t pcnt_filter_enable(pcnt_unit_t unit);
+esp_err_t pcnt_filter_disable(pcnt_unit_t unit);
+esp_err_t pcnt_counter_pause(pcnt_unit_t unit);
+esp_err_t pcnt_counter_resume(pcnt_unit_t unit);
+esp_err_t pcnt_counter_clear(pcnt_unit_t unit);
+esp_err_t pcnt_get_counter_value(pcnt_unit_t unit, int16_t* count);
+
+#endif // DRIVER_PCNT_H
@@ -0,0 +1,11 @@
+#ifndef ESP_ERR_H
+#define ESP_ERR_H
+
+// Native build: the ESP-IDF error type of the driver calls
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_ARG 0x102
+
+#endif // ESP_ERR_H
@@ -0,0 +1,17 @@
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+// Native build: only the spinlocks that guard state shared with interrupt
+// handlers. The simulation is single threaded and runs handlers only while
+// the clock advances, so they lock nothing.
+typedef struct {
+    int owner;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { 0 }
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+#define portENTER_CRITICAL_ISR(mux) ((void)(mux))
+#define portEXIT_CRITICAL_ISR(mux) ((void)(mux))
+
+#endif // FREERTOS_H
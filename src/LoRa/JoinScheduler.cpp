@@ -0,0 +1,98 @@
+#include "JoinScheduler.h"
+
+namespace SmartAirControl {
+
+    JoinScheduler::JoinScheduler(uint64_t devEUI, State& state)
+        : seed(static_cast<uint32_t>(devEUI ^ (devEUI >> 32))), state(state) {
+    }
+
+    void JoinScheduler::restore(uint32_t nowMs) {
+        if (state.magic == MAGIC) {
+            return;
+        }
+        state.magic = MAGIC;
+        state.seed = seed;
+        start(nowMs);
+        state.nextMs = nowMs + random(FIRST_DELAY_MS);
+    }
+
+    void JoinScheduler::start(uint32_t nowMs) {
+        state.firstMs = nowMs;
+        state.nextMs = nowMs;
+        state.windowMs = nowMs;
+        state.windowAirtimeMs = 0;
+        state.totalAirtimeMs = 0;
+        state.attempts = 0;
+    }
+
+    uint32_t JoinScheduler::random(uint32_t range) {
+        // Numerical Recipes LCG, the high bits are the random ones
+        state.seed = state.seed * 1664525UL + 1013904223UL;
+        return range > 0 ? static_cast<uint32_t>((static_cast<uint64_t>(state.seed >> 8) * range) >> 24) : 0;
+    }
+
+    void JoinScheduler::window(uint32_t sinceFirstMs, uint32_t& startMs, uint32_t& lengthMs, uint32_t& airtimeMs) {
+        if (sinceFirstMs < HOUR_MS) {
+            startMs = 0;
+            lengthMs = HOUR_MS;
+            airtimeMs = FIRST_HOUR_AIRTIME_MS;
+        } else if (sinceFirstMs < 11 * HOUR_MS) {
+            startMs = HOUR_MS;
+            lengthMs = 10 * HOUR_MS;
+            airtimeMs = NEXT_TEN_HOURS_AIRTIME_MS;
+        } else {
+            startMs = 11 * HOUR_MS + (sinceFirstMs - 11 * HOUR_MS) / DAY_MS * DAY_MS;
+            lengthMs = DAY_MS;
+            airtimeMs = DAILY_AIRTIME_MS;
+        }
+    }
+
+    uint32_t JoinScheduler::waitMs(uint32_t nowMs) const {
+        int32_t wait = static_cast<int32_t>(state.nextMs - nowMs);
+        return wait > 0 ? wait : 0;
+    }
+
+    void JoinScheduler::attempted(uint32_t nowMs, uint32_t airtimeMs, bool joined) {
+        restore(nowMs);
+        if (joined) {
+            // a later rejoin starts at the first backoff, without the delay
+            start(nowMs);
+            return;
+        }
+        if (state.attempts == 0) {
+            start(nowMs);
+        }
+        state.attempts++;
+        state.totalAirtimeMs += airtimeMs;
+
+        uint32_t windowStartMs, windowLengthMs, windowAirtimeMs;
+        window(nowMs - state.firstMs, windowStartMs, windowLengthMs, windowAirtimeMs);
+        if (state.windowMs != state.firstMs + windowStartMs) {
+            state.windowMs = state.firstMs + windowStartMs;
+            state.windowAirtimeMs = 0;
+        }
+        state.windowAirtimeMs += airtimeMs;
+
+        // 15 s, 30 s, 1 min, ... 1 h, each from half to one and a half of it
+        uint32_t backoff = MAX_BACKOFF_MS;
+        if (state.attempts <= 8 && (FIRST_BACKOFF_MS << (state.attempts - 1)) < MAX_BACKOFF_MS) {
+            backoff = FIRST_BACKOFF_MS << (state.attempts - 1);
+        }
+        uint32_t wait = backoff / 2 + random(backoff);
+
+        uint32_t quiet = airtimeMs * DUTY_CYCLE_DIVISOR;
+        if (wait < quiet) {
+            wait = quiet;
+        }
+
+        // another request like this one does not fit into the window
+        if (state.windowAirtimeMs + airtimeMs > windowAirtimeMs) {
+            uint32_t untilNextMs = state.windowMs + windowLengthMs - nowMs;
+            if (wait < untilNextMs) {
+                wait = untilNextMs + random(backoff);
+            }
+        }
+        state.nextMs = nowMs + wait;
+    }
+
+}
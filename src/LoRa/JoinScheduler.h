@@ -0,0 +1,82 @@
+#ifndef JOIN_SCHEDULER_H
+#define JOIN_SCHEDULER_H
+
+#include <cstdint>
+
+namespace SmartAirControl {
+
+    // Decides when the next join request may go on air while the device is
+    // not joined, following the retransmission backoff of LoRaWAN TS001
+    // (1.0.4 and 1.1, section 7).
+    //
+    // The first request goes out within FIRST_DELAY_MS of power on, at a
+    // random point so that devices restarting together after a mains outage
+    // do not collide. After a failed one the wait doubles from
+    // FIRST_BACKOFF_MS up to MAX_BACKOFF_MS, each wait jittered by +-50 %
+    // from a generator seeded with the DevEUI. On top of that:
+    //
+    //  - EU868 1 % duty cycle: the band is quiet for 99 times the time on air
+    //  - the aggregated join airtime of TS001, counted from the first request
+    //    (T0): 36 s in the first hour, 36 s in the next ten, then 8.7 s in
+    //    every 24 h; when a window has no room for another request the next
+    //    one waits for the window after.
+    //
+    // A successful join starts everything over. Everything that has to
+    // survive deep sleep is in State, which the caller keeps in RTC memory;
+    // the clock is hal::rtcMillis().
+    class JoinScheduler {
+        public:
+            struct State {
+                uint32_t magic;
+                uint32_t firstMs;         /** rtcMillis() of the first request (T0) */
+                uint32_t nextMs;          /** no request before */
+                uint32_t windowMs;        /** start of the current TS001 window */
+                uint32_t windowAirtimeMs; /** spent on join requests in it */
+                uint32_t totalAirtimeMs;  /** since T0 */
+                uint32_t seed;            /** of the jitter */
+                uint16_t attempts;        /** since T0 */
+            };
+
+            static const uint32_t MAGIC = 0x4A4F4E31; // "JON1"
+
+            static const uint32_t FIRST_DELAY_MS = 5000;
+            static const uint32_t FIRST_BACKOFF_MS = 15000;
+            static const uint32_t MAX_BACKOFF_MS = 60UL * 60 * 1000;
+            static const uint32_t DUTY_CYCLE_DIVISOR = 100;
+
+            static const uint32_t HOUR_MS = 60UL * 60 * 1000;
+            static const uint32_t DAY_MS = 24 * HOUR_MS;
+            static const uint32_t FIRST_HOUR_AIRTIME_MS = 36000;
+            static const uint32_t NEXT_TEN_HOURS_AIRTIME_MS = 36000;
+            static const uint32_t DAILY_AIRTIME_MS = 8700;
+
+            JoinScheduler(uint64_t devEUI, State& state);
+
+            // Starts over on a cold boot or if the RTC state is damaged
+            void restore(uint32_t nowMs);
+
+            // ms until the next join request may go out, 0 if it may now;
+            // only reads the state, which restore() has set up
+            uint32_t waitMs(uint32_t nowMs) const;
+
+            // A join request took airtimeMs on air; joined if it was accepted
+            void attempted(uint32_t nowMs, uint32_t airtimeMs, bool joined);
+
+            uint16_t getAttempts() const { return state.attempts; }
+            uint32_t getTotalAirtimeMs() const { return state.totalAirtimeMs; }
+
+        private:
+            // TS001 window of the time since T0: its start and length since
+            // T0 and the airtime allowed in it
+            static void window(uint32_t sinceFirstMs, uint32_t& startMs, uint32_t& lengthMs, uint32_t& airtimeMs);
+            // Uniform in [0, range)
+            uint32_t random(uint32_t range);
+            void start(uint32_t nowMs);
+
+            uint32_t seed;
+            State& state;
+    };
+
+}
+
+#endif // JOIN_SCHEDULER_H
@@ -1,4 +1,6 @@
 #include "LoRaWAN.h"
+#include "../HAL/Hal.h"
+#include "../Log/Log.h"
 
 // ##### load the ESP32 preferences facilites
 #include <Preferences.h>
@@ -7,11 +9,17 @@ void gotoSleep(uint32_t seconds);
 
 namespace SmartAirControl {
 
-    static void debug(bool isFail, const __FlashStringHelper* message, int state, bool Freeze);
-    static void arrayDump(uint8_t* buffer, uint16_t len);
+    // Time on air of the last transmission as RadioLib measured it
+    template <typename LoRaModule>
+    uint32_t LoRaWAN<LoRaModule>::getLastToA() {
+        return node.getLastToA();
+    }
+
+    // Logs message (a format taking the state) if isFail, and halts if freeze
+    static void debug(bool isFail, const char* message, int state, bool freeze);
 
-    uint16_t bootCountSinceUnsuccessfulJoin = 0;
     uint8_t session[RADIOLIB_LORAWAN_SESSION_BUF_SIZE];
+    SessionStore::State sessionStoreState;
 
     template <typename LoRaModule>
     LoRaWAN<LoRaModule>::LoRaWAN(const LoRaWANBand_t& region,
@@ -25,119 +33,104 @@ namespace SmartAirControl {
                                  uint8_t pin4,
                                  const uint8_t subBand)
         : radio(new Module(pin1, pin2, pin3, pin4))
-        , node(&radio, &region, subBand) {
+        , node(&radio, &region, subBand)
+        , store("session", sessionStoreState) {
         node.beginOTAA(joinEUI, devEUI, nwkKey, appKey);
     }
 
     template <typename LoRaModule>
     void LoRaWAN<LoRaModule>::goToSleep() {
-        Serial.print(F("[LoRaWAN] Set sleep: "));
-
         int16_t result = radio.sleep();
-
-        Serial.println(result == 0 ? F("SUCCESS") : F("ERROR"));
+        debug(result != RADIOLIB_ERR_NONE, "Set sleep failed (%d)", result, false);
     }
 
     template <typename LoRaModule>
-    int16_t LoRaWAN<LoRaModule>::activate(uint16_t bootCount) {
+    int16_t LoRaWAN<LoRaModule>::restore(uint16_t bootCount) {
         int16_t state = RADIOLIB_ERR_UNKNOWN;
 
-        Serial.println(F("Recalling LoRaWAN nonces & session"));
-
-        // ##### setup the flash storage
-        Preferences store;
-        store.begin("radiolib");
+        LOG_INFO(LORA, "Recalling LoRaWAN nonces & session");
 
         LoRaWANJoinEvent_t joinEvent;
 
-        // ##### if we have previously saved nonces, restore them and try to restore
-        // session as well
-        if (store.isKey("nonces")) {
-            uint8_t buffer[RADIOLIB_LORAWAN_NONCES_BUF_SIZE]; // create somewhere to
-                                                              // store nonces
-            store.getBytes("nonces", buffer,
-                           RADIOLIB_LORAWAN_NONCES_BUF_SIZE); // get them from the store
-            state = node.setBufferNonces(buffer);             // send them to LoRaWAN
-            debug(state != RADIOLIB_ERR_NONE, F("Restoring nonces buffer failed"), state, false);
+        // ##### the nonces and the session saved last from the flash journal;
+        // before there was one, the nonces alone were in NVS
+        SessionStore::Record stored;
+        bool found = store.load(stored);
+        if (found) {
+            // frames went out since the journal saved it, their counters are
+            // in the counter record
+            store.advanceCounters(stored.session);
+        } else {
+            Preferences legacy;
+            legacy.begin("radiolib", true);
+            found = legacy.getBytes("nonces", stored.nonces, RADIOLIB_LORAWAN_NONCES_BUF_SIZE) ==
+                    RADIOLIB_LORAWAN_NONCES_BUF_SIZE;
+            legacy.end();
+            memset(stored.session, 0, RADIOLIB_LORAWAN_SESSION_BUF_SIZE);
+        }
 
-            // recall session from RTC deep-sleep preserved variable
-            state = node.setBufferSession(session); // send them to LoRaWAN stack
+        if (found) {
+            state = node.setBufferNonces(stored.nonces); // send them to LoRaWAN
+            debug(state != RADIOLIB_ERR_NONE, "Restoring nonces buffer failed (%d)", state, false);
+
+            // recall session from RTC deep-sleep preserved variable, after a
+            // power loss from the journal
+            state = node.setBufferSession(session);
+            if (state != RADIOLIB_ERR_NONE) {
+                state = node.setBufferSession(stored.session);
+                if (state == RADIOLIB_ERR_NONE) {
+                    LOG_INFO(LORA, "Restored session from flash");
+                }
+            }
 
             // if we have booted more than once we should have a session to restore, so
             // report any failure otherwise no point saying there's been a failure when
             // it was bound to fail with an empty LWsession var.
-            debug((state != RADIOLIB_ERR_NONE) && (bootCount > 1), F("Restoring session buffer failed"), state, false);
+            debug((state != RADIOLIB_ERR_NONE) && (bootCount > 1), "Restoring session buffer failed (%d)", state, false);
 
             // if Nonces and Session restored successfully, activation is just a
             // formality moreover, Nonces didn't change so no need to re-save them
             if (state == RADIOLIB_ERR_NONE) {
-                Serial.println(F("Succesfully restored session - now activating"));
+                LOG_INFO(LORA, "Succesfully restored session - now activating");
                 state = node.activateOTAA(RADIOLIB_LORAWAN_DATA_RATE_UNUSED, &joinEvent);
-                debug((state != RADIOLIB_LORAWAN_SESSION_RESTORED), F("Failed to activate restored session"), state, true);
-
-                // ##### close the store before returning
-                store.end();
+                debug((state != RADIOLIB_LORAWAN_SESSION_RESTORED), "Failed to activate restored session (%d)", state, true);
 
                 return (state);
             }
-        } else { // store has no key "nonces"
-            Serial.println(F("No Nonces saved - starting fresh."));
+        } else { // nothing saved
+            LOG_INFO(LORA, "No Nonces saved - starting fresh.");
         }
 
-        // if we got here, there was no session to restore, so start trying to join
-        state = RADIOLIB_ERR_NETWORK_NOT_JOINED;
-        while (state != RADIOLIB_LORAWAN_NEW_SESSION) { // Original code
-            Serial.println(F("Join ('login') to the LoRaWAN Network"));
-            state = node.activateOTAA(RADIOLIB_LORAWAN_DATA_RATE_UNUSED, &joinEvent);
-
-            // ##### save the join counters (nonces) to permanent store
-            Serial.println(F("Saving nonces to flash"));
-            uint8_t buffer[RADIOLIB_LORAWAN_NONCES_BUF_SIZE]; // create somewhere to
-                                                              // store nonces
-            const uint8_t* persist = node.getBufferNonces();  // get pointer to nonces
-            memcpy(buffer, persist,
-                   RADIOLIB_LORAWAN_NONCES_BUF_SIZE); // copy in to buffer
-            store.putBytes("nonces", buffer,
-                           RADIOLIB_LORAWAN_NONCES_BUF_SIZE); // send them to the store
-
-            // we'll save the session after an uplink
-
-            if (state != RADIOLIB_LORAWAN_NEW_SESSION) {
-                Serial.print(F("Join failed: "));
-                Serial.println(state);
-
-                // how long to wait before join attempts. This is an interim solution
-                // pending implementation of TS001 LoRaWAN Specification section #7 - this
-                // doc applies to v1.0.4 & v1.1 it sleeps for longer & longer durations to
-                // give time for any gateway issues to resolve or whatever is interfering
-                // with the device <-> gateway airwaves.
-                uint32_t sleepForSeconds = 15;
-                Serial.print(F("Boots since unsuccessful join: "));
-                Serial.println(bootCountSinceUnsuccessfulJoin);
-                Serial.print(F("Retrying join in "));
-                Serial.print(sleepForSeconds);
-                Serial.println(F(" seconds"));
-
-                gotoSleep(sleepForSeconds);
-            }
-        } // while join
+        // if we got here, there was no session to restore: the caller joins
+        return RADIOLIB_ERR_NETWORK_NOT_JOINED;
+    }
 
-        Serial.println(F("Joined"));
-        Serial.print(F("JoinNonce: "));
-        Serial.println(joinEvent.joinNonce);
-        Serial.print(F("DevNonce: "));
-        Serial.println(joinEvent.devNonce);
-        Serial.print(F("NewSession: "));
-        Serial.println(joinEvent.newSession);
+    template <typename LoRaModule>
+    int16_t LoRaWAN<LoRaModule>::join() {
+        LOG_INFO(LORA, "Join ('login') to the LoRaWAN Network");
+
+        LoRaWANJoinEvent_t joinEvent;
+        int16_t state = node.activateOTAA(RADIOLIB_LORAWAN_DATA_RATE_UNUSED, &joinEvent);
+
+        // ##### save the join counters (nonces) to the journal, with the new
+        // session if there is one
+        LOG_DEBUG(LORA, "Saving nonces to flash");
+        memcpy(session, node.getBufferSession(), RADIOLIB_LORAWAN_SESSION_BUF_SIZE);
+        if (!store.save(node.getBufferNonces(), session, hal::rtcMillis())) {
+            LOG_ERROR(LORA, "Saving nonces failed");
+        }
 
-        // reset the failed join count
-        bootCountSinceUnsuccessfulJoin = 0;
+        if (state != RADIOLIB_LORAWAN_NEW_SESSION) {
+            LOG_WARN(LORA, "Join failed: %d", state);
+            return state;
+        }
 
-        delay(1000); // hold off off hitting the airwaves again too soon - an issue in
-                     // the US
+        LOG_INFO(LORA, "Joined, JoinNonce: %lu  DevNonce: %u  NewSession: %d",
+                 joinEvent.joinNonce, joinEvent.devNonce, joinEvent.newSession);
 
-        // ##### close the store
-        store.end();
+        // hold off hitting the airwaves again too soon - an issue in the US;
+        // the radio task waits it out without blocking the others
+        gotoSleep(1);
 
         return (state);
     }
@@ -148,33 +141,33 @@ namespace SmartAirControl {
     }
 
     template <typename LoRaModule>
-    void LoRaWAN<LoRaModule>::setup(uint16_t bootCount) {
-        Serial.println(F("Initalise the radio"));
+    int16_t LoRaWAN<LoRaModule>::setup(uint16_t bootCount) {
+        LOG_INFO(LORA, "Initalise the radio");
 
         int16_t state = radio.begin();
-        debug(state != RADIOLIB_ERR_NONE, F("Initalise radio failed"), state, true);
+        debug(state != RADIOLIB_ERR_NONE, "Initalise radio failed (%d)", state, true);
 
         if (state == RADIOLIB_ERR_NONE) {
-            // activate node by restoring session or otherwise joining the network
-            state = activate(bootCount);
-
-            if (state != RADIOLIB_LORAWAN_NEW_SESSION && state != RADIOLIB_LORAWAN_SESSION_RESTORED) {
-                Serial.println(F("LoRaWAN not activated"));
-
-                // now save session to RTC memory
-                const uint8_t* persist = node.getBufferSession();
-                memcpy(session, persist, RADIOLIB_LORAWAN_SESSION_BUF_SIZE);
-
-                // wait until next uplink - observing legal & TTN FUP constraints
-                gotoSleep(RADIOLIB_LORA_UPLINK_INTERVAL_SECONDS);
-            }
+            // activate node by restoring the session, joining is up to the caller
+            state = restore(bootCount);
         }
+        return state;
     }
 
     template <typename LoRaModule>
     void LoRaWAN<LoRaModule>::setUplinkPayload(uint8_t fPort, const std::string& uplinkPayload) {
+        setUplinkPayload(fPort, reinterpret_cast<const uint8_t*>(uplinkPayload.data()), uplinkPayload.length());
+    }
+
+    template <typename LoRaModule>
+    void LoRaWAN<LoRaModule>::setUplinkPayload(uint8_t fPort, const uint8_t* uplinkPayload, std::size_t uplinkSize) {
+        if (uplinkSize > MAX_UPLINK_PAYLOAD) {
+            uplinkSize = MAX_UPLINK_PAYLOAD;
+        }
+
         this->fPort = fPort;
-        this->uplinkPayload = uplinkPayload;
+        memcpy(this->uplinkPayload, uplinkPayload, uplinkSize);
+        this->uplinkSize = uplinkSize;
     }
 
     template <typename LoRaModule>
@@ -183,14 +176,9 @@ namespace SmartAirControl {
         uint8_t downlinkPayload[255]; // Make sure this fits your plans!
         size_t downlinkSize;          // To hold the actual payload size received
 
-        // you can also retrieve additional information about an uplink or
-        // downlink by passing a reference to LoRaWANEvent_t structure
-        static LoRaWANEvent_t uplinkDetails{};
-        static LoRaWANEvent_t downlinkDetails{};
-
         int16_t state = 0;
-        if (downlinkDetails.frmPending || downlinkDetails.confirmed) { // At first run this is false due to initialization
-            Serial.println(F("[LoRaWAN] Sending request for pending frame"));
+        if (isPending()) { // At first run this is false due to initialization
+            LOG_INFO(LORA, "Sending request for pending frame");
             state = node.sendReceive(reinterpret_cast<const uint8_t*>(""), // cppcheck-suppress cstyleCast
                                      0,
                                      220,
@@ -200,21 +188,18 @@ namespace SmartAirControl {
                                      &uplinkDetails,
                                      &downlinkDetails);
         } else {
-            Serial.print(F("[LoRaWAN] Sending: "));
-            Serial.print(F("fPort = "));
-            Serial.print(fPort);
-            Serial.print(", ");
-            Serial.println(uplinkPayload.c_str());
+            LOG_INFO(LORA, "Sending: fPort = %u, %u bytes", fPort, uplinkSize);
+            LOG_HEX(LOG_LEVEL_DEBUG, LORA, "Uplink:", uplinkPayload, uplinkSize);
 
             if (node.getFCntUp() == 1) {
-                Serial.println(F("[LoRaWAN]   and requesting LinkCheck and DeviceTime"));
+                LOG_INFO(LORA, "  and requesting LinkCheck and DeviceTime");
 
                 node.sendMacCommandReq(RADIOLIB_LORAWAN_MAC_LINK_CHECK);
                 node.sendMacCommandReq(RADIOLIB_LORAWAN_MAC_DEVICE_TIME);
             }
 
-            state = node.sendReceive(reinterpret_cast<const uint8_t*>(uplinkPayload.c_str()), // cppcheck-suppress cstyleCast
-                                     uplinkPayload.length(),
+            state = node.sendReceive(uplinkPayload,
+                                     uplinkSize,
                                      fPort,
                                      downlinkPayload,
                                      &downlinkSize,
@@ -223,111 +208,79 @@ namespace SmartAirControl {
                                      &downlinkDetails);
         }
 
-        debug((state < RADIOLIB_ERR_NONE), F("Error in sendReceive"), state, false); // This is correct
+        debug((state < RADIOLIB_ERR_NONE), "Error in sendReceive (%d)", state, false); // This is correct
+
+        // the frame counters after every frame, the whole session now and then (below)
+        if (!store.saveCounters(node.getBufferSession())) {
+            LOG_WARN(LORA, "Saving frame counters failed");
+        }
 
         if (state > 0) {
-            Serial.println(F("[LoRaWAN] Downlink received"));
+            LOG_INFO(LORA, "Downlink received");
 
-            if (downlinkSize > 0) {
-                Serial.print(F("[LoRaWAN] Payload:\t"));
-                arrayDump(downlinkPayload, downlinkSize);
+            // an application fPort carries a command even when empty
+            if (downlinkSize > 0 || downlinkDetails.fPort > 0) {
+                LOG_HEX(LOG_LEVEL_INFO, LORA, "Payload:", downlinkPayload, downlinkSize);
                 if (downlinkCB) {
                     downlinkCB(downlinkDetails.fPort, downlinkPayload, downlinkSize);
                 }
             } else {
-                Serial.println(F("[LoRaWAN] <MAC commands only>"));
+                LOG_INFO(LORA, "<MAC commands only>");
             }
 
-            Serial.println(F("[LoRaWan] Signal:"));
-            Serial.print(F("[LoRaWAN]     RSSI:               "));
-            Serial.print(radio.getRSSI());
-            Serial.println(F(" dBm"));
-
-            // print SNR (Signal-to-Noise Ratio)
-            Serial.print(F("[LoRaWAN]     SNR:                "));
-            Serial.print(radio.getSNR());
-            Serial.println(F(" dB"));
-
-            // print extra information about the event
-            Serial.println(F("[LoRaWAN] Event information:"));
-            Serial.print(F("[LoRaWAN]     Confirmed:          "));
-            Serial.println(downlinkDetails.confirmed);
-            Serial.print(F("[LoRaWAN]     Confirming:         "));
-            Serial.println(downlinkDetails.confirming);
-            Serial.print(F("[LoRaWAN]     FrmPending:         "));
-            Serial.println(downlinkDetails.frmPending);
-            Serial.print(F("[LoRaWAN]     Datarate:           "));
-            Serial.println(downlinkDetails.datarate);
-            Serial.print(F("[LoRaWAN]     Frequency:          "));
-            Serial.print(downlinkDetails.freq, 3);
-            Serial.println(F(" MHz"));
-            Serial.print(F("[LoRaWAN]     Frame count:        "));
-            Serial.println(downlinkDetails.fCnt);
-            Serial.print(F("[LoRaWAN]     Port:               "));
-            Serial.println(downlinkDetails.fPort);
-            Serial.print(F("[LoRaWAN]     Time-on-air:        "));
-            Serial.print(node.getLastToA());
-            Serial.println(F(" ms"));
-            Serial.print(F("[LoRaWAN]     Rx window:          "));
-            Serial.println(state);
+            LOG_DEBUG(LORA, "Signal: RSSI %.1f dBm  SNR %.1f dB", radio.getRSSI(), radio.getSNR());
+            LOG_DEBUG(LORA, "Event: Confirmed %d  Confirming %d  FrmPending %d  Datarate %u",
+                      downlinkDetails.confirmed, downlinkDetails.confirming, downlinkDetails.frmPending,
+                      downlinkDetails.datarate);
+            LOG_DEBUG(LORA, "Event: Frequency %.3f MHz  Frame count %lu  Port %u  Time-on-air %lu ms  Rx window %d",
+                      downlinkDetails.freq, downlinkDetails.fCnt, downlinkDetails.fPort, node.getLastToA(), state);
 
             uint8_t margin = 0;
             uint8_t gwCnt = 0;
             if (node.getMacLinkCheckAns(&margin, &gwCnt) == RADIOLIB_ERR_NONE) {
-                Serial.println(F("[LoRaWAN] Link check:"));
-                Serial.print(F("[LoRaWAN]     LinkCheck margin:   "));
-                Serial.println(margin);
-                Serial.print(F("[LoRaWAN]     LinkCheck count:    "));
-                Serial.println(gwCnt);
+                LOG_DEBUG(LORA, "Link check: margin %u  gateways %u", margin, gwCnt);
             }
 
             uint32_t networkTime = 0;
             uint8_t fracSecond = 0;
             if (node.getMacDeviceTimeAns(&networkTime, &fracSecond, true) == RADIOLIB_ERR_NONE) {
-                Serial.println(F("[LoRaWAN] Timing:"));
-                Serial.print(F("[LoRaWAN]     DeviceTime Unix:    "));
-                Serial.println(networkTime);
-                Serial.print(F("[LoRaWAN]     DeviceTime second:  1/"));
-                Serial.println(fracSecond);
+                LOG_DEBUG(LORA, "DeviceTime: Unix %lu  fraction %u/256", networkTime, fracSecond);
             }
         } else {
-            Serial.println(F("[LoRaWAN] No downlink received"));
+            LOG_DEBUG(LORA, "No downlink received");
         }
 
-        if (state <= 0 || !(downlinkDetails.frmPending || downlinkDetails.confirmed)) {
-            // now save session to RTC memory
+        if (state <= 0 || !isPending()) {
+            // now save session to RTC memory, and now and then to flash
             const uint8_t* persist = node.getBufferSession();
             memcpy(session, persist, RADIOLIB_LORAWAN_SESSION_BUF_SIZE);
+            if (store.saveIfDue(node.getBufferNonces(), session, hal::rtcMillis())) {
+                LOG_DEBUG(LORA, "Saved session to flash");
+            }
 
             // wait until next uplink - observing legal & TTN FUP constraints
             gotoSleep(RADIOLIB_LORA_UPLINK_INTERVAL_SECONDS);
         }
     }
 
-    // Helper function to display any issues
-    static void debug(bool isFail, const __FlashStringHelper* message, int state, bool Freeze) {
-        if (isFail) {
-            Serial.print(message);
-            Serial.print("(");
-            Serial.print(state);
-            Serial.println(")");
-            while (Freeze)
-                ;
-        }
+    template <typename LoRaModule>
+    uint8_t LoRaWAN<LoRaModule>::getMaxPayloadLen() {
+        return node.getMaxPayloadLen();
     }
 
-    // Helper function to display a byte array
-    static void arrayDump(uint8_t* buffer, uint16_t len) {
-        for (uint16_t c = 0; c < len; c++) {
-            Serial.printf("0x%02X ", buffer[c]);
-        }
-        Serial.print("-> ");
-
-        char str[len + 1];
-        str[len] = '\0';
+    template <typename LoRaModule>
+    bool LoRaWAN<LoRaModule>::isPending() const {
+        return downlinkDetails.frmPending || downlinkDetails.confirmed;
+    }
 
-        snprintf(str, len + 1, "%s", buffer);
-        Serial.println(str);
+    static void debug(bool isFail, const char* message, int state, bool freeze) {
+        if (isFail) {
+            LOG_ERROR(LORA, message, state);
+            while (freeze) {
+                // let the log task print why
+                hal::delay(1000);
+            }
+        }
     }
 
 } // namespace SmartAirControl
\ No newline at end of file
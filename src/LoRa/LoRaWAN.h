@@ -6,13 +6,14 @@
 #include <esp_attr.h>
 #include <functional>
 #include <string>
+#include "SessionStore.h"
 
 namespace SmartAirControl {
 
     // utilities & vars to support ESP32 deep-sleep. The RTC_DATA_ATTR attribute
     // puts these in to the RTC memory which is preserved during deep-sleep
-    extern RTC_DATA_ATTR uint16_t bootCountSinceUnsuccessfulJoin;
     extern RTC_DATA_ATTR uint8_t session[];
+    extern RTC_DATA_ATTR SessionStore::State sessionStoreState;
 
     template <typename LoRaModule>
     class LoRaWAN {
@@ -30,20 +31,36 @@ namespace SmartAirControl {
 
         void goToSleep();
 
-        void setup(uint16_t bootCount);
+        // Initialises the radio and restores the session from RTC memory or
+        // flash. Returns RADIOLIB_LORAWAN_SESSION_RESTORED, else
+        // RADIOLIB_ERR_NETWORK_NOT_JOINED or an error of the radio
+        int16_t setup(uint16_t bootCount);
+        // Sends one join request. Returns RADIOLIB_LORAWAN_NEW_SESSION or an
+        // error; when to try again is up to the caller (JoinScheduler.h)
+        int16_t join();
 
         void setUplinkPayload(uint8_t fPort, const std::string& uplinkPayload);
+        void setUplinkPayload(uint8_t fPort, const uint8_t* uplinkPayload, std::size_t uplinkSize);
         void setDownlinkCB(std::function<void(uint8_t, uint8_t*, std::size_t)> downlinkCB);
 
         void loop();
 
+        // largest application payload allowed at the current data rate
+        uint8_t getMaxPayloadLen();
+        // true while the network has more downlink frames or awaits a confirmation
+        bool isPending() const;
+        // time-on-air of the last uplink in ms, for the airtime budgets
+        uint32_t getLastToA();
+
     private:
-        int16_t activate(uint16_t bootCount);
+        int16_t restore(uint16_t bootCount);
 
         std::function<void(uint8_t fPort, uint8_t*, std::size_t)> downlinkCB;
 
         LoRaModule radio;
         LoRaWANNode node;
+        // the nonces and the session through a power loss
+        SessionStore store;
 
         // reserved for mac commands: 0
         // Here for application use: 1 ... 219,
@@ -51,7 +68,14 @@ namespace SmartAirControl {
         // Here 221 (info), 222 (warning), 223 (error) are used
         // reserved for further use: 224 ... 255,
         uint8_t fPort = 221;
-        std::string uplinkPayload;
+
+        // largest FRMPayload LoRaWAN allows at any EU868 data rate
+        static const std::size_t MAX_UPLINK_PAYLOAD = 222;
+        uint8_t uplinkPayload[MAX_UPLINK_PAYLOAD];
+        std::size_t uplinkSize = 0;
+
+        LoRaWANEvent_t uplinkDetails{};
+        LoRaWANEvent_t downlinkDetails{};
     };
 
 } // namespace GAIT
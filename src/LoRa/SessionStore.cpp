@@ -0,0 +1,120 @@
+#include "SessionStore.h"
+#include <cstring>
+#include "../Storage/Crc.h"
+
+namespace SmartAirControl {
+
+    // The session buffer keeps its counters little endian, at the offsets
+    // of RadioLib's LoRaWAN.h
+    static uint32_t getCounter(const uint8_t* session, size_t offset) {
+        return uint32_t(session[offset]) | uint32_t(session[offset + 1]) << 8 |
+               uint32_t(session[offset + 2]) << 16 | uint32_t(session[offset + 3]) << 24;
+    }
+
+    static void setCounter(uint8_t* session, size_t offset, uint32_t value) {
+        for (size_t i = 0; i < 4; i++) {
+            session[offset + i] = value >> (8 * i);
+        }
+    }
+
+    // RadioLib's checkSum16 of the buffer in front of the signature, which
+    // setBufferSession() checks: its big endian 16 bit words XORed
+    static uint16_t signature(const uint8_t* session) {
+        uint16_t checksum = 0;
+        for (size_t i = 0; i < RADIOLIB_LORAWAN_SESSION_SIGNATURE; i += 2) {
+            checksum ^= uint16_t(session[i]) << 8 | session[i + 1];
+        }
+        return checksum;
+    }
+
+    static bool isSigned(const uint8_t* session) {
+        uint16_t stored = session[RADIOLIB_LORAWAN_SESSION_SIGNATURE] |
+                          session[RADIOLIB_LORAWAN_SESSION_SIGNATURE + 1] << 8;
+        return stored == signature(session);
+    }
+
+    static void sign(uint8_t* session) {
+        uint16_t checksum = signature(session);
+        session[RADIOLIB_LORAWAN_SESSION_SIGNATURE] = checksum;
+        session[RADIOLIB_LORAWAN_SESSION_SIGNATURE + 1] = checksum >> 8;
+    }
+
+    SessionStore::SessionStore(const char* partition, State& state)
+        : flash(partition), journal(flash, VERSION, sizeof(Record)), state(state) {
+    }
+
+    void SessionStore::restore(uint32_t nowMs) {
+        if (state.magic == MAGIC) {
+            return;
+        }
+        // a power loss: what is in flash is as good as a fresh save
+        state.magic = MAGIC;
+        state.savedMs = nowMs;
+        state.sessionCrc = 0;
+    }
+
+    bool SessionStore::load(Record& record) {
+        return journal.recover(&record);
+    }
+
+    bool SessionStore::save(const uint8_t* nonces, const uint8_t* session, uint32_t nowMs) {
+        restore(nowMs);
+
+        Record record;
+        std::memcpy(record.nonces, nonces, sizeof(record.nonces));
+        std::memcpy(record.session, session, sizeof(record.session));
+        if (!journal.append(&record)) {
+            return false;
+        }
+        state.savedMs = nowMs;
+        state.sessionCrc = crc16(session, sizeof(record.session));
+        // a counter record of an older one would not belong to it any more
+        saveCounters(session);
+        return true;
+    }
+
+    bool SessionStore::saveIfDue(const uint8_t* nonces, const uint8_t* session, uint32_t nowMs) {
+        restore(nowMs);
+        if (nowMs - state.savedMs < SAVE_INTERVAL_MS ||
+            crc16(session, RADIOLIB_LORAWAN_SESSION_BUF_SIZE) == state.sessionCrc) {
+            return false;
+        }
+        return save(nonces, session, nowMs);
+    }
+
+    bool SessionStore::saveCounters(const uint8_t* session) {
+        Counters counters;
+        counters.sequence = journal.getSequence();
+        counters.fCntUp = getCounter(session, RADIOLIB_LORAWAN_SESSION_FCNT_UP);
+        counters.nFCntDown = getCounter(session, RADIOLIB_LORAWAN_SESSION_N_FCNT_DOWN);
+        counters.aFCntDown = getCounter(session, RADIOLIB_LORAWAN_SESSION_A_FCNT_DOWN);
+        hal::Nvs store("session");
+        return store.putBytes("counters", &counters, sizeof(counters)) == sizeof(counters);
+    }
+
+    void SessionStore::advanceCounters(uint8_t* session) {
+        static const size_t OFFSETS[] = {
+            RADIOLIB_LORAWAN_SESSION_FCNT_UP,
+            RADIOLIB_LORAWAN_SESSION_N_FCNT_DOWN,
+            RADIOLIB_LORAWAN_SESSION_A_FCNT_DOWN,
+        };
+        // RadioLib turns a session down that is not signed, this one stays so
+        if (!isSigned(session)) {
+            return;
+        }
+        Counters counters;
+        hal::Nvs store("session", true);
+        bool recorded = store.getBytes("counters", &counters, sizeof(counters)) == sizeof(counters) &&
+                        counters.sequence == journal.getSequence();
+        const uint32_t newer[] = { counters.fCntUp, counters.nFCntDown, counters.aFCntDown };
+        for (size_t i = 0; i < sizeof(OFFSETS) / sizeof(OFFSETS[0]); i++) {
+            uint32_t counter = getCounter(session, OFFSETS[i]);
+            if (recorded && newer[i] > counter) {
+                counter = newer[i];
+            }
+            setCounter(session, OFFSETS[i], counter + FCNT_MARGIN);
+        }
+        sign(session);
+    }
+
+}
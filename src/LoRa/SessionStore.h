@@ -0,0 +1,83 @@
+#ifndef SESSION_STORE_H
+#define SESSION_STORE_H
+
+#include <RadioLib.h>
+#include <cstdint>
+#include "../HAL/Hal.h"
+#include "../Storage/Journal.h"
+
+namespace SmartAirControl {
+
+    // The LoRaWAN nonces and session in a flash journal (the "session"
+    // partition), so a power loss costs no rejoin: RTC memory only keeps
+    // the session through deep sleep.
+    //
+    // The nonces change with every join attempt and are saved right away,
+    // the network refuses a DevNonce it has seen. The session changes with
+    // every frame and is saved at most every SAVE_INTERVAL_MS, which keeps
+    // the journal (four sectors of 4 KiB in partitions.csv) to about 730
+    // erases per sector and year. Its frame counters alone go to NVS after
+    // every frame (Counters, 16 bytes). After a power loss the session from
+    // the journal gets the counters of that record and FCNT_MARGIN on top,
+    // so no uplink repeats a counter the network has seen and drops.
+    //
+    // When to save next is kept in State, which the caller keeps in RTC
+    // memory; the clock is hal::rtcMillis().
+    class SessionStore {
+        public:
+            static const uint16_t VERSION = 1;
+            static const uint32_t SAVE_INTERVAL_MS = 15UL * 60 * 1000;
+            // Frames past the counter record a power loss can leave behind:
+            // the one it cuts short between its uplink and the record. For
+            // the downlink counters this costs at most one downlink.
+            static const uint32_t FCNT_MARGIN = 1;
+
+            struct Record {
+                uint8_t nonces[RADIOLIB_LORAWAN_NONCES_BUF_SIZE];
+                uint8_t session[RADIOLIB_LORAWAN_SESSION_BUF_SIZE];
+            };
+
+            struct Counters {
+                uint32_t sequence;  /** of the journal record they belong to */
+                uint32_t fCntUp;
+                uint32_t nFCntDown;
+                uint32_t aFCntDown;
+            };
+
+            struct State {
+                uint32_t magic;
+                uint32_t savedMs;     /** rtcMillis() of the last save */
+                uint16_t sessionCrc;  /** of the session saved last */
+            };
+
+            static const uint32_t MAGIC = 0x53455331; // "SES1"
+
+            SessionStore(const char* partition, State& state);
+
+            // The newest record in flash, false if there is none
+            bool load(Record& record);
+
+            // After a join attempt
+            bool save(const uint8_t* nonces, const uint8_t* session, uint32_t nowMs);
+            // After a frame, if SAVE_INTERVAL_MS passed since the last save
+            // and the session changed; true if it was saved
+            bool saveIfDue(const uint8_t* nonces, const uint8_t* session, uint32_t nowMs);
+            // After every frame, false if NVS failed
+            bool saveCounters(const uint8_t* session);
+
+            // The session of the record load() returned, brought up to its
+            // counter record plus FCNT_MARGIN and signed again for RadioLib;
+            // one RadioLib would refuse is left as it is
+            void advanceCounters(uint8_t* session);
+
+        private:
+            void restore(uint32_t nowMs);
+
+            hal::Flash flash;
+            Journal journal;
+            State& state;
+    };
+
+}
+
+#endif // SESSION_STORE_H
@@ -0,0 +1,192 @@
+#include "UplinkScheduler.h"
+#include "../Control/AirScore.h"
+#include "../Log/Log.h"
+
+namespace SmartAirControl {
+
+#if !defined(ESP32)
+    static int policyOverride = -1;
+
+    void UplinkScheduler::overridePolicy(int policy) {
+        policyOverride = policy;
+    }
+#endif
+
+    const float UplinkScheduler::PM_RELATIVE_CHANGE = 0.25f;
+    const float UplinkScheduler::GAS_RELATIVE_CHANGE = 0.2f;
+    const float UplinkScheduler::TREND_ALPHA = 0.25f;
+    const float UplinkScheduler::TREND_THRESHOLD = 1.0f;
+
+    // The EPA AQI PM2.5 categories (good, moderate, unhealthy for sensitive
+    // groups, unhealthy, very unhealthy, hazardous), as the scoring has them
+    static const int PM25_BAND_COUNT = sizeof(aqi::EPA_PM25) / sizeof(aqi::EPA_PM25[0]);
+
+    UplinkScheduler::UplinkScheduler(int policy, size_t batchSize, State& state)
+        : policy(policy), batchSize(batchSize), heartbeatMs(DEFAULT_HEARTBEAT_MS), state(state) {
+    }
+
+    void UplinkScheduler::configure(int policy, uint32_t heartbeatMs) {
+        this->policy = policy;
+        this->heartbeatMs = heartbeatMs;
+#if !defined(ESP32)
+        if (policyOverride >= 0) {
+            this->policy = policyOverride;
+        }
+#endif
+    }
+
+    const char* UplinkScheduler::policyName(int policy) {
+        return policy == UPLINK_FIXED ? "fixed" : "adaptive";
+    }
+
+    void UplinkScheduler::restore(uint32_t nowMs) {
+        if (state.magic == MAGIC) {
+            return;
+        }
+        state.magic = MAGIC;
+        state.lastUplinkMs = nowMs;
+        state.quietUntilMs = nowMs;
+        state.budgetTimeMs = nowMs;
+        state.budgetMs = BUDGET_CAPACITY_MS;
+        state.lastToaMs = DEFAULT_TOA_MS;
+        state.trend = 0;
+        state.sentPm25 = 0;
+        state.sentGas = 0;
+        state.sentTrend = 0;
+        state.lastScore = 0;
+        state.hasScore = false;
+        state.changed = true;
+    }
+
+    void UplinkScheduler::observe(const Sample& sample) {
+        if (state.hasScore) {
+            float change = static_cast<float>(sample.score) - state.lastScore;
+            state.trend += TREND_ALPHA * (change - state.trend);
+        }
+        state.lastScore = sample.score;
+        state.hasScore = true;
+
+        if (!state.changed && isSignificant(sample)) {
+            state.changed = true;
+        }
+    }
+
+    bool UplinkScheduler::isSignificant(const Sample& sample) const {
+        uint16_t pm25 = sample.pm25;
+        uint16_t difference = pm25 > state.sentPm25 ? pm25 - state.sentPm25 : state.sentPm25 - pm25;
+        if (difference >= PM_CHANGE && difference >= state.sentPm25 * PM_RELATIVE_CHANGE) {
+            return true;
+        }
+        // a small step that crosses into another category, not noise around its edge
+        if (band(pm25) != band(state.sentPm25) && difference >= PM_BAND_HYSTERESIS) {
+            return true;
+        }
+
+        if (state.sentGas > 0) {
+            float gasChange = (static_cast<float>(sample.gasResistance) - state.sentGas) / state.sentGas;
+            if (gasChange >= GAS_RELATIVE_CHANGE || gasChange <= -GAS_RELATIVE_CHANGE) {
+                return true;
+            }
+        }
+
+        int sign = trendSign();
+        return sign != 0 && sign != state.sentTrend;
+    }
+
+    int UplinkScheduler::band(uint16_t pm25) {
+        int i = 0;
+        while (i < PM25_BAND_COUNT - 1 && pm25 * 10u > aqi::EPA_PM25[i].high) {
+            i++;
+        }
+        return i;
+    }
+
+    int UplinkScheduler::trendSign() const {
+        if (state.trend >= TREND_THRESHOLD) {
+            return 1;
+        }
+        if (state.trend <= -TREND_THRESHOLD) {
+            return -1;
+        }
+        return 0;
+    }
+
+    size_t UplinkScheduler::getMaxPayload(size_t limit) const {
+        if (policy == UPLINK_FIXED || limit < MAX_PAYLOAD) {
+            return limit;
+        }
+        return MAX_PAYLOAD;
+    }
+
+    UplinkScheduler::Reason UplinkScheduler::due(uint32_t nowMs, size_t queued) const {
+        if (queued == 0 || holdOffMs(nowMs) > 0) {
+            return REASON_NONE;
+        }
+        if (policy == UPLINK_FIXED) {
+            return queued >= batchSize ? REASON_BATCH : REASON_NONE;
+        }
+        if (state.changed) {
+            return REASON_CHANGE;
+        }
+        if (nowMs - state.lastUplinkMs >= heartbeatMs) {
+            return REASON_HEARTBEAT;
+        }
+        return REASON_NONE;
+    }
+
+    uint32_t UplinkScheduler::untilDueMs(uint32_t nowMs, size_t queued) const {
+        if (queued == 0 || (policy == UPLINK_FIXED && queued < batchSize)) {
+            return NEVER;
+        }
+        uint32_t wait = holdOffMs(nowMs);
+        if (policy == UPLINK_ADAPTIVE && !state.changed) {
+            int32_t heartbeat = static_cast<int32_t>(state.lastUplinkMs + heartbeatMs - nowMs);
+            wait = heartbeat > static_cast<int32_t>(wait) ? heartbeat : wait;
+        }
+        return wait;
+    }
+
+    uint32_t UplinkScheduler::holdOffMs(uint32_t nowMs) const {
+        int32_t quiet = static_cast<int32_t>(state.quietUntilMs - nowMs);
+        uint32_t wait = quiet > 0 ? quiet : 0;
+        if (policy == UPLINK_FIXED) {
+            return wait;
+        }
+
+        // until the bucket holds the airtime of another uplink like the last
+        float missing = state.lastToaMs - getBudgetMs(nowMs);
+        if (missing > 0) {
+            uint32_t refill = static_cast<uint32_t>(missing * DAY_MS / REFILL_MS_PER_DAY) + 1;
+            wait = refill > wait ? refill : wait;
+        }
+        return wait;
+    }
+
+    float UplinkScheduler::getBudgetMs(uint32_t nowMs) const {
+        uint32_t elapsed = nowMs - state.budgetTimeMs;
+        float budget = state.budgetMs + static_cast<float>(elapsed) * REFILL_MS_PER_DAY / DAY_MS;
+        return budget < BUDGET_CAPACITY_MS ? budget : BUDGET_CAPACITY_MS;
+    }
+
+    void UplinkScheduler::sent(uint32_t nowMs, uint32_t toaMs, const Sample& newest) {
+        spend(nowMs, toaMs);
+        state.lastUplinkMs = nowMs;
+        state.lastToaMs = toaMs > 0 ? toaMs : DEFAULT_TOA_MS;
+        state.sentPm25 = newest.pm25;
+        state.sentGas = newest.gasResistance;
+        state.sentTrend = trendSign();
+        state.changed = false;
+    }
+
+    void UplinkScheduler::spend(uint32_t nowMs, uint32_t toaMs) {
+        state.budgetMs = getBudgetMs(nowMs) - toaMs;
+        state.budgetTimeMs = nowMs;
+        // counted from the start of the transmission (nowMs is no earlier),
+        // and the whole ms of toaMs may be up to one short
+        uint32_t quietMs = (toaMs + 1) * DUTY_CYCLE_DIVISOR;
+        state.quietUntilMs = nowMs + quietMs;
+        LOG_DEBUG(LORA, "Airtime %lu ms, quiet for %lu ms, fair use budget %.1f s", toaMs, quietMs,
+                  state.budgetMs / 1000.0f);
+    }
+
+}
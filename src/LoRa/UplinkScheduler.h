@@ -0,0 +1,139 @@
+#ifndef UPLINK_SCHEDULER_H
+#define UPLINK_SCHEDULER_H
+
+#include <cstddef>
+#include <cstdint>
+#include "../Codec/Sample.h"
+
+// Uplink policy selected by the UPLINK_POLICY build flag
+#define UPLINK_FIXED 0    // a batch whenever the batch size is queued
+#define UPLINK_ADAPTIVE 1 // on a significant change of the air, else a heartbeat
+
+#ifndef UPLINK_POLICY
+#define UPLINK_POLICY UPLINK_ADAPTIVE
+#endif
+
+namespace SmartAirControl {
+
+    // Decides when the queued samples go on air.
+    //
+    // The adaptive policy sends when the air changed in a way the network
+    // should know about: PM2.5 moved by PM_CHANGE (absolute and relative) or
+    // into another EPA band, the gas resistance moved by GAS_RELATIVE_CHANGE,
+    // or the trend of the score turned around. Otherwise a heartbeat (every
+    // DEFAULT_HEARTBEAT_MS unless configured) says the device is alive and
+    // the air unchanged.
+    //
+    // Both policies keep the EU868 1 % duty cycle: after an uplink of time on
+    // air t the band is quiet for 99 t. The adaptive policy also keeps the TTN
+    // fair use limit of 30 s airtime a day, as a token bucket that a burst of
+    // changes can draw down to zero. It refills at the daily limit less its
+    // capacity, so no 24 h window gets more than the limit.
+    //
+    // Everything that has to survive deep sleep is in State, which the
+    // caller keeps in RTC memory; the clock is hal::rtcMillis().
+    class UplinkScheduler {
+        public:
+            enum Reason {
+                REASON_NONE,
+                REASON_BATCH,     /** fixed policy, a batch is queued */
+                REASON_CHANGE,    /** the air changed significantly */
+                REASON_HEARTBEAT  /** nothing sent for the heartbeat interval */
+            };
+
+            struct State {
+                uint32_t magic;
+                uint32_t lastUplinkMs;  /** rtcMillis() of the last uplink */
+                uint32_t quietUntilMs;  /** duty cycle: no uplink before */
+                uint32_t budgetTimeMs;  /** rtcMillis() the budget was refilled */
+                float budgetMs;         /** fair use airtime left */
+                uint32_t lastToaMs;     /** of the last uplink, the guess for the next */
+                float trend;            /** smoothed score change per sample, in 0.5 % */
+                uint16_t sentPm25;      /** newest sample of the last uplink */
+                uint16_t sentGas;
+                int8_t sentTrend;       /** -1 falling, 0 flat, 1 rising */
+                uint8_t lastScore;
+                bool hasScore;
+                bool changed;           /** significant change since the last uplink */
+            };
+
+            static const uint32_t MAGIC = 0x55504C31; // "UPL1"
+
+            static const uint32_t DEFAULT_HEARTBEAT_MS = 30UL * 60 * 1000;
+            // EU868 g1 sub-band, ETSI EN 300 220
+            static const uint32_t DUTY_CYCLE_DIVISOR = 100;
+            static const uint32_t FAIR_USE_MS_PER_DAY = 30000;
+            static const uint32_t DAY_MS = 24UL * 60 * 60 * 1000;
+            // a burst of a sixth of the daily limit at most
+            static const uint32_t BUDGET_CAPACITY_MS = FAIR_USE_MS_PER_DAY / 6;
+            static const uint32_t REFILL_MS_PER_DAY = FAIR_USE_MS_PER_DAY - BUDGET_CAPACITY_MS;
+            // adaptive uplinks are short, the newest few samples: the fair
+            // use budget buys more of them, which keeps the network closer
+            // to the air than fewer full ones (the DR3 limit, about 8 samples)
+            static const size_t MAX_PAYLOAD = 115;
+            // guess for the first uplink, a full batch at DR5
+            static const uint32_t DEFAULT_TOA_MS = 400;
+            static const uint32_t NEVER = UINT32_MAX;
+
+            static const uint16_t PM_CHANGE = 5;          /** ug/m3, and PM_RELATIVE_CHANGE of the value */
+            static const float PM_RELATIVE_CHANGE;
+            static const uint16_t PM_BAND_HYSTERESIS = 2; /** ug/m3 past a band edge */
+            static const float GAS_RELATIVE_CHANGE;
+            static const float TREND_ALPHA;
+            static const float TREND_THRESHOLD;           /** 0.5 % of score per sample */
+
+            UplinkScheduler(int policy, size_t batchSize, State& state);
+
+            // Starts over on a cold boot or if the RTC state is damaged;
+            // afterwards the first sample is sent as soon as allowed
+            void restore(uint32_t nowMs);
+            // Policy and heartbeat interval, e.g. from the settings; takes
+            // effect with the next due()
+            void configure(int policy, uint32_t heartbeatMs);
+            int getPolicy() const { return policy; }
+            // Payload size for the next uplink given the limit of the data rate
+            size_t getMaxPayload(size_t limit) const;
+
+            // Every sample as it is queued
+            void observe(const Sample& sample);
+
+            // Whether to send now with queued samples waiting. The queries
+            // only read the state, the calls below change it.
+            Reason due(uint32_t nowMs, size_t queued) const;
+            // ms until due() gives a reason if no more samples are queued,
+            // NEVER if it does not
+            uint32_t untilDueMs(uint32_t nowMs, size_t queued) const;
+            // ms until the duty cycle and the fair use budget allow the next
+            // uplink, 0 if they do now
+            uint32_t holdOffMs(uint32_t nowMs) const;
+
+            // An uplink with newest as its newest sample took toaMs on air
+            void sent(uint32_t nowMs, uint32_t toaMs, const Sample& newest);
+            // Airtime of any other transmission (fetching pending downlinks)
+            void spend(uint32_t nowMs, uint32_t toaMs);
+
+            // Fair use airtime available now
+            float getBudgetMs(uint32_t nowMs) const;
+
+            static const char* policyName(int policy);
+
+#if !defined(ESP32)
+            // Host builds: the policy of every scheduler whatever it is
+            // configured to
+            static void overridePolicy(int policy);
+#endif
+
+        private:
+            bool isSignificant(const Sample& sample) const;
+            static int band(uint16_t pm25);
+            int trendSign() const;
+
+            int policy;
+            size_t batchSize;
+            uint32_t heartbeatMs;
+            State& state;
+    };
+
+}
+
+#endif // UPLINK_SCHEDULER_H
@@ -0,0 +1,177 @@
+#include "Log.h"
+#include <Arduino.h>
+#include <atomic>
+#include <cstdio>
+#include "../HAL/Hal.h"
+#include "../Tasks/MpscQueue.h"
+
+#ifndef LOG_RING_SIZE
+#define LOG_RING_SIZE 64
+#endif
+
+namespace SmartAirControl {
+namespace logging {
+
+    static const char* const TAG_NAMES[] = { "APP", "BME680", "PMS5003", "FAN", "GPS", "LoRaWAN" };
+    static const size_t TAG_COUNT = sizeof(TAG_NAMES) / sizeof(TAG_NAMES[0]);
+
+#if LOG_ANY_ENABLED
+    static MpscQueue<Record, LOG_RING_SIZE> ring;
+#endif
+    static std::atomic<uint32_t> dropped(0);
+
+    uint32_t now() {
+        return hal::millis();
+    }
+
+    bool push(const Record& record) {
+#if LOG_ANY_ENABLED
+        if (!ring.push(record)) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+#else
+        (void)record;
+        return false;
+#endif
+    }
+
+    void writeHex(uint8_t tag, uint8_t level, const char* label, const uint8_t* data, size_t size) {
+        // the bytes go into the argument slots, continuation records have no label
+        const size_t perRecord = sizeof(Record::args);
+        size_t offset = 0;
+        do {
+            Record record;
+            record.time = now();
+            record.format = offset == 0 ? label : nullptr;
+            record.tag = tag;
+            record.level = level;
+            record.count = size - offset < perRecord ? size - offset : perRecord;
+            record.hex = true;
+            std::memcpy(record.args, &data[offset], record.count);
+            offset += record.count;
+            push(record);
+        } while (offset < size);
+    }
+
+    uint32_t getDropped() {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+    static float toFloat(uint32_t bits) {
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    static size_t clamp(int written, size_t size) {
+        if (written < 0 || size == 0) {
+            return 0;
+        }
+        return static_cast<size_t>(written) < size ? written : size - 1;
+    }
+
+    // Appends the printf conversion spec (flags, width, precision, without
+    // length modifiers) at format to buffer, formatted with value
+    static size_t convert(const char*& format, uint32_t value, char* buffer, size_t size) {
+        char spec[16];
+        size_t length = 0;
+        spec[length++] = *format++;
+        while (*format != '\0' && std::strchr("-+ #0123456789.", *format) != nullptr && length < sizeof(spec) - 2) {
+            spec[length++] = *format++;
+        }
+        while (*format == 'l' || *format == 'h' || *format == 'z') {
+            format++;
+        }
+        char conversion = *format;
+        if (conversion == '\0') {
+            return 0;
+        }
+        format++;
+        spec[length++] = conversion;
+        spec[length] = '\0';
+
+        int written;
+        switch (conversion) {
+            case 'd':
+            case 'i':
+                written = std::snprintf(buffer, size, spec, static_cast<int>(static_cast<int32_t>(value)));
+                break;
+            case 'f':
+            case 'e':
+            case 'g':
+                written = std::snprintf(buffer, size, spec, static_cast<double>(toFloat(value)));
+                break;
+            case 'c':
+                written = std::snprintf(buffer, size, spec, static_cast<int>(value));
+                break;
+            default:
+                written = std::snprintf(buffer, size, spec, static_cast<unsigned>(value));
+                break;
+        }
+        return clamp(written, size);
+    }
+
+    size_t format(const Record& record, char* buffer, size_t size) {
+        const char* level = record.level == LOG_LEVEL_ERROR ? "ERROR " : (record.level == LOG_LEVEL_WARN ? "WARN " : "");
+        size_t length = clamp(std::snprintf(buffer, size, "%7lu [%s] %s", static_cast<unsigned long>(record.time),
+                                            record.tag < TAG_COUNT ? TAG_NAMES[record.tag] : "?", level), size);
+
+        if (record.hex) {
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(record.args);
+            if (record.format != nullptr) {
+                length += clamp(std::snprintf(&buffer[length], size - length, "%s", record.format), size - length);
+            }
+            for (size_t i = 0; i < record.count; i++) {
+                length += clamp(std::snprintf(&buffer[length], size - length, " %02X", bytes[i]), size - length);
+            }
+            return length;
+        }
+
+        const char* p = record.format;
+        size_t next = 0;
+        while (*p != '\0' && length + 1 < size) {
+            if (p[0] != '%') {
+                buffer[length++] = *p++;
+            } else if (p[1] == '%') {
+                buffer[length++] = '%';
+                p += 2;
+            } else if (next < record.count) {
+                length += convert(p, record.args[next++], &buffer[length], size - length);
+            } else {
+                // more conversions than arguments, print the rest verbatim
+                buffer[length++] = *p++;
+            }
+        }
+        buffer[length] = '\0';
+        return length;
+    }
+
+    size_t drain(size_t max) {
+        size_t drained = 0;
+#if LOG_ANY_ENABLED
+        char line[160];
+        Record record;
+        while (drained < max && ring.pop(record)) {
+            format(record, line, sizeof(line));
+            Serial.println(line);
+            drained++;
+        }
+
+        static uint32_t reported = 0;
+        uint32_t lost = getDropped();
+        if (lost != reported) {
+            std::snprintf(line, sizeof(line), "%7lu [LOG] WARN %lu records dropped", static_cast<unsigned long>(now()),
+                          static_cast<unsigned long>(lost - reported));
+            Serial.println(line);
+            reported = lost;
+        }
+#else
+        (void)max;
+#endif
+        return drained;
+    }
+
+}
+}
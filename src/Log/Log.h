@@ -0,0 +1,161 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Leveled logging with per-module tags.
+//
+//  LOG_INFO(FAN, "Duty %d -> %d RPM", duty, rpm);
+//
+// The level is fixed at compile time: LOG_LEVEL for everything, LOG_LEVEL_<TAG>
+// (e.g. -D LOG_LEVEL_GPS=LOG_LEVEL_DEBUG) for a single module. A disabled
+// statement is still type checked but its arguments are never evaluated and
+// no code or string is left in the binary, so LOG_LEVEL=LOG_LEVEL_NONE
+// (env:release) compiles all diagnostics out.
+//
+// An enabled statement does not format or print. It stores the format
+// pointer and the raw argument values as a binary record in a lock-free ring;
+// the log task formats and writes the records to the console later, off the
+// hot path. Formats must therefore be string literals, and the arguments
+// numbers (%d %i %u %x %X %o %c %f %e %g, l/h modifiers are ignored); there
+// is no %s. When the ring is full, records are dropped and counted.
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// Modules, in the order of SmartAirControl::logging::TAG_NAMES
+#define LOG_TAG_APP 0
+#define LOG_TAG_BME 1
+#define LOG_TAG_PMS 2
+#define LOG_TAG_FAN 3
+#define LOG_TAG_GPS 4
+#define LOG_TAG_LORA 5
+
+#ifndef LOG_LEVEL_APP
+#define LOG_LEVEL_APP LOG_LEVEL
+#endif
+#ifndef LOG_LEVEL_BME
+#define LOG_LEVEL_BME LOG_LEVEL
+#endif
+#ifndef LOG_LEVEL_PMS
+#define LOG_LEVEL_PMS LOG_LEVEL
+#endif
+#ifndef LOG_LEVEL_FAN
+#define LOG_LEVEL_FAN LOG_LEVEL
+#endif
+#ifndef LOG_LEVEL_GPS
+#define LOG_LEVEL_GPS LOG_LEVEL
+#endif
+#ifndef LOG_LEVEL_LORA
+#define LOG_LEVEL_LORA LOG_LEVEL
+#endif
+
+// Whether any module logs at all, usable in #if
+#define LOG_ANY_ENABLED (LOG_LEVEL_APP > 0 || LOG_LEVEL_BME > 0 || LOG_LEVEL_PMS > 0 || \
+                         LOG_LEVEL_FAN > 0 || LOG_LEVEL_GPS > 0 || LOG_LEVEL_LORA > 0)
+
+#define LOG_ENABLED(tag, level) (LOG_LEVEL_##tag >= (level))
+
+#define LOG_AT(level, tag, ...)                                                            \
+    do {                                                                                   \
+        if (LOG_ENABLED(tag, level)) {                                                     \
+            ::SmartAirControl::logging::write(LOG_TAG_##tag, level, __VA_ARGS__);          \
+        }                                                                                  \
+    } while (0)
+
+#define LOG_ERROR(tag, ...) LOG_AT(LOG_LEVEL_ERROR, tag, __VA_ARGS__)
+#define LOG_WARN(tag, ...) LOG_AT(LOG_LEVEL_WARN, tag, __VA_ARGS__)
+#define LOG_INFO(tag, ...) LOG_AT(LOG_LEVEL_INFO, tag, __VA_ARGS__)
+#define LOG_DEBUG(tag, ...) LOG_AT(LOG_LEVEL_DEBUG, tag, __VA_ARGS__)
+
+// Hex dump of size bytes behind data, label is the format of the first line
+#define LOG_HEX(level, tag, label, data, size)                                             \
+    do {                                                                                   \
+        if (LOG_ENABLED(tag, level)) {                                                     \
+            ::SmartAirControl::logging::writeHex(LOG_TAG_##tag, level, label, data, size); \
+        }                                                                                  \
+    } while (0)
+
+namespace SmartAirControl {
+namespace logging {
+
+    static const size_t MAX_ARGS = 6;
+
+    struct Record {
+        uint32_t time;          /** hal::millis() when logged */
+        const char* format;     /** string literal, or the label of a hex dump */
+        uint8_t tag;
+        uint8_t level;
+        uint8_t count;          /** arguments, or bytes of a hex dump */
+        bool hex;
+        uint32_t args[MAX_ARGS];
+    };
+
+    bool push(const Record& record);
+    uint32_t now();
+
+    inline uint32_t arg(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    inline uint32_t arg(double value) {
+        return arg(static_cast<float>(value));
+    }
+
+    template <typename T>
+    inline uint32_t arg(T value) {
+        static_assert(std::is_integral<T>::value || std::is_enum<T>::value,
+                      "log arguments must be numbers, strings cannot be deferred");
+        return static_cast<uint32_t>(value);
+    }
+
+    inline void fill(Record&, size_t) {
+    }
+
+    template <typename T, typename... Rest>
+    inline void fill(Record& record, size_t i, T value, Rest... rest) {
+        record.args[i] = arg(value);
+        fill(record, i + 1, rest...);
+    }
+
+    template <typename... Args>
+    inline void write(uint8_t tag, uint8_t level, const char* format, Args... args) {
+        static_assert(sizeof...(Args) <= MAX_ARGS, "too many log arguments");
+        Record record;
+        record.time = now();
+        record.format = format;
+        record.tag = tag;
+        record.level = level;
+        record.count = sizeof...(Args);
+        record.hex = false;
+        fill(record, 0, args...);
+        push(record);
+    }
+
+    void writeHex(uint8_t tag, uint8_t level, const char* label, const uint8_t* data, size_t size);
+
+    // Formats and prints up to max queued records, returns how many. Called by
+    // the log task; only one caller at a time.
+    size_t drain(size_t max);
+    // Records lost to a full ring since start
+    uint32_t getDropped();
+
+    // Formats one record into buffer, returns the length
+    size_t format(const Record& record, char* buffer, size_t size);
+
+}
+}
+
+#endif // LOG_H
@@ -1,58 +1,84 @@
 #include "PMS.h"
+#include "../Log/Log.h"
 
 namespace SmartAirControl {
 
+  // Active mode sends a frame about every second. Listening starts
+  // FRAME_GUARD_MS early: a frame takes 33 ms at 9600 baud, and update()
+  // may only see it one sensor task step later.
+  static const uint32_t FRAME_PERIOD_MS = 1000;
+  static const uint32_t FRAME_GUARD_MS = 80;
+
   SmartAirControl::PMS::PMS(int rxPin, int txPin, unsigned long serialBaud, SerialConfig serialConfig) 
-      : pmsSerial(HardwareSerial(2)), serialBaud(serialBaud), serialConfig(serialConfig), rxPin(rxPin), txPin(txPin), pms(Adafruit_PM25AQI()) {
+      : lastFrameCount(0), lastFrameTime(0), framePeriod(FRAME_PERIOD_MS), framed(false), pmsSerial(hal::serialPort(2)), serialBaud(serialBaud), serialConfig(serialConfig), rxPin(rxPin), txPin(txPin) {
   }
 
   void SmartAirControl::PMS::setup() {
     pmsSerial.begin(9600, SERIAL_8N1, 16, 17);
-      
-    if (!pms.begin_UART(&pmsSerial)) {
-      Serial.println("[PMS5003] Could not find PMS5003 sensor, check wiring!");
-      while (1) {
-        delay(10);
+    framed = false;
+  }
+
+  bool PMS::update() {
+    bool updated = false;
+    int available = pmsSerial.available();
+    while (available-- > 0) {
+      updated |= parser.push(pmsSerial.read());
+    }
+
+    if (updated) {
+      uint32_t now = hal::millis();
+      uint32_t interval = now - lastFrameTime;
+      // a missed frame is not a period
+      if (parser.getFrameCount() > 1 && interval < 2 * framePeriod) {
+        framePeriod += ((int32_t)interval - (int32_t)framePeriod) / 4;
       }
+      lastFrameTime = now;
+      framed = true;
     }
+    return updated;
+  }
+
+  uint32_t PMS::getMsUntilFrame() {
+    uint32_t sinceFrame = hal::millis() - lastFrameTime;
+    if (!parser.hasFrame() || sinceFrame + FRAME_GUARD_MS >= framePeriod) {
+      return 0;
+    }
+    return framePeriod - FRAME_GUARD_MS - sinceFrame;
+  }
+
+  bool PMS::hasFrame() const {
+    return framed;
+  }
+
+  const PMSParser& PMS::getParser() const {
+    return parser;
   }
     
   PM25_AQI_Data SmartAirControl::PMS::read() {
-    data = PM25_AQI_Data();
-    if (!pms.read(&data)) {
-      Serial.println("[PMS5003] Could not read from PMS5003 sensor!");
-      return data;
+    update();
+
+    if (parser.getFrameCount() == lastFrameCount) {
+      LOG_WARN(PMS, "No new frame from PMS5003 sensor!");
+      return parser.latest();
     }
+    lastFrameCount = parser.getFrameCount();
 
     printSensorData();
 
-    return data;
+    return parser.latest();
   }
 
   void PMS::printSensorData() {
-    Serial.println("[PMS5003]");
-    Serial.println("---------------------------------------");
-    Serial.println("Concentration Units (standard)");
-    Serial.print("PM 1.0: "); Serial.print(data.pm10_standard);
-    Serial.print("\tPM 2.5: "); Serial.print(data.pm25_standard);
-    Serial.print("\tPM 10.0: "); Serial.print(data.pm100_standard);
-    Serial.println(" ug/m3");
-
-    Serial.println("---------------------------------------");
-    Serial.println("Concentration Units (environmental)");
-    Serial.print("PM 1.0: "); Serial.print(data.pm10_env);
-    Serial.print("\tPM 2.5: "); Serial.print(data.pm25_env);
-    Serial.print("\tPM 10.0: "); Serial.print(data.pm100_env);
-    Serial.println(" ug/m3");
-
-    Serial.println("---------------------------------------");
-    Serial.print("Particles > 0.3um / 0.1L air: "); Serial.println(data.particles_03um);
-    Serial.print("Particles > 0.5um / 0.1L air: "); Serial.println(data.particles_05um);
-    Serial.print("Particles > 1.0um / 0.1L air: "); Serial.println(data.particles_10um);
-    Serial.print("Particles > 2.5um / 0.1L air: "); Serial.println(data.particles_25um);
-    Serial.print("Particles > 5.0um / 0.1L air: "); Serial.println(data.particles_50um);
-    Serial.print("Particles > 10.0 um / 0.1L air: "); Serial.println(data.particles_100um);
-    Serial.println("---------------------------------------");
+    const PM25_AQI_Data& data = parser.latest();
+    LOG_DEBUG(PMS, "Standard      PM 1.0: %u  PM 2.5: %u  PM 10.0: %u ug/m3",
+              data.pm10_standard, data.pm25_standard, data.pm100_standard);
+    LOG_DEBUG(PMS, "Environmental PM 1.0: %u  PM 2.5: %u  PM 10.0: %u ug/m3",
+              data.pm10_env, data.pm25_env, data.pm100_env);
+    LOG_DEBUG(PMS, "Particles / 0.1L air  >0.3um: %u  >0.5um: %u  >1.0um: %u  >2.5um: %u  >5.0um: %u  >10um: %u",
+              data.particles_03um, data.particles_05um, data.particles_10um,
+              data.particles_25um, data.particles_50um, data.particles_100um);
+    LOG_DEBUG(PMS, "Frames: %lu  Checksum errors: %lu  Resyncs: %lu",
+              parser.getFrameCount(), parser.getChecksumErrors(), parser.getResyncs());
   }
 
 }
\ No newline at end of file
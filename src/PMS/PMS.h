@@ -1,6 +1,7 @@
 #include <Arduino.h>
-#include <HardwareSerial.h>
+#include "../HAL/Hal.h"
 #include <Adafruit_PM25AQI.h>
+#include "PMSParser.h"
 
 namespace SmartAirControl {
 
@@ -9,14 +10,27 @@ namespace SmartAirControl {
             PMS(int rxPin, int txPin, unsigned long serialBaud, SerialConfig serialConfig);
             PM25_AQI_Data read();
             void setup();
+            // Feeds whatever the UART has buffered into the parser, returns true
+            // if a new valid frame arrived. Cheap enough to call every loop().
+            bool update();
+            // A frame arrived since setup(), read() holds a measurement
+            bool hasFrame() const;
+            const PMSParser& getParser() const;
+            // The UART only receives while the CPU is awake. Time until the
+            // next frame is expected (the sensor's period is learnt from the
+            // frames), 0 while one is due or the frames are out of sight.
+            uint32_t getMsUntilFrame();
             void printSensorData();
         private:
-            PM25_AQI_Data data;
-            HardwareSerial pmsSerial;
+            PMSParser parser;
+            uint32_t lastFrameCount;
+            uint32_t lastFrameTime;   /** hal::millis() when update() saw the last frame */
+            uint32_t framePeriod;     /** ms, smoothed */
+            bool framed;
+            hal::SerialPort& pmsSerial;
             unsigned long serialBaud;
             SerialConfig serialConfig;
             int rxPin;
             int txPin;
-            Adafruit_PM25AQI pms;
     };
 }
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include "PMSParser.h"
+
+namespace SmartAirControl {
+
+    PMSParser::PMSParser()
+        : published(0), position(0), highByte(0), sum(0), frameCount(0), checksumErrors(0), resyncs(0) {
+        frames[0] = PM25_AQI_Data();
+        frames[1] = PM25_AQI_Data();
+    }
+
+    bool PMSParser::push(uint8_t b) {
+        if (position == 0) {
+            if (b != START_1) {
+                return false;
+            }
+            sum = b;
+            position = 1;
+            return false;
+        }
+
+        if (position == 1) {
+            if (b != START_2) {
+                resync(b);
+                return false;
+            }
+            sum += b;
+            position = 2;
+            return false;
+        }
+
+        // from here on bytes pair up into big endian words
+        if ((position & 1) == 0) {
+            highByte = b;
+            if (position < FRAME_SIZE - 2) {
+                sum += b;
+            }
+            position++;
+            return false;
+        }
+
+        uint16_t value = (static_cast<uint16_t>(highByte) << 8) | b;
+        uint8_t word = (position - 3) / 2; // 0 = length, 1..13 = data, 14 = checksum
+        position++;
+
+        if (word == 0) {
+            if (value != FRAME_LENGTH) {
+                // a stray header: either byte of the word may start the
+                // next frame, e.g. 0x42 0x4D right after it
+                resyncs++;
+                position = 0;
+                push(highByte);
+                push(b);
+                return false;
+            }
+            sum += b;
+            frames[published ^ 1].framelen = value;
+            return false;
+        }
+
+        if (position < FRAME_SIZE) {
+            sum += b;
+            storeWord(word, value);
+            return false;
+        }
+
+        position = 0;
+        if (value != sum) {
+            checksumErrors++;
+            return false;
+        }
+
+        frames[published ^ 1].checksum = value;
+        published ^= 1;
+        frameCount++;
+        return true;
+    }
+
+    void PMSParser::resync(uint8_t b) {
+        resyncs++;
+        position = 0;
+        // the offending byte may itself start the next frame
+        push(b);
+    }
+
+    void PMSParser::storeWord(uint8_t index, uint16_t value) {
+        PM25_AQI_Data& frame = frames[published ^ 1];
+        switch (index) {
+            case 1: frame.pm10_standard = value; break;
+            case 2: frame.pm25_standard = value; break;
+            case 3: frame.pm100_standard = value; break;
+            case 4: frame.pm10_env = value; break;
+            case 5: frame.pm25_env = value; break;
+            case 6: frame.pm100_env = value; break;
+            case 7: frame.particles_03um = value; break;
+            case 8: frame.particles_05um = value; break;
+            case 9: frame.particles_10um = value; break;
+            case 10: frame.particles_25um = value; break;
+            case 11: frame.particles_50um = value; break;
+            case 12: frame.particles_100um = value; break;
+            case 13: frame.unused = value; break;
+            default: break;
+        }
+    }
+
+}
@@ -0,0 +1,53 @@
+#ifndef PMS_PARSER_H
+#define PMS_PARSER_H
+
+#include <cstdint>
+#include <Adafruit_PM25AQI.h>
+
+namespace SmartAirControl {
+
+    // Incremental PMS5003 frame parser. Bytes are fed one at a time as they
+    // come off the UART; the data words are decoded straight into a back
+    // buffer and the buffers are swapped once the checksum matches, so
+    // latest() always returns the last complete, valid frame.
+    //
+    //  0x42 0x4D | length (28) | 13 data words | checksum
+    //  every word is big endian, the checksum is the byte sum of everything before it
+    class PMSParser {
+        public:
+            static const uint8_t START_1 = 0x42;
+            static const uint8_t START_2 = 0x4D;
+            static const uint16_t FRAME_LENGTH = 28; // data words + checksum
+            static const uint8_t FRAME_SIZE = 4 + FRAME_LENGTH;
+
+            PMSParser();
+
+            // Returns true when b completed a valid frame
+            bool push(uint8_t b);
+
+            const PM25_AQI_Data& latest() const { return frames[published]; }
+            bool hasFrame() const { return frameCount > 0; }
+
+            uint32_t getFrameCount() const { return frameCount; }
+            uint32_t getChecksumErrors() const { return checksumErrors; }
+            uint32_t getResyncs() const { return resyncs; }
+
+        private:
+            void resync(uint8_t b);
+            void storeWord(uint8_t index, uint16_t value);
+
+            PM25_AQI_Data frames[2];
+            uint8_t published;
+
+            uint8_t position;   // bytes of the current frame seen so far
+            uint8_t highByte;
+            uint16_t sum;
+
+            uint32_t frameCount;
+            uint32_t checksumErrors;
+            uint32_t resyncs;
+    };
+
+}
+
+#endif // PMS_PARSER_H
@@ -0,0 +1,84 @@
+#include "PowerManager.h"
+#include "../HAL/Hal.h"
+#include "../Log/Log.h"
+
+namespace SmartAirControl {
+
+#if !defined(ESP32)
+    static int policyOverride = -1;
+
+    void PowerManager::overridePolicy(int policy) {
+        policyOverride = policy;
+    }
+#endif
+
+    PowerManager::PowerManager(int policy, uint32_t deepSleepMs, int wakeupPin)
+        : policy(policy), deepSleepMs(deepSleepMs), wakeupPin(wakeupPin) {
+    }
+
+    const char* PowerManager::policyName(int policy) {
+        switch (policy) {
+            case POWER_LIGHT_SLEEP:
+                return "light sleep";
+            case POWER_DEEP_SLEEP:
+                return "deep sleep";
+            default:
+                return "always on";
+        }
+    }
+
+    void PowerManager::setup() {
+#if !defined(ESP32)
+        if (policyOverride >= 0) {
+            policy = policyOverride;
+        }
+#endif
+        hal::setWakeupPin(wakeupPin);
+
+        // log records cannot carry strings, see Log.h
+        LOG_INFO(APP, "Power policy %d (POWER_POLICY), wakeup cause %d (hal::WakeupCause)", policy, hal::wakeupCause());
+    }
+
+    bool PowerManager::isWakeFromDeepSleep() const {
+        return hal::wakeupCause() != hal::WAKEUP_POWER_ON;
+    }
+
+    void PowerManager::setAwakeCondition(std::function<bool()> condition) {
+        awakeCondition = condition;
+    }
+
+    void PowerManager::setDeepSleepCondition(std::function<bool()> condition) {
+        deepSleepCondition = condition;
+    }
+
+    void PowerManager::setBeforeDeepSleep(std::function<void()> callback) {
+        beforeDeepSleep = callback;
+    }
+
+    void PowerManager::setAfterLightSleep(std::function<void(uint32_t)> callback) {
+        afterLightSleep = callback;
+    }
+
+    void PowerManager::idle(uint32_t idleMs) {
+        bool awake = policy == POWER_ALWAYS_ON || (awakeCondition && awakeCondition());
+
+        if (!awake && policy == POWER_DEEP_SLEEP && deepSleepCondition && deepSleepCondition()) {
+            LOG_INFO(APP, "Deep sleep for %lu ms", deepSleepMs);
+            if (beforeDeepSleep) {
+                beforeDeepSleep();
+            }
+            hal::deepSleep(deepSleepMs);
+        }
+
+        if (awake || idleMs < MIN_LIGHT_SLEEP_MS) {
+            hal::delay(idleMs);
+            return;
+        }
+
+        uint32_t slept = hal::lightSleep(idleMs);
+        if (afterLightSleep) {
+            afterLightSleep(slept);
+        }
+    }
+
+}
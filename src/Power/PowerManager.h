@@ -0,0 +1,71 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <cstdint>
+#include <functional>
+
+// Power policy selected by the POWER_POLICY build flag
+#define POWER_ALWAYS_ON 0   // the CPU idles in the scheduler between task steps
+#define POWER_LIGHT_SLEEP 1 // light sleep whenever every task waits
+#define POWER_DEEP_SLEEP 2  // light sleep, and deep sleep while the purifier has nothing to do
+
+#ifndef POWER_POLICY
+#define POWER_POLICY POWER_ALWAYS_ON
+#endif
+
+namespace SmartAirControl {
+
+    // Decides what the CPU does until the next task is due (sensor poll, fan
+    // update, uplink), as the idle handler of the tasks (setIdleHandler()).
+    //
+    // Light sleep keeps RAM and the fan PWM, but the tach and the UARTs stop,
+    // so whoever needs them keeps the CPU awake through the awake condition.
+    // Deep sleep is for when the application says it has nothing to do
+    // (deep sleep condition): it powers down for the deep sleep interval and
+    // the firmware boots again, restoring its state from RTC memory.
+    class PowerManager {
+        public:
+            PowerManager(int policy, uint32_t deepSleepMs, int wakeupPin = -1);
+
+            // Configures the wakeup pin and logs why the firmware is running
+            void setup();
+            int getPolicy() const { return policy; }
+            // Booted from a deep sleep, as opposed to power on or reset
+            bool isWakeFromDeepSleep() const;
+
+            // True while something needs the CPU awake
+            void setAwakeCondition(std::function<bool()> condition);
+            // True when the application may power down
+            void setDeepSleepCondition(std::function<bool()> condition);
+            // Runs before powering down, to put state into RTC memory
+            void setBeforeDeepSleep(std::function<void()> callback);
+            // Runs after a light sleep with the ms slept
+            void setAfterLightSleep(std::function<void(uint32_t)> callback);
+
+            // Waits or sleeps for up to idleMs
+            void idle(uint32_t idleMs);
+
+            // Entering and leaving light sleep takes about a ms
+            static const uint32_t MIN_LIGHT_SLEEP_MS = 5;
+
+            static const char* policyName(int policy);
+
+#if !defined(ESP32)
+            // Host builds: the policy of every PowerManager from its setup() on
+            static void overridePolicy(int policy);
+#endif
+
+        private:
+            int policy;
+            uint32_t deepSleepMs;
+            int wakeupPin;
+
+            std::function<bool()> awakeCondition;
+            std::function<bool()> deepSleepCondition;
+            std::function<void()> beforeDeepSleep;
+            std::function<void(uint32_t)> afterLightSleep;
+    };
+
+}
+
+#endif // POWER_MANAGER_H
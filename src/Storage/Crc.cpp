@@ -0,0 +1,16 @@
+#include "Crc.h"
+
+namespace SmartAirControl {
+
+    uint16_t crc16(const void* data, size_t length, uint16_t crc) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < length; i++) {
+            crc ^= static_cast<uint16_t>(bytes[i]) << 8;
+            for (uint8_t bit = 0; bit < 8; bit++) {
+                crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+            }
+        }
+        return crc;
+    }
+
+}
@@ -0,0 +1,15 @@
+#ifndef CRC_H
+#define CRC_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace SmartAirControl {
+
+    // CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF). Pass the previous result
+    // as crc to checksum data spread over several buffers.
+    uint16_t crc16(const void* data, size_t length, uint16_t crc = 0xFFFF);
+
+}
+
+#endif // CRC_H
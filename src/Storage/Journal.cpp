@@ -0,0 +1,132 @@
+#include "Journal.h"
+#include <cstddef>
+#include "Crc.h"
+
+namespace SmartAirControl {
+
+    // slots start on flash word boundaries
+    static const size_t SLOT_ALIGN = 16;
+    // read in pieces of this size, the stack is small
+    static const size_t CHUNK = 64;
+
+    Journal::Journal(hal::Flash& flash, uint16_t version, size_t recordSize)
+        : flash(flash), version(version), recordSize(recordSize),
+          slotSize((sizeof(Header) + recordSize + SLOT_ALIGN - 1) / SLOT_ALIGN * SLOT_ALIGN),
+          slotsPerSector(hal::Flash::SECTOR_SIZE / slotSize), slots(0), next(0), newest(0), sequence(0),
+          recovered(false) {
+    }
+
+    size_t Journal::offset(size_t slot) const {
+        return slot / slotsPerSector * hal::Flash::SECTOR_SIZE + slot % slotsPerSector * slotSize;
+    }
+
+    bool Journal::isBlank(size_t offset, size_t size) {
+        uint8_t buffer[CHUNK];
+        for (size_t done = 0; done < size; done += CHUNK) {
+            size_t length = size - done < CHUNK ? size - done : CHUNK;
+            if (!flash.read(offset + done, buffer, length)) {
+                return false;
+            }
+            for (size_t i = 0; i < length; i++) {
+                if (buffer[i] != 0xFF) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    uint16_t Journal::checksum(const Header& header, size_t slot) {
+        uint16_t crc = crc16(&header, offsetof(Header, crc));
+        uint8_t buffer[CHUNK];
+        size_t start = offset(slot) + sizeof(Header);
+        for (size_t done = 0; done < recordSize; done += CHUNK) {
+            size_t length = recordSize - done < CHUNK ? recordSize - done : CHUNK;
+            if (!flash.read(start + done, buffer, length)) {
+                // cannot match a stored CRC of a complete slot
+                return ~header.crc;
+            }
+            crc = crc16(buffer, length, crc);
+        }
+        return crc;
+    }
+
+    bool Journal::isValid(size_t slot, Header& header) {
+        return flash.read(offset(slot), &header, sizeof(header)) && header.magic == MAGIC &&
+               header.version == version && header.length == recordSize && header.crc == checksum(header, slot);
+    }
+
+    bool Journal::recover(void* record) {
+        size_t sectors = flash.size() / hal::Flash::SECTOR_SIZE;
+        slots = sectors >= 2 && slotsPerSector > 0 ? sectors * slotsPerSector : 0;
+        next = 0;
+        newest = 0;
+        sequence = 0;
+        recovered = true;
+
+        for (size_t slot = 0; slot < slots; slot++) {
+            Header header;
+            if (isValid(slot, header) && header.sequence > sequence) {
+                newest = slot;
+                sequence = header.sequence;
+            }
+        }
+        if (sequence == 0) {
+            return false;
+        }
+
+        next = (newest + 1) % slots;
+        return record == nullptr || flash.read(offset(newest) + sizeof(Header), record, recordSize);
+    }
+
+    bool Journal::append(const void* record) {
+        if (!recovered) {
+            recover(nullptr);
+        }
+
+        for (size_t tried = 0; tried < slots; tried++) {
+            size_t slot = next;
+            next = (next + 1) % slots;
+
+            if (slot % slotsPerSector == 0) {
+                size_t sector = slot / slotsPerSector;
+                if (sequence > 0 && sector == newest / slotsPerSector) {
+                    // every other slot is torn, the newest record stays
+                    return false;
+                }
+                // the appends came round: what the sector holds is older
+                // than the newest record, in the sector before
+                if (!isBlank(sector * hal::Flash::SECTOR_SIZE, hal::Flash::SECTOR_SIZE) &&
+                    !flash.eraseSector(sector)) {
+                    return false;
+                }
+            }
+            if (!isBlank(offset(slot), slotSize)) {
+                // torn by a power loss
+                continue;
+            }
+
+            Header header;
+            header.magic = MAGIC;
+            header.sequence = sequence + 1;
+            header.version = version;
+            header.length = static_cast<uint16_t>(recordSize);
+            header.reserved = 0xFFFF;
+            header.crc = crc16(record, recordSize, crc16(&header, offsetof(Header, crc)));
+            if (!flash.write(offset(slot), &header, sizeof(header)) ||
+                !flash.write(offset(slot) + sizeof(header), record, recordSize)) {
+                return false;
+            }
+
+            // read back, a worn cell may not have taken the data
+            Header written;
+            if (isValid(slot, written)) {
+                newest = slot;
+                sequence = header.sequence;
+                return true;
+            }
+        }
+        return false;
+    }
+
+}
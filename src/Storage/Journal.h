@@ -0,0 +1,70 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include "../HAL/Hal.h"
+
+namespace SmartAirControl {
+
+    // Records of a fixed size appended round a raw flash partition
+    // (hal::Flash), one per slot; the valid slot with the highest sequence
+    // number is the record. A slot header carries the sequence, the record
+    // version and length and a CRC over them and the record.
+    //
+    // Only blank slots are programmed. A sector is erased when the appends
+    // come round to its first slot, so each sector is erased once per pass
+    // over the partition and the wear spreads over all of them; the sector
+    // holding the newest record is never erased.
+    //
+    // A power loss in the middle of append() leaves a torn slot, which fails
+    // its CRC, or a partly erased sector; recover() passes over both and the
+    // previous record stays the newest. Records of another version or length
+    // (an older layout) count as none.
+    class Journal {
+        public:
+            static const uint32_t MAGIC = 0x4C4E524A; // "JRNL"
+
+            struct Header {
+                uint32_t magic;
+                uint32_t sequence;
+                uint16_t version;
+                uint16_t length;
+                uint16_t crc;
+                uint16_t reserved; /** left erased */
+            };
+
+            Journal(hal::Flash& flash, uint16_t version, size_t recordSize);
+
+            // Scans the partition for the newest valid record and reads it
+            // into record (if not null), false if there is none
+            bool recover(void* record);
+
+            // Writes record to the next blank slot, false if the flash failed
+            bool append(const void* record);
+
+            // 0 without a partition of at least two sectors
+            size_t getSlots() const { return slots; }
+            uint32_t getSequence() const { return sequence; }
+
+        private:
+            size_t offset(size_t slot) const;
+            bool isBlank(size_t offset, size_t size);
+            bool isValid(size_t slot, Header& header);
+            uint16_t checksum(const Header& header, size_t slot);
+
+            hal::Flash& flash;
+            uint16_t version;
+            size_t recordSize;
+            size_t slotSize;
+            size_t slotsPerSector;
+            size_t slots;
+            size_t next;       /** where append() starts looking */
+            size_t newest;     /** slot of the newest record */
+            uint32_t sequence; /** of the newest record, 0 for none */
+            bool recovered;
+    };
+
+}
+
+#endif // JOURNAL_H
@@ -0,0 +1,103 @@
+#include "RtcSampleRing.h"
+#include "Crc.h"
+
+namespace SmartAirControl {
+
+    RtcSampleRing::RtcSampleRing(Storage& storage) : storage(storage) {
+        current.magic = MAGIC;
+        current.sequence = 0;
+        current.head = 0;
+        current.count = 0;
+        current.crc = checksum(current);
+    }
+
+    size_t RtcSampleRing::restore() {
+        const Header& a = storage.headers[0];
+        const Header& b = storage.headers[1];
+        bool aValid = isValid(a);
+        bool bValid = isValid(b);
+
+        if (!aValid && !bValid) {
+            clear();
+            return 0;
+        }
+
+        // sequence numbers are compared by difference so wrap-around is harmless
+        if (aValid && (!bValid || static_cast<int32_t>(a.sequence - b.sequence) > 0)) {
+            current = a;
+        } else {
+            current = b;
+        }
+
+        // drop damaged records; everything behind the first bad one is suspect
+        size_t valid = 0;
+        while (valid < current.count && isValid(record(valid))) {
+            valid++;
+        }
+        if (valid < current.count) {
+            commit(current.head, valid);
+        }
+
+        return current.count;
+    }
+
+    void RtcSampleRing::push(const Sample& sample) {
+        if (isFull()) {
+            // release the oldest slot first so a torn write never hits a live record
+            commit((current.head + 1) % CAPACITY, current.count - 1);
+        }
+
+        Record& slot = storage.records[(current.head + current.count) % CAPACITY];
+        UplinkCodec::putFields(sample, slot.fields);
+        slot.crc = crc16(slot.fields, sizeof(slot.fields));
+
+        commit(current.head, current.count + 1);
+    }
+
+    Sample RtcSampleRing::at(size_t i) const {
+        Sample sample;
+        if (i < current.count) {
+            UplinkCodec::getFields(record(i).fields, sample);
+        }
+        return sample;
+    }
+
+    void RtcSampleRing::pop(size_t n) {
+        if (n > current.count) n = current.count;
+        commit((current.head + n) % CAPACITY, current.count - n);
+    }
+
+    void RtcSampleRing::clear() {
+        commit(0, 0);
+    }
+
+    void RtcSampleRing::commit(uint16_t head, uint16_t count) {
+        Header next;
+        next.magic = MAGIC;
+        next.sequence = current.sequence + 1;
+        next.head = head;
+        next.count = count;
+        next.crc = checksum(next);
+
+        // alternate between both copies, the other one stays intact meanwhile
+        storage.headers[next.sequence & 1] = next;
+        current = next;
+    }
+
+    bool RtcSampleRing::isValid(const Header& header) const {
+        return header.magic == MAGIC && header.head < CAPACITY && header.count <= CAPACITY &&
+               header.crc == checksum(header);
+    }
+
+    bool RtcSampleRing::isValid(const Record& record) const {
+        return record.crc == crc16(record.fields, sizeof(record.fields));
+    }
+
+    uint16_t RtcSampleRing::checksum(const Header& header) {
+        uint16_t crc = crc16(&header.magic, sizeof(header.magic));
+        crc = crc16(&header.sequence, sizeof(header.sequence), crc);
+        crc = crc16(&header.head, sizeof(header.head), crc);
+        return crc16(&header.count, sizeof(header.count), crc);
+    }
+
+}
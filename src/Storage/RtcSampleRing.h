@@ -0,0 +1,76 @@
+#ifndef RTC_SAMPLE_RING_H
+#define RTC_SAMPLE_RING_H
+
+#include <cstddef>
+#include <cstdint>
+#include "../Codec/Sample.h"
+#include "../Codec/UplinkCodec.h"
+
+namespace SmartAirControl {
+
+    // Sample FIFO kept in caller-provided storage, meant to live in RTC memory
+    // (RTC_DATA_ATTR) so queued readings survive deep sleep.
+    //
+    // The ring position is stored in two alternating CRC-guarded headers. A
+    // header is only written after the record it exposes is complete, so a
+    // brown-out in the middle of push() or pop() leaves the previous header
+    // valid. Every record carries its own CRC as well.
+    class RtcSampleRing {
+        public:
+            static const size_t CAPACITY = 64;
+            static const uint32_t MAGIC = 0x53415231; // "SAR1"
+
+            struct Record {
+                uint8_t fields[UplinkCodec::FIELDS_SIZE];
+                uint16_t crc;
+            };
+
+            struct Header {
+                uint32_t magic;
+                uint32_t sequence;
+                uint16_t head;
+                uint16_t count;
+                uint16_t crc;
+            };
+
+            struct Storage {
+                Header headers[2];
+                Record records[CAPACITY];
+            };
+
+            explicit RtcSampleRing(Storage& storage);
+
+            // Picks the newest valid header and drops damaged records. Starts
+            // empty on a cold boot or if both headers are corrupt. Returns the
+            // number of samples recovered.
+            size_t restore();
+
+            // Appends a sample, dropping the oldest one when full
+            void push(const Sample& sample);
+
+            // i = 0 is the oldest entry
+            Sample at(size_t i) const;
+
+            // Drops the n oldest entries, e.g. after they have been sent
+            void pop(size_t n);
+
+            void clear();
+            size_t size() const { return current.count; }
+            bool isFull() const { return current.count == CAPACITY; }
+            static size_t capacity() { return CAPACITY; }
+
+        private:
+            void commit(uint16_t head, uint16_t count);
+            bool isValid(const Header& header) const;
+            bool isValid(const Record& record) const;
+            const Record& record(size_t i) const { return storage.records[(current.head + i) % CAPACITY]; }
+
+            static uint16_t checksum(const Header& header);
+
+            Storage& storage;
+            Header current;
+    };
+
+}
+
+#endif // RTC_SAMPLE_RING_H
@@ -0,0 +1,74 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace SmartAirControl {
+
+    // Lock-free bounded queue for any number of producers (tasks on either
+    // core, interrupt handlers) and exactly one consumer. N must be a power
+    // of two. Every slot carries a sequence number that tells producers
+    // whether it is free and the consumer whether it is complete, so a
+    // producer preempted between claiming and filling a slot only holds up
+    // the consumer, never another producer.
+    template <typename T, size_t N>
+    class MpscQueue {
+        public:
+            MpscQueue() : enqueuePos(0), dequeuePos(0) {
+                static_assert(N >= 2 && (N & (N - 1)) == 0, "N must be a power of two");
+                for (size_t i = 0; i < N; i++) {
+                    slots[i].sequence.store(i, std::memory_order_relaxed);
+                }
+            }
+
+            // Producer side, returns false if the queue is full
+            bool push(const T& item) {
+                uint32_t pos = enqueuePos.load(std::memory_order_relaxed);
+                Slot* slot;
+                for (;;) {
+                    slot = &slots[pos & (N - 1)];
+                    int32_t diff = static_cast<int32_t>(slot->sequence.load(std::memory_order_acquire) - pos);
+                    if (diff == 0) {
+                        if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            break;
+                        }
+                    } else if (diff < 0) {
+                        return false;
+                    } else {
+                        pos = enqueuePos.load(std::memory_order_relaxed);
+                    }
+                }
+                slot->item = item;
+                slot->sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+
+            // Consumer side, returns false if the queue is empty or the
+            // oldest entry is still being written
+            bool pop(T& item) {
+                Slot& slot = slots[dequeuePos & (N - 1)];
+                if (slot.sequence.load(std::memory_order_acquire) != dequeuePos + 1) {
+                    return false;
+                }
+                item = slot.item;
+                slot.sequence.store(dequeuePos + N, std::memory_order_release);
+                dequeuePos++;
+                return true;
+            }
+
+        private:
+            struct Slot {
+                std::atomic<uint32_t> sequence;
+                T item;
+            };
+
+            Slot slots[N];
+            std::atomic<uint32_t> enqueuePos;
+            uint32_t dequeuePos;
+    };
+
+}
+
+#endif // MPSC_QUEUE_H
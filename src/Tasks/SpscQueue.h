@@ -0,0 +1,63 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+namespace SmartAirControl {
+
+    // Lock-free bounded queue for exactly one producer and one consumer task,
+    // which may run on different cores. Holds up to N items.
+    template <typename T, size_t N>
+    class SpscQueue {
+        public:
+            SpscQueue() : head(0), tail(0) {}
+
+            // Producer side, returns false if the queue is full
+            bool push(const T& item) {
+                size_t t = tail.load(std::memory_order_relaxed);
+                size_t next = (t + 1) % SLOTS;
+                if (next == head.load(std::memory_order_acquire)) {
+                    return false;
+                }
+                items[t] = item;
+                tail.store(next, std::memory_order_release);
+                return true;
+            }
+
+            // Consumer side, returns false if the queue is empty
+            bool pop(T& item) {
+                size_t h = head.load(std::memory_order_relaxed);
+                if (h == tail.load(std::memory_order_acquire)) {
+                    return false;
+                }
+                item = items[h];
+                head.store((h + 1) % SLOTS, std::memory_order_release);
+                return true;
+            }
+
+            // Consumer side, drains the queue and keeps only the newest item
+            bool popLatest(T& item) {
+                bool any = false;
+                while (pop(item)) {
+                    any = true;
+                }
+                return any;
+            }
+
+            bool isEmpty() const {
+                return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+            }
+
+        private:
+            // one slot stays free to tell a full queue from an empty one
+            static const size_t SLOTS = N + 1;
+
+            T items[SLOTS];
+            std::atomic<size_t> head;
+            std::atomic<size_t> tail;
+    };
+
+}
+
+#endif // SPSC_QUEUE_H
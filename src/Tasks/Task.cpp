@@ -0,0 +1,170 @@
+#include "Task.h"
+#include "../HAL/Hal.h"
+
+#if defined(ESP32)
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
+namespace SmartAirControl {
+
+    static const size_t MAX_TASKS = 8;
+    static IdleHandler idleHandler = nullptr;
+
+#if defined(ESP32)
+
+    struct RunningTask {
+        Task* task;
+        TaskHandle_t handle;
+        volatile uint32_t due;    /** hal::millis(), which keeps counting in light sleep */
+        volatile bool waiting;
+    };
+
+    static RunningTask tasks[MAX_TASKS];
+    static std::atomic<size_t> taskCount(0);
+
+    static void runTask(void* parameter) {
+        RunningTask* running = static_cast<RunningTask*>(parameter);
+        for (;;) {
+            uint32_t wait = running->task->step();
+            // always yield at least one tick so lower priority tasks and the idle task run
+            TickType_t ticks = pdMS_TO_TICKS(wait);
+            running->due = hal::millis() + wait;
+            running->waiting = true;
+            // the timeout, or wakeDueTasks() after a sleep
+            ulTaskNotifyTake(pdTRUE, ticks > 0 ? ticks : 1);
+            running->waiting = false;
+        }
+    }
+
+    bool startTask(Task& task, const char* name, int core, uint32_t stackSize, unsigned priority) {
+        size_t index = taskCount.load();
+        if (index == MAX_TASKS) {
+            return false;
+        }
+        RunningTask& running = tasks[index];
+        running.task = &task;
+        running.due = hal::millis();
+        running.waiting = false;
+        if (xTaskCreatePinnedToCore(runTask, name, stackSize, &running, priority, &running.handle, core) != pdPASS) {
+            return false;
+        }
+        taskCount.store(index + 1);
+        return true;
+    }
+
+    // Time until the earliest task is due, false if any task is running
+    static bool idleTime(uint32_t& idleMs) {
+        uint32_t now = hal::millis();
+        idleMs = UINT32_MAX;
+        for (size_t i = 0; i < taskCount.load(); i++) {
+            if (!tasks[i].waiting) {
+                return false;
+            }
+            int32_t remaining = static_cast<int32_t>(tasks[i].due - now);
+            uint32_t ms = remaining > 0 ? remaining : 0;
+            idleMs = ms < idleMs ? ms : idleMs;
+        }
+        return taskCount.load() > 0;
+    }
+
+    static void wakeDueTasks() {
+        uint32_t now = hal::millis();
+        for (size_t i = 0; i < taskCount.load(); i++) {
+            if (tasks[i].waiting && static_cast<int32_t>(tasks[i].due - now) <= 0) {
+                xTaskNotifyGive(tasks[i].handle);
+            }
+        }
+    }
+
+    // Runs at the priority of the FreeRTOS idle tasks, so only when both
+    // cores have nothing else to do
+    static void runIdle(void*) {
+        for (;;) {
+            uint32_t idleMs;
+            if (idleTime(idleMs) && idleMs > 0) {
+                idleHandler(idleMs);
+                wakeDueTasks();
+            }
+            vTaskDelay(1);
+        }
+    }
+
+    void setIdleHandler(IdleHandler handler) {
+        bool started = idleHandler != nullptr;
+        idleHandler = handler;
+        if (!started && handler != nullptr) {
+            xTaskCreatePinnedToCore(runIdle, "idle handler", 4096, nullptr, 0, nullptr, 1);
+        }
+    }
+
+#else
+
+    struct ScheduledTask {
+        Task* task;
+        unsigned priority;
+        uint32_t due;
+    };
+
+    static ScheduledTask tasks[MAX_TASKS];
+    static size_t taskCount = 0;
+
+    bool startTask(Task& task, const char* name, int core, uint32_t stackSize, unsigned priority) {
+        (void)name;
+        (void)core;
+        (void)stackSize;
+
+        if (taskCount == MAX_TASKS) {
+            return false;
+        }
+        tasks[taskCount].task = &task;
+        tasks[taskCount].priority = priority;
+        tasks[taskCount].due = hal::millis();
+        taskCount++;
+        return true;
+    }
+
+    void setIdleHandler(IdleHandler handler) {
+        idleHandler = handler;
+    }
+
+    void resetTasks() {
+        taskCount = 0;
+        idleHandler = nullptr;
+    }
+
+    void runTasks(uint32_t untilMs) {
+        for (;;) {
+            ScheduledTask* next = nullptr;
+            for (size_t i = 0; i < taskCount; i++) {
+                ScheduledTask& candidate = tasks[i];
+                if (next == nullptr || static_cast<int32_t>(candidate.due - next->due) < 0 ||
+                    (candidate.due == next->due && candidate.priority > next->priority)) {
+                    next = &candidate;
+                }
+            }
+            if (next == nullptr || static_cast<int32_t>(next->due - untilMs) > 0) {
+                return;
+            }
+
+            uint32_t now = hal::millis();
+            if (static_cast<int32_t>(next->due - now) > 0) {
+                // every task waits
+                if (idleHandler != nullptr) {
+                    idleHandler(next->due - now);
+                } else {
+                    hal::delay(next->due - now);
+                }
+                continue;
+            }
+
+            uint32_t wait = next->task->step();
+            // at least one tick, as under FreeRTOS
+            next->due = hal::millis() + (wait > 0 ? wait : 1);
+        }
+    }
+
+#endif
+
+}
@@ -0,0 +1,44 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <cstdint>
+
+namespace SmartAirControl {
+
+    // A unit of work that is run repeatedly on its own thread. Tasks do not
+    // know whether they run under FreeRTOS or a host scheduler shim; they only
+    // report how long they want to wait until their next step.
+    class Task {
+        public:
+            virtual ~Task() {}
+
+            // Runs one iteration, returns the delay in ms until the next one
+            virtual uint32_t step() = 0;
+    };
+
+    // Runs task until reset. On the ESP32 this creates a FreeRTOS task pinned
+    // to core; on a host build it registers the task with runTasks(), which
+    // ignores core and stackSize.
+    bool startTask(Task& task, const char* name, int core, uint32_t stackSize, unsigned priority);
+
+    // Called with the time in ms until the next task is due whenever every
+    // started task is waiting; it waits or sleeps for up to that long. A task
+    // that is due meanwhile runs as soon as the handler returns, even if the
+    // FreeRTOS tick count stood still while the CPU slept. Without a
+    // handler the CPU idles in the scheduler.
+    typedef void (*IdleHandler)(uint32_t idleMs);
+    void setIdleHandler(IdleHandler handler);
+
+#if !defined(ESP32)
+    // Host builds: forgets the started tasks, as a reboot does
+    void resetTasks();
+
+    // Host builds: steps the started tasks one at a time on the hal clock,
+    // earliest due first and the higher priority on a tie, until untilMs.
+    // Deterministic, and as fast as the steps themselves on the virtual clock.
+    void runTasks(uint32_t untilMs);
+#endif
+
+}
+
+#endif // TASK_H
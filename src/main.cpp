@@ -11,30 +11,44 @@ is likely to use up it's power source resulting in loss of the session.
 
 The relevant code is flagged with a ##### comment
 
-Saving the entire session is possible but not demonstrated here - it has
-implications for flash wearing and complications with which parts of the
-session may have changed after an uplink. So it is assumed that the device
-is going in to deep-sleep, as below, between normal uplinks.
+The session is kept in RTC memory through deep-sleep, as below, between
+normal uplinks. For a power loss it also goes to a flash journal now and
+then (LoRa/SessionStore.h), which spreads the wear over its own partition,
+and its frame counters to NVS after every uplink.
 
 Once you understand what happens, feel free to delete the comments and
 Serial.prints - we promise the final result isn't that many lines.
 
 */
 
-#if !defined(ESP32)
-#pragma error("This is not the example your device is looking for - ESP32 only")
-#endif
-
-#include <Preferences.h>
-
 #if USE_LORAWAN == 1
-RTC_DATA_ATTR uint16_t bootCount = 0;
 #include "LoRa/LoRAWAN.hpp"
-#include <ArduinoJson.h>
 #endif
+#include <atomic>
+#include "HAL/Hal.h"
+#include "Codec/BatchCodec.h"
+#include "Storage/RtcSampleRing.h"
+#include "LoRa/UplinkScheduler.h"
+#include "LoRa/JoinScheduler.h"
+#include "Tasks/SpscQueue.h"
+#include "Tasks/Task.h"
 #include "BME/BME.h"
 #include "PMS/PMS.h"
+#include "Filter/PmFilter.h"
 #include "Fan/Fan.h"
+#include "Fan/IsrTach.h"
+#include "Fan/PcntTach.h"
+#include "Fan/CaptureTach.h"
+#include "Fan/FanCalibration.h"
+#include "Control/FanPolicy.h"
+#include "Control/PmForecaster.h"
+#include "Control/Settings.h"
+#include "Command/CommandDispatcher.h"
+#include "Log/Log.h"
+#include "Boot/BootTrace.h"
+#include "Power/PowerManager.h"
+
+RTC_DATA_ATTR uint16_t bootCount = 0;
 
 #if USE_LORAWAN == 1
 static SmartAirControl::LoRaWAN<RADIOLIB_LORA_MODULE> loRaWAN(RADIOLIB_LORA_REGION,
@@ -50,152 +64,595 @@ static SmartAirControl::LoRaWAN<RADIOLIB_LORA_MODULE> loRaWAN(RADIOLIB_LORA_REGI
 
 #endif
 
+// the gas baseline learns over days, deep sleep keeps it in RTC memory
+RTC_DATA_ATTR SmartAirControl::GasBaseline::State gasBaselineState;
 static SmartAirControl::BME bme(BME680_OS_8X, 
                     BME680_OS_2X, 
                     BME680_OS_4X,
                     BME680_FILTER_SIZE_3, 
                     320, 150,
-                    1013.25);
+                    1013.25,
+                    gasBaselineState);
 static SmartAirControl::PMS pms(16, 17, 9600, SERIAL_8N1);
-static SmartAirControl::Fan fan(13, 12);
+#if FAN_TACH_BACKEND == FAN_TACH_PCNT
+static SmartAirControl::PcntTach tach(12);
+#elif FAN_TACH_BACKEND == FAN_TACH_CAPTURE
+static SmartAirControl::CaptureTach tach(12);
+#else
+static SmartAirControl::IsrTach tach(12);
+#endif
+static SmartAirControl::Fan fan(13, tach);
+static SmartAirControl::FanCalibration fanCalibration(fan);
+
+// Between samples the firmware deep sleeps while the fan is off and nothing
+// is due; the BOOT button wakes it early
+#ifndef DEEP_SLEEP_INTERVAL_S
+#define DEEP_SLEEP_INTERVAL_S 60
+#endif
+#ifndef POWER_WAKE_PIN
+#define POWER_WAKE_PIN -1
+#endif
+
+static SmartAirControl::PowerManager power(POWER_POLICY, DEEP_SLEEP_INTERVAL_S * 1000UL, POWER_WAKE_PIN);
 
 #if USE_LORAWAN == 1
 
 unsigned long lastLoraTime = 0;
 uint32_t sleepTime = 0;
 
+// Samples are queued every SAMPLE_INTERVAL_MS and go on air in batches when
+// the UplinkScheduler says so (LoRa/UplinkScheduler.h): with the fixed
+// policy once UPLINK_BATCH_SIZE of them are queued, whatever does not fit
+// into the payload limit of the current data rate staying queued; with the
+// adaptive policy when the air changed or for a heartbeat, the newest that
+// fit. The queue and the scheduler live in RTC memory so they survive deep
+// sleep.
+#define SAMPLE_INTERVAL_MS 10000
+#define UPLINK_BATCH_SIZE 6
+
+RTC_DATA_ATTR SmartAirControl::RtcSampleRing::Storage sampleStorage;
+static SmartAirControl::RtcSampleRing samples(sampleStorage);
+RTC_DATA_ATTR SmartAirControl::UplinkScheduler::State schedulerState;
+static SmartAirControl::UplinkScheduler scheduler(UPLINK_POLICY, UPLINK_BATCH_SIZE, schedulerState);
+
+// Until it is joined the device retries with the backoff of TS001
+// (LoRa/JoinScheduler.h), sampling and queueing as usual meanwhile
+RTC_DATA_ATTR SmartAirControl::JoinScheduler::State joinSchedulerState;
+static SmartAirControl::JoinScheduler joinScheduler(RADIOLIB_LORAWAN_DEV_EUI, joinSchedulerState);
+
 void gotoSleep(uint32_t seconds) {
     loRaWAN.goToSleep();
     
-    lastLoraTime = millis();
+    lastLoraTime = SmartAirControl::hal::millis();
     sleepTime = seconds * 1000;
 
-    Serial.println("[LoRaWAN] Go to sleep");
-    Serial.println();
+    LOG_INFO(LORA, "Go to sleep");
 }
 #endif
 
-class Data {
+SmartAirControl::Sample toSample(const SmartAirControl::Data& data, float score) {
+    return SmartAirControl::Sample(data.bmeData.temperature,
+                                   data.bmeData.pressure,
+                                   data.bmeData.humidity,
+                                   data.bmeData.gasResistance,
+                                   data.pmsData.pm10_env,
+                                   data.pmsData.pm25_env,
+                                   data.pmsData.pm100_env,
+                                   data.FanRpm,
+                                   data.FanPercent,
+                                   score);
+}
+
+// The application runs as three tasks that only talk through SPSC queues:
+//
+//  SensorTask  (core 1)  BME/PMS acquisition          --Data-->   ControlTask
+//  ControlTask (core 1)  score + fan control           --Sample--> RadioTask
+//  RadioTask   (core 0)  batching + LoRaWAN uplinks
+//  LogTask     (core 0)  prints what the others logged (Log/Log.h)
+//
+// A radio transaction blocks for seconds (join, RX windows); on its own core
+// it no longer holds up the fan control.
+//
+// Every task returns how long it has nothing to do, so the waits follow the
+// sensors (next PMS5003 frame, end of the BME680 conversion) instead of a
+// fixed poll. When all of them wait, the PowerManager sleeps (Power/PowerManager.h).
+#define SENSOR_INTERVAL_MS 1000
+// VOCs change over minutes: the gas heater only runs for a reading this often
+#define GAS_INTERVAL_MS 30000
+#define CONTROL_INTERVAL_MS 100
+
+static SmartAirControl::SpscQueue<SmartAirControl::Data, 4> sensorQueue;
+
+// What the network can change (Command/CommandDispatcher.h). The radio task
+// receives the commands and owns these; the control task gets a complete
+// copy through the queue and swaps it in between two cycles.
+static SmartAirControl::Settings settings = SmartAirControl::Settings::defaults();
+static SmartAirControl::SpscQueue<SmartAirControl::Settings, 2> settingsQueue;
+#if USE_LORAWAN == 1
+static SmartAirControl::SpscQueue<SmartAirControl::Sample, 2 * UPLINK_BATCH_SIZE> uplinkQueue;
+#endif
+
+class SensorTask : public SmartAirControl::Task {
     public:
-        Data(PM25_AQI_Data pmsData, SmartAirControl::BMEData bmeData, int FanRpm, float FanPercent) : pmsData(pmsData), bmeData(bmeData), FanRpm(FanRpm), FanPercent(FanPercent) {}
-        PM25_AQI_Data pmsData;
-        SmartAirControl::BMEData bmeData;
-        int FanRpm;
-        float FanPercent;
+        uint32_t step() override {
+            // the PMS5003 streams a frame every second, keep the UART
+            // drained; every frame goes through the filter, the readings
+            // carry its output
+            if (pms.update()) {
+                pmFilter.push(pms.getParser().latest());
+                pms.printSensorData();
+            }
+
+            if (pms.hasFrame()) {
+                SmartAirControl::boot::mark(SmartAirControl::boot::PHASE_PMS_READY);
+            }
+
+            // the BME680 conversion (mostly gas heater time) runs in the background
+            if (bme.poll()) {
+                if (bme.isGasStable()) {
+                    SmartAirControl::boot::mark(SmartAirControl::boot::PHASE_BME_READY);
+                }
+                if (isReady()) {
+                    SmartAirControl::Data data;
+                    data.pmsData = pmFilter.filtered();
+                    data.pm25Slope = pmFilter.getPm25Slope();
+                    data.bmeData = bme.getData();
+                    if (!sensorQueue.push(data)) {
+                        LOG_WARN(APP, "Sensor queue full, dropping reading");
+                    }
+                }
+            }
+
+            // back to back until the first reading is passed on: that heats
+            // the gas plate up fastest and catches the first PMS5003 frame
+            uint32_t interval = ready ? SENSOR_INTERVAL_MS : 0;
+            uint32_t sinceConversion = SmartAirControl::hal::millis() - lastConversion;
+            if (!bme.isConverting() && sinceConversion >= interval) {
+                lastConversion = SmartAirControl::hal::millis();
+                sinceConversion = 0;
+                bme.startConversion();
+            }
+
+            // poll while a frame arrives or the conversion runs, else until
+            // the next of them
+            uint32_t untilFrame = pms.getMsUntilFrame();
+            if (untilFrame == 0 || bme.isConverting()) {
+                return POLL_MS;
+            }
+            uint32_t untilConversion = interval - sinceConversion;
+            return untilFrame < untilConversion ? untilFrame : untilConversion;
+        }
+
+        // Warm-up starts now: readings are passed on once both sensors
+        // report ready, or after WARMUP_TIMEOUT_MS whatever they say
+        void begin() {
+            warmupStart = SmartAirControl::hal::millis();
+            ready = false;
+            pmFilter.reset();
+        }
+
+    private:
+        bool isReady() {
+            if (ready) {
+                return true;
+            }
+            if (pms.hasFrame() && bme.isGasStable()) {
+                ready = true;
+            } else if (SmartAirControl::hal::millis() - warmupStart >= WARMUP_TIMEOUT_MS) {
+                LOG_WARN(APP, "Sensors not ready after %lu ms (PMS5003 %d, BME680 %d), sampling anyway",
+                         WARMUP_TIMEOUT_MS, pms.hasFrame(), bme.isGasStable());
+                ready = true;
+            }
+            return ready;
+        }
+
+        static const uint32_t POLL_MS = 20;
+        static const uint32_t WARMUP_TIMEOUT_MS = 10000;
+
+        SmartAirControl::PmFilter pmFilter;
+        unsigned long lastConversion = 0;
+        unsigned long warmupStart = 0;
+        bool ready = false;
 };
 
-Data readSensors() {
-    PM25_AQI_Data pmsData = pms.read();
-    SmartAirControl::BMEData bmeData = bme.read();
-    int FanRpm = fan.getRpm();
-    float FanPercent = fan.getRpmPercent();
-    return Data(pmsData, bmeData, FanRpm, FanPercent);
-}
+class ControlTask : public SmartAirControl::Task {
+    public:
+        uint32_t step() override {
+            // the calibration sweep owns the fan until it is done, the air
+            // is sampled meanwhile
+            bool calibrating = fanCalibration.step();
+            if (!calibrating) {
+                SmartAirControl::boot::mark(SmartAirControl::boot::PHASE_FAN_READY);
+            }
+
+            settingsQueue.popLatest(applied);
+
+            SmartAirControl::Data data;
+            if (sensorQueue.popLatest(data)) {
+                data.FanRpm = fan.getRpm();
+                data.FanPercent = fan.getRpmPercent();
+                // predictive control scores the air a few minutes ahead
+                forecaster.update(data.pmsData.pm25_env, SmartAirControl::hal::millis());
+                SmartAirControl::AirQuality quality = SmartAirControl::airScore(applied.scorePolicy).evaluate(
+                    forecaster.getPolicy() == FAN_CONTROL_PREDICTIVE ? forecaster.predict(data) : data, applied);
+                LOG_DEBUG(APP, "AQI PM2.5 %u, PM10 %u, VOC %u, score %.2f, PM2.5 trend %.2f ug/m3/min, forecast %.1f",
+                          quality.pm25Index, quality.pm10Index, quality.vocIndex, quality.score, data.pm25Slope,
+                          forecaster.forecast());
+                if (!calibrating) {
+                    fanPolicy.adjustFanSpeed(fan, quality.score, applied, SmartAirControl::hal::millis());
+                    controlledBoot = bootCount;
+                }
+                latest = toSample(data, quality.score);
+                latestBoot = bootCount;
+                #if USE_LORAWAN != 1
+                SmartAirControl::boot::mark(SmartAirControl::boot::PHASE_FIRST_SAMPLE);
+                #endif
+            }
+
+            if (!calibrating) {
+                // closed loop trim towards the setpoint, at its own fixed rate
+                fan.update();
+            }
+
+            #if USE_LORAWAN == 1
+            // the first sample of a boot right away, the deep sleep waits for it
+            if (latestBoot == bootCount &&
+                (queuedBoot != bootCount || SmartAirControl::hal::millis() - lastSample >= SAMPLE_INTERVAL_MS)) {
+                lastSample = SmartAirControl::hal::millis();
+                if (!uplinkQueue.push(latest)) {
+                    LOG_WARN(APP, "Uplink queue full, dropping sample");
+                }
+                queuedBoot = bootCount;
+                SmartAirControl::boot::mark(SmartAirControl::boot::PHASE_FIRST_SAMPLE);
+            }
+            #endif
+
+            return CONTROL_INTERVAL_MS;
+        }
+
+        // Since the last boot the air has been sampled (and the sample
+        // queued) and the fan set from it
+        bool hasActedThisBoot() const {
+            #if USE_LORAWAN == 1
+            return queuedBoot == bootCount && controlledBoot == bootCount;
+            #else
+            return latestBoot == bootCount && controlledBoot == bootCount;
+            #endif
+        }
+
+    private:
+        SmartAirControl::Settings applied = SmartAirControl::Settings::defaults();
+        SmartAirControl::PmForecaster forecaster{FAN_CONTROL};
+        SmartAirControl::FanPolicy fanPolicy{FAN_POLICY};
+        SmartAirControl::Sample latest;
+        // boots the latest and the last queued sample and the last fan
+        // setting are from, 0 for none; a sample from before a deep sleep is
+        // no measurement of the air now
+        uint16_t latestBoot = 0;
+        uint16_t queuedBoot = 0;
+        uint16_t controlledBoot = 0;
+        unsigned long lastSample = 0;
+};
+
+#if USE_LORAWAN == 1
+class RadioTask : public SmartAirControl::Task {
+    public:
+        uint32_t step() override {
+            // busy until the step has looked at everything
+            uint32_t now = SmartAirControl::hal::rtcMillis();
+            idleUntilMs.store(now, std::memory_order_release);
+
+            // queued whether joined or not, the oldest go when the queue is full
+            SmartAirControl::Sample sample;
+            while (uplinkQueue.pop(sample)) {
+                samples.push(sample);
+                scheduler.observe(sample);
+            }
+
+            if (!activated) {
+                if (!radioReady) {
+                    radioReady = true;
+                    activated = loRaWAN.setup(bootCount) == RADIOLIB_LORAWAN_SESSION_RESTORED;
+                    // the first join request is timed from here
+                    joinScheduler.restore(SmartAirControl::hal::rtcMillis());
+                }
+                if (!activated && !join()) {
+                    // a join request within the deep sleep is worth staying up for
+                    now = SmartAirControl::hal::rtcMillis();
+                    uint32_t wait = joinScheduler.waitMs(now);
+                    publishIdle(now, wait >= DEEP_SLEEP_INTERVAL_S * 1000UL ? wait : 0);
+                    return POLL_MS;
+                }
+                SmartAirControl::boot::mark(SmartAirControl::boot::PHASE_LORA_ACTIVATED);
+            }
+
+            // gotoSleep() holds the radio off until the next uplink is allowed
+            if (SmartAirControl::hal::millis() - lastLoraTime < sleepTime) {
+                publishUplinkIdle(now);
+                return POLL_MS;
+            }
+
+            // fetch pending downlinks before sending anything new, within
+            // the same airtime limits
+            now = SmartAirControl::hal::rtcMillis();
+            if (loRaWAN.isPending()) {
+                if (scheduler.holdOffMs(now) == 0) {
+                    loRaWAN.loop();
+                    scheduler.spend(now, loRaWAN.getLastToA());
+                }
+            } else {
+                SmartAirControl::UplinkScheduler::Reason reason = scheduler.due(now, samples.size());
+                if (reason != SmartAirControl::UplinkScheduler::REASON_NONE) {
+                    sendBatch(reason);
+                }
+            }
+
+            publishUplinkIdle(SmartAirControl::hal::rtcMillis());
+            return POLL_MS;
+        }
+
+        // ms from nowMs (rtcMillis()) on that the radio has nothing to do
+        // with the samples it holds, as of its last step; 0 during a step.
+        // Safe from the idle handler, unlike the rest of the radio state.
+        uint32_t idleMs(uint32_t nowMs) const {
+            int32_t idle = static_cast<int32_t>(idleUntilMs.load(std::memory_order_acquire) - nowMs);
+            return idle > 0 ? idle : 0;
+        }
+
+    private:
+        // One join request when the JoinScheduler allows it; true once joined
+        bool join() {
+            uint32_t now = SmartAirControl::hal::rtcMillis();
+            if (joinScheduler.waitMs(now) > 0) {
+                return false;
+            }
+
+            activated = loRaWAN.join() == RADIOLIB_LORAWAN_NEW_SESSION;
+            // the join request counts against the airtime limits too
+            joinScheduler.attempted(now, loRaWAN.getLastToA(), activated);
+            scheduler.spend(now, loRaWAN.getLastToA());
+            if (!activated) {
+                LOG_INFO(LORA, "Join attempt %u failed, %lu ms airtime so far, next in %lu s",
+                         joinScheduler.getAttempts(), joinScheduler.getTotalAirtimeMs(),
+                         joinScheduler.waitMs(now) / 1000);
+            }
+            return activated;
+        }
+
+        void sendBatch(SmartAirControl::UplinkScheduler::Reason reason) {
+            // log records carry no strings (Log.h), so one literal per reason
+            static const char* const REASONS[] = {
+                "Construct LoRaWAN uplink",
+                "Construct LoRaWAN uplink: batch of %u samples queued",
+                "Construct LoRaWAN uplink: air changed, %u samples queued",
+                "Construct LoRaWAN uplink: heartbeat, %u samples queued",
+            };
+            LOG_INFO(APP, REASONS[reason], samples.size());
+
+            uint8_t fPort = 2;
+
+            // Base sample plus varint deltas (see Codec/BatchCodec.h)
+            uint8_t uplinkPayload[UINT8_MAX];
+            size_t maxPayload = scheduler.getMaxPayload(loRaWAN.getMaxPayloadLen());
+            size_t encoded = 0;
+            size_t uplinkSize = SmartAirControl::BatchCodec::encode(samples, uplinkPayload, maxPayload, encoded);
+            if (encoded == 0) {
+                // not even the base sample fits the data rate, the samples
+                // stay queued for a better one
+                LOG_WARN(APP, "Uplink payload limit of %u bytes below one sample", maxPayload);
+                return;
+            }
+
+            // adaptive: the newest samples that fit, older ones describe air
+            // that has moved on since
+            if (scheduler.getPolicy() == UPLINK_ADAPTIVE && encoded < samples.size()) {
+                size_t dropped = 0;
+                while (encoded < samples.size()) {
+                    dropped += samples.size() - encoded;
+                    samples.pop(samples.size() - encoded);
+                    uplinkSize = SmartAirControl::BatchCodec::encode(samples, uplinkPayload, maxPayload, encoded);
+                }
+                LOG_INFO(APP, "Dropped %u older samples", dropped);
+            }
+
+            LOG_INFO(APP, "Payload size: %u bytes for %u samples", uplinkSize, encoded);
+
+            loRaWAN.setUplinkPayload(fPort, uplinkPayload, uplinkSize);
+            loRaWAN.loop();
+
+            scheduler.sent(SmartAirControl::hal::rtcMillis(), loRaWAN.getLastToA(), samples.at(encoded - 1));
+            samples.pop(encoded);
+        }
+
+        // a downlink to fetch keeps the radio busy
+        void publishUplinkIdle(uint32_t nowMs) {
+            publishIdle(nowMs, loRaWAN.isPending() ? 0 : scheduler.untilDueMs(nowMs, samples.size()));
+        }
+
+        void publishIdle(uint32_t nowMs, uint32_t waitMs) {
+            // a day at most, so the difference to the clock stays signed
+            uint32_t bounded = waitMs < MAX_IDLE_MS ? waitMs : MAX_IDLE_MS;
+            idleUntilMs.store(nowMs + bounded, std::memory_order_release);
+        }
+
+        static const uint32_t POLL_MS = 100;
+        static const uint32_t MAX_IDLE_MS = 24UL * 60 * 60 * 1000;
+
+        bool radioReady = false;
+        bool activated = false;
+        // rtcMillis() before which nothing is due, see idleMs()
+        std::atomic<uint32_t> idleUntilMs{0};
+};
 
-float adjustFanSpeed(Data data) {
-    float gas = data.bmeData.gasResistance;
-    float pm1 = data.pmsData.particles_10um;
-    float pm25 = data.pmsData.particles_25um;
-    float pm10 = data.pmsData.particles_100um;
-    float temp = data.bmeData.temperature;
+static RadioTask radioTask;
+#endif
+
+#if LOG_ANY_ENABLED
+// Formats and prints the log records. Printing blocks on the UART, so it
+// happens here at the lowest priority instead of in the task that logs.
+class LogTask : public SmartAirControl::Task {
+    public:
+        uint32_t step() override {
+            // back soon while records pile up, else rarely, so the CPU can sleep
+            return SmartAirControl::logging::drain(BATCH) == BATCH ? 10 : 250;
+        }
+
+    private:
+        static const size_t BATCH = 16;
+};
 
-    // Normalize sensor values (example thresholds, adjust as needed)
-    float gasScore = gas < 10000 ? 1.0 : (gas < 20000 ? 0.5 : 0.0); // lower gas resistance = worse air
-    float pmScore = (pm1 + pm25 + pm10) / 3.0;
-    float pmNorm = pmScore < 10 ? 0.0 : (pmScore < 35 ? 0.5 : 1.0); // higher PM = worse air
-    float tempScore = temp > 30 ? 1.0 : (temp > 25 ? 0.5 : 0.0); // higher temp = higher speed
+static LogTask logTask;
+#endif
 
-    // Weighted sum (tune weights as needed)
-    float score = 0.2 * gasScore + 0.7 * pmNorm + 0.1 * tempScore;
+static SensorTask sensorTask;
+static ControlTask controlTask;
 
-    float fanPercent = (1 - score) * 100;
+// Wires the PowerManager to the tasks: who keeps the CPU awake, when the
+// purifier may power down and what has to survive it
+static void setupPower() {
+    power.setAwakeCondition([]() {
+        // the tach and the PMS5003 UART stop in light sleep
+        return fanCalibration.isRunning() || fan.needsTach() || pms.getMsUntilFrame() == 0;
+    });
+    power.setDeepSleepCondition([]() {
+        if (fan.getRpmPercent() > 0 || fanCalibration.isRunning() || !controlTask.hasActedThisBoot()) {
+            return false;
+        }
+        #if USE_LORAWAN == 1
+        // the samples are in RTC memory and the radio has nothing to do. The
+        // queue first: once it reads empty, the radio task has marked itself
+        // busy for any sample it took.
+        return uplinkQueue.isEmpty() && radioTask.idleMs(SmartAirControl::hal::rtcMillis()) > 0;
+        #else
+        return true;
+        #endif
+    });
+    power.setBeforeDeepSleep([]() {
+        #if USE_LORAWAN == 1
+        loRaWAN.goToSleep();
+        #endif
+        // otherwise the pin floats and the fan runs at full speed
+        fan.holdStopped();
+        while (SmartAirControl::logging::drain(SIZE_MAX) > 0) {
+        }
+    });
+    power.setAfterLightSleep([](uint32_t) {
+        // pulses were not counted while asleep
+        fan.restartMeasurement();
+    });
+}
 
-    fan.setRpmPercent(fanPercent);
+// Hands the settings to whoever uses them: the control task with its next
+// cycle, the uplink scheduler right away (it runs in the radio task, where
+// the commands arrive)
+static void applySettings() {
+    if (!settingsQueue.push(settings)) {
+        LOG_WARN(APP, "Settings queue full, the control task keeps its settings");
+    }
+    #if USE_LORAWAN == 1
+    scheduler.configure(settings.uplinkPolicy, settings.heartbeatMin * 60000UL);
+    #endif
+}
 
-    Serial.print(F("[APP] Adjusting fan speed to "));
-    Serial.print(fanPercent);
-    Serial.println(F("% based on air quality and temperature."));
+#if USE_LORAWAN == 1
+static void onDownlink(uint8_t fPort, uint8_t* payload, std::size_t size) {
+    LOG_INFO(APP, "Payload: fPort=%u", fPort);
+    LOG_HEX(LOG_LEVEL_INFO, APP, "Payload:", payload, size);
+    if (!SmartAirControl::CommandDispatcher::isCommandPort(fPort)) {
+        return;
+    }
 
-    return score;
+    // log records carry no strings (Log.h), so one literal per result
+    static const char* const RESULTS[] = {
+        "Command on fPort %u applied",
+        "Command on fPort %u unknown",
+        "Command on fPort %u rejected: %u bytes is not its size",
+        "Command on fPort %u rejected: value out of range",
+    };
+    SmartAirControl::CommandDispatcher::Result result =
+        SmartAirControl::CommandDispatcher::dispatch(fPort, payload, size, settings);
+    if (result != SmartAirControl::CommandDispatcher::RESULT_OK) {
+        LOG_WARN(APP, RESULTS[result], fPort, size);
+        return;
+    }
+    settings.save();
+    applySettings();
+    LOG_INFO(APP, RESULTS[result], fPort);
 }
+#endif
 
+// Nothing in setup() waits for a sensor: each reports when it is ready
+// (first PMS5003 frame, settled BME680 gas reading) while the tasks already
+// run, and the fan calibration and the LoRaWAN join go on alongside. The
+// boot trace logs when each got there (Boot/BootTrace.h).
 void setup() {
+    SmartAirControl::boot::start();
+    bootCount++;
+
     Serial.begin(115200);
-    while (!Serial)
-        ;        // wait for serial to be initalised
-    delay(2000); // give time to switch to the serial monitor
+    power.setup();
+    #ifdef SERIAL_MONITOR_WAIT_MS
+    // debugging: time to open the serial monitor before anything is printed
+    if (!power.isWakeFromDeepSleep()) {
+        SmartAirControl::hal::delay(SERIAL_MONITOR_WAIT_MS);
+    }
+    #endif
     
-    Serial.println(F("Setup"));
+    #if LOG_ANY_ENABLED
+    // first, so what setup() logs is printed while it runs
+    SmartAirControl::startTask(logTask, "log", 0, 4096, 0);
+    #endif
 
-    #if USE_LORAWAN == 1
-    loRaWAN.setup(bootCount);
+    LOG_INFO(APP, "Setup, boot %u", bootCount);
 
-    delay(1000); // give time to switch to the serial monitor
+    #if USE_LORAWAN == 1
+    size_t restored = samples.restore();
+    LOG_INFO(APP, "Samples restored from RTC memory: %u", restored);
+    scheduler.restore(SmartAirControl::hal::rtcMillis());
 
-    loRaWAN.setDownlinkCB([](uint8_t fPort, uint8_t* downlinkPayload, std::size_t downlinkSize) {
-            Serial.print(F("[APP] Payload: fPort="));
-            Serial.print(fPort);
-            Serial.print(", ");
-            SmartAirControl::arrayDump(downlinkPayload, downlinkSize);
-    });
+    loRaWAN.setDownlinkCB(onDownlink);
     #endif
+
+    if (SmartAirControl::Settings::load(settings)) {
+        LOG_INFO(APP, "Settings restored from NVS");
+    }
+    applySettings();
     
     bme.setup();
+    bme.setGasInterval(GAS_INTERVAL_MS);
     pms.setup();
     fan.setup();
+    if (!fan.isCalibrated()) {
+        fanCalibration.start();
+    }
+    sensorTask.begin();
+    #if !defined(ESP32)
+    // the emulated deep sleep keeps RAM, readings from before it are stale
+    SmartAirControl::Data stale;
+    while (sensorQueue.pop(stale)) {
+    }
+    #endif
 
-    delay(5000); // wait for sensors to warm up
-}
-
-void loop() {
-
+    SmartAirControl::startTask(controlTask, "control", 1, 4096, 3);
+    SmartAirControl::startTask(sensorTask, "sensor", 1, 4096, 2);
     #if USE_LORAWAN == 1
+    SmartAirControl::startTask(radioTask, "radio", 0, 8192, 1);
+    #endif
 
-    if (millis() - lastLoraTime > 10000) {
-        Serial.println(F("[APP] Aquire data and construct LoRaWAN uplink"));
-        
-        std::string uplinkPayload = RADIOLIB_LORAWAN_PAYLOAD;
-        uint8_t fPort = 2;
-        
-        Data sensorData = readSensors();
-        delay(1000); // wait for sensors to stabilize
-        float score = adjustFanSpeed(sensorData);
-        
-        // Create a JSON object
-        JsonDocument doc;
-        doc["t"] = sensorData.bmeData.temperature;
-        doc["p"] = sensorData.bmeData.pressure;
-        doc["h"] = sensorData.bmeData.humidity;
-        doc["g"] = sensorData.bmeData.gasResistance;
-        /*doc["p03"] = sensorData.pmsData.particles_03um;
-        doc["p05"] = sensorData.pmsData.particles_05um;
-        doc["p10"] = sensorData.pmsData.particles_10um;
-        doc["p25"] = sensorData.pmsData.particles_25um;
-        doc["p50"] = sensorData.pmsData.particles_50um;
-        doc["p100"] = sensorData.pmsData.particles_100um; */
-        doc["rpm"] = sensorData.FanRpm;
-        doc["s"] = score;
-        
-        
-        // Serialize to string
-        String jsonString;
-        serializeJson(doc, jsonString);
-        
-        // Assign to uplink payload
-        uplinkPayload = std::string(jsonString.c_str());
-
-        // Prit the size of the payload in bytes
-        Serial.print(F("[APP] Payload size: "));
-        Serial.print(uplinkPayload.length());
-        
-        loRaWAN.setUplinkPayload(fPort, uplinkPayload);
-
-        
+    if (power.getPolicy() != POWER_ALWAYS_ON) {
+        setupPower();
+        SmartAirControl::setIdleHandler([](uint32_t idleMs) {
+            power.idle(idleMs);
+        });
     }
-    loRaWAN.loop();
-    #else
-    Data data = readSensors();
-    adjustFanSpeed(data);
-    delay(10000);
+
+    SmartAirControl::boot::mark(SmartAirControl::boot::PHASE_SETUP);
+}
+
+void loop() {
+    // all work happens in the tasks started by setup(); the native build
+    // never calls loop(), it runs the tasks on the virtual clock instead
+    #if defined(ESP32)
+    vTaskDelete(nullptr);
     #endif
-}
\ No newline at end of file
+}
@@ -0,0 +1,245 @@
+// The air quality scorings (Control/AirScore.h) on reference inputs: the
+// legacy buckets at the default settings, the EPA AQI and CAQI sub-indices
+// with the VOC index from the gas resistance drop, and the score policy
+// from a downlink on fPort 15 through NVS and a power cycle
+#include <unity.h>
+#include <cstdint>
+#include <vector>
+#include "HAL/native/Simulation.h"
+#include "Command/CommandDispatcher.h"
+#include "Control/AirScore.h"
+#include "Control/Settings.h"
+
+using SmartAirControl::AirQuality;
+using SmartAirControl::CommandDispatcher;
+using SmartAirControl::Data;
+using SmartAirControl::EpaAirScore;
+using SmartAirControl::EuAirScore;
+using SmartAirControl::LegacyAirScore;
+using SmartAirControl::Settings;
+using SmartAirControl::airScore;
+namespace aqi = SmartAirControl::aqi;
+namespace sim = SmartAirControl::sim;
+
+void setUp() {
+    sim::Simulation::get().nvs().clear();
+}
+
+void tearDown() {}
+
+// A sensor cycle: mass concentrations in ug/m3, gas in KOhm
+static Data reading(uint16_t pm25, uint16_t pm100, float gasKOhm, float baselineKOhm) {
+    Data data;
+    data.pmsData.pm25_env = pm25;
+    data.pmsData.pm100_env = pm100;
+    data.bmeData.gasCompensated = gasKOhm;
+    data.bmeData.gasBaseline = baselineKOhm;
+    data.bmeData.temperature = 22;
+    return data;
+}
+
+// A sensor cycle for the legacy score: mean particle count, gas, temperature
+static Data counts(uint16_t meanCount, float gasKOhm, float temperature) {
+    Data data;
+    data.pmsData.particles_10um = meanCount + 3;
+    data.pmsData.particles_25um = meanCount;
+    data.pmsData.particles_100um = meanCount - 3;
+    data.bmeData.gasCompensated = gasKOhm;
+    data.bmeData.temperature = temperature;
+    return data;
+}
+
+static void test_legacy_buckets_at_the_default_settings() {
+    // PM low 10, high 35; gas low 50, high 100 KOhm; temperature low 25,
+    // high 30 C; weights gas 20, PM 70, temperature 10 %
+    Settings settings = Settings::defaults();
+    LegacyAirScore legacy;
+
+    AirQuality clean = legacy.evaluate(counts(5, 150, 20), settings);
+    TEST_ASSERT_EQUAL_FLOAT(0, clean.score);
+    TEST_ASSERT_EQUAL_UINT16(aqi::NO_INDEX, clean.pm25Index);
+    TEST_ASSERT_EQUAL_UINT16(aqi::NO_INDEX, clean.pm10Index);
+    TEST_ASSERT_EQUAL_UINT16(aqi::NO_INDEX, clean.vocIndex);
+
+    // each half way: 0.5 of every weight
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.5f, legacy.evaluate(counts(20, 80, 27), settings).score);
+    // each full
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 1.0f, legacy.evaluate(counts(40, 30, 31), settings).score);
+    // one at a time: its weight
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.7f, legacy.evaluate(counts(40, 150, 20), settings).score);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.2f, legacy.evaluate(counts(5, 30, 20), settings).score);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.1f, legacy.evaluate(counts(5, 150, 31), settings).score);
+    // the edges belong to the lower bucket for PM and temperature, the
+    // upper for gas
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.35f, legacy.evaluate(counts(10, 100, 25), settings).score);
+
+    // the thresholds and weights come from the settings
+    settings.pmHigh = 50;
+    settings.gasWeight = 0;
+    settings.pmWeight = 100;
+    settings.tempWeight = 0;
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.5f, legacy.evaluate(counts(40, 30, 31), settings).score);
+}
+
+static void test_voc_index_from_the_gas_drop() {
+    // on the band edges of VOC_DROP
+    TEST_ASSERT_EQUAL_UINT16(0, aqi::vocIndex(100, 100));
+    TEST_ASSERT_EQUAL_UINT16(50, aqi::vocIndex(90, 100));
+    TEST_ASSERT_EQUAL_UINT16(100, aqi::vocIndex(75, 100));
+    TEST_ASSERT_EQUAL_UINT16(150, aqi::vocIndex(60, 100));
+    TEST_ASSERT_EQUAL_UINT16(200, aqi::vocIndex(45, 100));
+    TEST_ASSERT_EQUAL_UINT16(250, aqi::vocIndex(30, 100));
+    TEST_ASSERT_EQUAL_UINT16(350, aqi::vocIndex(15, 100));
+    TEST_ASSERT_EQUAL_UINT16(500, aqi::vocIndex(0.01f, 100));
+    // within a band, rounded: a 50 % drop is 150 + 50 * 10 / 15
+    TEST_ASSERT_EQUAL_UINT16(183, aqi::vocIndex(50, 100));
+    // the drop is relative, the baseline sets the scale
+    TEST_ASSERT_EQUAL_UINT16(183, aqi::vocIndex(125, 250));
+    // rounded to a whole % first: 4.6 % is 5 %, 25 points
+    TEST_ASSERT_EQUAL_UINT16(25, aqi::vocIndex(95.4f, 100));
+
+    // above the baseline (warmer, drier air) is clean air
+    TEST_ASSERT_EQUAL_UINT16(0, aqi::vocIndex(180, 100));
+    // no baseline yet (burn-in, GasBaseline.h) or no reading: no index
+    TEST_ASSERT_EQUAL_UINT16(aqi::NO_INDEX, aqi::vocIndex(80, 0));
+    TEST_ASSERT_EQUAL_UINT16(aqi::NO_INDEX, aqi::vocIndex(0, 100));
+}
+
+static void test_epa_worst_sub_index_over_200() {
+    Settings settings = Settings::defaults();
+    EpaAirScore epa;
+
+    // PM2.5 12 ug/m3 is 56, PM10 100 is 73 (the EPA calculator)
+    AirQuality quality = epa.evaluate(reading(12, 100, 100, 100), settings);
+    TEST_ASSERT_EQUAL_UINT16(56, quality.pm25Index);
+    TEST_ASSERT_EQUAL_UINT16(73, quality.pm10Index);
+    TEST_ASSERT_EQUAL_UINT16(0, quality.vocIndex);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 73.0f / EpaAirScore::FULL_SCALE, quality.score);
+
+    // PM2.5 35 ug/m3 is 99, just below "unhealthy for sensitive groups"
+    quality = epa.evaluate(reading(35, 20, 100, 100), settings);
+    TEST_ASSERT_EQUAL_UINT16(99, quality.pm25Index);
+    TEST_ASSERT_EQUAL_UINT16(19, quality.pm10Index);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 99.0f / EpaAirScore::FULL_SCALE, quality.score);
+
+    // the VOC index is the worst: a 50 % drop
+    quality = epa.evaluate(reading(12, 100, 50, 100), settings);
+    TEST_ASSERT_EQUAL_UINT16(183, quality.vocIndex);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 183.0f / EpaAirScore::FULL_SCALE, quality.score);
+
+    // no baseline: the PM sub-indices alone
+    quality = epa.evaluate(reading(12, 100, 50, 0), settings);
+    TEST_ASSERT_EQUAL_UINT16(aqi::NO_INDEX, quality.vocIndex);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 73.0f / EpaAirScore::FULL_SCALE, quality.score);
+
+    // past full scale the score stays at 1: PM2.5 150 ug/m3 is 225
+    quality = epa.evaluate(reading(150, 20, 100, 100), settings);
+    TEST_ASSERT_EQUAL_UINT16(225, quality.pm25Index);
+    TEST_ASSERT_EQUAL_FLOAT(1, quality.score);
+    TEST_ASSERT_EQUAL_FLOAT(0, epa.evaluate(reading(0, 0, 120, 100), settings).score);
+
+    // the legacy settings play no part
+    settings.pmLow = 1;
+    settings.pmHigh = 2;
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 73.0f / EpaAirScore::FULL_SCALE,
+                             epa.evaluate(reading(12, 100, 100, 100), settings).score);
+}
+
+static void test_eu_worst_sub_index_over_100() {
+    Settings settings = Settings::defaults();
+    EuAirScore eu;
+
+    // CAQI: PM2.5 20 ug/m3 is 33, PM10 70 is 63
+    AirQuality quality = eu.evaluate(reading(20, 70, 100, 100), settings);
+    TEST_ASSERT_EQUAL_UINT16(33, quality.pm25Index);
+    TEST_ASSERT_EQUAL_UINT16(63, quality.pm10Index);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 63.0f / EuAirScore::FULL_SCALE, quality.score);
+
+    // band edges: PM2.5 55 is 75, PM10 180 and beyond 100
+    quality = eu.evaluate(reading(55, 180, 100, 100), settings);
+    TEST_ASSERT_EQUAL_UINT16(75, quality.pm25Index);
+    TEST_ASSERT_EQUAL_UINT16(100, quality.pm10Index);
+    TEST_ASSERT_EQUAL_FLOAT(1, quality.score);
+    TEST_ASSERT_EQUAL_UINT16(100, eu.evaluate(reading(500, 500, 100, 100), settings).pm25Index);
+
+    // the VOC index over its own full scale of 200: 183 weighs less than
+    // a PM sub-index of 100 would
+    quality = eu.evaluate(reading(20, 70, 50, 100), settings);
+    TEST_ASSERT_EQUAL_UINT16(183, quality.vocIndex);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 183.0f / EuAirScore::VOC_FULL_SCALE, quality.score);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 63.0f / EuAirScore::FULL_SCALE,
+                             eu.evaluate(reading(20, 70, 90, 100), settings).score);
+
+    // the same particles score higher than on the EPA scale
+    TEST_ASSERT_TRUE(eu.evaluate(reading(20, 70, 100, 100), settings).score >
+                     EpaAirScore().evaluate(reading(20, 70, 100, 100), settings).score);
+}
+
+static void test_score_policy_from_a_downlink_survives_a_power_cycle() {
+    // the build default before anything is stored
+    Settings settings = Settings::defaults();
+    TEST_ASSERT_EQUAL_UINT8(AIR_SCORE, settings.scorePolicy);
+    TEST_ASSERT_FALSE(Settings::load(settings));
+
+    // the way main.cpp handles a downlink: dispatched, saved
+    Data data = reading(12, 100, 100, 100);
+    for (uint8_t policy : { AIR_SCORE_LEGACY, AIR_SCORE_EU, AIR_SCORE_EPA }) {
+        uint8_t frame[1] = { policy };
+        TEST_ASSERT_EQUAL(CommandDispatcher::RESULT_OK, CommandDispatcher::dispatch(15, frame, sizeof(frame), settings));
+        settings.save();
+
+        // after a power cycle
+        Settings restored = Settings::defaults();
+        restored.scorePolicy = 0xFF;
+        TEST_ASSERT_TRUE(Settings::load(restored));
+        TEST_ASSERT_EQUAL_UINT8(policy, restored.scorePolicy);
+        TEST_ASSERT_EQUAL_PTR(&airScore(policy), &airScore(restored.scorePolicy));
+        TEST_ASSERT_EQUAL_FLOAT(airScore(policy).evaluate(data, restored).score,
+                                airScore(restored.scorePolicy).evaluate(data, restored).score);
+    }
+    // each its own scoring
+    TEST_ASSERT_TRUE(&airScore(AIR_SCORE_LEGACY) != &airScore(AIR_SCORE_EPA));
+    TEST_ASSERT_TRUE(&airScore(AIR_SCORE_EU) != &airScore(AIR_SCORE_EPA));
+
+    // an unknown policy is rejected and the stored one stays
+    uint8_t unknown[1] = { AIR_SCORE_EU + 1 };
+    TEST_ASSERT_EQUAL(CommandDispatcher::RESULT_BAD_VALUE, CommandDispatcher::dispatch(15, unknown, 1, settings));
+    TEST_ASSERT_EQUAL_UINT8(AIR_SCORE_EPA, settings.scorePolicy);
+
+    // a stored record with one out of range does not load, nor does a
+    // corrupt one; the byte is where the records of the two policies have
+    // them (the padding is not cleared, it may differ too)
+    std::vector<uint8_t>& stored = sim::Simulation::get().nvs()["settings/settings"];
+    std::vector<uint8_t> good = stored;
+    settings.scorePolicy = AIR_SCORE_LEGACY;
+    settings.save();
+    std::vector<uint8_t> legacy = stored;
+    TEST_ASSERT_EQUAL(good.size(), legacy.size());
+    size_t at = 0;
+    while (at < good.size() && !(good[at] == AIR_SCORE_EPA && legacy[at] == AIR_SCORE_LEGACY)) {
+        at++;
+    }
+    TEST_ASSERT_TRUE(at < good.size());
+    stored = good;
+    stored[at] = AIR_SCORE_EU + 1;
+    Settings restored = Settings::defaults();
+    TEST_ASSERT_FALSE(Settings::load(restored));
+    stored = good;
+    stored[at] = AIR_SCORE_LEGACY;
+    TEST_ASSERT_FALSE(Settings::load(restored));
+    stored = good;
+    TEST_ASSERT_TRUE(Settings::load(restored));
+
+    // and an unknown policy scores with the build default
+    TEST_ASSERT_EQUAL_PTR(&airScore(AIR_SCORE), &airScore(0xFF));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_legacy_buckets_at_the_default_settings);
+    RUN_TEST(test_voc_index_from_the_gas_drop);
+    RUN_TEST(test_epa_worst_sub_index_over_200);
+    RUN_TEST(test_eu_worst_sub_index_over_100);
+    RUN_TEST(test_score_policy_from_a_downlink_survives_a_power_cycle);
+    return UNITY_END();
+}
@@ -0,0 +1,259 @@
+// BatchCodec: base sample plus zig-zag varint deltas, round trip at the
+// field limits, the cut at the payload limit and malformed frames
+#include <unity.h>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include "Codec/BatchCodec.h"
+
+using SmartAirControl::BatchCodec;
+using SmartAirControl::Sample;
+using SmartAirControl::UplinkCodec;
+
+// What encode() reads from, like RtcSampleRing
+struct Samples {
+    size_t size() const { return count; }
+    const Sample& at(size_t i) const { return items[i]; }
+
+    Sample items[300];
+    size_t count = 0;
+};
+
+static const size_t BASE_SIZE = BatchCodec::HEADER_SIZE + UplinkCodec::FIELDS_SIZE;
+
+void setUp() {}
+void tearDown() {}
+
+static void assertSameSample(const Sample& expected, const Sample& actual) {
+    TEST_ASSERT_EQUAL_INT16(expected.temperature, actual.temperature);
+    TEST_ASSERT_EQUAL_UINT16(expected.pressure, actual.pressure);
+    TEST_ASSERT_EQUAL_UINT8(expected.humidity, actual.humidity);
+    TEST_ASSERT_EQUAL_UINT16(expected.gasResistance, actual.gasResistance);
+    TEST_ASSERT_EQUAL_UINT16(expected.pm10, actual.pm10);
+    TEST_ASSERT_EQUAL_UINT16(expected.pm25, actual.pm25);
+    TEST_ASSERT_EQUAL_UINT16(expected.pm100, actual.pm100);
+    TEST_ASSERT_EQUAL_UINT16(expected.fanRpm, actual.fanRpm);
+    TEST_ASSERT_EQUAL_UINT8(expected.fanPercent, actual.fanPercent);
+    TEST_ASSERT_EQUAL_UINT8(expected.score, actual.score);
+}
+
+// Every field at its lowest or its highest
+static Sample extreme(bool high) {
+    Sample sample;
+    sample.temperature = high ? INT16_MAX : INT16_MIN;
+    sample.pressure = high ? UINT16_MAX : 0;
+    sample.humidity = high ? 200 : 0;
+    sample.gasResistance = high ? UINT16_MAX : 0;
+    sample.pm10 = high ? UINT16_MAX : 0;
+    sample.pm25 = high ? UINT16_MAX : 0;
+    sample.pm100 = high ? UINT16_MAX : 0;
+    sample.fanRpm = high ? UINT16_MAX : 0;
+    sample.fanPercent = high ? 100 : 0;
+    sample.score = high ? 200 : 0;
+    return sample;
+}
+
+// Indoor air a minute apart
+static Samples indoor(size_t count) {
+    Samples samples;
+    for (size_t i = 0; i < count; i++) {
+        samples.items[i] = Sample(22.4f + (i % 7) * 0.03f, 1013.2f - (i % 3) * 0.1f, 45 + (i % 4) * 0.5f,
+                                  120 - (i % 5) * 0.7f, 6 + i % 2, 9 + i % 3, 14 + (i % 4), 5800 + (i % 5) * 12,
+                                  40, 0.2f + (i % 3) * 0.01f);
+    }
+    samples.count = count;
+    return samples;
+}
+
+static void assertRoundTrip(const Samples& samples) {
+    uint8_t frame[1024];
+    size_t encoded;
+    size_t size = BatchCodec::encode(samples, frame, sizeof(frame), encoded);
+    TEST_ASSERT_EQUAL(samples.size(), encoded);
+
+    Sample decoded[300];
+    TEST_ASSERT_EQUAL(encoded, BatchCodec::decode(frame, size, decoded, 300));
+    for (size_t i = 0; i < encoded; i++) {
+        assertSameSample(samples.at(i), decoded[i]);
+    }
+}
+
+static void test_zig_zag_keeps_small_magnitudes_small() {
+    TEST_ASSERT_EQUAL_UINT32(0, BatchCodec::zigZag(0));
+    TEST_ASSERT_EQUAL_UINT32(1, BatchCodec::zigZag(-1));
+    TEST_ASSERT_EQUAL_UINT32(2, BatchCodec::zigZag(1));
+    TEST_ASSERT_EQUAL_UINT32(3, BatchCodec::zigZag(-2));
+    // the largest uint16 difference either way fits 17 bits
+    TEST_ASSERT_EQUAL_UINT32(131070, BatchCodec::zigZag(65535));
+    TEST_ASSERT_EQUAL_UINT32(131069, BatchCodec::zigZag(-65535));
+    for (int32_t value : { 0, 1, -1, 63, -64, 64, 32767, -32768, 65535, -65535, INT32_MAX, INT32_MIN }) {
+        TEST_ASSERT_EQUAL_INT32(value, BatchCodec::unZigZag(BatchCodec::zigZag(value)));
+    }
+}
+
+static void test_varint_lengths_and_limits() {
+    static const struct {
+        uint32_t value;
+        size_t size;
+    } CASES[] = { { 0, 1 }, { 0x7F, 1 }, { 0x80, 2 }, { 0x3FFF, 2 }, { 0x4000, 3 }, { 131070, 3 }, { UINT32_MAX, 5 } };
+    for (const auto& c : CASES) {
+        uint8_t buffer[5];
+        TEST_ASSERT_EQUAL(c.size, BatchCodec::putVarint(c.value, buffer));
+        uint32_t value;
+        TEST_ASSERT_EQUAL(c.size, BatchCodec::getVarint(buffer, c.size, value));
+        TEST_ASSERT_EQUAL_UINT32(c.value, value);
+        // one byte short
+        TEST_ASSERT_EQUAL(0, BatchCodec::getVarint(buffer, c.size - 1, value));
+    }
+    // a continuation bit on the fifth byte: longer than any uint32
+    static const uint8_t TOO_LONG[] = { 0x80, 0x80, 0x80, 0x80, 0x80, 0x01 };
+    uint32_t value;
+    TEST_ASSERT_EQUAL(0, BatchCodec::getVarint(TOO_LONG, sizeof(TOO_LONG), value));
+}
+
+static void test_round_trip_of_indoor_air() {
+    Samples samples = indoor(6);
+    assertRoundTrip(samples);
+
+    // small deltas take a byte a field, against a full sample each
+    uint8_t frame[256];
+    size_t encoded;
+    size_t size = BatchCodec::encode(samples, frame, sizeof(frame), encoded);
+    TEST_ASSERT_EQUAL(BASE_SIZE + 5 * BatchCodec::FIELD_COUNT, size);
+}
+
+static void test_round_trip_of_largest_deltas_both_ways() {
+    Samples samples;
+    samples.items[0] = extreme(false);
+    samples.items[1] = extreme(true);
+    samples.items[2] = extreme(false);
+    samples.items[3] = extreme(false);
+    samples.items[4] = extreme(true);
+    samples.count = 5;
+    assertRoundTrip(samples);
+
+    // a delta of the full range costs 3 bytes a 16 bit field, 2 for the 8 bit ones
+    uint8_t frame[256];
+    size_t encoded;
+    size_t size = BatchCodec::encode(samples, frame, sizeof(frame), encoded);
+    uint8_t delta[BatchCodec::MAX_DELTA_SIZE];
+    TEST_ASSERT_EQUAL(7 * 3 + 3 * 2, BatchCodec::putDelta(samples.at(0), samples.at(1), delta));
+    TEST_ASSERT_EQUAL(BASE_SIZE + 3 * 27 + BatchCodec::FIELD_COUNT, size);
+}
+
+static void test_payload_limit_cuts_at_a_sample() {
+    Samples samples = indoor(20);
+    samples.items[7] = extreme(true);
+    uint8_t full[1024];
+    size_t all;
+    size_t fullSize = BatchCodec::encode(samples, full, sizeof(full), all);
+    TEST_ASSERT_EQUAL(20, all);
+
+    for (size_t limit = 0; limit <= fullSize; limit++) {
+        uint8_t frame[1024];
+        std::memset(frame, 0xAA, sizeof(frame));
+        size_t encoded;
+        size_t size = BatchCodec::encode(samples, frame, limit, encoded);
+        TEST_ASSERT_LESS_OR_EQUAL(limit, size);
+        TEST_ASSERT_EQUAL_UINT8(0xAA, frame[limit]);
+        if (limit < BASE_SIZE) {
+            TEST_ASSERT_EQUAL(0, encoded);
+            TEST_ASSERT_EQUAL(0, size);
+            continue;
+        }
+        TEST_ASSERT_GREATER_OR_EQUAL(1, encoded);
+        // the next sample would not have fit
+        if (encoded < samples.size()) {
+            uint8_t delta[BatchCodec::MAX_DELTA_SIZE];
+            TEST_ASSERT_GREATER_THAN(limit, size + BatchCodec::putDelta(samples.at(encoded - 1), samples.at(encoded), delta));
+        }
+        // and what is there decodes to the oldest samples
+        Sample decoded[20];
+        TEST_ASSERT_EQUAL(encoded, BatchCodec::decode(frame, size, decoded, 20));
+        for (size_t i = 0; i < encoded; i++) {
+            assertSameSample(samples.at(i), decoded[i]);
+        }
+    }
+}
+
+static void test_count_stops_at_255() {
+    Samples samples = indoor(300);
+    static uint8_t frame[300 * BatchCodec::MAX_DELTA_SIZE];
+    size_t encoded;
+    size_t size = BatchCodec::encode(samples, frame, sizeof(frame), encoded);
+    TEST_ASSERT_EQUAL(UINT8_MAX, encoded);
+    TEST_ASSERT_EQUAL_UINT8(UINT8_MAX, frame[1]);
+    Sample decoded[300];
+    TEST_ASSERT_EQUAL(UINT8_MAX, BatchCodec::decode(frame, size, decoded, 300));
+}
+
+static void test_malformed_frames_decode_to_nothing() {
+    Samples samples = indoor(4);
+    samples.items[2] = extreme(true);
+    uint8_t frame[256];
+    size_t encoded;
+    size_t size = BatchCodec::encode(samples, frame, sizeof(frame), encoded);
+    Sample decoded[8];
+    TEST_ASSERT_EQUAL(4, BatchCodec::decode(frame, size, decoded, 8));
+
+    // every truncation, also inside a varint, and a trailing byte
+    for (size_t shorter = 0; shorter < size; shorter++) {
+        TEST_ASSERT_EQUAL(0, BatchCodec::decode(frame, shorter, decoded, 8));
+    }
+    frame[size] = 0;
+    TEST_ASSERT_EQUAL(0, BatchCodec::decode(frame, size + 1, decoded, 8));
+
+    // more samples than the caller has room for
+    TEST_ASSERT_EQUAL(0, BatchCodec::decode(frame, size, decoded, 3));
+
+    // a count that does not match the deltas
+    uint8_t changed[256];
+    std::memcpy(changed, frame, size);
+    changed[1] = 0;
+    TEST_ASSERT_EQUAL(0, BatchCodec::decode(changed, size, decoded, 8));
+    changed[1] = 3;
+    TEST_ASSERT_EQUAL(0, BatchCodec::decode(changed, size, decoded, 8));
+    changed[1] = 5;
+    TEST_ASSERT_EQUAL(0, BatchCodec::decode(changed, size, decoded, 8));
+
+    // the single sample frame of version 1, and an unknown version
+    std::memcpy(changed, frame, size);
+    changed[0] = 1;
+    TEST_ASSERT_EQUAL(0, BatchCodec::decode(changed, size, decoded, 8));
+    changed[0] = BatchCodec::VERSION + 1;
+    TEST_ASSERT_EQUAL(0, BatchCodec::decode(changed, size, decoded, 8));
+
+    // a varint that never ends
+    std::memcpy(changed, frame, size);
+    std::memset(&changed[size - 6], 0xFF, 6);
+    TEST_ASSERT_EQUAL(0, BatchCodec::decode(changed, size, decoded, 8));
+
+    TEST_ASSERT_EQUAL(0, BatchCodec::decode(nullptr, size, decoded, 8));
+}
+
+static void test_nothing_to_encode() {
+    Samples empty;
+    uint8_t frame[64];
+    size_t encoded = 7;
+    TEST_ASSERT_EQUAL(0, BatchCodec::encode(empty, frame, sizeof(frame), encoded));
+    TEST_ASSERT_EQUAL(0, encoded);
+
+    Samples one = indoor(1);
+    TEST_ASSERT_EQUAL(0, BatchCodec::encode(one, nullptr, sizeof(frame), encoded));
+    TEST_ASSERT_EQUAL(0, encoded);
+    TEST_ASSERT_EQUAL(BASE_SIZE, BatchCodec::encode(one, frame, BASE_SIZE, encoded));
+    TEST_ASSERT_EQUAL(1, encoded);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_zig_zag_keeps_small_magnitudes_small);
+    RUN_TEST(test_varint_lengths_and_limits);
+    RUN_TEST(test_round_trip_of_indoor_air);
+    RUN_TEST(test_round_trip_of_largest_deltas_both_ways);
+    RUN_TEST(test_payload_limit_cuts_at_a_sample);
+    RUN_TEST(test_count_stops_at_255);
+    RUN_TEST(test_malformed_frames_decode_to_nothing);
+    RUN_TEST(test_nothing_to_encode);
+    return UNITY_END();
+}
@@ -0,0 +1,163 @@
+// BME680 conversion on the virtual clock: while the gas heater runs (150 ms
+// at 320 C, plus the TPH measurement) the sensor and control steps go on
+// without blocking, the PMS5003 frame that arrives meanwhile is parsed and
+// the fan is controlled; the blocking read() this replaced held both up
+// for the whole conversion
+#include <unity.h>
+#include <cstdint>
+#include <cstdio>
+#include "HAL/Hal.h"
+#include "HAL/native/Simulation.h"
+#include "BME/BME.h"
+#include "PMS/PMS.h"
+#include "Fan/Fan.h"
+#include "Fan/IsrTach.h"
+#include "Control/FanPolicy.h"
+
+using SmartAirControl::BME;
+using SmartAirControl::BMEData;
+using SmartAirControl::Fan;
+using SmartAirControl::FanPolicy;
+using SmartAirControl::GasBaseline;
+using SmartAirControl::PMS;
+using SmartAirControl::Settings;
+namespace hal = SmartAirControl::hal;
+namespace sim = SmartAirControl::sim;
+
+// as in main.cpp
+static const int HEATER_MS = 150;
+static const uint32_t POLL_MS = 20;
+static const uint32_t CONTROL_MS = 100;
+
+static GasBaseline::State baselineState;
+static BME bme(BME680_OS_8X, BME680_OS_2X, BME680_OS_4X, BME680_FILTER_SIZE_3, 320, HEATER_MS, 1013.25, baselineState);
+static PMS pms(16, 17, 9600, SERIAL_8N1);
+static SmartAirControl::IsrTach tach(sim::Simulation::get().fanTachPin);
+static Fan fan(sim::Simulation::get().fanPwmPin, tach);
+static FanPolicy fanPolicy(FAN_POLICY_OPTIMAL);
+static Settings settings = Settings::defaults();
+
+struct Window {
+    uint32_t conversionMs; /** from the start of the conversion to its data */
+    uint32_t longestStepMs;
+    int frames;            /** PMS5003 frames parsed meanwhile */
+    int controlSteps;      /** fan controlled meanwhile */
+    BMEData data;
+};
+
+// Steps like SensorTask and ControlTask until the conversion is collected,
+// with the blocking read() when blocking
+static Window convert(bool blocking) {
+    Window window = {};
+    uint32_t start = hal::millis();
+    uint32_t lastControl = start;
+    bool done = false;
+    if (!blocking) {
+        TEST_ASSERT_TRUE(bme.startConversion());
+    }
+    while (!done) {
+        uint32_t stepStart = hal::millis();
+        if (pms.update()) {
+            window.frames++;
+        }
+        if (blocking) {
+            window.data = bme.read();
+            done = true;
+        } else if (bme.poll()) {
+            window.data = bme.getData();
+            done = true;
+        }
+        if (hal::millis() - lastControl >= CONTROL_MS) {
+            lastControl = hal::millis();
+            fanPolicy.adjustFanSpeed(fan, 0.6f, settings, lastControl);
+            fan.update();
+            window.controlSteps++;
+        }
+        uint32_t stepMs = hal::millis() - stepStart;
+        window.longestStepMs = stepMs > window.longestStepMs ? stepMs : window.longestStepMs;
+        if (!done) {
+            hal::delay(POLL_MS);
+        }
+    }
+    window.conversionMs = hal::millis() - start;
+
+    char message[96];
+    std::snprintf(message, sizeof(message), "%s: %u ms, longest step %u ms, %d frames, %d control steps",
+                  blocking ? "read()" : "poll()", window.conversionMs, window.longestStepMs, window.frames,
+                  window.controlSteps);
+    TEST_MESSAGE(message);
+    return window;
+}
+
+// Until the next PMS5003 frame is due within the conversion
+static void alignToFrame() {
+    for (int i = 0; i < 1000 && !(pms.hasFrame() && pms.getMsUntilFrame() > 0 && pms.getMsUntilFrame() <= 60); i++) {
+        hal::delay(5);
+        pms.update();
+    }
+    TEST_ASSERT_TRUE(pms.hasFrame());
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_steps_go_on_during_the_heater_conversion() {
+    alignToFrame();
+    Window window = convert(false);
+
+    // the heater time and the measurement after it
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(HEATER_MS, window.conversionMs);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(HEATER_MS + 40 + POLL_MS, window.conversionMs);
+    // no step waited for the sensor
+    TEST_ASSERT_EQUAL_UINT32(0, window.longestStepMs);
+    TEST_ASSERT_EQUAL_INT(1, window.frames);
+    TEST_ASSERT_GREATER_OR_EQUAL(1, window.controlSteps);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, sim::Simulation::get().air().temperature, window.data.temperature);
+    TEST_ASSERT_TRUE(window.data.gasResistance > 0);
+}
+
+static void test_blocking_read_held_the_steps_up() {
+    alignToFrame();
+    Window window = convert(true);
+
+    // the one step took the whole conversion, nothing else ran
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(HEATER_MS, window.longestStepMs);
+    TEST_ASSERT_EQUAL_UINT32(window.conversionMs, window.longestStepMs);
+    TEST_ASSERT_EQUAL_INT(0, window.frames);
+    // at most the one after it
+    TEST_ASSERT_LESS_OR_EQUAL_INT(1, window.controlSteps);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, sim::Simulation::get().air().temperature, window.data.temperature);
+
+    // the frame waited in the UART buffer meanwhile
+    TEST_ASSERT_TRUE(pms.update());
+}
+
+static void test_split_and_blocking_read_agree() {
+    // the same air a conversion apart, on a plate warmed up (a cold one
+    // reads high and settles with every conversion)
+    while (!bme.isGasStable()) {
+        bme.read();
+    }
+    for (int i = 0; i < 16; i++) {
+        bme.read();
+    }
+    alignToFrame();
+    BMEData split = convert(false).data;
+    BMEData blocking = convert(true).data;
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, split.temperature, blocking.temperature);
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, split.humidity, blocking.humidity);
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, split.pressure, blocking.pressure);
+    TEST_ASSERT_FLOAT_WITHIN(split.gasResistance * 0.05f, split.gasResistance, blocking.gasResistance);
+}
+
+int main() {
+    bme.setup();
+    pms.setup();
+    fan.setup();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_steps_go_on_during_the_heater_conversion);
+    RUN_TEST(test_blocking_read_held_the_steps_up);
+    RUN_TEST(test_split_and_blocking_read_agree);
+    return UNITY_END();
+}
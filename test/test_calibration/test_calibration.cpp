@@ -0,0 +1,198 @@
+// FanCalibration on the simulated fan: the sweep stays within its time
+// budget (11 points, at least 1.5 s and at most 4 s each, 44 s in all) and
+// measures the fan; the percent->duty lookup it leaves behind is a plain
+// index that agrees with a segment search of the fitted table
+#include <unity.h>
+#include <cmath>
+#include <cstdio>
+#include <initializer_list>
+#include "HAL/Hal.h"
+#include "HAL/native/Simulation.h"
+#include "Fan/Fan.h"
+#include "Fan/FanCalibration.h"
+#include "Fan/IsrTach.h"
+
+using SmartAirControl::Fan;
+using SmartAirControl::FanCalibration;
+namespace hal = SmartAirControl::hal;
+namespace sim = SmartAirControl::sim;
+
+// ControlTask steps the calibration this often
+static const uint32_t STEP_MS = 100;
+static const unsigned long SETTLE_MS = 1500;
+static const unsigned long MAX_SETTLE_MS = 4000;
+static const unsigned long BUDGET_MS = 44000;
+
+// the factory table, which the simulated fan follows
+static const int RPM[Fan::N] = {   0,   780,  1140,  1440,  1740,  2730,  6720,  9960, 12930, 14520, 12570 };
+static const int DUTY[Fan::N] = { 255,   230,   204,   179,   153,   128,   102,    77,    51,    26,     0 };
+
+static SmartAirControl::IsrTach tach(sim::Simulation::get().fanTachPin);
+
+// A tach whose count never repeats within 2 %, so that no point settles
+class RestlessTach : public SmartAirControl::Tach {
+    public:
+        void begin() override {}
+        uint32_t takePulses() override {
+            calls++;
+            return calls % 2 ? 40 : 60;
+        }
+
+    private:
+        uint32_t calls = 0;
+};
+
+struct Sweep {
+    unsigned long totalMs;
+    int points;
+    unsigned long shortestMs; /** at one duty */
+    unsigned long longestMs;
+    int duty[Fan::N];         /** in the order swept */
+    int rpm[Fan::N];          /** accepted for it */
+};
+
+// Runs a calibration to its end like ControlTask does
+static Sweep sweep(Fan& fan) {
+    sim::Simulation& simulation = sim::Simulation::get();
+    FanCalibration calibration(fan, SETTLE_MS, MAX_SETTLE_MS);
+    TEST_ASSERT_EQUAL_UINT32(BUDGET_MS, calibration.getBudgetMs());
+
+    Sweep result = {};
+    result.shortestMs = BUDGET_MS;
+    unsigned long start = hal::millis();
+    calibration.start();
+    unsigned long pointStart = start;
+    int duty = simulation.fan().getDuty();
+    bool running = true;
+    while (running) {
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32(2 * BUDGET_MS, hal::millis() - start);
+        hal::delay(STEP_MS);
+        running = calibration.step();
+        // a point is accepted when the duty moves on, or when the sweep ends
+        if (simulation.fan().getDuty() != duty || !running) {
+            unsigned long ms = hal::millis() - pointStart;
+            result.shortestMs = ms < result.shortestMs ? ms : result.shortestMs;
+            result.longestMs = ms > result.longestMs ? ms : result.longestMs;
+            result.duty[result.points] = duty;
+            result.rpm[result.points] = fan.getRawRpm();
+            result.points++;
+            duty = simulation.fan().getDuty();
+            pointStart = hal::millis();
+        }
+    }
+    result.totalMs = hal::millis() - start;
+
+    char message[96];
+    std::snprintf(message, sizeof(message), "%d points in %.1f s, %.1f to %.1f s each", result.points,
+                  result.totalMs / 1000.0, result.shortestMs / 1000.0, result.longestMs / 1000.0);
+    TEST_MESSAGE(message);
+    return result;
+}
+
+// getInterpolatedDuty() as a search of the table, the way it was before the lookup
+static int searchDuty(const int rpm[], const int duty[], int percent) {
+    float desiredRpm = percent / 100.0 * rpm[Fan::N - 1];
+    if (desiredRpm <= rpm[0]) {
+        return duty[0];
+    }
+    for (int i = 0; i < Fan::N - 1; i++) {
+        if (desiredRpm <= rpm[i+1] && rpm[i+1] > rpm[i]) {
+            float frac = (desiredRpm - rpm[i]) / (rpm[i+1] - rpm[i]);
+            return int(duty[i] + frac * (duty[i+1] - duty[i]) + 0.5);
+        }
+    }
+    return duty[Fan::N - 1];
+}
+
+// The table as setTable() fits it: a point may not be slower than the one below
+static void fit(const int rpm[], int fitted[]) {
+    for (int i = 0; i < Fan::N; i++) {
+        fitted[i] = (i > 0 && rpm[i] < fitted[i-1]) ? fitted[i-1] : rpm[i];
+    }
+}
+
+void setUp() {
+    sim::Simulation::get().nvs().clear();
+}
+
+void tearDown() {}
+
+static void test_sweep_measures_the_fan_within_the_budget() {
+    Fan fan(sim::Simulation::get().fanPwmPin, tach);
+    fan.setup();
+    TEST_ASSERT_FALSE(fan.isCalibrated());
+
+    Sweep result = sweep(fan);
+    TEST_ASSERT_EQUAL_INT(Fan::N, result.points);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(BUDGET_MS, result.totalMs);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(SETTLE_MS, result.shortestMs);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(MAX_SETTLE_MS, result.longestMs);
+
+    // from full speed down, so the fan never starts from standstill at a low duty
+    TEST_ASSERT_EQUAL_INT(0, result.duty[0]);
+    TEST_ASSERT_EQUAL_INT(Fan::PWM_MAX, result.duty[Fan::N - 1]);
+    for (int i = 0; i < Fan::N - 1; i++) {
+        // two readings 500 ms apart agree within 2 % while the fan (time
+        // constant 1.2 s) is still up to 3 times that from where it settles:
+        // within 8 % or 50 rpm
+        float steady = sim::FanModel::steadyRpm(result.duty[i]);
+        float tolerance = steady * 0.08f > 50 ? steady * 0.08f : 50;
+        TEST_ASSERT_FLOAT_WITHIN(tolerance, steady, result.rpm[i]);
+    }
+    // the rotor is still running down when the last point times out
+    TEST_ASSERT_LESS_THAN(RPM[1] / 4, result.rpm[Fan::N - 1]);
+
+    // stored, and the fan stopped until the controller wants it
+    TEST_ASSERT_EQUAL_FLOAT(0, fan.getRpmPercent());
+    Fan next(sim::Simulation::get().fanPwmPin, tach);
+    next.setup();
+    TEST_ASSERT_TRUE(next.isCalibrated());
+}
+
+static void test_unsettled_points_are_accepted_after_four_seconds() {
+    RestlessTach restless;
+    Fan fan(sim::Simulation::get().fanPwmPin, restless);
+    fan.setup();
+
+    Sweep result = sweep(fan);
+    TEST_ASSERT_EQUAL_INT(Fan::N, result.points);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(BUDGET_MS, result.totalMs);
+    // every point waits for the timeout, give or take a step
+    TEST_ASSERT_UINT32_WITHIN(STEP_MS, MAX_SETTLE_MS, result.shortestMs);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(MAX_SETTLE_MS, result.longestMs);
+}
+
+static void test_lookup_matches_a_search_of_the_fitted_table() {
+    // the factory table turns slower at duty 0 than at 26, and a measured one
+    // with a flat segment and a dip
+    static const int MEASURED[Fan::N] = { 0, 820, 820, 1500, 1480, 2900, 6500, 10100, 12800, 14100, 14300 };
+    for (const int* rpm : { RPM, MEASURED }) {
+        Fan fan(sim::Simulation::get().fanPwmPin, tach);
+        fan.setTable(rpm, DUTY);
+        int fitted[Fan::N];
+        fit(rpm, fitted);
+
+        int previous = Fan::PWM_MAX;
+        for (int percent = 0; percent <= 100; percent++) {
+            int duty = fan.getInterpolatedDuty(percent);
+            TEST_ASSERT_EQUAL_INT(searchDuty(fitted, DUTY, percent), duty);
+            // faster never takes more duty-off time
+            TEST_ASSERT_LESS_OR_EQUAL_INT(previous, duty);
+            previous = duty;
+        }
+        TEST_ASSERT_EQUAL_INT(Fan::PWM_MAX, fan.getInterpolatedDuty(-5));
+    }
+
+    // the inversion at the top is fitted away: 100 % is duty 26, not 0
+    Fan factory(sim::Simulation::get().fanPwmPin, tach);
+    TEST_ASSERT_EQUAL_INT(26, factory.getInterpolatedDuty(100));
+    TEST_ASSERT_EQUAL_INT(26, factory.getInterpolatedDuty(150));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_sweep_measures_the_fan_within_the_budget);
+    RUN_TEST(test_unsettled_points_are_accepted_after_four_seconds);
+    RUN_TEST(test_lookup_matches_a_search_of_the_fitted_table);
+    return UNITY_END();
+}
@@ -0,0 +1,141 @@
+// UplinkCodec: round trip, saturation at the field limits, short buffers
+#include <unity.h>
+#include <cstdint>
+#include <cstdio>
+#include "Codec/UplinkCodec.h"
+
+using SmartAirControl::Sample;
+using SmartAirControl::UplinkCodec;
+
+void setUp() {}
+void tearDown() {}
+
+static void assertSameSample(const Sample& expected, const Sample& actual) {
+    TEST_ASSERT_EQUAL_INT16(expected.temperature, actual.temperature);
+    TEST_ASSERT_EQUAL_UINT16(expected.pressure, actual.pressure);
+    TEST_ASSERT_EQUAL_UINT8(expected.humidity, actual.humidity);
+    TEST_ASSERT_EQUAL_UINT16(expected.gasResistance, actual.gasResistance);
+    TEST_ASSERT_EQUAL_UINT16(expected.pm10, actual.pm10);
+    TEST_ASSERT_EQUAL_UINT16(expected.pm25, actual.pm25);
+    TEST_ASSERT_EQUAL_UINT16(expected.pm100, actual.pm100);
+    TEST_ASSERT_EQUAL_UINT16(expected.fanRpm, actual.fanRpm);
+    TEST_ASSERT_EQUAL_UINT8(expected.fanPercent, actual.fanPercent);
+    TEST_ASSERT_EQUAL_UINT8(expected.score, actual.score);
+}
+
+static Sample roundTrip(const Sample& sample) {
+    uint8_t frame[UplinkCodec::FRAME_SIZE];
+    TEST_ASSERT_EQUAL(UplinkCodec::FRAME_SIZE, UplinkCodec::encode(sample, frame, sizeof(frame)));
+    Sample decoded;
+    TEST_ASSERT_TRUE(UplinkCodec::decode(frame, sizeof(frame), decoded));
+    return decoded;
+}
+
+static void test_round_trip_keeps_the_resolution() {
+    Sample sample(21.37f, 1013.2f, 45.5f, 123.4f, 3, 7, 12, 2730, 42, 0.35f);
+    Sample decoded = roundTrip(sample);
+    assertSameSample(sample, decoded);
+
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, 21.37f, decoded.temperatureC());
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 1013.2f, decoded.pressureHpa());
+    TEST_ASSERT_FLOAT_WITHIN(0.25f, 45.5f, decoded.humidityPercent());
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 123.4f, decoded.gasResistanceKOhm());
+    TEST_ASSERT_FLOAT_WITHIN(0.0025f, 0.35f, decoded.scoreRatio());
+}
+
+static void test_negative_temperature() {
+    Sample decoded = roundTrip(Sample(-12.34f, 980, 80, 50, 0, 0, 0, 0, 0, 0));
+    TEST_ASSERT_EQUAL_INT16(-1234, decoded.temperature);
+}
+
+static void test_upper_limits_saturate() {
+    Sample sample(400.0f, 7000.0f, 150.0f, 9000.0f, UINT16_MAX, UINT16_MAX, UINT16_MAX, 100000, 250.0f, 2.0f);
+    TEST_ASSERT_EQUAL_INT16(INT16_MAX, sample.temperature);
+    TEST_ASSERT_EQUAL_UINT16(UINT16_MAX, sample.pressure);
+    TEST_ASSERT_EQUAL_UINT8(200, sample.humidity);
+    TEST_ASSERT_EQUAL_UINT16(UINT16_MAX, sample.gasResistance);
+    TEST_ASSERT_EQUAL_UINT16(UINT16_MAX, sample.fanRpm);
+    TEST_ASSERT_EQUAL_UINT8(100, sample.fanPercent);
+    TEST_ASSERT_EQUAL_UINT8(200, sample.score);
+    assertSameSample(sample, roundTrip(sample));
+}
+
+static void test_lower_limits_saturate() {
+    Sample sample(-400.0f, -1.0f, -5.0f, -1.0f, 0, 0, 0, -10, -5.0f, -1.0f);
+    TEST_ASSERT_EQUAL_INT16(INT16_MIN, sample.temperature);
+    TEST_ASSERT_EQUAL_UINT16(0, sample.pressure);
+    TEST_ASSERT_EQUAL_UINT8(0, sample.humidity);
+    TEST_ASSERT_EQUAL_UINT16(0, sample.gasResistance);
+    TEST_ASSERT_EQUAL_UINT16(0, sample.fanRpm);
+    TEST_ASSERT_EQUAL_UINT8(0, sample.fanPercent);
+    TEST_ASSERT_EQUAL_UINT8(0, sample.score);
+    assertSameSample(sample, roundTrip(sample));
+}
+
+static void test_frame_is_big_endian_and_versioned() {
+    Sample sample;
+    sample.pm25 = 0x1234;
+    uint8_t frame[UplinkCodec::FRAME_SIZE];
+    UplinkCodec::encode(sample, frame, sizeof(frame));
+    TEST_ASSERT_EQUAL_UINT8(UplinkCodec::VERSION, frame[0]);
+    TEST_ASSERT_EQUAL_UINT8(0x12, frame[10]);
+    TEST_ASSERT_EQUAL_UINT8(0x34, frame[11]);
+}
+
+static void test_encode_rejects_a_short_buffer() {
+    uint8_t frame[UplinkCodec::FRAME_SIZE];
+    for (size_t i = 0; i < sizeof(frame); i++) {
+        frame[i] = 0xA5;
+    }
+    TEST_ASSERT_EQUAL(0, UplinkCodec::encode(Sample(), frame, UplinkCodec::FRAME_SIZE - 1));
+    TEST_ASSERT_EQUAL(0, UplinkCodec::encode(Sample(), nullptr, UplinkCodec::FRAME_SIZE));
+    // nothing written
+    for (size_t i = 0; i < sizeof(frame); i++) {
+        TEST_ASSERT_EQUAL_UINT8(0xA5, frame[i]);
+    }
+}
+
+static void test_decode_rejects_truncated_frames() {
+    uint8_t frame[UplinkCodec::FRAME_SIZE];
+    UplinkCodec::encode(Sample(20, 1000, 50, 100, 1, 2, 3, 4, 5, 0.5f), frame, sizeof(frame));
+    Sample decoded;
+    for (size_t size = 0; size < UplinkCodec::FRAME_SIZE; size++) {
+        TEST_ASSERT_FALSE(UplinkCodec::decode(frame, size, decoded));
+    }
+    TEST_ASSERT_FALSE(UplinkCodec::decode(nullptr, sizeof(frame), decoded));
+}
+
+static void test_decode_rejects_an_unknown_version() {
+    uint8_t frame[UplinkCodec::FRAME_SIZE];
+    UplinkCodec::encode(Sample(), frame, sizeof(frame));
+    frame[0] = UplinkCodec::VERSION + 1;
+    Sample decoded;
+    TEST_ASSERT_FALSE(UplinkCodec::decode(frame, sizeof(frame), decoded));
+}
+
+static void test_smaller_than_the_json_it_replaced() {
+    // what loop() used to send for the same cycle, with fewer values
+    char json[128];
+    int jsonSize = std::snprintf(json, sizeof(json), "{\"t\":%.2f,\"p\":%.2f,\"h\":%.2f,\"g\":%.2f,\"rpm\":%d,\"s\":%.6f}",
+                                 21.37, 1013.2, 45.5, 123.4, 2730, 0.35);
+    char message[96];
+    std::snprintf(message, sizeof(message), "JSON %d bytes, frame %u bytes, %d bytes saved", jsonSize,
+                  static_cast<unsigned>(UplinkCodec::FRAME_SIZE), jsonSize - static_cast<int>(UplinkCodec::FRAME_SIZE));
+    TEST_MESSAGE(message);
+    TEST_ASSERT_LESS_OR_EQUAL(20, UplinkCodec::FRAME_SIZE);
+    TEST_ASSERT_GREATER_THAN(3 * UplinkCodec::FRAME_SIZE, jsonSize);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip_keeps_the_resolution);
+    RUN_TEST(test_negative_temperature);
+    RUN_TEST(test_upper_limits_saturate);
+    RUN_TEST(test_lower_limits_saturate);
+    RUN_TEST(test_frame_is_big_endian_and_versioned);
+    RUN_TEST(test_encode_rejects_a_short_buffer);
+    RUN_TEST(test_decode_rejects_truncated_frames);
+    RUN_TEST(test_decode_rejects_an_unknown_version);
+    RUN_TEST(test_smaller_than_the_json_it_replaced);
+    return UNITY_END();
+}
@@ -0,0 +1,214 @@
+// CommandDispatcher: every command port, and truncated, oversized and out of
+// range frames, each rejected without touching the settings
+#include <unity.h>
+#include <cstdint>
+#include "Command/CommandDispatcher.h"
+#include "Control/AirScore.h"
+#include "LoRa/UplinkScheduler.h"
+
+using SmartAirControl::CommandDispatcher;
+using SmartAirControl::Settings;
+
+// the frame size of each command port, FIRST_PORT on
+static const size_t SIZES[] = { 2, 10, 3, 3, 0, 1 };
+// a valid frame for each, none of them the defaults
+static const uint8_t VALID[][10] = {
+    { FAN_MANUAL, 55 },
+    { 0, 5, 0, 40, 0, 30, 0x01, 0x2C, 0xFB, 28 },
+    { 30, 60, 10 },
+    { UPLINK_FIXED, 0x01, 0x68 },
+    { },
+    { AIR_SCORE_EU },
+};
+
+void setUp() {}
+void tearDown() {}
+
+// Valid and different from the defaults in every field
+static Settings custom() {
+    Settings settings = Settings::defaults();
+    settings.fanMode = FAN_OFF;
+    settings.fanPercent = 20;
+    settings.pmLow = 12;
+    settings.pmHigh = 50;
+    settings.gasLow = 40;
+    settings.gasHigh = 120;
+    settings.tempLow = 20;
+    settings.tempHigh = 26;
+    settings.gasWeight = 10;
+    settings.pmWeight = 80;
+    settings.tempWeight = 10;
+    settings.uplinkPolicy = UPLINK_ADAPTIVE;
+    settings.heartbeatMin = 15;
+    settings.scorePolicy = AIR_SCORE_LEGACY;
+    TEST_ASSERT_TRUE(settings.isValid());
+    return settings;
+}
+
+static void assertSameSettings(const Settings& expected, const Settings& actual) {
+    TEST_ASSERT_EQUAL_UINT8(expected.fanMode, actual.fanMode);
+    TEST_ASSERT_EQUAL_UINT8(expected.fanPercent, actual.fanPercent);
+    TEST_ASSERT_EQUAL_UINT16(expected.pmLow, actual.pmLow);
+    TEST_ASSERT_EQUAL_UINT16(expected.pmHigh, actual.pmHigh);
+    TEST_ASSERT_EQUAL_UINT16(expected.gasLow, actual.gasLow);
+    TEST_ASSERT_EQUAL_UINT16(expected.gasHigh, actual.gasHigh);
+    TEST_ASSERT_EQUAL_INT8(expected.tempLow, actual.tempLow);
+    TEST_ASSERT_EQUAL_INT8(expected.tempHigh, actual.tempHigh);
+    TEST_ASSERT_EQUAL_UINT8(expected.gasWeight, actual.gasWeight);
+    TEST_ASSERT_EQUAL_UINT8(expected.pmWeight, actual.pmWeight);
+    TEST_ASSERT_EQUAL_UINT8(expected.tempWeight, actual.tempWeight);
+    TEST_ASSERT_EQUAL_UINT8(expected.uplinkPolicy, actual.uplinkPolicy);
+    TEST_ASSERT_EQUAL_UINT16(expected.heartbeatMin, actual.heartbeatMin);
+    TEST_ASSERT_EQUAL_UINT8(expected.scorePolicy, actual.scorePolicy);
+}
+
+// Dispatches a frame that has to be rejected with result
+static void assertRejected(CommandDispatcher::Result result, uint8_t fPort, const uint8_t* payload, size_t size) {
+    Settings before = custom();
+    Settings settings = before;
+    TEST_ASSERT_EQUAL(result, CommandDispatcher::dispatch(fPort, payload, size, settings));
+    assertSameSettings(before, settings);
+}
+
+static void test_each_port_applies_its_command() {
+    Settings settings = custom();
+    TEST_ASSERT_EQUAL(CommandDispatcher::RESULT_OK, CommandDispatcher::dispatch(10, VALID[0], 2, settings));
+    TEST_ASSERT_EQUAL_UINT8(FAN_MANUAL, settings.fanMode);
+    TEST_ASSERT_EQUAL_UINT8(55, settings.fanPercent);
+
+    TEST_ASSERT_EQUAL(CommandDispatcher::RESULT_OK, CommandDispatcher::dispatch(11, VALID[1], 10, settings));
+    TEST_ASSERT_EQUAL_UINT16(5, settings.pmLow);
+    TEST_ASSERT_EQUAL_UINT16(40, settings.pmHigh);
+    TEST_ASSERT_EQUAL_UINT16(30, settings.gasLow);
+    TEST_ASSERT_EQUAL_UINT16(300, settings.gasHigh);
+    TEST_ASSERT_EQUAL_INT8(-5, settings.tempLow);
+    TEST_ASSERT_EQUAL_INT8(28, settings.tempHigh);
+
+    TEST_ASSERT_EQUAL(CommandDispatcher::RESULT_OK, CommandDispatcher::dispatch(12, VALID[2], 3, settings));
+    TEST_ASSERT_EQUAL_UINT8(30, settings.gasWeight);
+    TEST_ASSERT_EQUAL_UINT8(60, settings.pmWeight);
+    TEST_ASSERT_EQUAL_UINT8(10, settings.tempWeight);
+
+    TEST_ASSERT_EQUAL(CommandDispatcher::RESULT_OK, CommandDispatcher::dispatch(13, VALID[3], 3, settings));
+    TEST_ASSERT_EQUAL_UINT8(UPLINK_FIXED, settings.uplinkPolicy);
+    TEST_ASSERT_EQUAL_UINT16(360, settings.heartbeatMin);
+
+    TEST_ASSERT_EQUAL(CommandDispatcher::RESULT_OK, CommandDispatcher::dispatch(15, VALID[5], 1, settings));
+    TEST_ASSERT_EQUAL_UINT8(AIR_SCORE_EU, settings.scorePolicy);
+
+    // the other fields stayed as they were
+    Settings expected = custom();
+    expected.fanMode = FAN_MANUAL;
+    expected.fanPercent = 55;
+    expected.pmLow = 5;
+    expected.pmHigh = 40;
+    expected.gasLow = 30;
+    expected.gasHigh = 300;
+    expected.tempLow = -5;
+    expected.tempHigh = 28;
+    expected.gasWeight = 30;
+    expected.pmWeight = 60;
+    expected.tempWeight = 10;
+    expected.uplinkPolicy = UPLINK_FIXED;
+    expected.heartbeatMin = 360;
+    expected.scorePolicy = AIR_SCORE_EU;
+    assertSameSettings(expected, settings);
+
+    // reset takes no payload at all
+    TEST_ASSERT_EQUAL(CommandDispatcher::RESULT_OK, CommandDispatcher::dispatch(14, nullptr, 0, settings));
+    assertSameSettings(Settings::defaults(), settings);
+}
+
+static void test_other_ports_are_unknown() {
+    uint8_t frame[10] = { 0 };
+    for (int fPort = 0; fPort <= 255; fPort++) {
+        bool command = fPort >= CommandDispatcher::FIRST_PORT && fPort <= CommandDispatcher::LAST_PORT;
+        TEST_ASSERT_EQUAL(command, CommandDispatcher::isCommandPort(fPort));
+        if (!command) {
+            // the uplink port 2 included, whatever the frame
+            assertRejected(CommandDispatcher::RESULT_UNKNOWN_PORT, fPort, frame, 2);
+            assertRejected(CommandDispatcher::RESULT_UNKNOWN_PORT, fPort, nullptr, 0);
+        }
+    }
+}
+
+static void test_truncated_and_oversized_frames_are_rejected() {
+    uint8_t frame[16] = { 0 };
+    for (uint8_t fPort = CommandDispatcher::FIRST_PORT; fPort <= CommandDispatcher::LAST_PORT; fPort++) {
+        size_t size = SIZES[fPort - CommandDispatcher::FIRST_PORT];
+        for (size_t i = 0; i < sizeof(frame); i++) {
+            frame[i] = i < size ? VALID[fPort - CommandDispatcher::FIRST_PORT][i] : 0;
+        }
+        for (size_t wrong = 0; wrong < sizeof(frame); wrong++) {
+            if (wrong != size) {
+                assertRejected(CommandDispatcher::RESULT_BAD_SIZE, fPort, frame, wrong);
+            }
+        }
+        // a frame that claims bytes it does not have
+        if (size > 0) {
+            assertRejected(CommandDispatcher::RESULT_BAD_SIZE, fPort, nullptr, size);
+        }
+    }
+}
+
+static void test_out_of_range_values_are_rejected() {
+    // fan: mode, percent
+    static const uint8_t FAN[][2] = { { FAN_OFF + 1, 0 }, { 255, 50 }, { FAN_MANUAL, 101 }, { FAN_AUTO, 255 } };
+    for (const uint8_t* frame : FAN) {
+        assertRejected(CommandDispatcher::RESULT_BAD_VALUE, 10, frame, 2);
+    }
+
+    // thresholds: each pair equal and reversed
+    static const uint8_t THRESHOLDS[][10] = {
+        { 0, 40, 0, 40, 0, 30, 0x01, 0x2C, 0xFB, 28 },
+        { 0, 41, 0, 40, 0, 30, 0x01, 0x2C, 0xFB, 28 },
+        { 0xFF, 0xFF, 0, 40, 0, 30, 0x01, 0x2C, 0xFB, 28 },
+        { 0, 5, 0, 40, 0x01, 0x2C, 0x01, 0x2C, 0xFB, 28 },
+        { 0, 5, 0, 40, 0x01, 0x2D, 0x01, 0x2C, 0xFB, 28 },
+        { 0, 5, 0, 40, 0, 30, 0x01, 0x2C, 28, 28 },
+        // in order as unsigned bytes, reversed as temperatures (127, -128)
+        { 0, 5, 0, 40, 0, 30, 0x01, 0x2C, 0x7F, 0x80 },
+    };
+    for (const uint8_t* frame : THRESHOLDS) {
+        assertRejected(CommandDispatcher::RESULT_BAD_VALUE, 11, frame, 10);
+    }
+
+    // weights not adding up to 100, also by overflowing a byte
+    static const uint8_t WEIGHTS[][3] = { { 30, 60, 9 }, { 30, 60, 11 }, { 0, 0, 0 }, { 200, 100, 56 }, { 255, 255, 102 } };
+    for (const uint8_t* frame : WEIGHTS) {
+        assertRejected(CommandDispatcher::RESULT_BAD_VALUE, 12, frame, 3);
+    }
+
+    // uplink: policy, heartbeat of 0
+    static const uint8_t UPLINK[][3] = { { UPLINK_ADAPTIVE + 1, 0, 30 }, { 255, 0, 30 }, { UPLINK_ADAPTIVE, 0, 0 } };
+    for (const uint8_t* frame : UPLINK) {
+        assertRejected(CommandDispatcher::RESULT_BAD_VALUE, 13, frame, 3);
+    }
+
+    // score policy
+    static const uint8_t SCORE[][1] = { { AIR_SCORE_EU + 1 }, { 255 } };
+    for (const uint8_t* frame : SCORE) {
+        assertRejected(CommandDispatcher::RESULT_BAD_VALUE, 15, frame, 1);
+    }
+}
+
+static void test_rejected_frame_leaves_an_earlier_command_in_place() {
+    Settings settings = custom();
+    TEST_ASSERT_EQUAL(CommandDispatcher::RESULT_OK, CommandDispatcher::dispatch(12, VALID[2], 3, settings));
+    Settings applied = settings;
+
+    // the PM pair is fine, the gas pair reversed: none of it is applied
+    static const uint8_t HALF_VALID[10] = { 0, 5, 0, 40, 0, 30, 0, 10, 0xFB, 28 };
+    TEST_ASSERT_EQUAL(CommandDispatcher::RESULT_BAD_VALUE, CommandDispatcher::dispatch(11, HALF_VALID, 10, settings));
+    assertSameSettings(applied, settings);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_each_port_applies_its_command);
+    RUN_TEST(test_other_ports_are_unknown);
+    RUN_TEST(test_truncated_and_oversized_frames_are_rejected);
+    RUN_TEST(test_out_of_range_values_are_rejected);
+    RUN_TEST(test_rejected_frame_leaves_an_earlier_command_in_place);
+    return UNITY_END();
+}
@@ -0,0 +1,117 @@
+// Step response of the closed fan speed loop (Fan, PidController) on the
+// simulated fan: settling time and overshoot, with the duty table right
+// and with it off by 20 % either way, as for another fan of the series or
+// a clogged filter
+#include <unity.h>
+#include <cmath>
+#include <cstdio>
+#include "HAL/Hal.h"
+#include "HAL/native/Simulation.h"
+#include "Fan/Fan.h"
+#include "Fan/IsrTach.h"
+
+using SmartAirControl::Fan;
+namespace hal = SmartAirControl::hal;
+namespace sim = SmartAirControl::sim;
+
+// ControlTask calls Fan::update() this often
+static const uint32_t UPDATE_MS = 100;
+// within this of the setpoint counts as settled
+static const float BAND = 0.05f;
+
+// the factory table, which the simulated fan follows
+static const int RPM[Fan::N] = {   0,   780,  1140,  1440,  1740,  2730,  6720,  9960, 12930, 14520, 12570 };
+static const int DUTY[Fan::N] = { 255,   230,   204,   179,   153,   128,   102,    77,    51,    26,     0 };
+
+static SmartAirControl::IsrTach tach(sim::Simulation::get().fanTachPin);
+
+struct Response {
+    float targetRpm;
+    float finalRpm;
+    float overshoot;     /** past the setpoint in the direction of the step, of the setpoint */
+    uint32_t settlingMs; /** until the speed stays within BAND */
+};
+
+static void run(Fan& fan, uint32_t ms) {
+    for (uint32_t t = 0; t < ms; t += UPDATE_MS) {
+        hal::delay(UPDATE_MS);
+        fan.update();
+    }
+}
+
+// Steps the fan from one setpoint to the other; the table believes the fan
+// turns tableScale times as fast as it does
+static Response step(float tableScale, int fromPercent, int toPercent) {
+    sim::Simulation& simulation = sim::Simulation::get();
+    simulation.nvs().clear();
+    Fan fan(simulation.fanPwmPin, tach);
+    fan.setup();
+    int rpm[Fan::N];
+    for (int i = 0; i < Fan::N; i++) {
+        rpm[i] = static_cast<int>(RPM[i] * tableScale + 0.5f);
+    }
+    fan.setTable(rpm, DUTY);
+
+    fan.setRpmPercent(fromPercent);
+    run(fan, 20000);
+    fan.setRpmPercent(toPercent);
+
+    Response response;
+    // the setpoint as the fan understands it: a share of the fastest speed in its table
+    response.targetRpm = toPercent / 100.0f * RPM[Fan::N - 2] * tableScale;
+    response.overshoot = 0;
+    response.settlingMs = 0;
+    float direction = toPercent > fromPercent ? 1.0f : -1.0f;
+    for (uint32_t t = UPDATE_MS; t <= 40000; t += UPDATE_MS) {
+        run(fan, UPDATE_MS);
+        float rpmNow = simulation.fan().getRpm();
+        float past = direction * (rpmNow - response.targetRpm) / response.targetRpm;
+        response.overshoot = past > response.overshoot ? past : response.overshoot;
+        if (std::fabs(rpmNow - response.targetRpm) > BAND * response.targetRpm) {
+            response.settlingMs = t;
+        }
+    }
+    response.finalRpm = simulation.fan().getRpm();
+
+    char message[128];
+    std::snprintf(message, sizeof(message), "table x%.1f, %d -> %d %%: %.0f rpm, overshoot %.1f %%, settled in %.1f s",
+                  tableScale, fromPercent, toPercent, response.finalRpm, response.overshoot * 100,
+                  response.settlingMs / 1000.0);
+    TEST_MESSAGE(message);
+    return response;
+}
+
+static const int STEPS[][2] = { { 0, 40 }, { 20, 50 }, { 50, 80 }, { 80, 30 }, { 40, 10 } };
+
+void setUp() {}
+
+void tearDown() {}
+
+static void test_steps_settle_quickly_with_the_table_right() {
+    for (const int* s : STEPS) {
+        Response response = step(1.0f, s[0], s[1]);
+        TEST_ASSERT_LESS_OR_EQUAL_FLOAT(0.08f, response.overshoot);
+        TEST_ASSERT_LESS_OR_EQUAL(7000, response.settlingMs);
+        TEST_ASSERT_FLOAT_WITHIN(0.02f * response.targetRpm, response.targetRpm, response.finalRpm);
+    }
+}
+
+static void test_loop_corrects_a_table_off_by_20_percent() {
+    for (float tableScale : { 0.8f, 1.2f }) {
+        for (const int* s : STEPS) {
+            Response response = step(tableScale, s[0], s[1]);
+            // the jump to the table value overshoots by the table error
+            // (25 % for a table 20 % slow), the loop adds nothing to it
+            TEST_ASSERT_LESS_OR_EQUAL_FLOAT(0.25f, response.overshoot);
+            TEST_ASSERT_LESS_OR_EQUAL(10000, response.settlingMs);
+            TEST_ASSERT_FLOAT_WITHIN(0.02f * response.targetRpm, response.targetRpm, response.finalRpm);
+        }
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_steps_settle_quickly_with_the_table_right);
+    RUN_TEST(test_loop_corrects_a_table_off_by_20_percent);
+    return UNITY_END();
+}
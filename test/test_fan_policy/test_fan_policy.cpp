@@ -0,0 +1,204 @@
+// FanPolicy against chatter: a faster setpoint only after UP_DWELL_MS (10 s)
+// on the last one, a slower one only after DOWN_DWELL_MS (120 s), neither
+// unless HYSTERESIS (0.01) cheaper; and FAN_MANUAL and FAN_OFF handing back
+// to FAN_AUTO without waiting
+#include <unity.h>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "HAL/native/Simulation.h"
+#include "Fan/Fan.h"
+#include "Fan/IsrTach.h"
+#include "Control/FanPolicy.h"
+
+using SmartAirControl::Fan;
+using SmartAirControl::FanPolicy;
+using SmartAirControl::Settings;
+namespace sim = SmartAirControl::sim;
+
+// ControlTask scores the air this often
+static const uint32_t CONTROL_MS = 100;
+
+static SmartAirControl::IsrTach tach(sim::Simulation::get().fanTachPin);
+static Fan fan(sim::Simulation::get().fanPwmPin, tach);
+
+struct Change {
+    uint32_t atMs;
+    int percent;
+};
+
+// Noise of +-amplitude, the same sequence every run
+struct Noise {
+    explicit Noise(float amplitude) : amplitude(amplitude), state(1) {}
+
+    float next() {
+        state = state * 1664525 + 1013904223;
+        return amplitude * ((state >> 8) / float(1 << 23) - 1);
+    }
+
+    float amplitude;
+    uint32_t state;
+};
+
+// Every CONTROL_MS from fromMs to toMs at score (plus noise), the setpoint
+// changes appended to changes; returns the setpoint at the end
+static int run(FanPolicy& policy, float score, uint32_t fromMs, uint32_t toMs, std::vector<Change>& changes,
+               Noise* noise = nullptr) {
+    int percent = changes.empty() ? -1 : changes.back().percent;
+    for (uint32_t nowMs = fromMs; nowMs < toMs; nowMs += CONTROL_MS) {
+        int next = policy.setpoint(score + (noise ? noise->next() : 0), nowMs);
+        if (next != percent) {
+            changes.push_back({ nowMs, next });
+            percent = next;
+        }
+    }
+    return percent;
+}
+
+// The lowest score, in steps of 0.001, at which a policy settled in clean
+// air speeds up
+static float firstStepUp() {
+    FanPolicy policy(FAN_POLICY_OPTIMAL);
+    int clean = policy.setpoint(0, 0);
+    uint32_t nowMs = 0;
+    for (int i = 0; i <= 1000; i++) {
+        // a dwell at each score, so only the margin holds it back
+        nowMs += FanPolicy::UP_DWELL_MS;
+        if (policy.setpoint(i / 1000.0f, nowMs) != clean) {
+            return i / 1000.0f;
+        }
+    }
+    TEST_FAIL_MESSAGE("never speeds up");
+    return 1;
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_speeds_up_after_ten_seconds() {
+    FanPolicy policy(FAN_POLICY_OPTIMAL);
+    std::vector<Change> changes;
+    int clean = run(policy, 0, 0, 60000, changes);
+    TEST_ASSERT_EQUAL(1, changes.size());
+
+    // worse air a minute in: the setpoint of clean air is already held for
+    // longer than the dwell, the next step up is at once
+    int worse = run(policy, 0.8f, 60000, 60000 + CONTROL_MS, changes);
+    TEST_ASSERT_TRUE(worse > clean);
+    TEST_ASSERT_EQUAL_UINT32(60000, changes.back().atMs);
+
+    // and every further one UP_DWELL_MS after the one before
+    run(policy, 0.8f, 60000 + CONTROL_MS, 600000, changes);
+    TEST_ASSERT_TRUE(changes.size() >= 3);
+    for (size_t i = 2; i < changes.size(); i++) {
+        TEST_ASSERT_TRUE(changes[i].percent > changes[i - 1].percent);
+        TEST_ASSERT_EQUAL_UINT32(FanPolicy::UP_DWELL_MS, changes[i].atMs - changes[i - 1].atMs);
+    }
+}
+
+static void test_slows_down_after_two_minutes() {
+    FanPolicy policy(FAN_POLICY_OPTIMAL);
+    std::vector<Change> changes;
+    int fast = run(policy, 0.8f, 0, 600000, changes);
+    uint32_t upMs = changes.back().atMs;
+    TEST_ASSERT_TRUE(upMs < 600000 - FanPolicy::UP_DWELL_MS);
+
+    // clean air again soon after the last step up: held for DOWN_DWELL_MS
+    // from it, and every further step down as long after the one before
+    uint32_t cleanMs = upMs + FanPolicy::UP_DWELL_MS;
+    size_t before = changes.size();
+    run(policy, 0.8f, 600000, cleanMs, changes);
+    int slow = run(policy, 0, cleanMs, cleanMs + 5 * FanPolicy::DOWN_DWELL_MS, changes);
+    TEST_ASSERT_TRUE(slow < fast);
+    TEST_ASSERT_EQUAL_UINT32(upMs + FanPolicy::DOWN_DWELL_MS, changes[before].atMs);
+    for (size_t i = before + 1; i < changes.size(); i++) {
+        TEST_ASSERT_TRUE(changes[i].percent < changes[i - 1].percent);
+        TEST_ASSERT_EQUAL_UINT32(FanPolicy::DOWN_DWELL_MS, changes[i].atMs - changes[i - 1].atMs);
+    }
+}
+
+static void test_margin_holds_a_noisy_score() {
+    float stepUp = firstStepUp();
+
+    // settled just below where a step up pays HYSTERESIS, then half an hour
+    // of a score jittering by 0.008 every step below it: the next setpoint
+    // is cheaper for some of it, never by the margin
+    FanPolicy policy(FAN_POLICY_OPTIMAL);
+    std::vector<Change> changes;
+    run(policy, stepUp - 0.05f, 0, 600000, changes);
+    size_t settled = changes.size();
+    Noise noise(0.008f);
+    run(policy, stepUp - 0.01f, 600000, 2400000, changes, &noise);
+    TEST_ASSERT_EQUAL(settled, changes.size());
+
+    // the score * 100 of FAN_POLICY_LINEAR follows every wiggle
+    FanPolicy linear(FAN_POLICY_LINEAR);
+    std::vector<Change> chatter;
+    Noise again(0.008f);
+    run(linear, stepUp - 0.01f, 600000, 2400000, chatter, &again);
+
+    char message[64];
+    std::snprintf(message, sizeof(message), "step up at %.3f, linear changed %u times", stepUp,
+                  unsigned(chatter.size()));
+    TEST_MESSAGE(message);
+    TEST_ASSERT_TRUE(chatter.size() > 1000);
+}
+
+static void test_dwell_holds_a_score_across_the_step() {
+    // jittering by 0.03 across the step up: the margin is met both ways
+    // now and then, the dwells space the changes out
+    float stepUp = firstStepUp();
+    FanPolicy policy(FAN_POLICY_OPTIMAL);
+    std::vector<Change> changes;
+    run(policy, stepUp - 0.05f, 0, 600000, changes);
+    size_t settled = changes.size();
+    Noise noise(0.03f);
+    run(policy, stepUp, 600000, 2400000, changes, &noise);
+
+    TEST_ASSERT_TRUE(changes.size() > settled);
+    for (size_t i = settled; i < changes.size(); i++) {
+        uint32_t heldMs = changes[i].atMs - changes[i - 1].atMs;
+        bool up = changes[i].percent > changes[i - 1].percent;
+        TEST_ASSERT_TRUE(heldMs >= (up ? FanPolicy::UP_DWELL_MS : FanPolicy::DOWN_DWELL_MS));
+    }
+    // no more than a step up and down every UP_DWELL_MS + DOWN_DWELL_MS
+    TEST_ASSERT_TRUE(changes.size() - settled <= 2 * 1800000 / (FanPolicy::UP_DWELL_MS + FanPolicy::DOWN_DWELL_MS) + 1);
+}
+
+static void test_manual_and_off_hand_back_at_once() {
+    Settings settings = Settings::defaults();
+    TEST_ASSERT_EQUAL(FAN_AUTO, settings.fanMode);
+    FanPolicy reference(FAN_POLICY_OPTIMAL);
+    int clean = reference.setpoint(0, 0);
+
+    for (uint8_t mode : { FAN_MANUAL, FAN_OFF }) {
+        FanPolicy policy(FAN_POLICY_OPTIMAL);
+        settings.fanMode = FAN_AUTO;
+        policy.adjustFanSpeed(fan, 0.8f, settings, 0);
+        int fast = int(fan.getRpmPercent());
+        TEST_ASSERT_TRUE(fast > clean);
+
+        settings.fanMode = mode;
+        settings.fanPercent = 70;
+        policy.adjustFanSpeed(fan, 0.8f, settings, 1000);
+        TEST_ASSERT_EQUAL_INT(mode == FAN_MANUAL ? 70 : 0, int(fan.getRpmPercent()));
+
+        // back in FAN_AUTO a step later, in clean air: no DOWN_DWELL_MS wait
+        // from the manual setpoint, nor an UP_DWELL_MS one from off
+        settings.fanMode = FAN_AUTO;
+        policy.adjustFanSpeed(fan, 0, settings, 1100);
+        TEST_ASSERT_EQUAL_INT(clean, int(fan.getRpmPercent()));
+    }
+}
+
+int main() {
+    fan.setup();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_speeds_up_after_ten_seconds);
+    RUN_TEST(test_slows_down_after_two_minutes);
+    RUN_TEST(test_margin_holds_a_noisy_score);
+    RUN_TEST(test_dwell_holds_a_score_across_the_step);
+    RUN_TEST(test_manual_and_off_hand_back_at_once);
+    return UNITY_END();
+}
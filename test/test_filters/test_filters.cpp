@@ -0,0 +1,182 @@
+// The fixed point filters (Filter/FixedFilters.h) and PmFilter on top of
+// them: the median of 5 against spikes, the Q8 EWMA step response, the
+// least squares slope on ramps and its sliding window past 120 samples
+#include <unity.h>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "Filter/FixedFilters.h"
+#include "Filter/PmFilter.h"
+
+using SmartAirControl::Ewma;
+using SmartAirControl::MedianFilter;
+using SmartAirControl::PmFilter;
+using SmartAirControl::SlopeEstimator;
+using SmartAirControl::fromFixed;
+using SmartAirControl::toFixed;
+
+// as PmFilter uses them
+static const uint32_t ALPHA_Q16 = 65536 / (PmFilter::SMOOTHING_FRAMES + 1);
+static const size_t WINDOW = PmFilter::SLOPE_WINDOW;
+
+void setUp() {}
+void tearDown() {}
+
+// Least squares slope of the last WINDOW values (fewer at the start), 0
+// for one
+static double referenceSlope(const std::vector<int32_t>& values) {
+    size_t first = values.size() > WINDOW ? values.size() - WINDOW : 0;
+    double n = values.size() - first;
+    if (n < 2) {
+        return 0;
+    }
+    double meanI = (n - 1) / 2;
+    double mean = 0;
+    for (size_t k = first; k < values.size(); k++) {
+        mean += values[k] / n;
+    }
+    double covariance = 0;
+    double variance = 0;
+    for (size_t k = first; k < values.size(); k++) {
+        covariance += (k - first - meanI) * (values[k] - mean);
+        variance += (k - first - meanI) * (k - first - meanI);
+    }
+    return covariance / variance;
+}
+
+static PM25_AQI_Data frame(uint16_t pm25) {
+    PM25_AQI_Data data = {};
+    data.pm10_env = pm25 / 2;
+    data.pm25_env = pm25;
+    data.pm100_env = pm25 + 5;
+    return data;
+}
+
+static void test_median_of_five_rejects_spikes() {
+    MedianFilter<5> median;
+    // the first samples: the median of what is there, the upper of two
+    TEST_ASSERT_EQUAL_INT32(10, median.push(10));
+    TEST_ASSERT_EQUAL_INT32(12, median.push(12));
+    TEST_ASSERT_EQUAL_INT32(10, median.push(8));
+    TEST_ASSERT_EQUAL_INT32(10, median.push(10));
+    TEST_ASSERT_EQUAL_INT32(10, median.push(10));
+
+    // one and two samples long spikes, up and down, are gone
+    static const int32_t SPIKES[] = { 500, 10, 10, 10, 500, 500, 10, 10, 10, 0, 0, 10, 10, 10 };
+    for (int32_t value : SPIKES) {
+        int32_t out = median.push(value);
+        TEST_ASSERT_TRUE(out >= 8 && out <= 12);
+    }
+    // three in a row are a step, not a spike
+    median.push(500);
+    median.push(500);
+    TEST_ASSERT_EQUAL_INT32(500, median.push(500));
+
+    // PmFilter: a single frame of 400 ug/m3 in 20 does not reach the output
+    PmFilter filter;
+    for (int i = 0; i < 30; i++) {
+        filter.push(frame(20));
+    }
+    filter.push(frame(400));
+    TEST_ASSERT_EQUAL_UINT16(20, filter.filtered().pm25_env);
+    TEST_ASSERT_EQUAL_UINT16(25, filter.filtered().pm100_env);
+    filter.push(frame(20));
+    TEST_ASSERT_EQUAL_UINT16(20, filter.filtered().pm25_env);
+}
+
+static void test_ewma_step_response() {
+    Ewma ewma(ALPHA_Q16);
+    // starts at the first sample, no ramp from 0
+    TEST_ASSERT_EQUAL_INT32(toFixed(20), ewma.push(toFixed(20)));
+
+    // a step to 120: 1 - (1 - alpha)^k of the way after k frames
+    double alpha = ALPHA_Q16 / 65536.0;
+    int32_t previous = ewma.get();
+    for (int k = 1; k <= 100; k++) {
+        int32_t state = ewma.push(toFixed(120));
+        double expected = toFixed(20) + toFixed(100) * (1 - std::pow(1 - alpha, k));
+        // every step truncates by less than one Q8 unit
+        TEST_ASSERT_FLOAT_WITHIN(float(k), float(expected), float(state));
+        // monotonic, never past the step
+        TEST_ASSERT_TRUE(state >= previous && state <= toFixed(120));
+        previous = state;
+    }
+    // 63 % after the time constant of about 10 frames
+    Ewma tau(ALPHA_Q16);
+    tau.push(0);
+    for (uint32_t k = 0; k < PmFilter::SMOOTHING_FRAMES; k++) {
+        tau.push(toFixed(100));
+    }
+    TEST_ASSERT_INT_WITHIN(3, 61, fromFixed(tau.get()));
+    // and at the step in whole units once settled
+    TEST_ASSERT_EQUAL_INT32(120, fromFixed(ewma.get()));
+
+    // down the same way
+    for (int k = 0; k < 200; k++) {
+        ewma.push(toFixed(20));
+    }
+    TEST_ASSERT_EQUAL_INT32(20, fromFixed(ewma.get()));
+    ewma.reset();
+    TEST_ASSERT_EQUAL_INT32(toFixed(7), ewma.push(toFixed(7)));
+}
+
+static void test_slope_is_exact_on_a_linear_ramp() {
+    // per sample in Q8, both ways, over several windows
+    for (int32_t step : { 3, -5, 0, 1 }) {
+        SlopeEstimator<WINDOW> slope;
+        TEST_ASSERT_EQUAL_INT32(0, slope.get());
+        slope.push(toFixed(1000));
+        TEST_ASSERT_EQUAL_INT32(0, slope.get());
+        for (int i = 1; i < 3 * int(WINDOW); i++) {
+            slope.push(toFixed(1000 + step * i));
+            TEST_ASSERT_EQUAL_INT32(toFixed(step), slope.get());
+        }
+    }
+
+    // PmFilter in ug/m3 per minute: 1 ug/m3 more every second
+    PmFilter filter;
+    for (int i = 0; i < 200; i++) {
+        filter.push(frame(10 + i));
+    }
+    TEST_ASSERT_EQUAL_FLOAT(60, filter.getPm25Slope());
+}
+
+static void test_slope_window_wraps_past_120_samples() {
+    // a ramp for a window, flat for a window and a half, then noise: the
+    // running sums agree with a least squares fit of the last 120 every time
+    SlopeEstimator<WINDOW> slope;
+    std::vector<int32_t> values;
+    uint32_t noise = 1;
+    for (size_t i = 0; i < 4 * WINDOW + 7; i++) {
+        int32_t value;
+        if (i < WINDOW) {
+            value = toFixed(2 * int32_t(i));
+        } else if (i < 5 * WINDOW / 2) {
+            value = toFixed(2 * int32_t(WINDOW));
+        } else {
+            noise = noise * 1664525 + 1013904223;
+            value = toFixed(100) + int32_t(noise >> 20) - 2048;
+        }
+        values.push_back(value);
+        slope.push(value);
+        TEST_ASSERT_FLOAT_WITHIN(1.0f, float(referenceSlope(values)), float(slope.get()));
+    }
+
+    // flat for the whole window once the ramp has slid out
+    SlopeEstimator<WINDOW> flat;
+    for (size_t i = 0; i < 2 * WINDOW; i++) {
+        flat.push(i < WINDOW ? toFixed(2 * int32_t(i)) : toFixed(2 * int32_t(WINDOW)));
+    }
+    TEST_ASSERT_EQUAL_INT32(0, flat.get());
+    flat.reset();
+    TEST_ASSERT_EQUAL_INT32(0, flat.get());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_median_of_five_rejects_spikes);
+    RUN_TEST(test_ewma_step_response);
+    RUN_TEST(test_slope_is_exact_on_a_linear_ramp);
+    RUN_TEST(test_slope_window_wraps_past_120_samples);
+    return UNITY_END();
+}
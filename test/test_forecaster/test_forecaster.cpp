@@ -0,0 +1,133 @@
+// PmForecaster: Holt's level and trend on a linear ramp, the restart after
+// a gap over MAX_GAP_MS, and the forecast HORIZON_S (180 s) ahead with the
+// Data it scores
+#include <unity.h>
+#include <cstdint>
+#include "Control/PmForecaster.h"
+
+using SmartAirControl::Data;
+using SmartAirControl::PmForecaster;
+
+// one filtered PMS5003 reading a second
+static const uint32_t READING_MS = 1000;
+
+void setUp() {}
+void tearDown() {}
+
+// pm25 + slope per second from startMs for seconds, returns the time after
+static uint32_t ramp(PmForecaster& forecaster, float pm25, float slope, uint32_t startMs, uint32_t seconds) {
+    uint32_t nowMs = startMs;
+    for (uint32_t s = 0; s <= seconds; s++) {
+        nowMs = startMs + s * READING_MS;
+        forecaster.update(pm25 + slope * s, nowMs);
+    }
+    return nowMs;
+}
+
+static void test_level_and_trend_follow_a_linear_ramp() {
+    // rising by 0.1 ug/m3 a second, 6 ug/m3 a minute
+    PmForecaster forecaster(FAN_CONTROL_PREDICTIVE);
+    forecaster.update(10, 0);
+    // nothing to go on yet: the reading itself
+    TEST_ASSERT_EQUAL_FLOAT(10, forecaster.forecast());
+
+    // after a few trend time constants the ramp is learnt: the forecast is
+    // where the ramp will be HORIZON_S on
+    ramp(forecaster, 10, 0.1f, 0, 600);
+    float now = 10 + 0.1f * 600;
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, now + 0.1f * PmForecaster::HORIZON_S, forecaster.forecast());
+
+    // part of the way after one trend time constant (60 s) of a new ramp
+    PmForecaster young(FAN_CONTROL_PREDICTIVE);
+    ramp(young, 10, 0.1f, 0, 60);
+    float ahead = young.forecast() - (10 + 0.1f * 60);
+    TEST_ASSERT_TRUE(ahead > 0.3f * 0.1f * PmForecaster::HORIZON_S);
+    TEST_ASSERT_TRUE(ahead < 0.8f * 0.1f * PmForecaster::HORIZON_S);
+
+    // irregular intervals weigh by time: readings 5 s apart learn the same ramp
+    PmForecaster sparse(FAN_CONTROL_PREDICTIVE);
+    for (uint32_t s = 0; s <= 600; s += 5) {
+        sparse.update(10 + 0.1f * s, s * READING_MS);
+    }
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, forecaster.forecast(), sparse.forecast());
+}
+
+static void test_a_flat_reading_has_no_trend() {
+    PmForecaster forecaster(FAN_CONTROL_PREDICTIVE);
+    ramp(forecaster, 25, 0, 0, 300);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 25, forecaster.forecast());
+}
+
+static void test_gap_over_a_minute_starts_over() {
+    PmForecaster forecaster(FAN_CONTROL_PREDICTIVE);
+    uint32_t nowMs = ramp(forecaster, 10, 0.1f, 0, 300);
+    TEST_ASSERT_TRUE(forecaster.forecast() > 40 + 10);
+
+    // exactly MAX_GAP_MS still counts as one step, the trend stays
+    nowMs += PmForecaster::MAX_GAP_MS;
+    forecaster.update(46, nowMs);
+    TEST_ASSERT_TRUE(forecaster.forecast() > 46 + 10);
+
+    // a reading at the same time changes nothing
+    float before = forecaster.forecast();
+    forecaster.update(500, nowMs);
+    TEST_ASSERT_EQUAL_FLOAT(before, forecaster.forecast());
+
+    // a millisecond more and the stale trend is dropped
+    nowMs += PmForecaster::MAX_GAP_MS + 1;
+    forecaster.update(30, nowMs);
+    TEST_ASSERT_EQUAL_FLOAT(30, forecaster.forecast());
+    // and learnt again from there: the level moves towards 31 and the
+    // trend up, from scratch
+    forecaster.update(31, nowMs + READING_MS);
+    TEST_ASSERT_TRUE(forecaster.forecast() > 30.5f);
+    TEST_ASSERT_TRUE(forecaster.forecast() < 31);
+}
+
+static void test_forecast_three_minutes_ahead() {
+    // a falling ramp ends at 0, not below
+    PmForecaster falling(FAN_CONTROL_PREDICTIVE);
+    ramp(falling, 60, -0.2f, 0, 250);
+    TEST_ASSERT_EQUAL_FLOAT(0, falling.forecast());
+
+    // the Data scored: every mass concentration and particle count scaled
+    // by the forecast over the PM2.5 reading
+    PmForecaster rising(FAN_CONTROL_PREDICTIVE);
+    Data data;
+    data.pmsData.pm10_env = 10;
+    data.pmsData.pm25_env = 20;
+    data.pmsData.pm100_env = 30;
+    data.pmsData.particles_10um = 400;
+    data.pmsData.particles_25um = 50;
+    data.pmsData.particles_100um = 5;
+    data.bmeData.temperature = 22;
+    // not started: as it is
+    TEST_ASSERT_EQUAL_UINT16(20, rising.predict(data).pmsData.pm25_env);
+
+    ramp(rising, 2, 0.03f, 0, 600);
+    float ahead = rising.forecast();
+    TEST_ASSERT_FLOAT_WITHIN(0.3f, 2 + 0.03f * (600 + PmForecaster::HORIZON_S), ahead);
+    Data predicted = rising.predict(data);
+    float factor = ahead / 20;
+    TEST_ASSERT_EQUAL_UINT16(uint16_t(10 * factor + 0.5f), predicted.pmsData.pm10_env);
+    TEST_ASSERT_EQUAL_UINT16(uint16_t(20 * factor + 0.5f), predicted.pmsData.pm25_env);
+    TEST_ASSERT_EQUAL_UINT16(uint16_t(30 * factor + 0.5f), predicted.pmsData.pm100_env);
+    TEST_ASSERT_EQUAL_UINT16(uint16_t(400 * factor + 0.5f), predicted.pmsData.particles_10um);
+    TEST_ASSERT_EQUAL_UINT16(uint16_t(5 * factor + 0.5f), predicted.pmsData.particles_100um);
+    // the rest stays
+    TEST_ASSERT_EQUAL_FLOAT(22, predicted.bmeData.temperature);
+
+    // no PM2.5 to scale: the forecast alone
+    data.pmsData.pm25_env = 0;
+    TEST_ASSERT_EQUAL_UINT16(uint16_t(ahead + 0.5f), rising.predict(data).pmsData.pm25_env);
+    TEST_ASSERT_EQUAL_UINT16(10, rising.predict(data).pmsData.pm10_env);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_level_and_trend_follow_a_linear_ramp);
+    RUN_TEST(test_a_flat_reading_has_no_trend);
+    RUN_TEST(test_gap_over_a_minute_starts_over);
+    RUN_TEST(test_forecast_three_minutes_ahead);
+    return UNITY_END();
+}
@@ -0,0 +1,206 @@
+// GasBaseline: the burn-in, the asymmetric tracking after it (fast towards
+// cleaner air, slow towards dirtier), the confidence levels, the humidity
+// compensation and the state through deep sleep (RTC) and a power cycle (NVS)
+#include <unity.h>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "HAL/native/Simulation.h"
+#include "BME/GasBaseline.h"
+
+using SmartAirControl::GasBaseline;
+namespace sim = SmartAirControl::sim;
+
+// one gas reading every 10 s
+static const uint32_t READING_MS = 10000;
+
+static GasBaseline::State state;
+
+void setUp() {
+    std::memset(&state, 0, sizeof(state));
+    sim::Simulation::get().nvs().clear();
+}
+
+void tearDown() {}
+
+// Readings of gasKOhm at the reference humidity for ms, returns the time after
+static uint32_t feed(GasBaseline& baseline, float gasKOhm, uint32_t nowMs, uint32_t ms) {
+    for (uint32_t t = 0; t < ms; t += READING_MS) {
+        nowMs += READING_MS;
+        baseline.update(gasKOhm, GasBaseline::REFERENCE_HUMIDITY, nowMs);
+    }
+    return nowMs;
+}
+
+// Burnt in at 100 KOhm from a cold start at 0
+static uint32_t burnIn(GasBaseline& baseline) {
+    baseline.restore(0);
+    uint32_t nowMs = feed(baseline, 100, 0, GasBaseline::BURN_IN_MS);
+    TEST_ASSERT_EQUAL_FLOAT(100, baseline.getBaseline());
+    return nowMs;
+}
+
+static void test_burn_in_averages_five_minutes() {
+    GasBaseline baseline(state);
+    baseline.restore(0);
+    TEST_ASSERT_EQUAL(GasBaseline::CONFIDENCE_NONE, baseline.getConfidence());
+
+    // a plate settling from 120 down to 90 KOhm, one reading short of the burn-in
+    uint32_t readings = GasBaseline::BURN_IN_MS / READING_MS;
+    float sum = 0;
+    uint32_t nowMs = 0;
+    for (uint32_t i = 0; i < readings; i++) {
+        float gas = 120 - 30.0f * i / (readings - 1);
+        sum += gas;
+        nowMs += READING_MS;
+        TEST_ASSERT_EQUAL_FLOAT(0, baseline.getBaseline());
+        TEST_ASSERT_EQUAL(GasBaseline::CONFIDENCE_NONE, baseline.getConfidence());
+        // uncompensated at the reference humidity
+        TEST_ASSERT_EQUAL_FLOAT(gas, baseline.update(gas, GasBaseline::REFERENCE_HUMIDITY, nowMs));
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, sum / readings, baseline.getBaseline());
+    TEST_ASSERT_EQUAL(GasBaseline::CONFIDENCE_LOW, baseline.getConfidence());
+
+    // saved to NVS right away
+    TEST_ASSERT_EQUAL(1, sim::Simulation::get().nvs().count("gas/baseline"));
+}
+
+static void test_pause_counts_as_max_step() {
+    GasBaseline baseline(state);
+    baseline.restore(0);
+    baseline.update(100, GasBaseline::REFERENCE_HUMIDITY, READING_MS);
+    TEST_ASSERT_EQUAL_UINT32(READING_MS, state.burnInMs);
+    // an hour asleep counts as MAX_STEP_MS, not as an hour
+    baseline.update(110, GasBaseline::REFERENCE_HUMIDITY, READING_MS + 60UL * 60 * 1000);
+    TEST_ASSERT_EQUAL_UINT32(READING_MS + GasBaseline::MAX_STEP_MS, state.burnInMs);
+    TEST_ASSERT_EQUAL_UINT16(2, state.burnInCount);
+    TEST_ASSERT_EQUAL_FLOAT(105, baseline.getBaseline());
+}
+
+static void test_tracks_cleaner_air_fast_and_dirtier_air_slowly() {
+    GasBaseline clean(state);
+    uint32_t nowMs = burnIn(clean);
+    // one step as the weighted average it is
+    nowMs += READING_MS;
+    clean.update(200, GasBaseline::REFERENCE_HUMIDITY, nowMs);
+    float weight = READING_MS / float(GasBaseline::RISE_TAU_MS + READING_MS);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 100 + 100 * weight, clean.getBaseline());
+    // RISE_TAU_MS of it covers about 1 - 1/e of the way
+    feed(clean, 200, nowMs, GasBaseline::RISE_TAU_MS - READING_MS);
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, 100 + 100 * (1 - std::exp(-1.0f)), clean.getBaseline());
+
+    // a VOC event of the same length halving the resistance hardly moves it
+    GasBaseline::State dirtyState = {};
+    GasBaseline dirty(dirtyState);
+    sim::Simulation::get().nvs().clear();
+    nowMs = burnIn(dirty);
+    feed(dirty, 50, nowMs, GasBaseline::RISE_TAU_MS);
+    float fall = 100 - dirty.getBaseline();
+    TEST_ASSERT_TRUE(fall > 0);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 50 * (1 - std::exp(-float(GasBaseline::RISE_TAU_MS) / GasBaseline::FALL_TAU_MS)),
+                             fall);
+    // a hundred times less than the rise
+    TEST_ASSERT_TRUE(fall * 100 < clean.getBaseline() - 100);
+}
+
+static void test_confidence_after_a_day_of_tracking() {
+    GasBaseline baseline(state);
+    uint32_t nowMs = burnIn(baseline);
+    TEST_ASSERT_EQUAL(GasBaseline::CONFIDENCE_LOW, baseline.getConfidence());
+
+    // a reading every MAX_STEP_MS, one short of the day
+    uint32_t steps = GasBaseline::CONFIDENT_MS / GasBaseline::MAX_STEP_MS;
+    for (uint32_t i = 0; i < steps - 1; i++) {
+        nowMs += GasBaseline::MAX_STEP_MS;
+        baseline.update(100, GasBaseline::REFERENCE_HUMIDITY, nowMs);
+    }
+    TEST_ASSERT_EQUAL(GasBaseline::CONFIDENCE_LOW, baseline.getConfidence());
+    // a longer pause counts as MAX_STEP_MS, and no further than the day
+    nowMs += 10 * GasBaseline::MAX_STEP_MS;
+    baseline.update(100, GasBaseline::REFERENCE_HUMIDITY, nowMs);
+    TEST_ASSERT_EQUAL(GasBaseline::CONFIDENCE_HIGH, baseline.getConfidence());
+    TEST_ASSERT_EQUAL_UINT32(GasBaseline::CONFIDENT_MS, state.trackedMs);
+    nowMs += GasBaseline::MAX_STEP_MS;
+    baseline.update(100, GasBaseline::REFERENCE_HUMIDITY, nowMs);
+    TEST_ASSERT_EQUAL_UINT32(GasBaseline::CONFIDENT_MS, state.trackedMs);
+}
+
+static void test_humidity_compensation() {
+    TEST_ASSERT_EQUAL_FLOAT(100, GasBaseline::compensate(100, GasBaseline::REFERENCE_HUMIDITY));
+    // 2 % per % RH, exponentially
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 100 * std::exp(0.2f), GasBaseline::compensate(100, 50));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 100 * std::exp(-0.2f), GasBaseline::compensate(100, 30));
+
+    // the same clean air at 30 to 70 % RH burns in to one baseline
+    GasBaseline baseline(state);
+    baseline.restore(0);
+    uint32_t nowMs = 0;
+    for (int i = 0; baseline.getBaseline() == 0; i++) {
+        float humidity = 30 + (i * 7) % 41;
+        float gas = 100 * std::exp(-GasBaseline::HUMIDITY_SLOPE * (humidity - GasBaseline::REFERENCE_HUMIDITY));
+        nowMs += READING_MS;
+        TEST_ASSERT_FLOAT_WITHIN(0.01f, 100, baseline.update(gas, humidity, nowMs));
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 100, baseline.getBaseline());
+}
+
+static void test_restore_from_rtc_and_nvs() {
+    GasBaseline baseline(state);
+    uint32_t nowMs = burnIn(baseline);
+    nowMs = feed(baseline, 80, nowMs, 30UL * 60 * 1000);
+    float tracked = baseline.getBaseline();
+    GasBaseline::State rtc = state;
+
+    // a deep sleep keeps RTC memory: nothing changes
+    GasBaseline woken(state);
+    woken.restore(nowMs + 60000);
+    TEST_ASSERT_EQUAL_MEMORY(&rtc, &state, sizeof(state));
+
+    // a power cycle: NVS has the one saved after the burn-in, the last 30
+    // minutes are not saved yet (SAVE_INTERVAL_MS)
+    std::memset(&state, 0, sizeof(state));
+    GasBaseline powered(state);
+    powered.restore(5000);
+    TEST_ASSERT_EQUAL_FLOAT(100, powered.getBaseline());
+    TEST_ASSERT_TRUE(tracked < powered.getBaseline());
+    TEST_ASSERT_EQUAL(GasBaseline::CONFIDENCE_LOW, powered.getConfidence());
+    // on the new clock
+    TEST_ASSERT_EQUAL_UINT32(5000, state.lastMs);
+    TEST_ASSERT_EQUAL_UINT32(5000, state.savedMs);
+
+    // an hour on it is saved, and restored after the next power cycle
+    feed(powered, 80, 5000, GasBaseline::SAVE_INTERVAL_MS);
+    float saved = powered.getBaseline();
+    std::memset(&state, 0, sizeof(state));
+    GasBaseline again(state);
+    again.restore(0);
+    TEST_ASSERT_EQUAL_FLOAT(saved, again.getBaseline());
+}
+
+static void test_corrupt_nvs_starts_a_new_burn_in() {
+    GasBaseline baseline(state);
+    burnIn(baseline);
+    std::vector<uint8_t>& stored = sim::Simulation::get().nvs()["gas/baseline"];
+    TEST_ASSERT_FALSE(stored.empty());
+    stored[stored.size() / 2] ^= 0x40;
+
+    std::memset(&state, 0, sizeof(state));
+    GasBaseline powered(state);
+    powered.restore(0);
+    TEST_ASSERT_EQUAL_FLOAT(0, powered.getBaseline());
+    TEST_ASSERT_EQUAL(GasBaseline::CONFIDENCE_NONE, powered.getConfidence());
+    TEST_ASSERT_EQUAL_UINT16(0, state.burnInCount);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_burn_in_averages_five_minutes);
+    RUN_TEST(test_pause_counts_as_max_step);
+    RUN_TEST(test_tracks_cleaner_air_fast_and_dirtier_air_slowly);
+    RUN_TEST(test_confidence_after_a_day_of_tracking);
+    RUN_TEST(test_humidity_compensation);
+    RUN_TEST(test_restore_from_rtc_and_nvs);
+    RUN_TEST(test_corrupt_nvs_starts_a_new_burn_in);
+    return UNITY_END();
+}
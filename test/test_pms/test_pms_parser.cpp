@@ -0,0 +1,216 @@
+// PMSParser against streams of valid frames mixed with random bytes,
+// truncated frames and bad checksums, and its throughput
+#include <unity.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "PMS/PMSParser.h"
+
+using SmartAirControl::PMSParser;
+
+void setUp() {}
+void tearDown() {}
+
+static uint32_t seed;
+
+static uint32_t random(uint32_t range) {
+    seed = seed * 1664525UL + 1013904223UL;
+    return (seed >> 8) % range;
+}
+
+// A valid frame whose data words all derive from id
+static std::vector<uint8_t> frame(uint16_t id) {
+    std::vector<uint8_t> bytes;
+    bytes.push_back(static_cast<uint8_t>(PMSParser::START_1));
+    bytes.push_back(static_cast<uint8_t>(PMSParser::START_2));
+    bytes.push_back(0);
+    bytes.push_back(static_cast<uint8_t>(PMSParser::FRAME_LENGTH));
+    for (int word = 1; word <= 13; word++) {
+        uint16_t value = static_cast<uint16_t>(id * 13 + word);
+        bytes.push_back(value >> 8);
+        bytes.push_back(value & 0xFF);
+    }
+    uint16_t sum = 0;
+    for (size_t i = 0; i < bytes.size(); i++) {
+        sum += bytes[i];
+    }
+    bytes.push_back(sum >> 8);
+    bytes.push_back(sum & 0xFF);
+    return bytes;
+}
+
+static uint16_t idOf(const PM25_AQI_Data& data) {
+    return static_cast<uint16_t>((data.pm10_standard - 1) / 13);
+}
+
+// Every word of the published frame belongs to frame id
+static void assertFrame(uint16_t id, const PM25_AQI_Data& data) {
+    const uint16_t words[13] = { data.pm10_standard, data.pm25_standard, data.pm100_standard, data.pm10_env,
+                                 data.pm25_env, data.pm100_env, data.particles_03um, data.particles_05um,
+                                 data.particles_10um, data.particles_25um, data.particles_50um,
+                                 data.particles_100um, data.unused };
+    TEST_ASSERT_EQUAL_UINT16(PMSParser::FRAME_LENGTH, data.framelen);
+    for (int i = 0; i < 13; i++) {
+        TEST_ASSERT_EQUAL_UINT16(id * 13 + i + 1, words[i]);
+    }
+}
+
+// Feeds bytes, returns the ids of the frames completed in order
+static std::vector<uint16_t> feed(PMSParser& parser, const std::vector<uint8_t>& bytes) {
+    std::vector<uint16_t> ids;
+    for (size_t i = 0; i < bytes.size(); i++) {
+        if (parser.push(bytes[i])) {
+            TEST_ASSERT_TRUE(parser.hasFrame());
+            ids.push_back(idOf(parser.latest()));
+            assertFrame(ids.back(), parser.latest());
+        }
+    }
+    return ids;
+}
+
+static void append(std::vector<uint8_t>& stream, const std::vector<uint8_t>& bytes) {
+    stream.insert(stream.end(), bytes.begin(), bytes.end());
+}
+
+static void test_clean_stream() {
+    PMSParser parser;
+    std::vector<uint8_t> stream;
+    for (uint16_t id = 0; id < 100; id++) {
+        append(stream, frame(id));
+    }
+    std::vector<uint16_t> ids = feed(parser, stream);
+    TEST_ASSERT_EQUAL(100, ids.size());
+    for (uint16_t id = 0; id < 100; id++) {
+        TEST_ASSERT_EQUAL_UINT16(id, ids[id]);
+    }
+    TEST_ASSERT_EQUAL_UINT32(100, parser.getFrameCount());
+    TEST_ASSERT_EQUAL_UINT32(0, parser.getChecksumErrors());
+    TEST_ASSERT_EQUAL_UINT32(0, parser.getResyncs());
+}
+
+static void test_every_frame_between_random_bytes_is_recovered() {
+    seed = 1;
+    PMSParser parser;
+    std::vector<uint8_t> stream;
+    const uint16_t frames = 2000;
+    for (uint16_t id = 0; id < frames; id++) {
+        // noise that is biased towards the start bytes
+        for (uint32_t n = random(40); n > 0; n--) {
+            uint32_t pick = random(8);
+            stream.push_back(pick == 0 ? PMSParser::START_1 : pick == 1 ? PMSParser::START_2 : random(256));
+        }
+        append(stream, frame(id));
+    }
+    std::vector<uint16_t> ids = feed(parser, stream);
+    TEST_ASSERT_EQUAL(frames, ids.size());
+    for (uint16_t id = 0; id < frames; id++) {
+        TEST_ASSERT_EQUAL_UINT16(id, ids[id]);
+    }
+    TEST_ASSERT_GREATER_THAN(0, parser.getResyncs());
+}
+
+static void test_start_bytes_before_a_frame() {
+    // a stray header in front of a frame must not cost the frame
+    const uint8_t prefixes[][3] = { { 0x42 }, { 0x42, 0x42 }, { 0x42, 0x4D }, { 0x42, 0x4D, 0x00 }, { 0x4D, 0x42 } };
+    const size_t sizes[] = { 1, 2, 2, 3, 2 };
+    for (size_t p = 0; p < sizeof(sizes) / sizeof(sizes[0]); p++) {
+        PMSParser parser;
+        std::vector<uint8_t> stream(prefixes[p], prefixes[p] + sizes[p]);
+        append(stream, frame(7));
+        std::vector<uint16_t> ids = feed(parser, stream);
+        TEST_ASSERT_EQUAL_MESSAGE(1, ids.size(), "the frame after the stray header was lost");
+    }
+}
+
+static void test_truncated_frame_costs_at_most_the_frame_it_runs_into() {
+    // cut the frame after every possible byte, then two good frames
+    for (size_t cut = 1; cut < PMSParser::FRAME_SIZE; cut++) {
+        PMSParser parser;
+        std::vector<uint8_t> truncated = frame(1);
+        truncated.resize(cut);
+        std::vector<uint8_t> stream = truncated;
+        append(stream, frame(2));
+        append(stream, frame(3));
+        std::vector<uint16_t> ids = feed(parser, stream);
+        TEST_ASSERT_TRUE(ids.size() >= 1);
+        TEST_ASSERT_EQUAL_UINT16(3, ids.back());
+        if (cut < 4) {
+            // still in the header: the next frame is found
+            TEST_ASSERT_EQUAL(2, ids.size());
+        }
+    }
+}
+
+static void test_bad_checksum_keeps_the_last_frame() {
+    PMSParser parser;
+    feed(parser, frame(5));
+    for (size_t byte = 4; byte < PMSParser::FRAME_SIZE; byte++) {
+        std::vector<uint8_t> corrupt = frame(6);
+        corrupt[byte] ^= 0x01;
+        TEST_ASSERT_EQUAL(0, feed(parser, corrupt).size());
+        assertFrame(5, parser.latest());
+    }
+    TEST_ASSERT_EQUAL_UINT32(PMSParser::FRAME_SIZE - 4, parser.getChecksumErrors());
+    TEST_ASSERT_EQUAL(1, feed(parser, frame(6)).size());
+}
+
+static void test_bad_length_resyncs() {
+    PMSParser parser;
+    std::vector<uint8_t> wrong = frame(8);
+    wrong[3] = 20;
+    std::vector<uint8_t> stream = wrong;
+    append(stream, frame(9));
+    std::vector<uint16_t> ids = feed(parser, stream);
+    TEST_ASSERT_EQUAL(1, ids.size());
+    TEST_ASSERT_EQUAL_UINT16(9, ids[0]);
+    TEST_ASSERT_GREATER_THAN(0, parser.getResyncs());
+}
+
+static void test_pure_noise_publishes_nothing_made_up() {
+    seed = 2;
+    PMSParser parser;
+    for (uint32_t i = 0; i < 1000000; i++) {
+        if (parser.push(static_cast<uint8_t>(random(256)))) {
+            // only a frame with a correct length and checksum, by chance
+            TEST_ASSERT_EQUAL_UINT16(PMSParser::FRAME_LENGTH, parser.latest().framelen);
+        }
+    }
+    TEST_ASSERT_FALSE(parser.getFrameCount() > 2);
+}
+
+static void test_throughput() {
+    std::vector<uint8_t> stream;
+    for (uint16_t id = 0; id < 10000; id++) {
+        append(stream, frame(id));
+    }
+    PMSParser parser;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < 10; pass++) {
+        for (size_t i = 0; i < stream.size(); i++) {
+            parser.push(stream[i]);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double bytesPerSecond = 10.0 * stream.size() / (seconds > 0 ? seconds : 1e-9);
+
+    char message[80];
+    std::snprintf(message, sizeof(message), "%.1f MB/s, the UART delivers 960 B/s", bytesPerSecond / 1e6);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_EQUAL_UINT32(100000, parser.getFrameCount());
+    // a thousand times what 9600 baud can bring, even on a slow host
+    TEST_ASSERT_GREATER_THAN(960000.0, bytesPerSecond);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_clean_stream);
+    RUN_TEST(test_every_frame_between_random_bytes_is_recovered);
+    RUN_TEST(test_start_bytes_before_a_frame);
+    RUN_TEST(test_truncated_frame_costs_at_most_the_frame_it_runs_into);
+    RUN_TEST(test_bad_checksum_keeps_the_last_frame);
+    RUN_TEST(test_bad_length_resyncs);
+    RUN_TEST(test_pure_noise_publishes_nothing_made_up);
+    RUN_TEST(test_throughput);
+    return UNITY_END();
+}
@@ -0,0 +1,159 @@
+// RpmEstimator and PulseRing: the speed from edge time stamps or pulse
+// counts must not depend on how often the estimator is called
+#include <unity.h>
+#include <cmath>
+#include <cstdio>
+#include <initializer_list>
+#include "Fan/PulseRing.h"
+#include "Fan/RpmEstimator.h"
+
+using SmartAirControl::PulseRing;
+using SmartAirControl::RpmEstimator;
+
+// The speeds of the factory table (Fan.cpp), from the slowest that turns
+static const float SPEEDS[] = { 780, 1140, 1440, 1740, 2730, 6720, 9960, 12930, 14520 };
+static const uint32_t PULSES_PER_REVOLUTION = 2;
+
+static uint32_t seed = 1;
+
+// Uniform in [low, high]
+static uint32_t between(uint32_t low, uint32_t high) {
+    seed = seed * 1664525UL + 1013904223UL;
+    return low + static_cast<uint32_t>((static_cast<uint64_t>(seed >> 8) * (high - low + 1)) >> 24);
+}
+
+// A fan at a steady speed feeding the ring, as the tach interrupt does
+struct Fan {
+    Fan(float rpm, double startUs) : periodUs(60e6 / (rpm * PULSES_PER_REVOLUTION)), nextEdgeUs(startUs + periodUs) {}
+
+    // Pushes the edges up to nowUs, returns how many
+    uint32_t runTo(double nowUs, PulseRing& ring) {
+        uint32_t pulses = 0;
+        while (nextEdgeUs <= nowUs) {
+            ring.push(static_cast<uint32_t>(static_cast<uint64_t>(nextEdgeUs)));
+            nextEdgeUs += periodUs;
+            pulses++;
+        }
+        return pulses;
+    }
+
+    double periodUs;
+    double nextEdgeUs;
+};
+
+void setUp() {
+    seed = 1;
+}
+
+void tearDown() {}
+
+// Calls at random 50 to 950 ms apart, after a second of spin-up; returns
+// the worst relative error of the raw estimate
+static float worstEdgeError(float rpm, double startUs) {
+    PulseRing ring;
+    RpmEstimator estimator;
+    Fan fan(rpm, startUs);
+    double nowUs = startUs + 1e6;
+    float worst = 0;
+    for (int call = 0; call < 200; call++) {
+        nowUs += between(50, 950) * 1000.0;
+        fan.runTo(nowUs, ring);
+        float estimate = estimator.update(ring, 1, static_cast<uint32_t>(static_cast<uint64_t>(nowUs)));
+        float error = std::fabs(estimate - rpm) / rpm;
+        worst = error > worst ? error : worst;
+    }
+    return worst;
+}
+
+static void test_edge_periods_within_a_tenth_of_a_percent_under_irregular_calls() {
+    for (float rpm : SPEEDS) {
+        float worst = worstEdgeError(rpm, 0);
+        char message[64];
+        std::snprintf(message, sizeof(message), "%5.0f rpm: worst %.4f %%", rpm, worst * 100);
+        TEST_MESSAGE(message);
+        TEST_ASSERT_LESS_OR_EQUAL_FLOAT(0.001f, worst);
+    }
+}
+
+static void test_edge_periods_across_the_micros_wrap() {
+    // micros() wraps after 71 minutes, the window straddles it
+    for (float rpm : SPEEDS) {
+        TEST_ASSERT_LESS_OR_EQUAL_FLOAT(0.001f, worstEdgeError(rpm, 4294967296.0 - 30e6));
+    }
+}
+
+static void test_counted_pulses_average_to_the_speed_under_irregular_calls() {
+    for (float rpm : SPEEDS) {
+        PulseRing ring;
+        RpmEstimator estimator;
+        Fan fan(rpm, 0);
+        double nowUs = 1e6;
+        fan.runTo(nowUs, ring);
+        // a reading holds for the time until the next one
+        double weighted = 0;
+        double totalUs = 0;
+        for (int call = 0; call < 200; call++) {
+            uint32_t elapsedUs = between(50, 950) * 1000;
+            nowUs += elapsedUs;
+            uint32_t pulses = fan.runTo(nowUs, ring);
+            weighted += estimator.update(pulses, elapsedUs, static_cast<uint32_t>(nowUs)) * elapsedUs;
+            totalUs += elapsedUs;
+        }
+        // one pulse more or less at the ends of the whole run
+        float resolution = 60e6f / PULSES_PER_REVOLUTION / totalUs;
+        TEST_ASSERT_FLOAT_WITHIN(resolution, rpm, weighted / totalUs);
+    }
+}
+
+static void test_smoothing_keeps_its_time_constant_for_any_call_interval() {
+    // a step from 0 to 6720 rpm: after one time constant (2 s) the smoothed
+    // value is 63 % of the way there, however often it was updated
+    for (uint32_t intervalMs : { 50U, 200U, 500U }) {
+        PulseRing ring;
+        RpmEstimator estimator(500000, 2000000, 2.0);
+        estimator.update(0, 1000, 0);
+        Fan fan(6720, 0);
+        for (uint32_t t = intervalMs; t <= 2000; t += intervalMs) {
+            fan.runTo(t * 1000.0, ring);
+            estimator.update(ring, 1, t * 1000);
+        }
+        TEST_ASSERT_FLOAT_WITHIN(6720 * 0.06f, 6720 * (1 - std::exp(-1.0f)), estimator.getSmoothedRpm());
+    }
+}
+
+static void test_spin_down_is_capped_by_the_silence_and_reaches_zero() {
+    PulseRing ring;
+    RpmEstimator estimator(500000, 2000000, 2.0);
+    Fan fan(6720, 0);
+    fan.runTo(1e6, ring);
+    TEST_ASSERT_FLOAT_WITHIN(6720 * 0.001f, 6720, estimator.update(ring, 1, 1000000));
+    // the fan stops: the silence bounds the speed from above, 60 s / 2 / 100 ms = 300 rpm
+    TEST_ASSERT_LESS_OR_EQUAL_FLOAT(301, estimator.update(ring, 1, 1100000));
+    TEST_ASSERT_EQUAL_FLOAT(0, estimator.update(ring, 1, 3100000));
+}
+
+static void test_lapped_snapshot_drops_the_overwritten_stamps() {
+    PulseRing ring;
+    for (uint32_t i = 1; i <= PulseRing::CAPACITY + 10; i++) {
+        ring.push(i * 100);
+    }
+    uint32_t stamps[PulseRing::CAPACITY];
+    size_t n = ring.snapshot(stamps, PulseRing::CAPACITY);
+    TEST_ASSERT_EQUAL_size_t(PulseRing::CAPACITY, n);
+    // newest first, consecutive
+    for (size_t i = 0; i < n; i++) {
+        TEST_ASSERT_EQUAL_UINT32((PulseRing::CAPACITY + 10 - i) * 100, stamps[i]);
+    }
+    TEST_ASSERT_EQUAL_UINT32(PulseRing::CAPACITY + 10, ring.count());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_edge_periods_within_a_tenth_of_a_percent_under_irregular_calls);
+    RUN_TEST(test_edge_periods_across_the_micros_wrap);
+    RUN_TEST(test_counted_pulses_average_to_the_speed_under_irregular_calls);
+    RUN_TEST(test_smoothing_keeps_its_time_constant_for_any_call_interval);
+    RUN_TEST(test_spin_down_is_capped_by_the_silence_and_reaches_zero);
+    RUN_TEST(test_lapped_snapshot_drops_the_overwritten_stamps);
+    return UNITY_END();
+}
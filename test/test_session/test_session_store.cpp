@@ -0,0 +1,202 @@
+// SessionStore across a power cut: the session comes back from the journal,
+// saved up to SAVE_INTERVAL_MS before, with the frame counters of the record
+// written after every frame, so the next uplink never repeats a counter the
+// network has seen
+#include <unity.h>
+#include <RadioLib.h>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+#include "HAL/native/Simulation.h"
+#include "LoRa/SessionStore.h"
+
+using SmartAirControl::SessionStore;
+namespace sim = SmartAirControl::sim;
+
+// one uplink a minute, a full save every 15
+static const uint32_t UPLINK_MS = 60000;
+
+static SX1262 radio(new Module(0, 0, 0, 0));
+
+// What the node keeps in RTC memory, lost with the power
+struct Device {
+    Device() : node(&radio, &EU868), state(), store("session", state), nowMs(0), lastFCnt(0), lastDownFCnt(0) {}
+
+    LoRaWANNode node;
+    SessionStore::State state;
+    SessionStore store;
+    uint32_t nowMs;
+    uint32_t lastFCnt;     /** of the last uplink sent */
+    uint32_t lastDownFCnt; /** of the last downlink received */
+};
+
+static void join(Device& device) {
+    LoRaWANJoinEvent_t joinEvent;
+    TEST_ASSERT_EQUAL(RADIOLIB_LORAWAN_NEW_SESSION, device.node.activateOTAA(RADIOLIB_LORAWAN_DATA_RATE_UNUSED, &joinEvent));
+    TEST_ASSERT_TRUE(device.store.save(device.node.getBufferNonces(), device.node.getBufferSession(), device.nowMs));
+}
+
+// One uplink the way LoRaWAN::loop() handles it; without the counter record
+// when the power goes before it is written
+static void uplink(Device& device, bool recorded = true) {
+    uint8_t payload[4] = { 1, 2, 3, 4 };
+    uint8_t downlink[255];
+    size_t downlinkSize;
+    LoRaWANEvent_t up;
+    LoRaWANEvent_t down;
+    int16_t state = device.node.sendReceive(payload, sizeof(payload), 2, downlink, &downlinkSize, false, &up, &down);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, state);
+    device.lastFCnt = up.fCnt;
+    if (state > 0) {
+        device.lastDownFCnt = down.fCnt;
+    }
+    if (recorded) {
+        TEST_ASSERT_TRUE(device.store.saveCounters(device.node.getBufferSession()));
+        device.store.saveIfDue(device.node.getBufferNonces(), device.node.getBufferSession(), device.nowMs);
+    }
+    device.nowMs += UPLINK_MS;
+}
+
+// The session a device booting after a power cut hands RadioLib, advanced or
+// as the journal has it
+static void recall(Device& device, bool advance, uint8_t* session) {
+    SessionStore::Record stored;
+    TEST_ASSERT_TRUE(device.store.load(stored));
+    if (advance) {
+        device.store.advanceCounters(stored.session);
+    }
+    std::memcpy(session, stored.session, RADIOLIB_LORAWAN_SESSION_BUF_SIZE);
+    TEST_ASSERT_EQUAL(RADIOLIB_ERR_NONE, device.node.setBufferNonces(stored.nonces));
+    TEST_ASSERT_EQUAL(RADIOLIB_ERR_NONE, device.node.setBufferSession(stored.session));
+    TEST_ASSERT_EQUAL(RADIOLIB_LORAWAN_SESSION_RESTORED,
+                      device.node.activateOTAA(RADIOLIB_LORAWAN_DATA_RATE_UNUSED, nullptr));
+}
+
+static uint32_t counter(const uint8_t* session, size_t offset) {
+    uint32_t value;
+    std::memcpy(&value, &session[offset], sizeof(value));
+    return value;
+}
+
+// The FCnt of the first uplink after a power cut
+static uint32_t nextFCnt(Device& device, bool advance) {
+    uint8_t session[RADIOLIB_LORAWAN_SESSION_BUF_SIZE];
+    Device booted;
+    recall(booted, advance, session);
+    uplink(booted, false);
+    return booted.lastFCnt;
+}
+
+void setUp() {
+    sim::Simulation& simulation = sim::Simulation::get();
+    simulation.nvs().clear();
+    simulation.flash("session") = sim::FlashModel();
+}
+
+void tearDown() {}
+
+static void test_next_uplink_after_a_power_cut_counts_on() {
+    for (int uplinks : { 1, 5, 14, 15, 16, 40 }) {
+        setUp();
+        Device device;
+        join(device);
+        for (int i = 0; i < uplinks; i++) {
+            uplink(device);
+        }
+
+        uint32_t fCnt = nextFCnt(device, true);
+        TEST_ASSERT_GREATER_THAN_UINT32(device.lastFCnt, fCnt);
+        // no further than the margin
+        TEST_ASSERT_EQUAL_UINT32(device.lastFCnt + 1 + SessionStore::FCNT_MARGIN, fCnt);
+    }
+}
+
+static void test_session_from_the_journal_alone_repeats_counters() {
+    // what restore() did before the counter record: 20 uplinks, the last
+    // full save after the 16th
+    Device device;
+    join(device);
+    for (int i = 0; i < 20; i++) {
+        uplink(device);
+    }
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(device.lastFCnt, nextFCnt(device, false));
+    TEST_ASSERT_GREATER_THAN_UINT32(device.lastFCnt, nextFCnt(device, true));
+}
+
+static void test_power_cut_before_the_counter_record() {
+    Device device;
+    join(device);
+    for (int i = 0; i < 7; i++) {
+        uplink(device);
+    }
+    // the network heard this one, the record still has the one before
+    uplink(device, false);
+    TEST_ASSERT_GREATER_THAN_UINT32(device.lastFCnt, nextFCnt(device, true));
+}
+
+static void test_downlink_counters_are_advanced_too() {
+    sim::Simulation& simulation = sim::Simulation::get();
+    Device device;
+    join(device);
+    for (int i = 0; i < 9; i++) {
+        // a command in the RX window of every other uplink
+        if (i % 2 == 0) {
+            simulation.network().scheduleDownlink(0, 10, std::vector<uint8_t>(2, 0));
+        }
+        uplink(device);
+    }
+    TEST_ASSERT_EQUAL_UINT32(5, device.lastDownFCnt);
+
+    uint8_t session[RADIOLIB_LORAWAN_SESSION_BUF_SIZE];
+    Device booted;
+    recall(booted, true, session);
+    // a replay of the last downlink is not newer than what the node has seen
+    TEST_ASSERT_EQUAL_UINT32(device.lastDownFCnt + SessionStore::FCNT_MARGIN,
+                             counter(session, RADIOLIB_LORAWAN_SESSION_A_FCNT_DOWN));
+    TEST_ASSERT_EQUAL_UINT32(SessionStore::FCNT_MARGIN, counter(session, RADIOLIB_LORAWAN_SESSION_N_FCNT_DOWN));
+}
+
+static void test_counter_record_of_another_session_is_ignored() {
+    Device device;
+    join(device);
+    for (int i = 0; i < 3; i++) {
+        uplink(device);
+    }
+    // an earlier session counted much further
+    SessionStore::Counters old = { 0, 5000, 40, 60 };
+    std::vector<uint8_t>& record = sim::Simulation::get().nvs()["session/counters"];
+    TEST_ASSERT_EQUAL(sizeof(old), record.size());
+    std::memcpy(record.data(), &old, sizeof(old));
+
+    // back to the journal, which saved the session right after the join
+    uint8_t session[RADIOLIB_LORAWAN_SESSION_BUF_SIZE];
+    Device booted;
+    recall(booted, true, session);
+    TEST_ASSERT_EQUAL_UINT32(SessionStore::FCNT_MARGIN, counter(session, RADIOLIB_LORAWAN_SESSION_FCNT_UP));
+}
+
+static void test_unsigned_session_is_left_alone() {
+    Device device;
+    join(device);
+    SessionStore::Record stored;
+    TEST_ASSERT_TRUE(device.store.load(stored));
+    stored.session[RADIOLIB_LORAWAN_SESSION_SIGNATURE] ^= 0x01;
+    uint8_t before[RADIOLIB_LORAWAN_SESSION_BUF_SIZE];
+    std::memcpy(before, stored.session, sizeof(before));
+
+    device.store.advanceCounters(stored.session);
+    TEST_ASSERT_EQUAL_MEMORY(before, stored.session, sizeof(before));
+    TEST_ASSERT_EQUAL(RADIOLIB_ERR_SESSION_DISCARDED, device.node.setBufferSession(stored.session));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_next_uplink_after_a_power_cut_counts_on);
+    RUN_TEST(test_session_from_the_journal_alone_repeats_counters);
+    RUN_TEST(test_power_cut_before_the_counter_record);
+    RUN_TEST(test_downlink_counters_are_advanced_too);
+    RUN_TEST(test_counter_record_of_another_session_is_ignored);
+    RUN_TEST(test_unsigned_session_is_left_alone);
+    return UNITY_END();
+}
@@ -0,0 +1,332 @@
+// RtcSampleRing and Journal across reboots and power cuts: a reboot is a new
+// object over the same RTC memory or flash partition, a cut stops a write
+// after every byte in turn
+#include <unity.h>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "HAL/Hal.h"
+#include "HAL/native/Simulation.h"
+#include "Storage/Journal.h"
+#include "Storage/RtcSampleRing.h"
+
+using SmartAirControl::Journal;
+using SmartAirControl::RtcSampleRing;
+using SmartAirControl::Sample;
+namespace sim = SmartAirControl::sim;
+namespace hal = SmartAirControl::hal;
+
+static RtcSampleRing::Storage storage;
+
+void setUp() {
+    std::memset(&storage, 0, sizeof(storage));
+}
+
+void tearDown() {}
+
+// Unique per index, every field different from its neighbours'
+static Sample testSample(int i) {
+    return Sample(20.0f + i * 0.01f, 1000.0f + i * 0.1f, i % 100, 100.0f + i, i, 2 * i, 3 * i, 1000 + i, i % 101, 0.3f);
+}
+
+// The samples of a ring that boots on the storage
+static std::vector<uint16_t> rebootAndList() {
+    RtcSampleRing ring(storage);
+    ring.restore();
+    std::vector<uint16_t> pm25;
+    for (size_t i = 0; i < ring.size(); i++) {
+        pm25.push_back(ring.at(i).pm25);
+    }
+    return pm25;
+}
+
+static void test_cold_boot_starts_empty() {
+    RtcSampleRing ring(storage);
+    TEST_ASSERT_EQUAL(0, ring.restore());
+    std::memset(&storage, 0xA5, sizeof(storage));
+    TEST_ASSERT_EQUAL(0, ring.restore());
+}
+
+static void test_samples_survive_wake_sleep_cycles() {
+    // every cycle boots, queues a sample and sends three whenever six are queued
+    std::vector<uint16_t> expected;
+    for (int cycle = 0; cycle < 200; cycle++) {
+        RtcSampleRing ring(storage);
+        TEST_ASSERT_EQUAL(expected.size(), ring.restore());
+        for (size_t i = 0; i < expected.size(); i++) {
+            TEST_ASSERT_EQUAL_UINT16(expected[i], ring.at(i).pm25);
+        }
+        ring.push(testSample(cycle));
+        expected.push_back(testSample(cycle).pm25);
+        if (ring.size() == 6) {
+            ring.pop(3);
+            expected.erase(expected.begin(), expected.begin() + 3);
+        }
+    }
+}
+
+static void test_full_ring_drops_the_oldest() {
+    {
+        RtcSampleRing ring(storage);
+        ring.restore();
+        for (size_t i = 0; i < RtcSampleRing::CAPACITY + 5; i++) {
+            ring.push(testSample(i));
+        }
+    }
+    std::vector<uint16_t> pm25 = rebootAndList();
+    TEST_ASSERT_EQUAL(RtcSampleRing::CAPACITY, pm25.size());
+    TEST_ASSERT_EQUAL_UINT16(testSample(5).pm25, pm25.front());
+    TEST_ASSERT_EQUAL_UINT16(testSample(RtcSampleRing::CAPACITY + 4).pm25, pm25.back());
+}
+
+// A region of the storage an operation writes, in the order it writes them
+struct Region {
+    size_t offset;
+    size_t size;
+};
+
+static Region headerRegion(uint32_t sequence) {
+    Region region = { offsetof(RtcSampleRing::Storage, headers) + (sequence & 1) * sizeof(RtcSampleRing::Header),
+                      sizeof(RtcSampleRing::Header) };
+    return region;
+}
+
+static Region recordRegion(size_t slot) {
+    Region region = { offsetof(RtcSampleRing::Storage, records) + slot * sizeof(RtcSampleRing::Record),
+                      sizeof(RtcSampleRing::Record) };
+    return region;
+}
+
+// Replays the operation from before to after, cut after every byte it
+// writes; after a reboot the ring has to hold what it held before or after
+static void assertCutsRecover(const RtcSampleRing::Storage& before, const RtcSampleRing::Storage& after,
+                              const std::vector<Region>& writes) {
+    storage = before;
+    std::vector<uint16_t> old = rebootAndList();
+    storage = after;
+    std::vector<uint16_t> updated = rebootAndList();
+
+    const uint8_t* to = reinterpret_cast<const uint8_t*>(&after);
+    size_t total = 0;
+    for (size_t w = 0; w < writes.size(); w++) {
+        total += writes[w].size;
+    }
+    for (size_t cut = 0; cut <= total; cut++) {
+        storage = before;
+        uint8_t* bytes = reinterpret_cast<uint8_t*>(&storage);
+        size_t left = cut;
+        for (size_t w = 0; w < writes.size() && left > 0; w++) {
+            size_t n = writes[w].size < left ? writes[w].size : left;
+            std::memcpy(bytes + writes[w].offset, to + writes[w].offset, n);
+            left -= n;
+        }
+        std::vector<uint16_t> got = rebootAndList();
+        TEST_ASSERT_TRUE_MESSAGE(got == old || got == updated, "a cut left neither the old nor the new ring");
+        // the writes cover everything the operation changed
+        if (cut == total) {
+            TEST_ASSERT_EQUAL_MEMORY(to, bytes, sizeof(storage));
+        }
+    }
+}
+
+static void test_torn_push_recovers() {
+    RtcSampleRing ring(storage);
+    ring.restore();
+    for (int i = 0; i < 10; i++) {
+        ring.push(testSample(i));
+    }
+    RtcSampleRing::Storage before = storage;
+    ring.push(testSample(10));
+
+    // the record, then the header exposing it
+    std::vector<Region> writes;
+    writes.push_back(recordRegion(10));
+    writes.push_back(headerRegion(11));
+    assertCutsRecover(before, storage, writes);
+}
+
+static void test_torn_push_into_a_full_ring_recovers() {
+    RtcSampleRing ring(storage);
+    ring.restore();
+    for (size_t i = 0; i < RtcSampleRing::CAPACITY + 3; i++) {
+        ring.push(testSample(i));
+    }
+    RtcSampleRing::Storage before = storage;
+    uint32_t sequence = before.headers[0].sequence > before.headers[1].sequence ? before.headers[0].sequence
+                                                                                 : before.headers[1].sequence;
+    ring.push(testSample(1000));
+
+    // the header releasing the oldest slot, the record, the header exposing it
+    std::vector<Region> writes;
+    writes.push_back(headerRegion(sequence + 1));
+    writes.push_back(recordRegion(3));
+    writes.push_back(headerRegion(sequence + 2));
+    assertCutsRecover(before, storage, writes);
+}
+
+static void test_torn_pop_recovers() {
+    RtcSampleRing ring(storage);
+    ring.restore();
+    for (int i = 0; i < 8; i++) {
+        ring.push(testSample(i));
+    }
+    RtcSampleRing::Storage before = storage;
+    ring.pop(5);
+
+    std::vector<Region> writes;
+    writes.push_back(headerRegion(9));
+    assertCutsRecover(before, storage, writes);
+}
+
+static void test_damaged_record_drops_it_and_the_newer_ones() {
+    {
+        RtcSampleRing ring(storage);
+        ring.restore();
+        for (int i = 0; i < 6; i++) {
+            ring.push(testSample(i));
+        }
+    }
+    storage.records[3].fields[0] ^= 0x10;
+    std::vector<uint16_t> pm25 = rebootAndList();
+    TEST_ASSERT_EQUAL(3, pm25.size());
+    TEST_ASSERT_EQUAL_UINT16(testSample(2).pm25, pm25.back());
+}
+
+static void test_any_flipped_byte_recovers_a_consistent_ring() {
+    {
+        RtcSampleRing ring(storage);
+        ring.restore();
+        for (int i = 0; i < 12; i++) {
+            ring.push(testSample(i));
+        }
+    }
+    const RtcSampleRing::Storage good = storage;
+    for (size_t offset = 0; offset < sizeof(storage); offset++) {
+        storage = good;
+        reinterpret_cast<uint8_t*>(&storage)[offset] ^= 0xFF;
+        std::vector<uint16_t> pm25 = rebootAndList();
+        // a prefix of what was queued, never a made-up sample
+        TEST_ASSERT_LESS_OR_EQUAL(12, pm25.size());
+        for (size_t i = 0; i < pm25.size(); i++) {
+            TEST_ASSERT_EQUAL_UINT16(testSample(i).pm25, pm25[i]);
+        }
+    }
+}
+
+// Journal: a record of the session store's size on a blank partition
+static const uint16_t JOURNAL_VERSION = 1;
+static const size_t RECORD_SIZE = 300;
+
+struct TestRecord {
+    uint8_t bytes[RECORD_SIZE];
+};
+
+static TestRecord testRecord(uint8_t fill) {
+    TestRecord record;
+    std::memset(record.bytes, fill, sizeof(record.bytes));
+    return record;
+}
+
+// The fill of the record a journal booting on the partition recovers, 0 for none
+static uint8_t rebootAndRecover(hal::Flash& partition) {
+    Journal journal(partition, JOURNAL_VERSION, RECORD_SIZE);
+    TestRecord record;
+    if (!journal.recover(&record)) {
+        return 0;
+    }
+    TestRecord same = testRecord(record.bytes[0]);
+    TEST_ASSERT_EQUAL_MEMORY(same.bytes, record.bytes, RECORD_SIZE);
+    return record.bytes[0];
+}
+
+static void test_journal_keeps_the_newest_record_across_reboots() {
+    hal::Flash partition("reboots");
+    TEST_ASSERT_EQUAL_UINT8(0, rebootAndRecover(partition));
+    // round the partition several times, a reboot after every append
+    for (int i = 1; i < 200; i++) {
+        Journal journal(partition, JOURNAL_VERSION, RECORD_SIZE);
+        journal.recover(nullptr);
+        TestRecord record = testRecord(static_cast<uint8_t>(i));
+        TEST_ASSERT_TRUE(journal.append(&record));
+        TEST_ASSERT_EQUAL_UINT8(i, rebootAndRecover(partition));
+    }
+}
+
+static void test_journal_ignores_another_version() {
+    hal::Flash partition("version");
+    Journal journal(partition, JOURNAL_VERSION, RECORD_SIZE);
+    TestRecord record = testRecord(7);
+    TEST_ASSERT_TRUE(journal.append(&record));
+    Journal newer(partition, JOURNAL_VERSION + 1, RECORD_SIZE);
+    TEST_ASSERT_FALSE(newer.recover(&record));
+}
+
+// Cuts the power after every byte of the append of record n + 1 to a
+// journal holding records 1 ... n: after a reboot it has n or n + 1, and
+// takes the next append
+static void assertAppendCutsRecover(const char* label, size_t appended) {
+    sim::FlashModel& flash = sim::Simulation::get().flash(label);
+    hal::Flash partition(label);
+    {
+        Journal journal(partition, JOURNAL_VERSION, RECORD_SIZE);
+        journal.recover(nullptr);
+        for (size_t i = 1; i <= appended; i++) {
+            TestRecord record = testRecord(static_cast<uint8_t>(i));
+            TEST_ASSERT_TRUE(journal.append(&record));
+        }
+    }
+    const sim::FlashModel before = flash;
+    const uint8_t previous = static_cast<uint8_t>(appended);
+    const uint8_t written = static_cast<uint8_t>(appended + 1);
+
+    for (size_t cut = 0;; cut++) {
+        flash = before;
+        flash.cutPowerAfter(cut);
+        Journal journal(partition, JOURNAL_VERSION, RECORD_SIZE);
+        TestRecord record = testRecord(written);
+        bool done = journal.append(&record);
+        flash.restorePower();
+
+        uint8_t got = rebootAndRecover(partition);
+        TEST_ASSERT_TRUE_MESSAGE(got == written || (!done && got == previous), "a cut lost the record");
+
+        Journal next(partition, JOURNAL_VERSION, RECORD_SIZE);
+        next.recover(nullptr);
+        TestRecord after = testRecord(0x5A);
+        TEST_ASSERT_TRUE(next.append(&after));
+        TEST_ASSERT_EQUAL_UINT8(0x5A, rebootAndRecover(partition));
+        if (done) {
+            // the cut came after the last byte
+            break;
+        }
+    }
+}
+
+static void test_torn_journal_append_in_a_sector_recovers() {
+    assertAppendCutsRecover("cut", 3);
+}
+
+static void test_torn_journal_append_at_the_wrap_recovers() {
+    // the append that erases the oldest sector first
+    hal::Flash partition("wrap");
+    Journal journal(partition, JOURNAL_VERSION, RECORD_SIZE);
+    journal.recover(nullptr);
+    assertAppendCutsRecover("wrap", journal.getSlots());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_cold_boot_starts_empty);
+    RUN_TEST(test_samples_survive_wake_sleep_cycles);
+    RUN_TEST(test_full_ring_drops_the_oldest);
+    RUN_TEST(test_torn_push_recovers);
+    RUN_TEST(test_torn_push_into_a_full_ring_recovers);
+    RUN_TEST(test_torn_pop_recovers);
+    RUN_TEST(test_damaged_record_drops_it_and_the_newer_ones);
+    RUN_TEST(test_any_flipped_byte_recovers_a_consistent_ring);
+    RUN_TEST(test_journal_keeps_the_newest_record_across_reboots);
+    RUN_TEST(test_journal_ignores_another_version);
+    RUN_TEST(test_torn_journal_append_in_a_sector_recovers);
+    RUN_TEST(test_torn_journal_append_at_the_wrap_recovers);
+    return UNITY_END();
+}
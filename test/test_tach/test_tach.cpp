@@ -0,0 +1,202 @@
+// The tach backends (Fan/Tach.h) on the same synthetic edge timelines:
+// the speed Fan reads through each, and the interrupts each costs. The
+// pulse counter and the capture unit run on the models behind
+// HAL/native/include/driver.
+#include <unity.h>
+#include <cmath>
+#include <cstdio>
+#include <driver/mcpwm.h>
+#include <driver/pcnt.h>
+#include "HAL/Hal.h"
+#include "HAL/native/Simulation.h"
+#include "Fan/CaptureTach.h"
+#include "Fan/Fan.h"
+#include "Fan/IsrTach.h"
+#include "Fan/PcntTach.h"
+
+using SmartAirControl::Fan;
+using SmartAirControl::Tach;
+namespace hal = SmartAirControl::hal;
+namespace sim = SmartAirControl::sim;
+
+// ControlTask calls Fan::update() this often
+static const uint32_t UPDATE_MS = 100;
+// a counted speed is off by up to one edge in a CONTROL_PERIOD_MS
+static const float COUNT_RESOLUTION_RPM = 60000.0f / (2 * Fan::CONTROL_PERIOD_MS);
+
+enum Backend { ISR, PCNT, CAPTURE, CAPTURE_PRESCALED, BACKENDS };
+static const char* const NAMES[BACKENDS] = { "ISR", "PCNT", "capture", "capture /4" };
+
+// What the tach line does besides its pulses
+struct Timeline {
+    float rpm;
+    float jitter;       /** of every period, uniform +- */
+    uint32_t bounceUs;  /** > 0: every edge bounces once, high for this long */
+    uint32_t spikeEvery; /** > 0: a 2 us low spike in the middle of every n-th period */
+};
+
+struct Reading {
+    float rpm;                  /** Fan::getRawRpm() at the end */
+    float worstError;           /** of every reading after the first second, of the speed */
+    float interruptsPerSecond;
+};
+
+static uint32_t seed = 1;
+
+static float uniform() {
+    seed = seed * 1664525UL + 1013904223UL;
+    return (seed >> 8) / 16777216.0f;
+}
+
+static Tach* start(Backend backend, sim::Simulation& simulation) {
+    static SmartAirControl::IsrTach isrTach(simulation.fanTachPin);
+    static SmartAirControl::PcntTach pcntTach(simulation.fanTachPin);
+    static SmartAirControl::CaptureTach captureTach(simulation.fanTachPin);
+    static SmartAirControl::CaptureTach prescaledTach(simulation.fanTachPin, MCPWM_UNIT_1, 4);
+    Tach* tachs[BACKENDS] = { &isrTach, &pcntTach, &captureTach, &prescaledTach };
+    return tachs[backend];
+}
+
+// One backend at a time on the line, the others detached
+static void stop(sim::Simulation& simulation) {
+    simulation.attachFallingEdge(simulation.fanTachPin, nullptr, nullptr);
+    pcnt_counter_pause(PCNT_UNIT_0);
+    mcpwm_capture_disable_channel(MCPWM_UNIT_0, MCPWM_SELECT_CAP0);
+    mcpwm_capture_disable_channel(MCPWM_UNIT_1, MCPWM_SELECT_CAP0);
+}
+
+// Plays seconds of the timeline to the backend and reads the speed the
+// way ControlTask does
+static Reading play(Backend backend, const Timeline& timeline, uint32_t seconds) {
+    sim::Simulation& simulation = sim::Simulation::get();
+    simulation.nvs().clear();
+    stop(simulation);
+    Fan fan(simulation.fanPwmPin, *start(backend, simulation));
+    // the simulated fan stays stopped, the timeline is the only source of edges
+    fan.setup();
+
+    seed = 1;
+    uint64_t startUs = simulation.nowUs();
+    uint64_t endUs = startUs + seconds * 1000000ULL;
+    uint64_t interrupts = simulation.report().tachInterrupts;
+    float periodUs = 60e6f / (timeline.rpm * sim::FanModel::PULSES_PER_REVOLUTION);
+    uint64_t edgeUs = startUs + static_cast<uint64_t>(periodUs);
+    uint64_t nextUpdateUs = startUs + UPDATE_MS * 1000ULL;
+    uint32_t periods = 0;
+
+    Reading reading;
+    reading.worstError = 0;
+    while (nextUpdateUs <= endUs) {
+        if (edgeUs < nextUpdateUs) {
+            uint32_t thisPeriodUs = static_cast<uint32_t>(periodUs * (1 + timeline.jitter * (2 * uniform() - 1)));
+            simulation.advanceTo(edgeUs);
+            if (timeline.bounceUs > 0) {
+                simulation.tachEdge(timeline.bounceUs);
+                simulation.advanceTo(edgeUs + 2 * timeline.bounceUs);
+            }
+            simulation.tachEdge(thisPeriodUs / 2);
+            periods++;
+            if (timeline.spikeEvery > 0 && periods % timeline.spikeEvery == 0) {
+                simulation.advanceTo(edgeUs + thisPeriodUs / 2 + thisPeriodUs / 4);
+                simulation.tachEdge(2);
+            }
+            edgeUs += thisPeriodUs;
+            continue;
+        }
+        simulation.advanceTo(nextUpdateUs);
+        fan.update();
+        nextUpdateUs += UPDATE_MS * 1000ULL;
+        if (simulation.nowUs() - startUs > 1000000) {
+            float error = std::fabs(fan.getRawRpm() - timeline.rpm) / timeline.rpm;
+            reading.worstError = error > reading.worstError ? error : reading.worstError;
+        }
+    }
+    reading.rpm = fan.getRawRpm();
+    reading.interruptsPerSecond = static_cast<float>(simulation.report().tachInterrupts - interrupts) / seconds;
+
+    char message[128];
+    std::snprintf(message, sizeof(message), "%-10s %5.0f rpm: read %5.0f, worst %5.1f %% off, %4.0f interrupts/s",
+                  NAMES[backend], timeline.rpm, reading.rpm, reading.worstError * 100, reading.interruptsPerSecond);
+    TEST_MESSAGE(message);
+    return reading;
+}
+
+// Speeds of the calibration table, from the slowest that turns
+static const float SPEEDS[] = { 780, 1440, 2730, 6720, 9960, 14520 };
+
+void setUp() {}
+
+void tearDown() {}
+
+static void test_clean_edges_across_the_speed_range() {
+    for (float rpm : SPEEDS) {
+        Timeline timeline = { rpm, 0.01f, 0, 0 };
+        for (int backend = 0; backend < BACKENDS; backend++) {
+            Reading reading = play(static_cast<Backend>(backend), timeline, 5);
+            if (backend == PCNT) {
+                // no edge times: a whole number of edges per period
+                TEST_ASSERT_LESS_OR_EQUAL_FLOAT(0.01f + COUNT_RESOLUTION_RPM / rpm, reading.worstError);
+            } else {
+                // edge periods over the estimator window, jitter averaged out
+                TEST_ASSERT_LESS_OR_EQUAL_FLOAT(0.01f, reading.worstError);
+            }
+        }
+    }
+}
+
+static void test_edge_times_read_low_speeds_closer_than_counting() {
+    Timeline timeline = { 780, 0.01f, 0, 0 };
+    Reading counted = play(PCNT, timeline, 5);
+    Reading timed = play(CAPTURE, timeline, 5);
+    TEST_ASSERT_GREATER_THAN_FLOAT(0.05f, counted.worstError);
+    TEST_ASSERT_LESS_THAN_FLOAT(counted.worstError / 5, timed.worstError);
+}
+
+static void test_contact_bounce_is_rejected_without_the_capture_prescaler() {
+    for (float rpm : { 1440.0f, 14520.0f }) {
+        Timeline timeline = { rpm, 0.01f, 3, 0 };
+        for (Backend backend : { ISR, PCNT, CAPTURE }) {
+            Reading reading = play(backend, timeline, 5);
+            float tolerance = backend == PCNT ? 0.01f + COUNT_RESOLUTION_RPM / rpm : 0.01f;
+            TEST_ASSERT_LESS_OR_EQUAL_FLOAT(tolerance, reading.worstError);
+        }
+        // the prescaler counts the bounce before the shortest period is checked
+        Reading prescaled = play(CAPTURE_PRESCALED, timeline, 5);
+        TEST_ASSERT_FLOAT_WITHIN(rpm * 0.02f, rpm * 2, prescaled.rpm);
+    }
+}
+
+static void test_only_the_pulse_counter_filters_spikes() {
+    // a 2 us spike mid-period in every fourth period: past the debounce of
+    // the ISR and the shortest period of the capture, under the 10 us glitch
+    // filter of the pulse counter
+    Timeline timeline = { 6720, 0.01f, 0, 4 };
+    Reading counted = play(PCNT, timeline, 5);
+    TEST_ASSERT_LESS_OR_EQUAL_FLOAT(0.01f + COUNT_RESOLUTION_RPM / timeline.rpm, counted.worstError);
+    for (Backend backend : { ISR, CAPTURE }) {
+        Reading reading = play(backend, timeline, 5);
+        TEST_ASSERT_GREATER_THAN_FLOAT(timeline.rpm * 1.1f, reading.rpm);
+    }
+}
+
+static void test_interrupt_cost_at_full_speed() {
+    Timeline timeline = { 14520, 0.01f, 0, 0 };
+    float edgesPerSecond = timeline.rpm * sim::FanModel::PULSES_PER_REVOLUTION / 60;
+    // one per edge for the GPIO interrupt and the capture, one per four
+    // with the capture prescaler, none for the pulse counter
+    TEST_ASSERT_FLOAT_WITHIN(edgesPerSecond * 0.02f, edgesPerSecond, play(ISR, timeline, 5).interruptsPerSecond);
+    TEST_ASSERT_FLOAT_WITHIN(edgesPerSecond * 0.02f, edgesPerSecond, play(CAPTURE, timeline, 5).interruptsPerSecond);
+    TEST_ASSERT_FLOAT_WITHIN(edgesPerSecond * 0.02f / 4, edgesPerSecond / 4,
+                              play(CAPTURE_PRESCALED, timeline, 5).interruptsPerSecond);
+    TEST_ASSERT_EQUAL_FLOAT(0, play(PCNT, timeline, 5).interruptsPerSecond);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_clean_edges_across_the_speed_range);
+    RUN_TEST(test_edge_times_read_low_speeds_closer_than_counting);
+    RUN_TEST(test_contact_bounce_is_rejected_without_the_capture_prescaler);
+    RUN_TEST(test_only_the_pulse_counter_filters_spikes);
+    RUN_TEST(test_interrupt_cost_at_full_speed);
+    return UNITY_END();
+}
@@ -0,0 +1,168 @@
+// The task split on the host scheduler (Tasks/Task.h) and the virtual
+// clock: the control loop keeps its period while a radio transaction
+// waits for seconds, the sensor task works on the same core and the CPU
+// sleeps in between
+#include <unity.h>
+#include <cstdint>
+#include <cstdio>
+#include "HAL/Hal.h"
+#include "Tasks/SpscQueue.h"
+#include "Tasks/Task.h"
+
+using SmartAirControl::SpscQueue;
+using SmartAirControl::Task;
+namespace hal = SmartAirControl::hal;
+
+// as in main.cpp
+static const uint32_t CONTROL_PERIOD_MS = 100;
+// a little off the 1 s of main.cpp, so that the sensor step drifts across
+// the control period and now and then holds up a control step that falls
+// due during it
+static const uint32_t SENSOR_PERIOD_MS = 1003;
+// a BME680 conversion collected and a PMS5003 frame parsed
+static const uint32_t SENSOR_STEP_MS = 5;
+
+static SpscQueue<uint32_t, 4> readings;
+
+class SensorStub : public Task {
+    public:
+        uint32_t step() override {
+            hal::delay(SENSOR_STEP_MS);
+            readings.push(++produced);
+            return SENSOR_PERIOD_MS - SENSOR_STEP_MS;
+        }
+
+        uint32_t produced = 0;
+};
+
+// Records how far every step started from its period
+class ControlStub : public Task {
+    public:
+        uint32_t step() override {
+            uint32_t now = hal::millis();
+            if (steps > 0) {
+                uint32_t period = now - last;
+                uint32_t jitter = period > CONTROL_PERIOD_MS ? period - CONTROL_PERIOD_MS : CONTROL_PERIOD_MS - period;
+                maxJitter = jitter > maxJitter ? jitter : maxJitter;
+            }
+            last = now;
+            steps++;
+
+            uint32_t reading;
+            while (readings.pop(reading)) {
+                inOrder = inOrder && reading == consumed + 1;
+                consumed = reading;
+            }
+            return CONTROL_PERIOD_MS;
+        }
+
+        uint32_t last = 0;
+        uint32_t steps = 0;
+        uint32_t maxJitter = 0;
+        uint32_t consumed = 0;
+        bool inOrder = true;
+};
+
+// An uplink every 10 s: the TX, then the RX1 and RX2 windows a second
+// apart and the time on air of a long frame, about 3 s in all. The task
+// waits for the radio meanwhile, as RadioLib does on the board.
+class RadioStub : public Task {
+    public:
+        uint32_t step() override {
+            static const uint32_t PHASES[] = { 1500, 1000, 500, 7000 };
+            uint32_t wait = PHASES[phase];
+            if (phase == 0) {
+                transactions++;
+            }
+            phase = (phase + 1) % 4;
+            return wait;
+        }
+
+        uint32_t phase = 0;
+        uint32_t transactions = 0;
+};
+
+static SensorStub sensorTask;
+static ControlStub controlTask;
+static RadioStub radioTask;
+static uint32_t sleptMs;
+
+// Light sleep: the clock moves on by the time until the next task
+static void lightSleep(uint32_t idleMs) {
+    sleptMs += idleMs;
+    hal::delay(idleMs);
+}
+
+void setUp() {
+    SmartAirControl::resetTasks();
+    sensorTask = SensorStub();
+    controlTask = ControlStub();
+    radioTask = RadioStub();
+    sleptMs = 0;
+    uint32_t value;
+    while (readings.pop(value)) {
+    }
+}
+
+void tearDown() {
+    SmartAirControl::resetTasks();
+}
+
+static void start() {
+    // the priorities and cores of main.cpp
+    SmartAirControl::startTask(controlTask, "control", 1, 4096, 3);
+    SmartAirControl::startTask(sensorTask, "sensor", 1, 4096, 2);
+    SmartAirControl::startTask(radioTask, "radio", 0, 8192, 1);
+}
+
+static void test_control_jitter_stays_bounded_during_radio_transactions() {
+    start();
+    uint32_t startMs = hal::millis();
+    SmartAirControl::runTasks(startMs + 10UL * 60 * 1000);
+
+    char message[96];
+    std::snprintf(message, sizeof(message), "%lu control steps, %lu radio transactions, max jitter %lu ms",
+                  static_cast<unsigned long>(controlTask.steps), static_cast<unsigned long>(radioTask.transactions),
+                  static_cast<unsigned long>(controlTask.maxJitter));
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_EQUAL_UINT32(60, radioTask.transactions);
+    // no step is lost to the radio, and none is later than the longest step
+    // of a task sharing its core; the period counts from the start of a
+    // step, so a late one moves the later ones by as much, at most
+    TEST_ASSERT_GREATER_OR_EQUAL((10UL * 60 * 1000 - sensorTask.produced * SENSOR_STEP_MS) / CONTROL_PERIOD_MS,
+                                 controlTask.steps);
+    TEST_ASSERT_LESS_OR_EQUAL(SENSOR_STEP_MS, controlTask.maxJitter);
+    // and every reading arrives, in order
+    TEST_ASSERT_TRUE(controlTask.inOrder);
+    TEST_ASSERT_UINT32_WITHIN(1, sensorTask.produced, controlTask.consumed);
+}
+
+static void test_sleeping_between_steps_adds_no_jitter() {
+    SmartAirControl::setIdleHandler(lightSleep);
+    start();
+    uint32_t startMs = hal::millis();
+    SmartAirControl::runTasks(startMs + 10UL * 60 * 1000);
+
+    TEST_ASSERT_LESS_OR_EQUAL(SENSOR_STEP_MS, controlTask.maxJitter);
+    // busy only for the sensor steps
+    TEST_ASSERT_UINT32_WITHIN(SENSOR_STEP_MS, 10UL * 60 * 1000 - sensorTask.produced * SENSOR_STEP_MS, sleptMs);
+}
+
+static void test_control_runs_first_on_a_tie() {
+    start();
+    uint32_t startMs = hal::millis();
+    // all three are due at once: the control step comes before the sensor's
+    // 5 ms of work, so it starts on time
+    SmartAirControl::runTasks(startMs);
+    TEST_ASSERT_EQUAL_UINT32(1, controlTask.steps);
+    TEST_ASSERT_EQUAL_UINT32(startMs, controlTask.last);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_control_jitter_stays_bounded_during_radio_transactions);
+    RUN_TEST(test_sleeping_between_steps_adds_no_jitter);
+    RUN_TEST(test_control_runs_first_on_a_tie);
+    return UNITY_END();
+}